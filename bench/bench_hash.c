@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/kvhash.h"
+
+#define BENCH_BYTES (256u * 1024 * 1024)
+
+static const size_t key_lengths[] = { 8, 16, 32, 64, 256, 1024, 4096 };
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// The unseeded hash the store used before, kept here as the baseline.
+static unsigned int djb2(const char *data, size_t len) {
+    unsigned int hash = 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)data[i];
+    }
+    return hash;
+}
+
+// Hashes BENCH_BYTES worth of keys of length len, each one starting where the
+// previous hash points so calls cannot overlap in the pipeline.
+static void run(const char *name, unsigned int (*hash)(const char *, size_t), const char *buf, size_t len) {
+    size_t iterations = BENCH_BYTES / len;
+    unsigned int h = 0;
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        h = hash(buf + (h & 63), len);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    printf("  %-7s %5zu bytes: %7.2f ns/key %8.2f GB/s (%x)\n", name, len,
+           (double)elapsed / (double)iterations,
+           (double)BENCH_BYTES / (double)elapsed, h);
+}
+
+int main(void) {
+    char *buf = malloc(4096 + 64);
+    for (size_t i = 0; i < 4096 + 64; i++) {
+        buf[i] = (char)('a' + i % 26);
+    }
+
+    printf("Hash throughput (%u MB per key length):\n", BENCH_BYTES >> 20);
+    for (size_t i = 0; i < sizeof(key_lengths) / sizeof(key_lengths[0]); i++) {
+        run("djb2", djb2, buf, key_lengths[i]);
+        run("kv_hash", kv_hash, buf, key_lengths[i]);
+    }
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,293 @@
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/kvstore.h"
+#include "../src/slab.h"
+
+#define BENCH_KEYS 100000
+
+static const int thread_counts[] = { 1, 2, 4, 8 };
+
+typedef struct {
+    unsigned int seed;
+    int write_pct;
+    bool churn;
+    volatile int *stop;
+    uint64_t ops;
+} bench_worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Bytes currently allocated through malloc, which also backs the arena chunks.
+static size_t heap_in_use(void) {
+    return mallinfo2().uordblks;
+}
+
+static void *bench_worker(void *arg) {
+    bench_worker_t *w = arg;
+    char key[MAX_KEY_LEN];
+    char value[64];
+
+    while (!*w->stop && w->churn) {
+        // create and drop short-lived keys: one node allocation and free each
+        snprintf(key, sizeof(key), "churn:%u:%lu", w->seed, (unsigned long)(w->ops % 1024));
+        kv_set(key, "v");
+        kv_delete(key);
+        w->ops += 2;
+    }
+
+    while (!*w->stop) {
+        int i = rand_r(&w->seed) % BENCH_KEYS;
+        snprintf(key, sizeof(key), "key:%d", i);
+
+        if (rand_r(&w->seed) % 100 < w->write_pct) {
+            kv_set(key, "updated");
+        } else {
+            kv_get_copy(key, value, sizeof(value));
+        }
+        w->ops++;
+    }
+    return NULL;
+}
+
+// Average single-threaded lookup cost over keys that exist (hit) or not (miss).
+static double lookup_ns(const char *prefix, int lookups) {
+    char key[MAX_KEY_LEN];
+    char value[64];
+    unsigned int seed = 42;
+    volatile ssize_t sink = 0;
+
+    uint64_t start = now_ns();
+    for (int n = 0; n < lookups; n++) {
+        snprintf(key, sizeof(key), "%s:%d", prefix, rand_r(&seed) % BENCH_KEYS);
+        sink += kv_get_copy(key, value, sizeof(value));
+    }
+    (void)sink;
+    return (double)(now_ns() - start) / lookups;
+}
+
+#define BENCH_HASHES 10000
+#define BENCH_HASH_FIELDS 10
+#define BENCH_LARGE_HASH_FIELDS 100000
+
+// Heap cost per field of many small hashes, then HGET latency on one large hash.
+static void bench_hashes(void) {
+    char key[MAX_KEY_LEN];
+    char field[32];
+    char value[64];
+
+    size_t heap_before = heap_in_use();
+    for (int i = 0; i < BENCH_HASHES; i++) {
+        snprintf(key, sizeof(key), "hash:%d", i);
+        for (int f = 0; f < BENCH_HASH_FIELDS; f++) {
+            snprintf(field, sizeof(field), "field%d", f);
+            kv_hset(key, field, "value-0123");
+        }
+    }
+    size_t grown = heap_in_use() - heap_before;
+    printf("hash: %.1f bytes/field over %d hashes of %d fields\n",
+           (double)grown / (BENCH_HASHES * BENCH_HASH_FIELDS), BENCH_HASHES, BENCH_HASH_FIELDS);
+
+    for (int f = 0; f < BENCH_LARGE_HASH_FIELDS; f++) {
+        snprintf(field, sizeof(field), "field%d", f);
+        kv_hset("hash:large", field, "value-0123");
+    }
+    unsigned int seed = 7;
+    const int lookups = 1000000;
+    uint64_t start = now_ns();
+    for (int n = 0; n < lookups; n++) {
+        snprintf(field, sizeof(field), "field%d", rand_r(&seed) % BENCH_LARGE_HASH_FIELDS);
+        kv_hget_copy("hash:large", field, value, sizeof(value));
+    }
+    printf("hash: HGET on a %d-field hash %.1f ns\n", BENCH_LARGE_HASH_FIELDS,
+           (double)(now_ns() - start) / lookups);
+}
+
+/*
+ * Counters: INCR and HINCRBY add to a number stored in the node or field.
+ * The last line does what HINCRBY did when fields were kept as text:
+ * read, strtod(), add, snprintf() and write back.
+ */
+static void bench_counters(void) {
+    const int incrs = 1000000;
+    char field[32];
+    char value[64];
+    int64_t n;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < incrs; i++) kv_incrby("counter", 1, &n);
+    printf("counter: INCR %.1f ns\n", (double)(now_ns() - start) / incrs);
+
+    start = now_ns();
+    for (int i = 0; i < incrs; i++) kv_hincrby("hash:0", "field7", 1, &n);
+    printf("counter: HINCRBY on a %d-field hash %.1f ns\n", BENCH_HASH_FIELDS, (double)(now_ns() - start) / incrs);
+
+    unsigned int seed = 7;
+    start = now_ns();
+    for (int i = 0; i < incrs; i++) {
+        snprintf(field, sizeof(field), "field%d", rand_r(&seed) % BENCH_LARGE_HASH_FIELDS);
+        kv_hincrby("hash:large", field, 1, &n);
+    }
+    printf("counter: HINCRBY on a %d-field hash %.1f ns\n", BENCH_LARGE_HASH_FIELDS, (double)(now_ns() - start) / incrs);
+
+    kv_hset("hash:text", "field7", "0");
+    start = now_ns();
+    for (int i = 0; i < incrs; i++) {
+        kv_hget_copy("hash:text", "field7", value, sizeof(value));
+        int len = snprintf(value, sizeof(value), "%.17g", strtod(value, NULL) + 1);
+        kv_hsetn("hash:text", 9, "field7", 6, value, (size_t)len);
+    }
+    printf("counter: text read, add and write %.1f ns\n", (double)(now_ns() - start) / incrs);
+}
+
+#define BENCH_TX_FIELDS 4        // INCR + HINCRBY pairs per batch
+#define BENCH_TX_BATCHES 100000  // batches per thread
+
+static const char *const tx_fields[BENCH_TX_FIELDS] = { "views", "likes", "shares", "replies" };
+
+// The keys EXEC collects from such a batch: the counter and the hash of every pair.
+static const char *const tx_keys[BENCH_TX_FIELDS * 2] = {
+    "tx:total", "tx:post", "tx:total", "tx:post", "tx:total", "tx:post", "tx:total", "tx:post",
+};
+
+// Runs batches of INCR and HINCRBY pairs, locking per command or, as EXEC does, once per batch.
+static void *tx_worker(void *arg) {
+    bool batched = *(const bool *)arg;
+    int64_t n;
+    for (int b = 0; b < BENCH_TX_BATCHES; b++) {
+        uint64_t locked = batched ? kv_lock_keys(tx_keys, BENCH_TX_FIELDS * 2, 1, true) : 0;
+        for (int f = 0; f < BENCH_TX_FIELDS; f++) {
+            kv_incrby("tx:total", 1, &n);
+            kv_hincrby("tx:post", tx_fields[f], 1, &n);
+        }
+        if (batched) kv_unlock_keys(locked);
+    }
+    return NULL;
+}
+
+// Returns the batches per second that threads complete together.
+static double tx_round(int threads, bool batched) {
+    pthread_t tids[8];
+    uint64_t start = now_ns();
+    for (int t = 0; t < threads; t++) pthread_create(&tids[t], NULL, tx_worker, &batched);
+    for (int t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+    return (double)threads * BENCH_TX_BATCHES / ((double)(now_ns() - start) / 1e9);
+}
+
+/**
+ * @brief Compares a MULTI/EXEC batch with the same commands run one by one.
+ *
+ * Each batch updates a string counter and BENCH_TX_FIELDS fields of a hash,
+ * as a client recording an event would. EXEC takes the two stripes once
+ * with kv_lock_keys(); run alone, every command locks its own stripe.
+ */
+static void bench_transactions(void) {
+    printf("transaction: %d INCR + %d HINCRBY per batch, locked per command / once per batch\n",
+           BENCH_TX_FIELDS, BENCH_TX_FIELDS);
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        double single = tx_round(thread_counts[i], false);
+        double batched = tx_round(thread_counts[i], true);
+        printf("  threads=%d  %10.0f / %10.0f batches/s  (x%.2f)\n", thread_counts[i], single, batched, batched / single);
+    }
+}
+
+static double run_round(int threads, int write_pct, bool churn, int duration_ms) {
+    volatile int stop = 0;
+    pthread_t tids[8];
+    bench_worker_t workers[8];
+
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (bench_worker_t){ .seed = (unsigned int)t + 1, .write_pct = write_pct, .churn = churn, .stop = &stop };
+        pthread_create(&tids[t], NULL, bench_worker, &workers[t]);
+    }
+
+    uint64_t start = now_ns();
+    struct timespec pause = { duration_ms / 1000, (long)(duration_ms % 1000) * 1000000L };
+    nanosleep(&pause, NULL);
+    stop = 1;
+
+    uint64_t total = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        total += workers[t].ops;
+    }
+    double secs = (double)(now_ns() - start) / 1e9;
+    return (double)total / secs;
+}
+
+/**
+ * @brief Measures keyspace throughput as the number of threads grows.
+ *
+ * Preloads BENCH_KEYS string keys, times single-threaded hits and misses, and
+ * runs a GET-heavy mix against them with 1, 2, 4 and 8 threads, then a
+ * SET/DEL churn round that stresses node allocation. Finally
+ * reports the memory cost of small hashes and HGET latency on a large one. `make bench`
+ * builds and runs it once per index engine.
+ *
+ * Usage: bench_kvstore [duration_ms] [write_pct]
+ */
+int main(int argc, char *argv[]) {
+    int duration_ms = argc > 1 ? atoi(argv[1]) : 1000;
+    int write_pct = argc > 2 ? atoi(argv[2]) : 5;
+
+    kv_init();
+    char key[MAX_KEY_LEN];
+    uint64_t worst_set = 0;
+    size_t heap_before = heap_in_use();
+    uint64_t load_start = now_ns();
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        uint64_t t0 = now_ns();
+        kv_set(key, "value-0123456789"); // typical 10-20 byte value
+        uint64_t took = now_ns() - t0;
+        if (took > worst_set) worst_set = took;
+    }
+    double load_secs = (double)(now_ns() - load_start) / 1e9;
+    size_t heap_after = heap_in_use();
+
+    kv_table_stats_t stats;
+    kv_table_stats(&stats);
+    printf("engine: %s\n", stats.engine);
+    printf("load: %d keys in %.3f s, slowest SET %.1f us, %lu buckets, load factor %.2f\n",
+           BENCH_KEYS, load_secs, (double)worst_set / 1e3, stats.buckets, stats.load_factor);
+    printf("memory: %.1f bytes/key (heap grew %zu bytes)\n",
+           (double)(heap_after - heap_before) / BENCH_KEYS, heap_after - heap_before);
+
+    printf("lookup: hit %.1f ns, miss %.1f ns\n", lookup_ns("key", 1000000), lookup_ns("absent", 1000000));
+
+    printf("kvstore: %d keys, %d%% writes, %d ms per round\n", BENCH_KEYS, write_pct, duration_ms);
+    double base = 0;
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        double ops = run_round(thread_counts[i], write_pct, false, duration_ms);
+        if (i == 0) base = ops;
+        printf("  threads=%d  %12.0f ops/s  (x%.2f)\n", thread_counts[i], ops, ops / base);
+    }
+
+    printf("churn: SET then DEL of short-lived keys\n");
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        double ops = run_round(thread_counts[i], 0, true, duration_ms);
+        if (i == 0) base = ops;
+        printf("  threads=%d  %12.0f ops/s  (x%.2f)\n", thread_counts[i], ops, ops / base);
+    }
+
+    slab_stats_t slabs[SLAB_MAX_CACHES];
+    int caches = slab_get_stats(slabs, SLAB_MAX_CACHES);
+    for (int i = 0; i < caches; i++) {
+        printf("slab %s: %zu slabs, %zu in use, %zu free (%.1f%% fragmentation)\n", slabs[i].name,
+               slabs[i].slabs, slabs[i].in_use, slabs[i].free_objects, 100.0 * slabs[i].fragmentation);
+    }
+
+    bench_hashes();
+    bench_counters();
+    bench_transactions();
+    return 0;
+}
@@ -0,0 +1,337 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Compares the server's I/O backends end to end over loopback.
+ *
+ * For each backend a server is started, a growing number of idle keep-alive
+ * connections is opened, and BENCH_CLIENTS connections then issue GETs back
+ * to back for BENCH_SECONDS. Reported per run: throughput, p50/p99 request
+ * latency, and the server's thread count and resident memory, which is
+ * where thread-per-connection pays for idle clients. The event loop backends
+ * also report the system calls they made per request, read from the
+ * syscalls= and commands= counters INFO keeps per I/O thread.
+ *
+ * A second pass pipelines the GETs: each client writes a batch of commands
+ * at once and then reads all the replies, so one round trip carries many
+ * requests. Latency is then per batch. Another pass repeats the pipelined runs
+ * on the event loop backends with the GETs in RESP2 instead, and a last one
+ * repeats the text runs over the server's Unix socket instead of loopback TCP.
+ */
+
+#define BENCH_PORT 18080
+#define BENCH_CLIENTS 4
+#define BENCH_SECONDS 1
+#define BENCH_MAX_SAMPLES (1 << 20)
+#define BENCH_WORKER_THREADS "8192" // a worker for every idle connection, or the threads runs stall
+
+static const char *backends[] = { "threads", "epoll", "uring" };
+static const int idle_counts[] = { 0, 1000, 5000 };
+static const int pipeline_depths[] = { 1, 16, 128 };
+
+// One GET and how its reply ends, per wire protocol.
+typedef struct {
+    const char *name;
+    const char *get;
+    const char *reply_end;
+} bench_protocol_t;
+
+static const bench_protocol_t text_protocol = { "text", "GET bench\n", "END\n" };
+static const bench_protocol_t resp_protocol = { "resp", "*2\r\n$3\r\nGET\r\n$5\r\nbench\r\n", "value\r\n" };
+
+typedef struct {
+    uint16_t port;
+    const char *unix_path; // connect here instead of the port when set
+    const bench_protocol_t *protocol;
+    int depth; // commands per round trip
+    volatile int *stop;
+    uint64_t *samples; // request latencies in ns
+    size_t count;
+} bench_client_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int connect_port(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int connect_unix(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends a batch of commands and reads until `replies` replies ending in end.
+// Returns 0 on success.
+static int round_trip(int fd, const char *cmd, size_t cmd_len, const char *end, int replies) {
+    if (send(fd, cmd, cmd_len, 0) != (ssize_t)cmd_len) return -1;
+
+    size_t end_len = strlen(end);
+    char buf[4096];
+    size_t matched = 0; // bytes of end seen so far, carried across reads
+    while (replies > 0) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return -1;
+        for (ssize_t i = 0; i < n; i++) {
+            matched = buf[i] == end[matched] ? matched + 1 : (buf[i] == end[0]);
+            if (matched == end_len) {
+                replies--;
+                matched = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *bench_client(void *arg) {
+    bench_client_t *c = arg;
+    int fd = c->unix_path ? connect_unix(c->unix_path) : connect_port(c->port);
+    if (fd < 0) return NULL;
+
+    const char *get = c->protocol->get;
+    size_t get_len = strlen(get);
+    size_t cmd_len = (size_t)c->depth * get_len;
+    char *cmd = malloc(cmd_len);
+    for (int i = 0; i < c->depth; i++) {
+        memcpy(cmd + (size_t)i * get_len, get, get_len);
+    }
+
+    while (!*c->stop && c->count < BENCH_MAX_SAMPLES) {
+        uint64_t start = now_ns();
+        if (round_trip(fd, cmd, cmd_len, c->protocol->reply_end, c->depth) != 0) break;
+        c->samples[c->count++] = now_ns() - start;
+    }
+    free(cmd);
+    close(fd);
+    return NULL;
+}
+
+static pid_t start_server(const char *server_bin, const char *backend, uint16_t port, const char *unix_path) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        char port_str[16];
+        snprintf(port_str, sizeof(port_str), "%u", port);
+        setenv("PORT", port_str, 1);
+        setenv("IO_BACKEND", backend, 1);
+        setenv("WORKER_THREADS", BENCH_WORKER_THREADS, 1);
+        setenv("UNIX_SOCKET", unix_path, 1);
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        execl(server_bin, server_bin, (char *)NULL);
+        _exit(127);
+    }
+
+    // wait until it accepts connections
+    for (int i = 0; i < 100; i++) {
+        int fd = connect_port(port);
+        if (fd >= 0) {
+            round_trip(fd, "SET bench value\n", 16, "END\n", 1);
+            close(fd);
+            return pid;
+        }
+        sleep_ms(20);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+// Sums the syscalls= and commands= counters of every io_thread line of INFO.
+// Returns -1 if the server does not count them (the threads backend).
+static int server_io_counters(uint16_t port, unsigned long *syscalls, unsigned long *commands) {
+    *syscalls = 0;
+    *commands = 0;
+    int fd = connect_port(port);
+    if (fd < 0) return -1;
+
+    char buf[16384];
+    size_t len = 0;
+    send(fd, "INFO\n", 5, 0);
+    while (len < sizeof(buf) - 1) {
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0) break;
+        len += (size_t)n;
+        buf[len] = '\0';
+        if (strstr(buf, "END\n")) break;
+    }
+    buf[len] = '\0';
+    close(fd);
+
+    bool found = false;
+    for (char *line = strstr(buf, "io_thread_"); line; line = strstr(line + 1, "io_thread_")) {
+        char *sys = strstr(line, "syscalls=");
+        char *cmds = strstr(line, "commands=");
+        if (!sys || !cmds) continue;
+        *syscalls += strtoul(sys + strlen("syscalls="), NULL, 10);
+        *commands += strtoul(cmds + strlen("commands="), NULL, 10);
+        found = true;
+    }
+    return found ? 0 : -1;
+}
+
+// Reads the Threads and VmRSS lines of /proc/<pid>/status.
+static void server_usage(pid_t pid, long *threads, long *rss_kb) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    *threads = -1;
+    *rss_kb = -1;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        sscanf(line, "Threads: %ld", threads);
+        sscanf(line, "VmRSS: %ld", rss_kb);
+    }
+    fclose(f);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Runs the clients over unix_path if set, over the port otherwise; idle connections always use the port.
+static void run(const char *backend, pid_t pid, uint16_t port, const char *unix_path,
+                const bench_protocol_t *protocol, int idle, int depth) {
+    int *idle_fds = malloc((size_t)idle * sizeof(int));
+    int opened = 0;
+    while (opened < idle) {
+        int fd = connect_port(port);
+        if (fd < 0) break;
+        idle_fds[opened++] = fd;
+        // give the server time to accept
+        if (opened % 4 == 0) sleep_ms(1);
+    }
+    sleep_ms(200); // let the threaded server spawn its threads
+
+    volatile int stop = 0;
+    bench_client_t clients[BENCH_CLIENTS];
+    pthread_t tids[BENCH_CLIENTS];
+    uint64_t *samples = malloc((size_t)BENCH_CLIENTS * BENCH_MAX_SAMPLES * sizeof(uint64_t));
+    unsigned long syscalls_before, commands_before;
+    int counted = server_io_counters(port, &syscalls_before, &commands_before);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_CLIENTS; i++) {
+        clients[i] = (bench_client_t){ .port = port, .unix_path = unix_path, .protocol = protocol, .depth = depth, .stop = &stop, .samples = samples + (size_t)i * BENCH_MAX_SAMPLES };
+        pthread_create(&tids[i], NULL, bench_client, &clients[i]);
+    }
+    sleep_ms(BENCH_SECONDS * 1000);
+    stop = 1;
+
+    size_t total = 0;
+    for (int i = 0; i < BENCH_CLIENTS; i++) {
+        pthread_join(tids[i], NULL);
+        memmove(samples + total, clients[i].samples, clients[i].count * sizeof(uint64_t));
+        total += clients[i].count;
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    char per_request[32] = "-";
+    unsigned long syscalls_after, commands_after;
+    if (counted == 0 && server_io_counters(port, &syscalls_after, &commands_after) == 0 &&
+        commands_after > commands_before) {
+        snprintf(per_request, sizeof(per_request), "%.3f",
+                 (double)(syscalls_after - syscalls_before) / (double)(commands_after - commands_before));
+    }
+
+    long threads, rss_kb;
+    server_usage(pid, &threads, &rss_kb);
+
+    qsort(samples, total, sizeof(uint64_t), compare_u64);
+    double p50 = total ? (double)samples[total / 2] / 1000.0 : 0;
+    double p99 = total ? (double)samples[total * 99 / 100] / 1000.0 : 0;
+    printf("%-8s %-4s %-4s %6d idle  depth %3d  %10.0f req/s  p50 %7.1f us  p99 %8.1f us  %6s syscalls/req  %6ld threads  %8ld KB rss\n",
+           backend, unix_path ? "unix" : "tcp", protocol->name, opened, depth, (double)total * depth / elapsed, p50, p99, per_request, threads, rss_kb);
+
+    for (int i = 0; i < opened; i++) close(idle_fds[i]);
+    free(idle_fds);
+    free(samples);
+    sleep_ms(200);
+}
+
+int main(int argc, char **argv) {
+    const char *server_bin = argc > 1 ? argv[1] : "bin/server";
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // room for the idle connections on both ends
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    printf("GET round trips from %d clients for %d s, with idle connections open\n", BENCH_CLIENTS, BENCH_SECONDS);
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        // a fresh port per run, so sockets in TIME_WAIT from the last one do not get in the way
+        uint16_t port = (uint16_t)(BENCH_PORT + (getpid() % 1000) * 3 + b);
+        char unix_path[64];
+        snprintf(unix_path, sizeof(unix_path), "/tmp/bench_server_%d_%zu.sock", (int)getpid(), b);
+        pid_t pid = start_server(server_bin, backends[b], port, unix_path);
+        if (pid < 0) {
+            fprintf(stderr, "could not start %s with IO_BACKEND=%s\n", server_bin, backends[b]);
+            return 1;
+        }
+
+        for (size_t i = 0; i < sizeof(idle_counts) / sizeof(idle_counts[0]); i++) {
+            run(backends[b], pid, port, NULL, &text_protocol, idle_counts[i], 1);
+        }
+        for (size_t i = 1; i < sizeof(pipeline_depths) / sizeof(pipeline_depths[0]); i++) {
+            run(backends[b], pid, port, NULL, &text_protocol, 0, pipeline_depths[i]);
+        }
+        if (strcmp(backends[b], "threads") != 0) {
+            for (size_t i = 0; i < sizeof(pipeline_depths) / sizeof(pipeline_depths[0]); i++) {
+                run(backends[b], pid, port, NULL, &resp_protocol, 0, pipeline_depths[i]);
+            }
+        }
+        for (size_t i = 0; i < sizeof(pipeline_depths) / sizeof(pipeline_depths[0]); i++) {
+            run(backends[b], pid, port, unix_path, &text_protocol, 0, pipeline_depths[i]);
+        }
+
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+/*
+ * Size-classed arena for variable-length keys and values.
+ *
+ * Blocks up to ARENA_MAX_CLASS_SIZE are rounded up to one of the classes
+ * below (16-byte steps up to 128, then four classes per power of two, so a
+ * block wastes at most 25%) and carved out of ARENA_CHUNK_SIZE chunks. Freed
+ * blocks go to a per-class free list and are reused by the next allocation of
+ * that class. Larger blocks go straight to malloc.
+ */
+static const size_t class_sizes[] = {
+    32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096,
+    5120, 6144, 7168, 8192,
+    10240, 12288, 14336, 16384,
+    20480, 24576, 28672, 32768,
+};
+
+#define ARENA_CLASSES (sizeof(class_sizes) / sizeof(class_sizes[0]))
+
+_Static_assert(ARENA_MAX_CLASS_SIZE == 32768, "ARENA_MAX_CLASS_SIZE must match the last class");
+
+typedef struct free_block {
+    struct free_block *next;
+} free_block;
+
+typedef struct {
+    pthread_mutex_t lock;
+    free_block *free_list;
+    char *chunk_pos;      // next uncarved byte of the current chunk
+    size_t chunk_left;
+} __attribute__((aligned(64))) arena_class;
+
+static arena_class classes[ARENA_CLASSES] = {
+    [0 ... ARENA_CLASSES - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+
+static size_t stat_allocated;
+static size_t stat_reserved;
+static size_t stat_large_blocks;
+
+static int class_index(size_t size) {
+    size_t lo = 0;
+    size_t hi = ARENA_CLASSES - 1;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (class_sizes[mid] < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)lo;
+}
+
+/**
+ * @brief Returns the number of bytes actually reserved for a block of this size.
+ */
+size_t arena_block_size(size_t size) {
+    if (size > ARENA_MAX_CLASS_SIZE) return size;
+    return class_sizes[class_index(size)];
+}
+
+void *arena_alloc(size_t size) {
+    if (size > ARENA_MAX_CLASS_SIZE) {
+        void *block = malloc(size);
+        if (block) {
+            __atomic_add_fetch(&stat_allocated, size, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&stat_reserved, size, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&stat_large_blocks, 1, __ATOMIC_RELAXED);
+        }
+        return block;
+    }
+
+    arena_class *c = &classes[class_index(size)];
+    size_t block_size = class_sizes[c - classes];
+    void *block = NULL;
+
+    pthread_mutex_lock(&c->lock);
+    if (c->free_list) {
+        block = c->free_list;
+        c->free_list = c->free_list->next;
+    } else {
+        if (c->chunk_left < block_size) {
+            char *chunk = malloc(ARENA_CHUNK_SIZE);
+            if (chunk) {
+                // the tail of the previous chunk is too small for this class and is abandoned
+                c->chunk_pos = chunk;
+                c->chunk_left = ARENA_CHUNK_SIZE;
+                __atomic_add_fetch(&stat_reserved, ARENA_CHUNK_SIZE, __ATOMIC_RELAXED);
+            }
+        }
+        if (c->chunk_left >= block_size) {
+            block = c->chunk_pos;
+            c->chunk_pos += block_size;
+            c->chunk_left -= block_size;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    if (block) {
+        __atomic_add_fetch(&stat_allocated, block_size, __ATOMIC_RELAXED);
+    }
+    return block;
+}
+
+/**
+ * @brief Returns a block to the arena.
+ *
+ * @param size The size originally passed to arena_alloc().
+ */
+void arena_free(void *ptr, size_t size) {
+    if (!ptr) return;
+
+    if (size > ARENA_MAX_CLASS_SIZE) {
+        free(ptr);
+        __atomic_sub_fetch(&stat_allocated, size, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&stat_reserved, size, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&stat_large_blocks, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    arena_class *c = &classes[class_index(size)];
+    free_block *block = ptr;
+
+    pthread_mutex_lock(&c->lock);
+    block->next = c->free_list;
+    c->free_list = block;
+    pthread_mutex_unlock(&c->lock);
+
+    __atomic_sub_fetch(&stat_allocated, class_sizes[c - classes], __ATOMIC_RELAXED);
+}
+
+void arena_get_stats(arena_stats_t *stats) {
+    stats->allocated = __atomic_load_n(&stat_allocated, __ATOMIC_RELAXED);
+    stats->reserved = __atomic_load_n(&stat_reserved, __ATOMIC_RELAXED);
+    stats->large_blocks = __atomic_load_n(&stat_large_blocks, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,20 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_MAX_CLASS_SIZE (32 * 1024)
+
+typedef struct {
+    size_t allocated;   // bytes handed out, rounded up to their size class
+    size_t reserved;    // bytes obtained from the system for arena chunks and large blocks
+    size_t large_blocks;
+} arena_stats_t;
+
+void *arena_alloc(size_t size);
+void arena_free(void *ptr, size_t size);
+size_t arena_block_size(size_t size);
+void arena_get_stats(arena_stats_t *stats);
+
+#endif
@@ -22,65 +22,62 @@
 /**
  * @brief Entry point for the TCP client application.
  *
- * Connects to a server using IP and port from environment variables or defaults, then sends commands either from command-line arguments or interactively. Prints server responses and handles connection errors gracefully.
+ * Connects to a server using IP and port from environment variables or defaults, or to its Unix socket when given a path with -s PATH or UNIX_SOCKET, then sends commands either from command-line arguments or interactively. Prints server responses and handles connection errors gracefully.
  *
  * @return 0 on success, 1 on failure.
  */
 int main(int argc, char *argv[]) {
     log_info("Version: %s\n", VERSION);
     int sockfd;
-    int status;
-    struct sockaddr_in addr;
-    char buffer[BUFFER_SIZE];
 
     const char *server_ip = getenv("HOST") ? getenv("HOST") : "127.0.0.1";
     int server_port = getenv("PORT") ? atoi(getenv("PORT")) : 8080;
-
-    sockfd = socket(PF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        perror("socket");
-        return 1;
+    const char *unix_socket = getenv("UNIX_SOCKET");
+
+    // -s PATH goes before the command; shift it out so argv[1] starts the command again
+    if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+        unix_socket = argv[2];
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
     }
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = PF_INET;
-    addr.sin_port = htons((uint16_t)server_port);
-    inet_aton(server_ip, &addr.sin_addr);
-
-    status = connect(sockfd, (struct sockaddr *) &addr, sizeof(addr));
-    if (status) {
-        perror("connect");
-        close(sockfd);
-        return 1;
+    if (unix_socket) {
+        sockfd = connect_unix(unix_socket);
+        if (sockfd < 0) return 1;
+        log_info("Connected to %s\n", unix_socket);
+    } else {
+        sockfd = connect_tcp(server_ip, server_port);
+        if (sockfd < 0) return 1;
+        log_info("Connected to %s:%d\n", server_ip, server_port);
     }
 
-    log_info("Connected to %s:%d\n", server_ip, server_port);
-
     // Line command mode
     if (argc > 1) {
-        char command[BUFFER_SIZE] = {0};
-        if (build_command_string(argc, argv, command, sizeof(command)) != 0) {
+        size_t size = command_string_size(argc, argv);
+        char *command = malloc(size);
+        if (!command || build_command_string(argc, argv, command, size) != 0) {
             log_error("Failed to construct command\n");
+            free(command);
             close(sockfd);
             return 1;
         }
 
         command_t cmd = parse_command(command);
         if (cmd == CMD_UNKNOWN) {
-            char command_name[64];
-            sscanf(command, "%s", command_name);
-            log_error("Invalid command: %s\n", command_name);
+            log_error("Invalid command: %s\n", argv[1]);
+            free(command);
             close(sockfd);
             return 1;
         }
 
-        if (build_command_string(argc, argv, command, sizeof(command)) != 0) {
-            log_error("Failed to construct command\n");
+        int sent = send_command(sockfd, command);
+        free(command);
+        if (sent < 0) {
+            log_error("Failed to send command\n");
             close(sockfd);
             return 1;
         }
-
-        send_command(sockfd, command);
         read_response(sockfd);
 
         close(sockfd);
@@ -89,21 +86,21 @@ int main(int argc, char *argv[]) {
 
     // Interactive mode
     bool running = true;
+    char *line = NULL;
+    size_t line_size = 0;
 
     while (running) {
         printf("Enter command (or 'exit' to quit): ");
-        memset(buffer, 0, sizeof(buffer));
-        fgets(buffer, sizeof(buffer), stdin);
-
-        if (strncmp(buffer, "exit", 4) == 0) {
+        if (getline(&line, &line_size, stdin) < 0 || strncmp(line, "exit", 4) == 0) {
             running = false;
             continue;
         }
 
-        send_command(sockfd, buffer);
+        send_command(sockfd, line);
         read_response(sockfd);
     }
 
+    free(line);
     close(sockfd);
     return 0;
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
+#include <errno.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h> 
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
 #include <sys/time.h>
 #include <stdbool.h>
 
@@ -63,10 +69,77 @@ int build_command_string(int argc, char *argv[], char *buffer, size_t buffer_siz
     return 0;
 }
 
+/**
+ * @brief Connects to the server's TCP port.
+ *
+ * @return The connected socket, or -1 on error (logged).
+ */
+int connect_tcp(const char *ip, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_aton(ip, &addr.sin_addr) == 0) {
+        log_error("Invalid address: %s", ip);
+        return -1;
+    }
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/**
+ * @brief Connects to the server's Unix socket, for a client on the same host.
+ *
+ * @return The connected socket, or -1 on error (logged).
+ */
+int connect_unix(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_error("Unix socket path too long: %s", path);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/**
+ * @brief Bytes build_command_string() may need for argv, its NUL included.
+ *
+ * Counts every byte as if it needed escaping and every word as quoted.
+ */
+size_t command_string_size(int argc, char *argv[]) {
+    size_t size = 1;
+    for (int i = 1; i < argc; i++) size += strlen(argv[i]) * 2 + 3;
+    return size;
+}
+
 /**
  * @brief Sends a command string over a socket and measures transmission time.
  *
- * Sends the specified command over the given socket file descriptor. If the command is "PING", prints the round-trip time in microseconds. Returns the number of bytes sent, or -1 if the command is too long.
+ * Sends the specified command over the given socket file descriptor, followed by a newline unless it ends with one, going on after short writes so a command of any length goes out whole. If the command is "PING", prints the round-trip time in microseconds.
  *
  * @param sockfd Socket file descriptor to send the command through.
  * @param command Null-terminated command string to send.
@@ -77,12 +150,31 @@ int send_command(int sockfd, const char *command) {
     struct timeval end;
     gettimeofday(&start, NULL); 
 
-    size_t cmd_len = strnlen(command, BUFFER_SIZE);
-    if (cmd_len >= BUFFER_SIZE) {
-        log_error("Command too long: %s", command);
-        return -1;
+    size_t cmd_len = strlen(command);
+    // the server frames commands by newline; argv mode builds them without one
+    struct iovec iov[2] = {
+        { .iov_base = (void *)command, .iov_len = cmd_len },
+        { .iov_base = "\n", .iov_len = cmd_len == 0 || command[cmd_len - 1] != '\n' ? 1 : 0 },
+    };
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+    size_t total = iov[0].iov_len + iov[1].iov_len;
+    size_t sent = 0;
+    while (sent < total) {
+        ssize_t n = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        sent += (size_t)n;
+        // skip what was written, possibly part of the first block
+        while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov[0].iov_len) {
+            n -= (ssize_t)msg.msg_iov[0].iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = (char *)msg.msg_iov[0].iov_base + n;
+            msg.msg_iov[0].iov_len -= (size_t)n;
+        }
     }
-    ssize_t bytes_sent = send(sockfd, command, cmd_len, 0);
 
     gettimeofday(&end, NULL);
     uint64_t delta_us = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_usec - start.tv_usec);
@@ -90,7 +182,7 @@ int send_command(int sockfd, const char *command) {
         printf("Ping response time: %" PRIu64 " microseconds\n", delta_us);
     }
 
-    return (int)bytes_sent;
+    return (int)sent;
 }
 
 
@@ -109,7 +201,14 @@ bool handle_char(char c, char *line_buffer, size_t *line_pos, bool *first_line)
 
         *first_line = false;
         *line_pos = 0; 
-    } else if (*line_pos < BUFFER_SIZE - 1) {
+    } else {
+        // a line longer than the buffer is printed in pieces
+        if (*line_pos == BUFFER_SIZE - 1) {
+            line_buffer[*line_pos] = '\0';
+            printf("%s", line_buffer);
+            *first_line = false;
+            *line_pos = 0;
+        }
         line_buffer[(*line_pos)++] = c;
     }
 
@@ -1,11 +1,16 @@
 #ifndef CLIENT_UTILS_H
 #define CLIENT_UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
+// Bytes read from the socket at a time, and the longest reply line printed in one piece.
 #define BUFFER_SIZE 1024
 
+int connect_tcp(const char *ip, int port);
+int connect_unix(const char *path);
 int send_command(int sockfd, const char *command);
+size_t command_string_size(int argc, char *argv[]);
 int build_command_string(int argc, char *argv[], char *buffer, size_t buffer_size);
 void read_response(int sockfd);
 bool handle_char(char c, char *line_buffer, size_t *line_pos, bool *first_line);
@@ -0,0 +1,74 @@
+#include "clients.h"
+
+static client_limits_t limits;
+static unsigned long connected;
+static unsigned long rejected;
+static unsigned long evicted;
+static unsigned long timed_out;
+
+// Set once at startup, before any connection is accepted.
+void clients_set_limits(const client_limits_t *l) {
+    limits = *l;
+}
+
+const client_limits_t *clients_limits(void) {
+    return &limits;
+}
+
+/**
+ * @brief Counts a newly accepted connection against maxclients.
+ *
+ * @return true if it may be served; false if it is over the limit, in which
+ *         case it is counted as rejected and must not be released.
+ */
+bool clients_admit(void) {
+    unsigned long now_connected = __atomic_add_fetch(&connected, 1, __ATOMIC_RELAXED);
+    if (limits.maxclients > 0 && now_connected > (unsigned long)limits.maxclients) {
+        __atomic_sub_fetch(&connected, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&rejected, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+// Ends a connection clients_admit() let in.
+void clients_release(void) {
+    __atomic_sub_fetch(&connected, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Checks a connection's pending reply bytes against the output limits.
+ *
+ * @param soft_since When the connection went over the soft limit, 0 while it
+ *                   is under; updated here.
+ * @return true if the connection should be disconnected.
+ */
+bool clients_output_exceeded(size_t pending, time_t now, time_t *soft_since) {
+    if (limits.output_hard_limit > 0 && pending >= limits.output_hard_limit) return true;
+
+    if (limits.output_soft_limit == 0 || pending < limits.output_soft_limit) {
+        *soft_since = 0;
+        return false;
+    }
+    if (*soft_since == 0) *soft_since = now;
+    return now - *soft_since >= limits.output_soft_seconds;
+}
+
+bool clients_idle_expired(time_t last_active, time_t now) {
+    return limits.timeout > 0 && now - last_active > limits.timeout;
+}
+
+void clients_count_evicted(void) {
+    __atomic_add_fetch(&evicted, 1, __ATOMIC_RELAXED);
+}
+
+void clients_count_timed_out(void) {
+    __atomic_add_fetch(&timed_out, 1, __ATOMIC_RELAXED);
+}
+
+void clients_stats(client_stats_t *out) {
+    out->connected = __atomic_load_n(&connected, __ATOMIC_RELAXED);
+    out->rejected = __atomic_load_n(&rejected, __ATOMIC_RELAXED);
+    out->evicted = __atomic_load_n(&evicted, __ATOMIC_RELAXED);
+    out->timed_out = __atomic_load_n(&timed_out, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,38 @@
+#ifndef CLIENTS_H
+#define CLIENTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+/*
+ * Limits every backend applies to client connections, and the counters INFO
+ * reports for them. A zero limit is no limit.
+ */
+typedef struct {
+    int maxclients;              // connections served at once
+    int timeout;                 // seconds a connection may go without reading or writing
+    size_t output_hard_limit;    // pending reply bytes that disconnect a client at once
+    size_t output_soft_limit;    // pending reply bytes that disconnect a client after output_soft_seconds
+    int output_soft_seconds;
+    size_t max_request;          // longest command accepted, in bytes
+} client_limits_t;
+
+typedef struct {
+    unsigned long connected;
+    unsigned long rejected;  // turned away at maxclients
+    unsigned long evicted;   // disconnected for their output buffer
+    unsigned long timed_out; // disconnected after timeout idle seconds
+} client_stats_t;
+
+void clients_set_limits(const client_limits_t *limits);
+const client_limits_t *clients_limits(void);
+bool clients_admit(void);
+void clients_release(void);
+bool clients_output_exceeded(size_t pending, time_t now, time_t *soft_since);
+bool clients_idle_expired(time_t last_active, time_t now);
+void clients_count_evicted(void);
+void clients_count_timed_out(void);
+void clients_stats(client_stats_t *out);
+
+#endif
@@ -1,52 +1,52 @@
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
 
 #include "commands.h"
 #include "kvstore.h"
+#include "kvnum.h"
 #include "protocol.h"
 #include "errors.h"
 #include "info.h"
 
-#define BUFFER_SIZE 1024
-
-static command_entry_t command_table[] = {
-    { CMD_PING,    cmd_ping },
-    { CMD_TIME,    cmd_time },
-    { CMD_SET,     cmd_set },
-    { CMD_GET,     cmd_get },
-    { CMD_MSET,    cmd_mset },
-    { CMD_MGET,    cmd_mget },
-    { CMD_DEL,     cmd_del },
-    { CMD_INFO,    cmd_info },
-    { CMD_TYPE,    cmd_type },
-    { CMD_HSET,    cmd_hset },
-    { CMD_HGET,    cmd_hget },
-    { CMD_HMGET,   cmd_hmget },
-    { CMD_HINCRBY, cmd_hincrby },
-    { CMD_UNKNOWN, NULL }  // Sentinel
+// Text protocol handlers, from the command list in protocol.h.
+#define COMMAND_PROC(id, name, arity, flags, keys, proc, resp_proc) [CMD_##id] = proc,
+
+static const command_proc_t command_procs[CMD_COUNT] = {
+    COMMAND_LIST(COMMAND_PROC)
 };
 
+// Calls and time per command, over both protocols, for INFO.
+static command_stats_t command_stats[CMD_COUNT];
+
+// Set while EXEC runs a transaction, whose replies share its RESPONSE block.
+static __thread bool in_exec;
+
 static const char *kv_type_names[] = {
     [KV_STRING] = "string",
     [KV_HASH]   = "hash",
 };
 
-void send_response_header(int clientfd, const char *type) {
-    char header[BUFFER_SIZE];
-    int len = snprintf(header, sizeof(header), "RESPONSE %s\n", type);
-    send(clientfd, header, len, 0);
+/**
+ * @brief Starts a reply. Inside EXEC only the type line is written, so each
+ * queued command's reply is its type followed by its data.
+ */
+void send_response_header(reply_t *out, const char *type) {
+    reply_printf(out, in_exec ? "%s\n" : "RESPONSE %s\n", type);
 }
 
-void send_response_footer(int clientfd) {
-    send(clientfd, "END\n", 4, 0);
+void send_response_footer(reply_t *out) {
+    if (!in_exec) reply_append(out, "END\n", 4);
 }
 
-void send_error_response(int clientfd, int res) {
-    send_response_header(clientfd, "ERROR");
+void send_error_response(reply_t *out, int res) {
+    send_response_header(out, "ERROR");
 
     const char *msg;
 
@@ -60,283 +60,428 @@ void send_error_response(int clientfd, int res) {
         case EXTRACT_ERR_KEY_NOT_FOUND:
             msg = ERR_NOT_FOUND;
             break;
+        case EXTRACT_ERR_OOM:
+            msg = ERR_OOM;
+            break;
+        case EXTRACT_ERR_LINE_TOO_LONG:
+            msg = ERR_LINE_TOO_LONG;
+            break;
+        case EXTRACT_ERR_BUSY:
+            msg = ERR_BUSY;
+            break;
+        case EXTRACT_ERR_MAX_CLIENTS:
+            msg = ERR_MAX_CLIENTS;
+            break;
+        case EXTRACT_ERR_NOT_INTEGER:
+            msg = ERR_NOT_INTEGER;
+            break;
+        case EXTRACT_ERR_NOT_FLOAT:
+            msg = ERR_NOT_FLOAT;
+            break;
+        case EXTRACT_ERR_OVERFLOW:
+            msg = ERR_OVERFLOW;
+            break;
+        case EXTRACT_ERR_NESTED_MULTI:
+            msg = ERR_NESTED_MULTI;
+            break;
+        case EXTRACT_ERR_NO_MULTI:
+            msg = ERR_NO_MULTI;
+            break;
+        case EXTRACT_ERR_EXEC_ABORT:
+            msg = ERR_EXEC_ABORT;
+            break;
         case EXTRACT_ERR_PARSE:
         default:
             msg = ERR_PARSE_ERROR;
             break;
     }
 
-    send(clientfd, msg, strlen(msg), 0); //NOSONAR
-    send_response_footer(clientfd);
+    reply_str(out, msg);
+    send_response_footer(out);
 }
 
-int extract_key_field(const char *message, char *key, size_t key_size, char *field, size_t field_size) {
-    const char *p = message;
-
-    // Skip command word
-    while (*p != ' ' && *p != '\0' && *p != '\n') p++;
-    if (*p == '\0' || *p == '\n') return EXTRACT_ERR_PARSE;
-    while (*p == ' ') p++;
-
-    // Extract key
-    int res = extract_key_from_ptr(&p, key, key_size);
-    if (res != EXTRACT_OK) return res;
-
-    // Extract field
-    res = extract_key_from_ptr(&p, field, field_size);
-    if (res != EXTRACT_OK) return res;
-
+/**
+ * @brief Checks that the arguments from first on, every step-th one, fit as keys.
+ *
+ * @return EXTRACT_OK or EXTRACT_ERR_KEY_TOO_LONG.
+ */
+static int check_keys(const command_args_t *args, int first, int step) {
+    for (int i = first; i < args->argc; i += step) {
+        if (args->argv_len[i] >= MAX_KEY_LEN) return EXTRACT_ERR_KEY_TOO_LONG;
+    }
     return EXTRACT_OK;
 }
 
-int extract_key_from_ptr(const char **p, char *key, size_t key_size) {
-    while (**p == ' ') (*p)++;
+static void send_simple_ok_string(reply_t *out, const char *msg) {
+    send_response_header(out, "OK STRING");
+    reply_str(out, msg);
+    send_response_footer(out);
+}
 
-    if (**p == '"') {
-        // parse quoted token
-        (*p)++; // skip opening quote
-        const char *key_start = *p;
-        const char *quote_end = strchr(*p, '"');
-        if (!quote_end) return EXTRACT_ERR_PARSE;
+/**
+ * @brief Appends a value read with kv_get_ref() or kv_hget_ref() and releases it.
+ *
+ * A pinned value of REPLY_REF_MIN bytes or more is not copied: the reply
+ * takes over the pin and writes straight from the store's block.
+ */
+void append_value(reply_t *out, kv_ref *ref) {
+    if (ref->pinned && ref->len >= REPLY_REF_MIN) {
+        reply_ref(out, ref->data, ref->len, kv_unpin);
+        ref->pinned = false;
+        return;
+    }
+    reply_append(out, ref->data, ref->len);
+    kv_ref_release(ref);
+}
 
-        size_t key_len = quote_end - key_start;
-        if (key_len >= key_size) return EXTRACT_ERR_KEY_TOO_LONG;
+// Parses a whole token as a base-10 integer.
+static int parse_int64(const char *token, size_t len, int64_t *out) {
+    char digits[32];
+    if (len == 0 || len >= sizeof(digits)) return -1;
+    memcpy(digits, token, len);
+    digits[len] = '\0';
+
+    char *end;
+    errno = 0;
+    long long v = strtoll(digits, &end, 10);
+    if (errno != 0 || *end != '\0') return -1;
+    *out = (int64_t)v;
+    return 0;
+}
 
-        memcpy(key, key_start, key_len);
-        key[key_len] = '\0';
-        *p = quote_end + 1; // skip closing quote
+/**
+ * @brief Parses the "EX seconds" or "PX milliseconds" option of SET.
+ *
+ * @return 0 with *ttl_ms set, or EXTRACT_ERR_PARSE if the option is unknown
+ *         or the time is not a positive integer.
+ */
+static int parse_set_expiry(const command_args_t *args, int i, int64_t *ttl_ms) {
+    int64_t unit;
+    if (strcasecmp(args->argv[i], "EX") == 0) {
+        unit = 1000;
+    } else if (strcasecmp(args->argv[i], "PX") == 0) {
+        unit = 1;
     } else {
-        // unquoted token
-        const char *key_start = *p;
-        while (**p != ' ' && **p != '\0' && **p != '\n') (*p)++;
-        size_t key_len = *p - key_start;
-        if (key_len >= key_size) return EXTRACT_ERR_KEY_TOO_LONG;
-
-        memcpy(key, key_start, key_len);
-        key[key_len] = '\0';
+        return EXTRACT_ERR_PARSE;
     }
 
-    while (**p == ' ') (*p)++;
+    int64_t ttl;
+    if (parse_int64(args->argv[i + 1], args->argv_len[i + 1], &ttl) != 0 || ttl <= 0 || ttl > INT64_MAX / 1000 / unit) {
+        return EXTRACT_ERR_PARSE;
+    }
+    *ttl_ms = ttl * unit;
     return EXTRACT_OK;
 }
 
-int extract_value_from_ptr(const char **p, char *value, size_t value_size) {
-    if (**p == '\0' || **p == '\n') return EXTRACT_ERR_PARSE;  // <--- ADD THIS LINE
+static int store_error(int res) {
+    switch (res) {
+        case KV_ERR_TOO_LARGE:   return EXTRACT_ERR_VALUE_TOO_LONG;
+        case KV_ERR_OOM:         return EXTRACT_ERR_OOM;
+        case KV_ERR_NOT_INTEGER: return EXTRACT_ERR_NOT_INTEGER;
+        case KV_ERR_NOT_FLOAT:   return EXTRACT_ERR_NOT_FLOAT;
+        case KV_ERR_OVERFLOW:    return EXTRACT_ERR_OVERFLOW;
+        default:                 return EXTRACT_ERR_INTERNAL;
+    }
+}
 
-    if (**p == '"') {
-        (*p)++;
-        const char *value_start = *p;
-        const char *quote_end = strchr(*p, '"');
-        if (!quote_end) return EXTRACT_ERR_PARSE;
+uint64_t commands_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
 
-        size_t value_len = quote_end - value_start;
-        if (value_len >= value_size) return EXTRACT_ERR_VALUE_TOO_LONG;
+// Counts a call of cmd that began at start_us (from commands_clock_us()) and has just returned.
+void commands_count_call(command_t cmd, uint64_t start_us) {
+    __atomic_add_fetch(&command_stats[cmd].calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&command_stats[cmd].usec, commands_clock_us() - start_us, __ATOMIC_RELAXED);
+}
 
-        memcpy(value, value_start, value_len);
-        value[value_len] = '\0';
-        *p = quote_end + 1;
-    } else {
-        const char *value_start = *p;
-        while (**p != ' ' && **p != '\0' && **p != '\n') (*p)++;
-        size_t value_len = *p - value_start;
+// Counts a call of cmd turned away before its handler, for a wrong argument count or key.
+void commands_count_rejected(command_t cmd) {
+    __atomic_add_fetch(&command_stats[cmd].rejected_calls, 1, __ATOMIC_RELAXED);
+}
 
-        if (value_len == 0) return EXTRACT_ERR_PARSE;
+void commands_stats(command_t cmd, command_stats_t *out) {
+    out->calls = __atomic_load_n(&command_stats[cmd].calls, __ATOMIC_RELAXED);
+    out->usec = __atomic_load_n(&command_stats[cmd].usec, __ATOMIC_RELAXED);
+    out->rejected_calls = __atomic_load_n(&command_stats[cmd].rejected_calls, __ATOMIC_RELAXED);
+}
 
-        if (value_len >= value_size) return EXTRACT_ERR_VALUE_TOO_LONG;
+/**
+ * @brief Runs a tokenized text command.
+ *
+ * The argument count and the length of every key are checked against the
+ * command's entry in the registry before its handler runs, and the call is
+ * counted in the command's stats. Between MULTI and EXEC a command that
+ * passes the checks is queued instead, and one that fails them makes EXEC
+ * refuse the transaction.
+ */
+void handle_command(reply_t *out, command_t cmd, command_args_t *args) {
+    const command_def_t *def = command_def(cmd);
+
+    int res = command_arity_ok(def, args->argc) ? EXTRACT_OK : EXTRACT_ERR_PARSE;
+    if (res == EXTRACT_OK && def->first_key > 0) {
+        int last = command_last_key(def, args->argc);
+        for (int i = def->first_key; i <= last && res == EXTRACT_OK; i += def->key_step) {
+            if (args->argv_len[i] >= MAX_KEY_LEN) res = EXTRACT_ERR_KEY_TOO_LONG;
+        }
+    }
+    if (res != EXTRACT_OK) {
+        commands_count_rejected(cmd);
+        args->queue.failed = true;
+        send_error_response(out, res);
+        return;
+    }
 
-        memcpy(value, value_start, value_len);
-        value[value_len] = '\0';
+    if (args->queue.active && !(def->flags & COMMAND_NOQUEUE)) {
+        res = command_queue_push(&args->queue, cmd, args);
+        if (res != EXTRACT_OK) {
+            args->queue.failed = true;
+            send_error_response(out, res);
+            return;
+        }
+        send_simple_ok_string(out, "QUEUED\n");
+        return;
     }
 
-    while (**p == ' ') (*p)++;
-    return EXTRACT_OK;
+    uint64_t start = commands_clock_us();
+    command_procs[cmd](out, args);
+    commands_count_call(cmd, start);
 }
 
-static void send_simple_ok_string(int clientfd, const char *msg) {
-    send_response_header(clientfd, "OK STRING");
-    send(clientfd, msg, strnlen(msg, BUFFER_SIZE), 0);
-    send_response_footer(clientfd);
-}
+/**
+ * @brief Runs the commands queued since MULTI as one atomic batch.
+ *
+ * Every key the batch names is gathered first and their stripes are locked
+ * once by kv_lock_keys(), in ascending order, exclusively if any command
+ * writes. The commands' own kv_* calls then skip locking, and other clients
+ * see the batch applied as a whole or not at all. A command that fails does
+ * not stop the ones after it; nothing is rolled back. The connection leaves
+ * the transaction before the first command runs.
+ *
+ * @param begin Starts the reply of EXEC, once nothing can fail any more.
+ * @param run   Checks and runs one command: handle_command(), or the RESP2 one.
+ * @return EXTRACT_OK, or EXTRACT_ERR_OOM if the batch could not be prepared;
+ *         the transaction is discarded either way.
+ */
+int commands_exec(reply_t *out, command_args_t *args, void (*begin)(reply_t *out, int count), command_run_t run) {
+    command_queue_t queue = args->queue;
+    args->queue = (command_queue_t){ 0 };
+
+    const char **keys = queue.args_count > 0 ? malloc(queue.args_count * sizeof(*keys)) : NULL;
+    if (queue.args_count > 0 && !keys) {
+        command_queue_clear(&queue);
+        return EXTRACT_ERR_OOM;
+    }
 
-void handle_command(int clientfd, command_t cmd, const char *message) {
-    for (int i = 0; command_table[i].proc != NULL; i++) {
-        if (command_table[i].cmd == cmd) {
-            command_table[i].proc(clientfd, message);
-            return;
+    int key_count = 0;
+    bool write = false;
+    for (int i = 0; i < queue.count; i++) {
+        command_t cmd = command_queue_load(&queue, i, args);
+        if (cmd == CMD_UNKNOWN) {
+            free(keys);
+            command_queue_clear(&queue);
+            return EXTRACT_ERR_OOM;
         }
+
+        const command_def_t *def = command_def(cmd);
+        if (def->flags & COMMAND_WRITE) write = true;
+        if (def->first_key == 0) continue;
+        int last = command_last_key(def, args->argc);
+        for (int k = def->first_key; k <= last; k += def->key_step) keys[key_count++] = args->argv[k];
+    }
+
+    begin(out, queue.count);
+    uint64_t locked = kv_lock_keys((const char *const *)keys, key_count, 1, write);
+    for (int i = 0; i < queue.count; i++) {
+        run(out, command_queue_load(&queue, i, args), args);
     }
+    kv_unlock_keys(locked);
+
+    args->argc = 0;
+    free(keys);
+    command_queue_clear(&queue);
+    return EXTRACT_OK;
 }
 
-void cmd_ping(int clientfd, const char *message) {
-    (void)message;
-    send_response_header(clientfd, "OK STRING");
+void cmd_ping(reply_t *out, command_args_t *args) {
+    (void)args;
+    send_response_header(out, "OK STRING");
 
-    const char *response = "PONG\n";
-    send(clientfd, response, 5, 0);
+    reply_append(out, "PONG\n", 5);
 
-    send_response_footer(clientfd);
+    send_response_footer(out);
 }
 
-void cmd_time(int clientfd, const char *message) {
-    (void)message;
-    send_response_header(clientfd, "OK STRING");
+void cmd_echo(reply_t *out, command_args_t *args) {
+    send_response_header(out, "OK STRING");
+    reply_append(out, args->argv[1], args->argv_len[1]);
+    reply_append(out, "\n", 1);
+    send_response_footer(out);
+}
+
+void cmd_time(reply_t *out, command_args_t *args) {
+    (void)args;
+    send_response_header(out, "OK STRING");
 
     time_t now = time(NULL);
-    char timestr[BUFFER_SIZE];
+    char timestr[32]; // ctime_r() needs 26
     ctime_r(&now, timestr);
-    send(clientfd, timestr, strlen(timestr), 0); //NOSONAR
+    reply_str(out, timestr);
 
-    send_response_footer(clientfd);
+    send_response_footer(out);
 }
 
-void cmd_set(int clientfd, const char *buffer) {
-    char key[MAX_KEY_LEN];
-    char value[MAX_VAL_LEN];
-    int res = extract_key_value(buffer, key, value, sizeof(key), sizeof(value));
-
+// SET key value [EX seconds|PX milliseconds]
+void cmd_set(reply_t *out, command_args_t *args) {
+    int64_t ttl_ms = 0;
+    int res = args->argc == 3 ? EXTRACT_OK : EXTRACT_ERR_PARSE;
+    if (args->argc == 5) res = parse_set_expiry(args, 3, &ttl_ms);
     if (res != EXTRACT_OK) {
-        send_error_response(clientfd, res);
+        send_error_response(out, res);
         return;
     }
 
-    if (kv_set(key, value) == 0) {
-        send_simple_ok_string(clientfd, "OK\n");
+    res = kv_setex(args->argv[1], args->argv_len[1], args->argv[2], args->argv_len[2], ttl_ms);
+    if (res == 0) {
+        send_simple_ok_string(out, "OK\n");
     } else {
-        send_error_response(clientfd, EXTRACT_ERR_INTERNAL);
+        send_error_response(out, store_error(res));
     }
 }
 
-void cmd_get(int clientfd, const char *buffer) {
-    char key[MAX_KEY_LEN];
-    if (extract_key(buffer, key, sizeof(key)) != 0) {
-        send_error_response(clientfd, EXTRACT_ERR_PARSE);
-        return;
-    }
-
-    const char *val = kv_get(key);
+void cmd_get(reply_t *out, command_args_t *args) {
+    kv_ref val;
+    bool found = kv_get_ref(args->argv[1], &val);
 
-    send_response_header(clientfd, "OK STRING");
+    send_response_header(out, "OK STRING");
 
-    if (val) {
-        size_t len = strnlen(val, MAX_VAL_LEN);
-        send(clientfd, val, len, 0);
-        send(clientfd, "\n", 1, 0);
+    if (found) {
+        append_value(out, &val);
+        reply_append(out, "\n", 1);
     } else {
-        send(clientfd, ERR_NOT_FOUND, strlen(ERR_NOT_FOUND), 0);
+        reply_str(out, ERR_NOT_FOUND);
     }
 
-    send_response_footer(clientfd);
+    send_response_footer(out);
 }
 
-void cmd_del(int clientfd, const char *buffer) {
-    char key[MAX_KEY_LEN];
-    if (extract_key(buffer, key, sizeof(key)) != 0) {
-        send_error_response(clientfd, EXTRACT_ERR_PARSE);
-        return;
+// DEL key [key ...]: DELETED if any of the keys existed
+void cmd_del(reply_t *out, command_args_t *args) {
+    int deleted = 0;
+    for (int i = 1; i < args->argc; i++) {
+        if (kv_delete(args->argv[i]) == 0) deleted++;
     }
 
-    if (kv_delete(key) == 0) {
-        send_simple_ok_string(clientfd, "DELETED\n");
+    if (deleted > 0) {
+        send_simple_ok_string(out, "DELETED\n");
     } else {
-        send_error_response(clientfd, EXTRACT_ERR_KEY_NOT_FOUND);
+        send_error_response(out, EXTRACT_ERR_KEY_NOT_FOUND);
     }
 }
 
-void cmd_mset(int clientfd, const char *buffer) {
-    char copy[BUFFER_SIZE];
-    snprintf(copy, sizeof(copy), "%s", buffer);
-
-    const char *p = copy + 5;  // Skip "MSET "
-    while (*p == ' ') p++;
-
-    while (*p != '\0' && *p != '\n') {
-        char key[MAX_KEY_LEN];
-        char value[MAX_VAL_LEN];
-
-        int key_res = extract_key_from_ptr(&p, key, MAX_KEY_LEN);
-        if (key_res != EXTRACT_OK) {
-            send_error_response(clientfd, key_res);
-            return;
-        }
+// MSET key value [key value ...], applied under one lock acquisition
+void cmd_mset(reply_t *out, command_args_t *args) {
+    if (args->argc % 2 == 0) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
+        return;
+    }
 
-        int value_res = extract_value_from_ptr(&p, value, MAX_VAL_LEN);
-        if (value_res != EXTRACT_OK) {
-            send_error_response(clientfd, value_res);
-            return;
-        }
+    int res = 0;
+    uint64_t locked = kv_lock_keys((const char *const *)args->argv + 1, (args->argc - 1) / 2, 2, true);
+    for (int i = 1; i < args->argc && res == 0; i += 2) {
+        res = kv_setn(args->argv[i], args->argv_len[i], args->argv[i + 1], args->argv_len[i + 1]);
+    }
+    kv_unlock_keys(locked);
 
-        if (kv_set(key, value) != 0) {
-            send_error_response(clientfd, EXTRACT_ERR_INTERNAL);
-            return;
-        }
+    if (res != 0) {
+        send_error_response(out, store_error(res));
+        return;
     }
 
-    send_response_header(clientfd, "OK STRING");
-    send(clientfd, "OK\n", 3, 0);
-    send_response_footer(clientfd);
+    send_response_header(out, "OK STRING");
+    reply_append(out, "OK\n", 3);
+    send_response_footer(out);
 }
 
-void cmd_mget(int clientfd, const char *buffer) {
-    char copy[BUFFER_SIZE];
-    snprintf(copy, sizeof(copy), "%s", buffer);
-
-    char *newline = strchr(copy, '\n');
-    if (newline) *newline = '\0';
-
-    char *saveptr = NULL;
-    char *token = strtok_r(copy + 5, " ", &saveptr); //NOSONAR
-
-    send_response_header(clientfd, "OK MULTI");
-
-    int index = 1;
-    while (token != NULL) {
-        const char *key = token;
-        const char *val = kv_get(key);
-
-        char line[BUFFER_SIZE];
-        int len = (val && val[0] != '\0')
-            ? snprintf(line, sizeof(line), "%d) %s\n", index, val)
-            : snprintf(line, sizeof(line), "%d) (nil)\n", index);
+void cmd_mget(reply_t *out, command_args_t *args) {
+    // Snapshot all values under shared locks, straight into the reply
+    send_response_header(out, "OK MULTI");
 
-        send(clientfd, line, len, 0);
+    uint64_t locked = kv_lock_keys((const char *const *)args->argv + 1, args->argc - 1, 1, false);
+    for (int i = 1; i < args->argc; i++) {
+        kv_ref val;
+        bool found = kv_get_ref(args->argv[i], &val);
 
-        index++;
-        token = strtok_r(NULL, " ", &saveptr);
+        reply_printf(out, "%d) ", i);
+        if (found && val.len > 0) {
+            append_value(out, &val);
+        } else {
+            if (found) kv_ref_release(&val);
+            reply_append(out, "(nil)", 5);
+        }
+        reply_append(out, "\n", 1);
     }
+    kv_unlock_keys(locked);
 
-    send_response_footer(clientfd);
+    send_response_footer(out);
 }
 
-void cmd_info(int clientfd, const char *message) {
-    (void)message;
-    char version[80];
-    char uptime[80];
-    char memory[80];
-    char keys[80];
+/**
+ * @brief Appends the INFO report, one "name: value" line each, without framing.
+ */
+void append_info(reply_t *out) {
+    server_info_t inf = get_info(start_time);
 
-    send_response_header(clientfd, "OK STRING");
+    reply_printf(out, "Uptime: %ld s\n", inf.uptime);
+    reply_printf(out, "Memory: %d mb\n", inf.mem);
+    reply_printf(out, "used_memory: %zu\nused_memory_peak: %zu\nused_memory_dataset: %zu\nused_memory_overhead: %zu\n",
+                 inf.used_memory, inf.used_memory_peak, inf.used_memory_dataset, inf.used_memory_overhead);
+    reply_printf(out, "maxmemory: %zu\nmaxmemory_policy: %s\nevicted_keys: %zu\n",
+                 inf.maxmemory, inf.maxmemory_policy, inf.evicted_keys);
+    reply_printf(out, "Keys: %d\nexpires: %zu\nexpired_keys: %zu\n", inf.keys, inf.expires, inf.expired_keys);
+    reply_printf(out, "Version: %s\n", inf.version);
+    reply_printf(out, "Table engine: %s\nTable size: %lu buckets\nLoad factor: %.2f\nRehashing: %d stripes (%.1f%%)\n",
+                 inf.table_engine, inf.table_size, inf.load_factor, inf.rehashing_stripes, inf.rehash_progress);
+    reply_printf(out, "Slabs: %lu (%lu free objects, %.1f%% fragmentation)\n",
+                 inf.slabs, inf.slab_free_objects, inf.slab_fragmentation);
+
+    reply_printf(out, "io_threads: %d\n", inf.io_threads);
+    for (int i = 0; i < inf.io_threads; i++) {
+        const io_thread_stats_t *t = &inf.io_thread[i];
+        reply_printf(out, "io_thread_%d: backend=%s cpu=%d connections=%lu accepted=%lu commands=%lu bytes_in=%lu syscalls=%lu\n",
+                     i, t->backend ? t->backend : "none", t->cpu, t->connections, t->accepted, t->commands,
+                     t->bytes_in, t->syscalls);
+    }
 
-    server_info_t inf = get_info(start_time);
-    snprintf(uptime, sizeof(uptime), "Uptime: %ld s\n", inf.uptime);
-    snprintf(memory, sizeof(memory), "Memory: %d mb\n", inf.mem);
-    snprintf(keys, sizeof(keys), "Keys: %d\n", inf.keys);
-    snprintf(version, sizeof(version), "Version: %s\n", inf.version);
-
-    send(clientfd, uptime, strlen(uptime), 0); //NOSONAR
-    send(clientfd, memory, strlen(memory), 0); //NOSONAR
-    send(clientfd, keys, strlen(keys), 0); //NOSONAR
-    send(clientfd, version, strlen(version), 0); //NOSONAR
-    send_response_footer(clientfd);
-}
-
-void cmd_type(int clientfd, const char *buffer) {
-    char key[MAX_KEY_LEN];
-    if (extract_key(buffer, key, sizeof(key)) != 0) {
-        send_error_response(clientfd, EXTRACT_ERR_PARSE);
-        return;
+    reply_printf(out, "connected_clients: %lu\nmaxclients: %d\nrejected_clients: %lu\nevicted_clients: %lu\ntimedout_clients: %lu\n",
+                 inf.clients.connected, inf.maxclients, inf.clients.rejected, inf.clients.evicted, inf.clients.timed_out);
+
+    const worker_pool_stats_t *w = &inf.workers;
+    reply_printf(out, "worker_threads: %d/%d (%d busy)\nworker_queue: %d/%d\n",
+                 w->threads, w->max_threads, w->busy, w->queued, w->queue_depth);
+    reply_printf(out, "accepted_connections: %lu\ndelayed_connections: %lu\nrejected_connections: %lu\n",
+                 w->accepted, w->delayed, w->rejected);
+
+    for (int cmd = 0; cmd < CMD_COUNT; cmd++) {
+        command_stats_t st;
+        commands_stats(cmd, &st);
+        if (st.calls == 0 && st.rejected_calls == 0) continue;
+        reply_printf(out, "cmdstat_%s: calls=%lu usec=%lu usec_per_call=%.2f rejected_calls=%lu\n",
+                     command_def(cmd)->name, st.calls, st.usec,
+                     st.calls ? (double)st.usec / st.calls : 0.0, st.rejected_calls);
     }
+}
 
-    kv_type_t type = kv_get_type(key);
+void cmd_info(reply_t *out, command_args_t *args) {
+    (void)args;
+    send_response_header(out, "OK STRING");
+    append_info(out);
+    send_response_footer(out);
+}
+
+void cmd_type(reply_t *out, command_args_t *args) {
+    kv_type_t type = kv_get_type(args->argv[1]);
 
     const char *type_str;
     if (type >= 0 && type < (int)(sizeof(kv_type_names) / sizeof(kv_type_names[0])) && kv_type_names[type]) {
@@ -345,196 +490,278 @@ void cmd_type(int clientfd, const char *buffer) {
         type_str = "(nil)";
     }
 
-    send_response_header(clientfd, "OK STRING");
-    send(clientfd, type_str, strlen(type_str), 0); //NOSONAR
-    send(clientfd, "\n", 1, 0);
-    send_response_footer(clientfd);
+    send_response_header(out, "OK STRING");
+    reply_printf(out, "%s\n", type_str);
+    send_response_footer(out);
 }
 
-
-void cmd_hset(int clientfd, const char *buffer) {
-    char copy[BUFFER_SIZE];
-    snprintf(copy, sizeof(copy), "%s", buffer);
-
-    const char *p = copy + 5; // skip "HSET "
-    while (*p == ' ') p++;
-
-    char key[MAX_KEY_LEN];
-    int res = extract_key_from_ptr(&p, key, sizeof(key));
+// HSET key field value [field value ...]: replies with the number of fields set
+void cmd_hset(reply_t *out, command_args_t *args) {
+    if (args->argc % 2 != 0) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
+        return;
+    }
+    int res = check_keys(args, 2, 2);
     if (res != EXTRACT_OK) {
-        send_error_response(clientfd, res);
+        send_error_response(out, res);
         return;
     }
 
-    int field_count = 0;
-    while (*p != '\0' && *p != '\n') {
-        char field[MAX_KEY_LEN];
-        char value[MAX_VAL_LEN];
-
-        int field_res = extract_key_from_ptr(&p, field, MAX_KEY_LEN);  // CORRECTO: usar extract_key_from_ptr aquí
-        if (field_res != EXTRACT_OK) {
-            send_error_response(clientfd, field_res);
-            return;
-        }
-
-        int value_res = extract_value_from_ptr(&p, value, MAX_VAL_LEN);
-        if (value_res != EXTRACT_OK) {
-            send_error_response(clientfd, value_res);
-            return;
-        }
+    const char *key = args->argv[1];
+    const char *keys[] = { key };
+    uint64_t locked = kv_lock_keys(keys, 1, 1, true);
 
-        if (kv_hset(key, field, value) != 0) {
-            send_error_response(clientfd, EXTRACT_ERR_INTERNAL);
+    int field_count = 0;
+    for (int i = 2; i < args->argc; i += 2) {
+        int set_res = kv_hsetn(key, args->argv_len[1], args->argv[i], args->argv_len[i],
+                               args->argv[i + 1], args->argv_len[i + 1]);
+        if (set_res != 0) {
+            kv_unlock_keys(locked);
+            send_error_response(out, store_error(set_res));
             return;
         }
-
         field_count++;
     }
 
-    send_response_header(clientfd, "OK STRING");
-    char okmsg[64];
-    snprintf(okmsg, sizeof(okmsg), "%d\n", field_count);
-    send(clientfd, okmsg, strlen(okmsg), 0); //NOSONAR
-    send_response_footer(clientfd);
-}
-
-void cmd_hget(int clientfd, const char *buffer) {
-    char key[MAX_KEY_LEN];
-    char field[MAX_KEY_LEN];
+    kv_unlock_keys(locked);
 
-    int res = extract_key_field(buffer, key, sizeof(key), field, sizeof(field));
-    if (res != EXTRACT_OK) {
-        send_error_response(clientfd, res);
-        return;
-    }
+    send_response_header(out, "OK STRING");
+    reply_printf(out, "%d\n", field_count);
+    send_response_footer(out);
+}
 
-    if (kv_get(key) != NULL) {
-        send_error_response(clientfd, EXTRACT_ERR_PARSE);
+void cmd_hget(reply_t *out, command_args_t *args) {
+    const char *key = args->argv[1];
+    if (kv_get_type(key) == KV_STRING) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
         return;
     }
 
-    const char *val = kv_hget(key, field);
+    kv_ref val;
+    bool found = kv_hget_ref(key, args->argv[2], &val);
 
-    send_response_header(clientfd, "OK STRING");
+    send_response_header(out, "OK STRING");
 
-    if (val) {
-        send(clientfd, val, strlen(val), 0); //NOSONAR
-        send(clientfd, "\n", 1, 0);
+    if (found) {
+        append_value(out, &val);
+        reply_append(out, "\n", 1);
     } else {
-        const char *nil_str = "(nil)\n";
-        send(clientfd, nil_str, strlen(nil_str), 0); //NOSONAR
+        reply_append(out, "(nil)\n", 6);
     }
 
-    send_response_footer(clientfd);
+    send_response_footer(out);
 }
 
-void cmd_hmget(int clientfd, const char *buffer) {
-    char copy[BUFFER_SIZE];
-    snprintf(copy, sizeof(copy), "%s", buffer);
+void cmd_hmget(reply_t *out, command_args_t *args) {
+    // Build results under a shared lock so all fields come from one snapshot
+    send_response_header(out, "OK MULTI");
+
+    const char *key = args->argv[1];
+    const char *keys[] = { key };
+    uint64_t locked = kv_lock_keys(keys, 1, 1, false);
+    for (int i = 2; i < args->argc; i++) {
+        kv_ref val;
+        reply_printf(out, "%d) ", i - 1);
+        if (kv_hget_ref(key, args->argv[i], &val)) {
+            append_value(out, &val);
+        } else {
+            reply_append(out, "(nil)", 5);
+        }
+        reply_append(out, "\n", 1);
+    }
+    kv_unlock_keys(locked);
 
-    const char *p = copy + 6; // skip "HMGET "
-    while (*p == ' ') p++;
+    send_response_footer(out);
+}
 
-    // Manually parse key
-    char key[MAX_KEY_LEN];
-    int res = extract_key_from_ptr(&p, key, sizeof(key));
-    if (res != EXTRACT_OK) {
-        send_error_response(clientfd, res);
+static void send_integer(reply_t *out, long long n) {
+    send_response_header(out, "OK STRING");
+    reply_printf(out, "%lld\n", n);
+    send_response_footer(out);
+}
+
+static void send_float(reply_t *out, double n) {
+    char text[KV_NUM_TEXT];
+    size_t len = kv_format_float(n, text);
+    send_response_header(out, "OK STRING");
+    reply_append(out, text, len);
+    reply_append(out, "\n", 1);
+    send_response_footer(out);
+}
+
+// INCR, DECR, INCRBY and DECRBY: adds sign times the increment, 1 without one.
+static void incr_command(reply_t *out, command_args_t *args, int64_t sign) {
+    int64_t increment = 1;
+    if (args->argc == 3 && (parse_int64(args->argv[2], args->argv_len[2], &increment) != 0 ||
+                            (sign < 0 && increment == INT64_MIN))) {
+        send_error_response(out, EXTRACT_ERR_NOT_INTEGER);
+        return;
+    }
+    if (kv_get_type(args->argv[1]) == KV_HASH) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
         return;
     }
 
-    // Parse fields
-    const char *fields[64];
-    char fields_storage[64][MAX_KEY_LEN];
-    int field_count = 0;
+    int64_t value;
+    int res = kv_incrby(args->argv[1], sign * increment, &value);
+    if (res == 0) {
+        send_integer(out, value);
+    } else {
+        send_error_response(out, store_error(res));
+    }
+}
 
-    while (*p != '\0' && *p != '\n') {
-        res = extract_key_from_ptr(&p, fields_storage[field_count], MAX_KEY_LEN);
-        if (res != EXTRACT_OK) {
-            send_error_response(clientfd, res);
-            return;
-        }
+// INCR key and INCRBY key increment
+void cmd_incr(reply_t *out, command_args_t *args) {
+    incr_command(out, args, 1);
+}
 
-        fields[field_count] = fields_storage[field_count];
-        field_count++;
+// DECR key and DECRBY key decrement
+void cmd_decr(reply_t *out, command_args_t *args) {
+    incr_command(out, args, -1);
+}
 
-        if (field_count >= 64) break;
+void cmd_incrbyfloat(reply_t *out, command_args_t *args) {
+    double increment;
+    if (!kv_parse_float(args->argv[2], args->argv_len[2], &increment)) {
+        send_error_response(out, EXTRACT_ERR_NOT_FLOAT);
+        return;
+    }
+    if (kv_get_type(args->argv[1]) == KV_HASH) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
+        return;
     }
 
-    // Validate: at least 1 field required
-    if (field_count == 0) {
-        send_error_response(clientfd, EXTRACT_ERR_PARSE);
+    double value;
+    int res = kv_incrbyfloat(args->argv[1], increment, &value);
+    if (res == 0) {
+        send_float(out, value);
+    } else {
+        send_error_response(out, store_error(res));
+    }
+}
+
+void cmd_hincrby(reply_t *out, command_args_t *args) {
+    int64_t increment;
+    if (parse_int64(args->argv[3], args->argv_len[3], &increment) != 0) {
+        send_error_response(out, EXTRACT_ERR_NOT_INTEGER);
+        return;
+    }
+    if (kv_get_type(args->argv[1]) == KV_STRING) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
         return;
     }
 
-    // Build results
-    char *results[64];
-    char results_storage[64][MAX_VAL_LEN];
-    for (int i = 0; i < field_count; i++) {
-        results[i] = results_storage[i];
-        const char *val = kv_hget(key, fields[i]);
-        if (val) {
-            snprintf(results[i], MAX_VAL_LEN, "%s", val);
-        } else {
-            snprintf(results[i], MAX_VAL_LEN, "(nil)");
-        }
+    int64_t value;
+    int res = kv_hincrby(args->argv[1], args->argv[2], increment, &value);
+    if (res == 0) {
+        send_integer(out, value);
+    } else {
+        send_error_response(out, store_error(res));
     }
+}
 
-    // Send response
-    send_response_header(clientfd, "OK MULTI");
+void cmd_hincrbyfloat(reply_t *out, command_args_t *args) {
+    double increment;
+    if (!kv_parse_float(args->argv[3], args->argv_len[3], &increment)) {
+        send_error_response(out, EXTRACT_ERR_NOT_FLOAT);
+        return;
+    }
+    if (kv_get_type(args->argv[1]) == KV_STRING) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
+        return;
+    }
+
+    double value;
+    int res = kv_hincrbyfloat(args->argv[1], args->argv[2], increment, &value);
+    if (res == 0) {
+        send_float(out, value);
+    } else {
+        send_error_response(out, store_error(res));
+    }
+}
 
-    for (int i = 0; i < field_count; i++) {
-        char line[BUFFER_SIZE];
-        int len = snprintf(line, sizeof(line), "%d) %s\n", i + 1, results[i]);
-        send(clientfd, line, len, 0);
+// EXPIRE/PEXPIRE key time, with the time in units of unit_ms.
+static void expire_command(reply_t *out, command_args_t *args, int64_t unit_ms) {
+    int64_t ttl;
+    if (args->argv_len[1] == 0 || parse_int64(args->argv[2], args->argv_len[2], &ttl) != 0 ||
+        ttl > INT64_MAX / unit_ms || ttl < INT64_MIN / unit_ms) {
+        send_error_response(out, EXTRACT_ERR_PARSE);
+        return;
     }
 
-    send_response_footer(clientfd);
+    send_integer(out, kv_expire(args->argv[1], ttl * unit_ms) == 0 ? 1 : 0);
+}
+
+void cmd_expire(reply_t *out, command_args_t *args) {
+    expire_command(out, args, 1000);
 }
 
-void cmd_hincrby(int clientfd, const char *buffer) {
-    char copy[BUFFER_SIZE];
-    snprintf(copy, sizeof(copy), "%s", buffer);
+void cmd_pexpire(reply_t *out, command_args_t *args) {
+    expire_command(out, args, 1);
+}
 
-    const char *p = copy + 8; // skip "HINCRBY "
-    while (*p == ' ') p++;
+// TTL/PTTL key: the remaining time, -1 without a TTL and -2 for a missing key.
+static void ttl_command(reply_t *out, command_args_t *args, int64_t unit_ms) {
+    int64_t ttl = kv_ttl(args->argv[1]);
+    if (ttl >= 0) ttl = (ttl + unit_ms / 2) / unit_ms;
+    send_integer(out, ttl);
+}
 
-    char key[MAX_KEY_LEN];
-    int res = extract_key_from_ptr(&p, key, sizeof(key));
-    if (res != EXTRACT_OK) {
-        send_error_response(clientfd, res);
+void cmd_ttl(reply_t *out, command_args_t *args) {
+    ttl_command(out, args, 1000);
+}
+
+void cmd_pttl(reply_t *out, command_args_t *args) {
+    ttl_command(out, args, 1);
+}
+
+void cmd_persist(reply_t *out, command_args_t *args) {
+    send_integer(out, kv_persist(args->argv[1]) == 0 ? 1 : 0);
+}
+
+void cmd_multi(reply_t *out, command_args_t *args) {
+    if (args->queue.active) {
+        send_error_response(out, EXTRACT_ERR_NESTED_MULTI);
         return;
     }
+    args->queue.active = true;
+    args->queue.failed = false;
+    send_simple_ok_string(out, "OK\n");
+}
 
-    char field[MAX_KEY_LEN];
-    res = extract_key_from_ptr(&p, field, sizeof(field));
-    if (res != EXTRACT_OK) {
-        send_error_response(clientfd, res);
+static void exec_begin(reply_t *out, int count) {
+    (void)count;
+    send_response_header(out, "OK EXEC");
+    in_exec = true;
+}
+
+// EXEC: one block holding each queued command's reply, as its type line and data
+void cmd_exec(reply_t *out, command_args_t *args) {
+    if (!args->queue.active) {
+        send_error_response(out, EXTRACT_ERR_NO_MULTI);
         return;
     }
-
-    // Now parse the increment
-    while (*p == ' ') p++;
-    if (*p == '\0' || *p == '\n') {
-        send_error_response(clientfd, EXTRACT_ERR_PARSE);
+    if (args->queue.failed) {
+        command_queue_clear(&args->queue);
+        send_error_response(out, EXTRACT_ERR_EXEC_ABORT);
         return;
     }
 
-    char incr_str[64];
-    size_t len = 0;
-    while (*p != ' ' && *p != '\0' && *p != '\n' && len < sizeof(incr_str) - 1) {
-        incr_str[len++] = *p;
-        p++;
+    int res = commands_exec(out, args, exec_begin, handle_command);
+    in_exec = false;
+    if (res != EXTRACT_OK) {
+        send_error_response(out, res);
+        return;
     }
-    incr_str[len] = '\0';
-
-    double increment = strtod(incr_str, NULL);
-
-    double new_value = kv_hincrby(key, field, increment);
+    send_response_footer(out);
+}
 
-    send_response_header(clientfd, "OK STRING");
-    char valstr[64];
-    snprintf(valstr, sizeof(valstr), "%.17g\n", new_value);
-    send(clientfd, valstr, strlen(valstr), 0); //NOSONAR
-    send_response_footer(clientfd);
+void cmd_discard(reply_t *out, command_args_t *args) {
+    if (!args->queue.active) {
+        send_error_response(out, EXTRACT_ERR_NO_MULTI);
+        return;
+    }
+    command_queue_clear(&args->queue);
+    send_simple_ok_string(out, "OK\n");
 }
@@ -1,38 +1,62 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "kvstore.h"
 #include "protocol.h"
+#include "reply.h"
 
-typedef void (*command_proc_t)(int clientfd, const char *message);
+typedef void (*command_proc_t)(reply_t *out, command_args_t *args);
 
-typedef struct {
-    command_t cmd;
-    command_proc_t proc;
-} command_entry_t;
-
-void handle_command(int clientfd, command_t cmd, const char *message);
-void cmd_set(int clientfd, const char *buffer);
-void cmd_get(int clientfd, const char *buffer);
-void cmd_mset(int clientfd, const char *buffer);
-void cmd_mget(int clientfd, const char *buffer);
-void cmd_del(int clientfd, const char *buffer);
-void cmd_ping(int clientfd, const char *message);
-void cmd_time(int clientfd, const char *message);
-void cmd_info(int clientfd, const char *buffer);
-void cmd_type(int clientfd, const char *message);
-void cmd_hset(int clientfd, const char *buffer);
-void cmd_hget(int clientfd, const char *buffer);
-void cmd_hmget(int clientfd, const char *buffer);
-void cmd_hincrby(int clientfd, const char *buffer);
-
-void send_response_header(int clientfd, const char *type);
-void send_response_footer(int clientfd);
-void send_error_response(int clientfd, int res);
-
-int extract_key_from_ptr(const char **p, char *key, size_t key_size);
-int extract_value_from_ptr(const char **p, char *value, size_t value_size);
-int extract_key_value(const char *message, char *key, char *value, size_t key_size, size_t value_size);
-int extract_key_field(const char *message, char *key, size_t key_size, char *field, size_t field_size);
+// Checks and runs one command by its id, as handle_command() does.
+typedef void (*command_run_t)(reply_t *out, command_t cmd, command_args_t *args);
 
+// Per-command counters, reported by INFO as cmdstat_<name> lines.
+typedef struct {
+    unsigned long calls;
+    unsigned long usec;           // time spent in the handler
+    unsigned long rejected_calls; // wrong argument count or key too long
+} command_stats_t;
+
+void handle_command(reply_t *out, command_t cmd, command_args_t *args);
+uint64_t commands_clock_us(void);
+void commands_count_call(command_t cmd, uint64_t start_us);
+void commands_count_rejected(command_t cmd);
+void commands_stats(command_t cmd, command_stats_t *out);
+int commands_exec(reply_t *out, command_args_t *args, void (*begin)(reply_t *out, int count), command_run_t run);
+void cmd_set(reply_t *out, command_args_t *args);
+void cmd_get(reply_t *out, command_args_t *args);
+void cmd_mset(reply_t *out, command_args_t *args);
+void cmd_mget(reply_t *out, command_args_t *args);
+void cmd_del(reply_t *out, command_args_t *args);
+void cmd_ping(reply_t *out, command_args_t *args);
+void cmd_echo(reply_t *out, command_args_t *args);
+void cmd_time(reply_t *out, command_args_t *args);
+void cmd_info(reply_t *out, command_args_t *args);
+void cmd_type(reply_t *out, command_args_t *args);
+void cmd_hset(reply_t *out, command_args_t *args);
+void cmd_hget(reply_t *out, command_args_t *args);
+void cmd_hmget(reply_t *out, command_args_t *args);
+void cmd_hincrby(reply_t *out, command_args_t *args);
+void cmd_hincrbyfloat(reply_t *out, command_args_t *args);
+void cmd_incr(reply_t *out, command_args_t *args);
+void cmd_decr(reply_t *out, command_args_t *args);
+void cmd_incrbyfloat(reply_t *out, command_args_t *args);
+void cmd_expire(reply_t *out, command_args_t *args);
+void cmd_pexpire(reply_t *out, command_args_t *args);
+void cmd_ttl(reply_t *out, command_args_t *args);
+void cmd_pttl(reply_t *out, command_args_t *args);
+void cmd_persist(reply_t *out, command_args_t *args);
+void cmd_multi(reply_t *out, command_args_t *args);
+void cmd_exec(reply_t *out, command_args_t *args);
+void cmd_discard(reply_t *out, command_args_t *args);
+
+void send_response_header(reply_t *out, const char *type);
+void send_response_footer(reply_t *out);
+void send_error_response(reply_t *out, int res);
+void append_info(reply_t *out);
+void append_value(reply_t *out, kv_ref *ref);
 
 #endif
@@ -0,0 +1,242 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+
+#include "config.h"
+#include "kvstore.h"
+#include "iostats.h"
+#include "logs.h"
+
+void config_defaults(server_config_t *config) {
+    config->port = DEFAULT_PORT;
+    config->max_value_size = KV_DEFAULT_MAX_VALUE_LEN;
+    config->hash_max_packed_fields = KV_DEFAULT_HASH_PACKED_FIELDS;
+    config->hash_max_packed_value = KV_DEFAULT_HASH_PACKED_VALUE;
+    config->maxmemory = 0;
+    config->maxmemory_policy = KV_EVICT_NOEVICTION;
+    config->io_backend = IO_BACKEND_EPOLL;
+    config->io_threads = 1;
+    config->listen_backlog = DEFAULT_LISTEN_BACKLOG;
+    config->worker_threads = DEFAULT_WORKER_THREADS;
+    config->worker_queue = DEFAULT_WORKER_QUEUE;
+    config->unix_socket = NULL;
+    config->clients.maxclients = DEFAULT_MAXCLIENTS;
+    config->clients.timeout = 0;
+    config->clients.output_hard_limit = DEFAULT_OUTPUT_HARD_LIMIT;
+    config->clients.output_soft_limit = DEFAULT_OUTPUT_SOFT_LIMIT;
+    config->clients.output_soft_seconds = DEFAULT_OUTPUT_SOFT_SECONDS;
+    config->clients.max_request = DEFAULT_MAX_REQUEST_SIZE;
+}
+
+/**
+ * @brief Parses a byte size such as "512", "64kb" or "8mb".
+ *
+ * Accepts an optional k, m or g suffix (case-insensitive, with or without a
+ * trailing "b"), each a power of 1024.
+ *
+ * @return 0 on success, -1 if the text is not a valid size.
+ */
+int parse_size(const char *text, size_t *out) {
+    if (!text || !isdigit((unsigned char)*text)) return -1;
+
+    errno = 0;
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno != 0) return -1;
+
+    unsigned long long unit = 1;
+    switch (tolower((unsigned char)*end)) {
+        case 'k': unit = 1024ULL; end++; break;
+        case 'm': unit = 1024ULL * 1024; end++; break;
+        case 'g': unit = 1024ULL * 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (unit > 1 && tolower((unsigned char)*end) == 'b') end++;
+    if (*end != '\0') return -1;
+
+    if (value > (unsigned long long)((size_t)-1) / unit) return -1;
+    *out = (size_t)(value * unit);
+    return 0;
+}
+
+// Parses an integer between min and max.
+static int parse_int(const char *text, long min, long max, int *out) {
+    if (!text || !isdigit((unsigned char)*text)) return -1;
+
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value < min || value > max) return -1;
+    *out = (int)value;
+    return 0;
+}
+
+// Parses a count between 1 and max.
+static int parse_count(const char *text, long max, int *out) {
+    return parse_int(text, 1, max, out);
+}
+
+// Accepts a Unix socket path that fits in sockaddr_un.sun_path with its NUL.
+static int parse_unix_socket(const char *text, const char **out) {
+    if (!text || *text == '\0' || strlen(text) >= sizeof(((struct sockaddr_un *)0)->sun_path)) return -1;
+    *out = text;
+    return 0;
+}
+
+// Parses an I/O thread count between 1 and IOSTATS_MAX_THREADS.
+static int parse_io_threads(const char *text, int *out) {
+    return parse_count(text, IOSTATS_MAX_THREADS, out);
+}
+
+/**
+ * @brief Overrides defaults with environment variables.
+ *
+ * PORT sets the TCP port and MAX_VALUE_SIZE the largest value SET and HSET
+ * accept (for example "8mb"). HASH_MAX_PACKED_FIELDS and HASH_MAX_PACKED_VALUE
+ * bound the hashes kept in the packed encoding. MAXMEMORY caps used_memory
+ * (for example "100mb") and MAXMEMORY_POLICY picks what happens at the cap:
+ * noeviction, allkeys-lru, allkeys-lfu or volatile-ttl. IO_BACKEND selects
+ * "epoll" (the default event loop), "uring" (io_uring event loops) or
+ * "threads" (a pool of threads serving a connection each), and IO_THREADS
+ * how many event loops epoll or uring runs. LISTEN_BACKLOG sizes the kernel
+ * accept queue; WORKER_THREADS and WORKER_QUEUE bound the threads backend's
+ * pool and the connections waiting for it. UNIX_SOCKET names a Unix socket
+ * path to listen on next to the TCP port. MAXCLIENTS caps open connections,
+ * TIMEOUT disconnects clients idle for that many seconds (0 never does), and
+ * OUTPUT_BUFFER_HARD_LIMIT, OUTPUT_BUFFER_SOFT_LIMIT and
+ * OUTPUT_BUFFER_SOFT_SECONDS disconnect clients whose unread replies grow past
+ * the hard limit, or stay past the soft one for that long (sizes, 0 for no
+ * limit). Invalid values are logged and ignored.
+ */
+void config_load_env(server_config_t *config) {
+    const char *port = getenv("PORT");
+    if (port) {
+        config->port = atoi(port);
+    }
+
+    const char *max_value = getenv("MAX_VALUE_SIZE");
+    if (max_value && parse_size(max_value, &config->max_value_size) != 0) {
+        log_error("Invalid MAX_VALUE_SIZE: %s", max_value);
+    }
+
+    const char *packed_fields = getenv("HASH_MAX_PACKED_FIELDS");
+    if (packed_fields && parse_size(packed_fields, &config->hash_max_packed_fields) != 0) {
+        log_error("Invalid HASH_MAX_PACKED_FIELDS: %s", packed_fields);
+    }
+
+    const char *packed_value = getenv("HASH_MAX_PACKED_VALUE");
+    if (packed_value && parse_size(packed_value, &config->hash_max_packed_value) != 0) {
+        log_error("Invalid HASH_MAX_PACKED_VALUE: %s", packed_value);
+    }
+
+    const char *maxmemory = getenv("MAXMEMORY");
+    if (maxmemory && parse_size(maxmemory, &config->maxmemory) != 0) {
+        log_error("Invalid MAXMEMORY: %s", maxmemory);
+    }
+
+    const char *policy = getenv("MAXMEMORY_POLICY");
+    if (policy) {
+        int parsed = kv_eviction_policy_from_name(policy);
+        if (parsed < 0) {
+            log_error("Invalid MAXMEMORY_POLICY: %s", policy);
+        } else {
+            config->maxmemory_policy = (kv_eviction_policy_t)parsed;
+        }
+    }
+
+    const char *backend = getenv("IO_BACKEND");
+    if (backend && strcmp(backend, "epoll") == 0) {
+        config->io_backend = IO_BACKEND_EPOLL;
+    } else if (backend && strcmp(backend, "threads") == 0) {
+        config->io_backend = IO_BACKEND_THREADS;
+    } else if (backend && strcmp(backend, "uring") == 0) {
+        config->io_backend = IO_BACKEND_URING;
+    } else if (backend) {
+        log_error("Invalid IO_BACKEND: %s", backend);
+    }
+
+    const char *io_threads = getenv("IO_THREADS");
+    if (io_threads && parse_io_threads(io_threads, &config->io_threads) != 0) {
+        log_error("Invalid IO_THREADS: %s", io_threads);
+    }
+
+    const char *backlog = getenv("LISTEN_BACKLOG");
+    if (backlog && parse_count(backlog, INT_MAX, &config->listen_backlog) != 0) {
+        log_error("Invalid LISTEN_BACKLOG: %s", backlog);
+    }
+
+    const char *workers = getenv("WORKER_THREADS");
+    if (workers && parse_count(workers, MAX_WORKER_THREADS, &config->worker_threads) != 0) {
+        log_error("Invalid WORKER_THREADS: %s", workers);
+    }
+
+    const char *queue = getenv("WORKER_QUEUE");
+    if (queue && parse_count(queue, MAX_WORKER_QUEUE, &config->worker_queue) != 0) {
+        log_error("Invalid WORKER_QUEUE: %s", queue);
+    }
+
+    const char *unix_socket = getenv("UNIX_SOCKET");
+    if (unix_socket && parse_unix_socket(unix_socket, &config->unix_socket) != 0) {
+        log_error("Invalid UNIX_SOCKET: %s", unix_socket);
+    }
+
+    const char *maxclients = getenv("MAXCLIENTS");
+    if (maxclients && parse_count(maxclients, INT_MAX, &config->clients.maxclients) != 0) {
+        log_error("Invalid MAXCLIENTS: %s", maxclients);
+    }
+
+    const char *timeout = getenv("TIMEOUT");
+    if (timeout && parse_int(timeout, 0, INT_MAX, &config->clients.timeout) != 0) {
+        log_error("Invalid TIMEOUT: %s", timeout);
+    }
+
+    const char *hard = getenv("OUTPUT_BUFFER_HARD_LIMIT");
+    if (hard && parse_size(hard, &config->clients.output_hard_limit) != 0) {
+        log_error("Invalid OUTPUT_BUFFER_HARD_LIMIT: %s", hard);
+    }
+
+    const char *soft = getenv("OUTPUT_BUFFER_SOFT_LIMIT");
+    if (soft && parse_size(soft, &config->clients.output_soft_limit) != 0) {
+        log_error("Invalid OUTPUT_BUFFER_SOFT_LIMIT: %s", soft);
+    }
+
+    const char *soft_seconds = getenv("OUTPUT_BUFFER_SOFT_SECONDS");
+    if (soft_seconds && parse_int(soft_seconds, 0, INT_MAX, &config->clients.output_soft_seconds) != 0) {
+        log_error("Invalid OUTPUT_BUFFER_SOFT_SECONDS: %s", soft_seconds);
+    }
+
+    const char *max_request = getenv("MAX_REQUEST_SIZE");
+    if (max_request && parse_size(max_request, &config->clients.max_request) != 0) {
+        log_error("Invalid MAX_REQUEST_SIZE: %s", max_request);
+    }
+}
+
+/**
+ * @brief Overrides settings with command line options, which win over the environment.
+ *
+ * Accepts --io-threads N and --unix-socket PATH.
+ *
+ * @return 0 on success, -1 on an unknown option or invalid value (logged).
+ */
+int config_load_args(server_config_t *config, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) {
+            if (parse_io_threads(argv[++i], &config->io_threads) != 0) {
+                log_error("Invalid --io-threads: %s", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--unix-socket") == 0 && i + 1 < argc) {
+            if (parse_unix_socket(argv[++i], &config->unix_socket) != 0) {
+                log_error("Invalid --unix-socket: %s", argv[i]);
+                return -1;
+            }
+        } else {
+            log_error("Unknown option: %s", argv[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
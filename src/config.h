@@ -0,0 +1,49 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+
+#include "kvstore.h"
+#include "clients.h"
+
+#define DEFAULT_PORT 8080
+#define DEFAULT_LISTEN_BACKLOG 511
+#define DEFAULT_WORKER_THREADS 256
+#define DEFAULT_WORKER_QUEUE 1024
+#define MAX_WORKER_THREADS 65536
+#define MAX_WORKER_QUEUE 65536
+#define DEFAULT_MAXCLIENTS 10000
+#define DEFAULT_OUTPUT_HARD_LIMIT (64 * 1024 * 1024)
+#define DEFAULT_OUTPUT_SOFT_LIMIT (16 * 1024 * 1024)
+#define DEFAULT_OUTPUT_SOFT_SECONDS 60
+#define DEFAULT_MAX_REQUEST_SIZE (64 * 1024 * 1024)
+
+// How the server multiplexes client connections.
+typedef enum {
+    IO_BACKEND_EPOLL,   // one event loop thread for every connection
+    IO_BACKEND_THREADS, // one thread per connection
+    IO_BACKEND_URING    // io_uring event loops, epoll where the kernel lacks support
+} io_backend_t;
+
+typedef struct {
+    int port;
+    size_t max_value_size;
+    size_t hash_max_packed_fields;
+    size_t hash_max_packed_value;
+    size_t maxmemory; // 0 for no limit
+    kv_eviction_policy_t maxmemory_policy;
+    io_backend_t io_backend;
+    int io_threads; // event loops for IO_BACKEND_EPOLL and IO_BACKEND_URING
+    int listen_backlog;
+    int worker_threads; // most connections IO_BACKEND_THREADS serves at once
+    int worker_queue;   // accepted connections waiting for a worker
+    const char *unix_socket; // path of a Unix socket to listen on as well, NULL for none
+    client_limits_t clients;
+} server_config_t;
+
+void config_defaults(server_config_t *config);
+void config_load_env(server_config_t *config);
+int config_load_args(server_config_t *config, int argc, char **argv);
+int parse_size(const char *text, size_t *out);
+
+#endif
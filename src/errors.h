@@ -7,6 +7,16 @@
 #define ERR_PARSE_ERROR    "ERROR parse error\n"
 #define ERR_UNKNOWN_CMD    "ERROR unknown command\n"
 #define ERR_INTERNAL_ERROR "ERROR internal error\n"
+#define ERR_OOM            "ERROR out of memory\n"
+#define ERR_LINE_TOO_LONG  "ERROR line too long\n"
+#define ERR_BUSY           "ERROR server busy\n"
+#define ERR_MAX_CLIENTS    "ERROR max number of clients reached\n"
+#define ERR_NOT_INTEGER    "ERROR value is not an integer\n"
+#define ERR_NOT_FLOAT      "ERROR value is not a valid float\n"
+#define ERR_OVERFLOW       "ERROR increment would overflow\n"
+#define ERR_NESTED_MULTI   "ERROR MULTI calls can not be nested\n"
+#define ERR_NO_MULTI       "ERROR no transaction, MULTI first\n"
+#define ERR_EXEC_ABORT     "ERROR transaction discarded because of previous errors\n"
 
 #define EXTRACT_OK                0
 #define EXTRACT_ERR_PARSE        -1
@@ -14,5 +24,15 @@
 #define EXTRACT_ERR_VALUE_TOO_LONG -3
 #define EXTRACT_ERR_KEY_NOT_FOUND -4
 #define EXTRACT_ERR_INTERNAL     -5
+#define EXTRACT_ERR_OOM          -6
+#define EXTRACT_ERR_LINE_TOO_LONG -7
+#define EXTRACT_ERR_BUSY         -8
+#define EXTRACT_ERR_MAX_CLIENTS  -9
+#define EXTRACT_ERR_NOT_INTEGER  -10
+#define EXTRACT_ERR_NOT_FLOAT    -11
+#define EXTRACT_ERR_OVERFLOW     -12
+#define EXTRACT_ERR_NESTED_MULTI -13
+#define EXTRACT_ERR_NO_MULTI     -14
+#define EXTRACT_ERR_EXEC_ABORT   -15
 
 #endif
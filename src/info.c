@@ -1,11 +1,11 @@
 #include <string.h>
 #include <time.h>
-#include <sys/resource.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #include "info.h"
 #include "kvstore.h"
+#include "slab.h"
 
 #ifndef VERSION
 #define VERSION "dev"
@@ -24,16 +24,50 @@ server_info_t get_info(time_t server_start_time) {
     time_t now = time(NULL);
     long uptime = now - server_start_time;
 
-    struct rusage usage;
-    getrusage(RUSAGE_SELF, &usage);
+    // counted by the store itself: ru_maxrss only ever grows and includes
+    // thread stacks, buffers and allocator slack
+    kv_memory_stats_t mem;
+    kv_memory_stats(&mem);
 
-    int mem_mb = 0;
-#if defined(__APPLE__)
-    mem_mb = (int)(usage.ru_maxrss / 1024 / 1024);
-#else
-    mem_mb = (int)(usage.ru_maxrss / 1024);
-#endif
+    kv_table_stats_t table;
+    kv_table_stats(&table);
+
+    server_info_t info = fill_data((int)(mem.used_memory / 1024 / 1024), kv_count_keys(), uptime, VERSION);
+    info.used_memory = mem.used_memory;
+    info.used_memory_peak = mem.used_memory_peak;
+    info.used_memory_dataset = mem.dataset;
+    info.used_memory_overhead = mem.overhead;
+    info.maxmemory = mem.maxmemory;
+    info.maxmemory_policy = mem.policy;
+    info.evicted_keys = mem.evicted_keys;
+
+    kv_expire_stats_t expire;
+    kv_expire_stats(&expire);
+    info.expires = expire.expires;
+    info.expired_keys = expire.expired_keys;
+    info.table_engine = table.engine;
+    info.table_size = table.buckets;
+    info.load_factor = table.load_factor;
+    info.rehashing_stripes = table.rehashing_stripes;
+    info.rehash_progress = table.rehash_buckets_total
+        ? 100.0 * (double)table.rehash_buckets_done / (double)table.rehash_buckets_total
+        : 100.0;
+
+    slab_stats_t slabs[SLAB_MAX_CACHES];
+    int caches = slab_get_stats(slabs, SLAB_MAX_CACHES);
+    unsigned long objects = 0;
+    info.slabs = 0;
+    info.slab_free_objects = 0;
+    for (int i = 0; i < caches; i++) {
+        info.slabs += slabs[i].slabs;
+        info.slab_free_objects += slabs[i].free_objects;
+        objects += slabs[i].objects;
+    }
+    info.slab_fragmentation = objects ? 100.0 * (double)info.slab_free_objects / (double)objects : 0.0;
 
-    int keys = kv_count_keys();
-    return fill_data(mem_mb, keys, uptime, VERSION);
+    info.io_threads = iostats_get(info.io_thread, IOSTATS_MAX_THREADS);
+    workers_stats(&info.workers);
+    clients_stats(&info.clients);
+    info.maxclients = clients_limits()->maxclients;
+    return info;
 }
\ No newline at end of file
@@ -1,15 +1,42 @@
 #ifndef INFO_H
 #define INFO_H
 
+#include <stddef.h>
 #include <time.h>
 
+#include "iostats.h"
+#include "workers.h"
+#include "clients.h"
+
 extern time_t start_time;
 
 typedef struct {
-    int  mem;
+    int  mem;               // used_memory in MB
+    size_t used_memory;
+    size_t used_memory_peak;
+    size_t used_memory_dataset;
+    size_t used_memory_overhead;
+    size_t maxmemory;       // 0 when unlimited
+    const char *maxmemory_policy;
+    size_t evicted_keys;
     int  keys;
+    size_t expires;         // keys with a TTL
+    size_t expired_keys;
     long uptime;
     char version[50];
+    const char *table_engine;
+    unsigned long table_size;
+    double load_factor;
+    int rehashing_stripes;
+    double rehash_progress;
+    unsigned long slabs;
+    unsigned long slab_free_objects;
+    double slab_fragmentation;
+    int io_threads;         // event loops registered, 0 with IO_BACKEND=threads
+    io_thread_stats_t io_thread[IOSTATS_MAX_THREADS];
+    worker_pool_stats_t workers; // all zero unless IO_BACKEND=threads
+    client_stats_t clients;
+    int maxclients;
 } server_info_t;
 
 server_info_t get_info(time_t start_time);
@@ -0,0 +1,50 @@
+#include <stddef.h>
+
+#include "iostats.h"
+
+static io_thread_stats_t threads[IOSTATS_MAX_THREADS];
+static int thread_count;
+
+/**
+ * @brief Claims a stats slot for the calling I/O thread.
+ *
+ * @return The slot, or NULL once IOSTATS_MAX_THREADS are registered.
+ */
+io_thread_stats_t *iostats_register(int cpu) {
+    int id = __atomic_fetch_add(&thread_count, 1, __ATOMIC_RELAXED);
+    if (id >= IOSTATS_MAX_THREADS) return NULL;
+
+    __atomic_store_n(&threads[id].cpu, cpu, __ATOMIC_RELAXED);
+    return &threads[id];
+}
+
+/**
+ * @brief Copies the counters of up to max registered threads into out.
+ *
+ * @return The number of threads copied.
+ */
+int iostats_get(io_thread_stats_t *out, int max) {
+    int count = __atomic_load_n(&thread_count, __ATOMIC_RELAXED);
+    if (count > IOSTATS_MAX_THREADS) count = IOSTATS_MAX_THREADS;
+    if (count > max) count = max;
+
+    for (int i = 0; i < count; i++) {
+        out[i].cpu = __atomic_load_n(&threads[i].cpu, __ATOMIC_RELAXED);
+        out[i].backend = __atomic_load_n(&threads[i].backend, __ATOMIC_RELAXED);
+        out[i].connections = __atomic_load_n(&threads[i].connections, __ATOMIC_RELAXED);
+        out[i].accepted = __atomic_load_n(&threads[i].accepted, __ATOMIC_RELAXED);
+        out[i].commands = __atomic_load_n(&threads[i].commands, __ATOMIC_RELAXED);
+        out[i].bytes_in = __atomic_load_n(&threads[i].bytes_in, __ATOMIC_RELAXED);
+        out[i].syscalls = __atomic_load_n(&threads[i].syscalls, __ATOMIC_RELAXED);
+    }
+    return count;
+}
+
+// Adds delta to a counter of the caller's own slot.
+void iostats_add(unsigned long *counter, long delta) {
+    __atomic_add_fetch(counter, (unsigned long)delta, __ATOMIC_RELAXED);
+}
+
+void iostats_set_backend(io_thread_stats_t *stats, const char *backend) {
+    __atomic_store_n(&stats->backend, backend, __ATOMIC_RELAXED);
+}
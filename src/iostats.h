@@ -0,0 +1,25 @@
+#ifndef IOSTATS_H
+#define IOSTATS_H
+
+#define IOSTATS_MAX_THREADS 64
+
+/*
+ * Counters of one I/O thread. Each thread owns its slot and updates it with
+ * relaxed atomics; INFO reads every slot without locking.
+ */
+typedef struct {
+    int cpu;                   // CPU the thread is pinned to, -1 if it is not
+    const char *backend;       // event loop serving the thread: "epoll" or "uring"
+    unsigned long connections; // currently open
+    unsigned long accepted;
+    unsigned long commands;
+    unsigned long bytes_in;
+    unsigned long syscalls;    // network system calls: waits, accepts, reads and writes
+} io_thread_stats_t;
+
+io_thread_stats_t *iostats_register(int cpu);
+int iostats_get(io_thread_stats_t *out, int max);
+void iostats_add(unsigned long *counter, long delta);
+void iostats_set_backend(io_thread_stats_t *stats, const char *backend);
+
+#endif
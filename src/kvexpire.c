@@ -0,0 +1,139 @@
+#include <stdlib.h>
+
+#include "kvexpire.h"
+
+/*
+ * Linear probing over {node, when} pairs. The table grows at half full and
+ * shrinks below 1/8, so a sample started at a random slot finds entries
+ * within a few probes. Removal shifts the rest of the probe run back instead
+ * of leaving tombstones.
+ */
+
+#define KV_EXPIRES_MIN_SLOTS 8
+
+static size_t slot_of(const kv_expires *e, const kv_node *node) {
+    uint64_t h = (uint64_t)(uintptr_t)node * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 32) & (e->capacity - 1);
+}
+
+static void place(kv_expires *e, kv_node *node, int64_t when) {
+    size_t i = slot_of(e, node);
+    while (e->slots[i].node != NULL) {
+        i = (i + 1) & (e->capacity - 1);
+    }
+    e->slots[i] = (kv_expire_entry){ node, when };
+}
+
+static int resize(kv_expires *e, size_t capacity) {
+    kv_expire_entry *slots = calloc(capacity, sizeof(*slots));
+    if (!slots) return -1;
+
+    kv_expires old = *e;
+    e->slots = slots;
+    e->capacity = capacity;
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.slots[i].node) place(e, old.slots[i].node, old.slots[i].when);
+    }
+    free(old.slots);
+    return 0;
+}
+
+static long find(const kv_expires *e, const kv_node *node) {
+    if (e->capacity == 0) return -1;
+
+    size_t i = slot_of(e, node);
+    while (e->slots[i].node != NULL) {
+        if (e->slots[i].node == node) return (long)i;
+        i = (i + 1) & (e->capacity - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Sets or updates the expiry time of node.
+ *
+ * @return 0 on success, -1 if the table could not grow.
+ */
+int kvexpire_set(kv_expires *e, kv_node *node, int64_t when) {
+    long i = find(e, node);
+    if (i >= 0) {
+        e->slots[i].when = when;
+        return 0;
+    }
+
+    if ((e->used + 1) * 2 > e->capacity) {
+        size_t capacity = e->capacity ? e->capacity * 2 : KV_EXPIRES_MIN_SLOTS;
+        // a failed grow is fine while a free slot is left
+        if (resize(e, capacity) != 0 && e->used + 1 >= e->capacity) return -1;
+    }
+
+    place(e, node, when);
+    e->used++;
+    return 0;
+}
+
+bool kvexpire_get(const kv_expires *e, const kv_node *node, int64_t *when) {
+    long i = find(e, node);
+    if (i < 0) return false;
+    *when = e->slots[i].when;
+    return true;
+}
+
+/**
+ * @brief Drops the entry of node.
+ *
+ * @return true if node had one.
+ */
+bool kvexpire_remove(kv_expires *e, const kv_node *node) {
+    long found = find(e, node);
+    if (found < 0) return false;
+
+    // pull back later entries of the run that would no longer be reachable
+    size_t mask = e->capacity - 1;
+    size_t hole = (size_t)found;
+    size_t i = hole;
+    for (;;) {
+        i = (i + 1) & mask;
+        if (e->slots[i].node == NULL) break;
+        size_t home = slot_of(e, e->slots[i].node);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            e->slots[hole] = e->slots[i];
+            hole = i;
+        }
+    }
+    e->slots[hole].node = NULL;
+    e->used--;
+
+    if (e->used == 0) {
+        kvexpire_clear(e);
+    } else if (e->capacity > KV_EXPIRES_MIN_SLOTS && e->used * 8 < e->capacity) {
+        resize(e, e->capacity / 2); // keeps the larger table on failure
+    }
+    return true;
+}
+
+/**
+ * @brief Copies up to n entries, scanning forward from slot start.
+ *
+ * The caller picks start at random; entries are copied out so it may delete
+ * the sampled keys afterwards.
+ *
+ * @return The number of entries copied.
+ */
+size_t kvexpire_sample(const kv_expires *e, size_t start, kv_expire_entry *out, size_t n) {
+    size_t found = 0;
+    for (size_t visited = 0; visited < e->capacity && found < n; visited++) {
+        const kv_expire_entry *slot = &e->slots[(start + visited) & (e->capacity - 1)];
+        if (slot->node) out[found++] = *slot;
+    }
+    return found;
+}
+
+void kvexpire_clear(kv_expires *e) {
+    free(e->slots);
+    *e = (kv_expires){ 0 };
+}
+
+size_t kvexpire_mem(const kv_expires *e) {
+    return e->capacity * sizeof(kv_expire_entry);
+}
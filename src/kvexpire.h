@@ -0,0 +1,35 @@
+#ifndef KVEXPIRE_H
+#define KVEXPIRE_H
+
+/*
+ * Per-stripe table of key expiry times, keyed by node pointer. Only keys with
+ * a TTL have an entry (and KV_NODE_EXPIRES set), so keys without one pay
+ * nothing. None of the functions lock; kvstore.c calls them with the stripe
+ * lock held.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kvstore.h"
+
+typedef struct {
+    kv_node *node;  // NULL marks an empty slot
+    int64_t when;   // absolute expiry, CLOCK_MONOTONIC milliseconds
+} kv_expire_entry;
+
+typedef struct {
+    kv_expire_entry *slots;
+    size_t capacity; // power of two, 0 until the first TTL
+    size_t used;
+} kv_expires;
+
+int kvexpire_set(kv_expires *e, kv_node *node, int64_t when);
+bool kvexpire_get(const kv_expires *e, const kv_node *node, int64_t *when);
+bool kvexpire_remove(kv_expires *e, const kv_node *node);
+size_t kvexpire_sample(const kv_expires *e, size_t start, kv_expire_entry *out, size_t n);
+void kvexpire_clear(kv_expires *e);
+size_t kvexpire_mem(const kv_expires *e);
+
+#endif
@@ -0,0 +1,460 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "kvfields.h"
+#include "kvnum.h"
+#include "kvstr.h"
+#include "kvhash.h"
+#include "arena.h"
+#include "slab.h"
+
+/*
+ * Hash fields use one of two encodings.
+ *
+ * KV_FIELDS_PACKED: a single arena block of field/value pairs, each string
+ * written as a varint length, its bytes and a NUL terminator. Lookups scan
+ * the block, which for a few dozen short fields is a handful of cache lines
+ * and far cheaper than a node and two strings per field. The length of a
+ * value is shifted left by two bits to make room for its
+ * kv_value_encoding_t; a number is stored as its 8 bytes.
+ *
+ * KV_FIELDS_DICT: a chained hash table of kv_field_nodes, used once a hash
+ * has more than max_packed_fields fields or any field or value longer than
+ * max_packed_value bytes, so HGET stays O(1) on large hashes. Conversion is
+ * one way; a hash that shrinks again stays a dict.
+ */
+
+#define KV_DICT_MIN_BUCKETS 16
+#define KV_PACKED_VALUE_MAX ((1u << 30) - 1) // longest value whose tagged length fits the varint
+
+typedef struct kv_field_node {
+    struct kv_field_node *next;
+    kv_str field;
+    union {
+        kv_str value; // KV_VALUE_RAW
+        kv_num num;   // KV_VALUE_INT or KV_VALUE_FLOAT
+    };
+    uint8_t encoding; // kv_value_encoding_t
+} kv_field_node;
+
+struct kv_dict {
+    kv_field_node **buckets;
+    uint32_t size; // power of two
+    size_t mem;    // bytes held by the dict, its buckets, nodes and long strings
+};
+
+static slab_cache field_node_cache = SLAB_CACHE_INIT("kv_field_node", sizeof(kv_field_node));
+
+static size_t max_packed_fields = KV_DEFAULT_HASH_PACKED_FIELDS;
+static size_t max_packed_value = KV_DEFAULT_HASH_PACKED_VALUE;
+
+/**
+ * @brief Sets how large a hash may grow before it converts to a dict.
+ *
+ * @param max_fields Most fields kept in the packed encoding.
+ * @param max_value  Longest field name or value, in bytes, kept packed.
+ */
+void kv_set_hash_packed_limits(size_t max_fields, size_t max_value) {
+    max_packed_fields = max_fields;
+    max_packed_value = max_value < KV_PACKED_VALUE_MAX ? max_value : KV_PACKED_VALUE_MAX;
+}
+
+static size_t varint_size(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint8_t *varint_put(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static const uint8_t *varint_get(const uint8_t *p, uint32_t *v) {
+    uint32_t result = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        result |= (uint32_t)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *v = result | (uint32_t)*p++ << shift;
+    return p;
+}
+
+// Packed size of one string: length prefix, bytes and NUL terminator.
+static size_t entry_size(size_t len) {
+    return varint_size((uint32_t)len) + len + 1;
+}
+
+static uint8_t *entry_put(uint8_t *p, const char *data, size_t len) {
+    p = varint_put(p, (uint32_t)len);
+    memcpy(p, data, len);
+    p[len] = '\0';
+    return p + len + 1;
+}
+
+// Decodes the string at p and returns a pointer to the entry after it.
+static const uint8_t *entry_get(const uint8_t *p, const char **data, uint32_t *len) {
+    p = varint_get(p, len);
+    *data = (const char *)p;
+    return p + *len + 1;
+}
+
+static size_t value_entry_size(size_t len, uint8_t encoding) {
+    return varint_size((uint32_t)len << 2 | encoding) + len + 1;
+}
+
+static uint8_t *value_entry_put(uint8_t *p, const char *data, size_t len, uint8_t encoding) {
+    p = varint_put(p, (uint32_t)len << 2 | encoding);
+    memcpy(p, data, len);
+    p[len] = '\0';
+    return p + len + 1;
+}
+
+// Decodes the value entry at p into value and returns a pointer to the entry after it.
+static const uint8_t *value_entry_get(const uint8_t *p, kv_value *value) {
+    uint32_t tagged;
+    p = varint_get(p, &tagged);
+    value->encoding = (uint8_t)(tagged & 3);
+    value->len = tagged >> 2;
+    value->data = (const char *)p;
+    if (value->encoding != KV_VALUE_RAW) {
+        memcpy(&value->num, p, sizeof(value->num));
+        value->data = NULL;
+    }
+    return p + (tagged >> 2) + 1;
+}
+
+// Returns the offset of the value entry that follows field, or -1 if absent.
+static long packed_find(const kv_fields *h, const char *field, size_t field_len) {
+    const uint8_t *p = h->packed;
+    const uint8_t *end = h->packed + h->bytes;
+    const char *data;
+    uint32_t len;
+    kv_value value;
+
+    while (p < end) {
+        p = entry_get(p, &data, &len);
+        if (len == field_len && memcmp(data, field, field_len) == 0) {
+            return (long)(p - h->packed);
+        }
+        p = value_entry_get(p, &value);
+    }
+    return -1;
+}
+
+/**
+ * @brief Replaces old_size bytes at off with new_size bytes for the caller to fill.
+ *
+ * The block keeps its arena size class invariant: it is reallocated whenever
+ * the new length falls in another class, otherwise the tail is moved in place.
+ *
+ * @return Pointer to the new bytes, or NULL if the arena is out of memory
+ *         (h is left untouched).
+ */
+static uint8_t *packed_splice(kv_fields *h, size_t off, size_t old_size, size_t new_size) {
+    size_t bytes = h->bytes - old_size + new_size;
+    size_t tail = h->bytes - off - old_size;
+    uint8_t *buf = h->packed;
+
+    if (!buf || arena_block_size(h->bytes) != arena_block_size(bytes)) {
+        buf = arena_alloc(bytes);
+        if (!buf) return NULL;
+        if (h->packed) {
+            memcpy(buf, h->packed, off);
+            memcpy(buf + off + new_size, h->packed + off + old_size, tail);
+            arena_free(h->packed, h->bytes);
+        }
+    } else {
+        memmove(buf + off + new_size, buf + off + old_size, tail);
+    }
+
+    h->packed = buf;
+    h->bytes = (uint32_t)bytes;
+    return buf + off;
+}
+
+// Sets a field to value_len bytes of value, which for a number are the bytes of its kv_num.
+static int packed_set(kv_fields *h, const char *field, size_t field_len,
+                      const char *value, size_t value_len, uint8_t encoding) {
+    long off = packed_find(h, field, field_len);
+    if (off >= 0) {
+        kv_value old;
+        size_t old_size = (size_t)(value_entry_get(h->packed + off, &old) - (h->packed + off));
+        uint8_t *p = packed_splice(h, (size_t)off, old_size, value_entry_size(value_len, encoding));
+        if (!p) return -1;
+        value_entry_put(p, value, value_len, encoding);
+        return 0;
+    }
+
+    uint8_t *p = packed_splice(h, h->bytes, 0, entry_size(field_len) + value_entry_size(value_len, encoding));
+    if (!p) return -1;
+    p = entry_put(p, field, field_len);
+    value_entry_put(p, value, value_len, encoding);
+    h->count++;
+    return 0;
+}
+
+static size_t field_value_mem(const kv_field_node *node) {
+    return node->encoding == KV_VALUE_RAW ? kv_str_mem(&node->value) : 0;
+}
+
+static void free_field_node(kv_field_node *node) {
+    kv_str_free(&node->field);
+    if (node->encoding == KV_VALUE_RAW) kv_str_free(&node->value);
+    slab_free(&field_node_cache, node);
+}
+
+/**
+ * @brief Stores a value in a field node, keeping the old one on failure.
+ *
+ * @param value For a number, the bytes of its kv_num.
+ */
+static int field_node_set(kv_field_node *node, const char *value, size_t value_len, uint8_t encoding) {
+    if (encoding != KV_VALUE_RAW) {
+        if (node->encoding == KV_VALUE_RAW) kv_str_free(&node->value);
+        memcpy(&node->num, value, sizeof(node->num));
+        node->encoding = encoding;
+        return 0;
+    }
+    if (node->encoding == KV_VALUE_RAW) return kv_str_set(&node->value, value, value_len);
+
+    kv_num num = node->num;
+    kv_str_init(&node->value);
+    if (kv_str_set(&node->value, value, value_len) != 0) {
+        node->num = num;
+        return -1;
+    }
+    node->encoding = KV_VALUE_RAW;
+    return 0;
+}
+
+static kv_field_node *new_field_node(const char *field, size_t field_len,
+                                     const char *value, size_t value_len, uint8_t encoding) {
+    kv_field_node *node = slab_alloc(&field_node_cache);
+    if (!node) return NULL;
+
+    kv_str_init(&node->field);
+    kv_str_init(&node->value);
+    node->encoding = KV_VALUE_RAW;
+    if (kv_str_set(&node->field, field, field_len) != 0 || field_node_set(node, value, value_len, encoding) != 0) {
+        free_field_node(node);
+        return NULL;
+    }
+    node->next = NULL;
+    return node;
+}
+
+static size_t field_node_mem(const kv_field_node *node) {
+    return sizeof(kv_field_node) + kv_str_mem(&node->field) + field_value_mem(node);
+}
+
+static struct kv_dict *dict_new(uint32_t size) {
+    struct kv_dict *d = malloc(sizeof(struct kv_dict));
+    if (!d) return NULL;
+
+    d->buckets = calloc(size, sizeof(kv_field_node *));
+    if (!d->buckets) {
+        free(d);
+        return NULL;
+    }
+    d->size = size;
+    d->mem = sizeof(struct kv_dict) + size * sizeof(kv_field_node *);
+    return d;
+}
+
+static void dict_free(struct kv_dict *d) {
+    for (uint32_t i = 0; i < d->size; i++) {
+        kv_field_node *node = d->buckets[i];
+        while (node) {
+            kv_field_node *next = node->next;
+            free_field_node(node);
+            node = next;
+        }
+    }
+    free(d->buckets);
+    free(d);
+}
+
+static void dict_link(struct kv_dict *d, kv_field_node *node) {
+    uint32_t idx = kv_hash(kv_str_data(&node->field), node->field.len) & (d->size - 1);
+    node->next = d->buckets[idx];
+    d->buckets[idx] = node;
+}
+
+static kv_field_node *dict_find(const struct kv_dict *d, const char *field, size_t field_len) {
+    kv_field_node *node = d->buckets[kv_hash(field, field_len) & (d->size - 1)];
+    while (node) {
+        if (kv_str_equals(&node->field, field, field_len)) return node;
+        node = node->next;
+    }
+    return NULL;
+}
+
+// Doubles the bucket array. On allocation failure the dict keeps its size.
+static void dict_grow(struct kv_dict *d) {
+    kv_field_node **old = d->buckets;
+    uint32_t old_size = d->size;
+
+    d->buckets = calloc((size_t)old_size * 2, sizeof(kv_field_node *));
+    if (!d->buckets) {
+        d->buckets = old;
+        return;
+    }
+    d->size = old_size * 2;
+    d->mem += old_size * sizeof(kv_field_node *);
+
+    for (uint32_t i = 0; i < old_size; i++) {
+        kv_field_node *node = old[i];
+        while (node) {
+            kv_field_node *next = node->next;
+            dict_link(d, node);
+            node = next;
+        }
+    }
+    free(old);
+}
+
+static int dict_set(kv_fields *h, const char *field, size_t field_len,
+                    const char *value, size_t value_len, uint8_t encoding) {
+    kv_field_node *node = dict_find(h->dict, field, field_len);
+    if (node) {
+        size_t before = field_value_mem(node);
+        if (field_node_set(node, value, value_len, encoding) != 0) return -1;
+        h->dict->mem = h->dict->mem - before + field_value_mem(node);
+        return 0;
+    }
+
+    node = new_field_node(field, field_len, value, value_len, encoding);
+    if (!node) return -1;
+    dict_link(h->dict, node);
+    h->dict->mem += field_node_mem(node);
+    h->count++;
+
+    if (h->count > h->dict->size) {
+        dict_grow(h->dict);
+    }
+    return 0;
+}
+
+// Moves every packed field into a new dict. Leaves h packed on failure.
+static int convert_to_dict(kv_fields *h) {
+    uint32_t size = KV_DICT_MIN_BUCKETS;
+    while (size < h->count) size <<= 1;
+
+    struct kv_dict *d = dict_new(size);
+    if (!d) return -1;
+
+    const uint8_t *p = h->packed;
+    const uint8_t *end = h->packed + h->bytes;
+    while (p < end) {
+        const char *field;
+        uint32_t field_len;
+        kv_value value;
+        p = entry_get(p, &field, &field_len);
+        p = value_entry_get(p, &value);
+
+        const char *data = value.encoding == KV_VALUE_RAW ? value.data : (const char *)&value.num;
+        kv_field_node *node = new_field_node(field, field_len, data, value.len, value.encoding);
+        if (!node) {
+            dict_free(d);
+            return -1;
+        }
+        dict_link(d, node);
+        d->mem += field_node_mem(node);
+    }
+
+    arena_free(h->packed, h->bytes);
+    h->dict = d;
+    h->bytes = 0;
+    h->encoding = KV_FIELDS_DICT;
+    return 0;
+}
+
+void kvfields_init(kv_fields *h) {
+    h->packed = NULL;
+    h->bytes = 0;
+    h->count = 0;
+    h->encoding = KV_FIELDS_PACKED;
+}
+
+void kvfields_free(kv_fields *h) {
+    if (h->encoding == KV_FIELDS_DICT) {
+        dict_free(h->dict);
+    } else if (h->packed) {
+        arena_free(h->packed, h->bytes);
+    }
+    kvfields_init(h);
+}
+
+/**
+ * @brief Bytes the hash's fields occupy outside the kv_node.
+ */
+size_t kvfields_mem(const kv_fields *h) {
+    if (h->encoding == KV_FIELDS_DICT) return h->dict->mem;
+    return h->packed ? arena_block_size(h->bytes) : 0;
+}
+
+/**
+ * @brief Looks up a field.
+ *
+ * @param value Receives the value, owned by the hash, when the field exists.
+ * @return true if the field exists.
+ */
+bool kvfields_get(const kv_fields *h, const char *field, size_t field_len, kv_value *value) {
+    if (h->encoding == KV_FIELDS_DICT) {
+        const kv_field_node *node = dict_find(h->dict, field, field_len);
+        if (!node) return false;
+        value->encoding = node->encoding;
+        if (node->encoding == KV_VALUE_RAW) {
+            value->data = kv_str_data(&node->value);
+            value->len = node->value.len;
+        } else {
+            value->num = node->num;
+        }
+        return true;
+    }
+
+    long off = packed_find(h, field, field_len);
+    if (off < 0) return false;
+    value_entry_get(h->packed + off, value);
+    return true;
+}
+
+static int fields_set(kv_fields *h, const char *field, size_t field_len,
+                      const char *value, size_t value_len, uint8_t encoding) {
+    if (h->encoding == KV_FIELDS_PACKED) {
+        bool too_long = field_len > max_packed_value || value_len > max_packed_value;
+        bool too_many = h->count >= max_packed_fields && packed_find(h, field, field_len) < 0;
+        if (!too_long && !too_many) {
+            return packed_set(h, field, field_len, value, value_len, encoding);
+        }
+        if (convert_to_dict(h) != 0) return -1;
+    }
+    return dict_set(h, field, field_len, value, value_len, encoding);
+}
+
+/**
+ * @brief Creates or overwrites a field, converting to a dict past the packed limits.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int kvfields_set(kv_fields *h, const char *field, size_t field_len, const char *value, size_t value_len) {
+    return fields_set(h, field, field_len, value, value_len, KV_VALUE_RAW);
+}
+
+/**
+ * @brief Stores a number in a field, like kvfields_set().
+ *
+ * @param encoding KV_VALUE_INT or KV_VALUE_FLOAT.
+ */
+int kvfields_set_num(kv_fields *h, const char *field, size_t field_len, uint8_t encoding, kv_num num) {
+    return fields_set(h, field, field_len, (const char *)&num, sizeof(num), encoding);
+}
@@ -0,0 +1,25 @@
+#ifndef KVFIELDS_H
+#define KVFIELDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kvstore.h"
+#include "kvnum.h"
+
+/*
+ * Field storage of a hash value. Small hashes are a single packed buffer;
+ * kvfields_set() converts them to a dict once they pass the limits set with
+ * kv_set_hash_packed_limits(). None of the functions lock; kvstore.c calls
+ * them with the key's stripe lock held.
+ */
+
+void kvfields_init(kv_fields *h);
+void kvfields_free(kv_fields *h);
+bool kvfields_get(const kv_fields *h, const char *field, size_t field_len, kv_value *value);
+size_t kvfields_mem(const kv_fields *h);
+int kvfields_set(kv_fields *h, const char *field, size_t field_len, const char *value, size_t value_len);
+int kvfields_set_num(kv_fields *h, const char *field, size_t field_len, uint8_t encoding, kv_num num);
+
+#endif
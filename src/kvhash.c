@@ -0,0 +1,138 @@
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+#include "kvhash.h"
+
+/*
+ * wyhash (final version 4, public domain, by Wang Yi). Inputs are read eight
+ * bytes at a time and folded with 64x64->128-bit multiplies, so a 1 KB key
+ * costs about 20 multiplies where djb2 needed 1024 dependent steps.
+ */
+
+#define WY_P0 0xa0761d6478bd642fULL
+#define WY_P1 0xe7037ed1a0b428dbULL
+#define WY_P2 0x8ebc6af09c88c6e3ULL
+#define WY_P3 0x589965cc75374cc3ULL
+
+static uint64_t hash_seed;
+
+static inline void wy_mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t wy_mix(uint64_t a, uint64_t b) {
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+// Unaligned native-endian loads; memcpy compiles to a single mov.
+static inline uint64_t wy_r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t wy_r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t wy_r3(const uint8_t *p, size_t k) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t kv_hash64(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *p = data;
+    uint64_t a;
+    uint64_t b;
+
+    seed ^= wy_mix(seed ^ WY_P0, WY_P1);
+    if (len <= 16) {
+        if (len >= 4) {
+            // two overlapping 4-byte reads from each end cover 4..16 bytes
+            a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+            b = (wy_r4(p + len - 4) << 32) | wy_r4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = wy_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            // three independent lanes keep the multiplier busy on long keys
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do {
+                seed = wy_mix(wy_r8(p) ^ WY_P1, wy_r8(p + 8) ^ seed);
+                see1 = wy_mix(wy_r8(p + 16) ^ WY_P2, wy_r8(p + 24) ^ see1);
+                see2 = wy_mix(wy_r8(p + 32) ^ WY_P3, wy_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wy_mix(wy_r8(p) ^ WY_P1, wy_r8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wy_r8(p + i - 16);
+        b = wy_r8(p + i - 8);
+    }
+
+    a ^= WY_P1;
+    b ^= seed;
+    wy_mum(&a, &b);
+    return wy_mix(a ^ WY_P0 ^ len, b ^ WY_P1);
+}
+
+/**
+ * @brief Hashes a binary-safe key with the process seed.
+ *
+ * The low bits pick the stripe and the bits above them the bucket, both by
+ * masking with a power-of-two size, so the 64-bit result is simply truncated.
+ */
+unsigned int kv_hash(const char *data, size_t len) {
+    return (unsigned int)kv_hash64(data, len, hash_seed);
+}
+
+uint64_t kv_hash_get_seed(void) {
+    return hash_seed;
+}
+
+/**
+ * @brief Replaces the process seed, e.g. to reproduce a run.
+ *
+ * Keys already stored were placed with the old seed, so call it only while
+ * the store is empty.
+ */
+void kv_hash_set_seed(uint64_t seed) {
+    hash_seed = seed;
+}
+
+// Seeds before main() so no key is ever hashed with a zero seed.
+__attribute__((constructor)) static void kv_hash_seed_init(void) {
+    if (getrandom(&hash_seed, sizeof(hash_seed), GRND_NONBLOCK) == (ssize_t)sizeof(hash_seed)) return;
+
+    // no entropy yet (early boot): still differs per process and per run
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hash_seed = wy_mix((uint64_t)ts.tv_sec ^ WY_P2, (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 32));
+}
@@ -0,0 +1,18 @@
+#ifndef KVHASH_H
+#define KVHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Seeded keyspace hash (wyhash). The seed is drawn from the kernel when the
+ * process starts, so bucket and stripe placement differ on every run and a
+ * client cannot precompute keys that pile into one bucket.
+ */
+
+uint64_t kv_hash64(const void *data, size_t len, uint64_t seed);
+unsigned int kv_hash(const char *data, size_t len);
+uint64_t kv_hash_get_seed(void);
+void kv_hash_set_seed(uint64_t seed);
+
+#endif
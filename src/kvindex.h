@@ -0,0 +1,82 @@
+#ifndef KVINDEX_H
+#define KVINDEX_H
+
+/*
+ * Keyspace index engine used inside each kvstore stripe.
+ *
+ * The engine is picked at build time (make KV_ENGINE=chain|swiss):
+ *   - kvindex_chain.c: power-of-two bucket array with chained kv_nodes.
+ *   - kvindex_swiss.c: open addressing with 1-byte hash tags probed 16 at a
+ *     time with SSE2, so most misses touch a single cache line of tags.
+ *
+ * Both engines grow and shrink incrementally: a resize keeps two tables and
+ * kvindex_rehash_step() migrates the old one a little at a time. None of the
+ * functions lock; kvstore.c calls them with the stripe lock held.
+ */
+
+#include <stdbool.h>
+
+#include "kvstore.h"
+#include "kvstr.h"
+#include "kvhash.h"
+
+#define KV_STRIPE_BITS 6
+#define KV_INDEX_SHRINK_PERCENT 10
+
+#if defined(KV_ENGINE_SWISS)
+
+#define KV_SWISS_GROUP 16
+
+typedef struct {
+    uint8_t *ctrl;        // one tag per slot: EMPTY, DELETED or the top 7 hash bits
+    kv_node **slots;
+    unsigned long capacity; // slots, a power-of-two multiple of KV_SWISS_GROUP
+    unsigned long used;
+    unsigned long tombstones;
+} kv_swiss_table;
+
+typedef struct {
+    kv_swiss_table t[2];
+    long rehash_idx;      // next group of t[0] to migrate, -1 when not rehashing
+} kv_index;
+
+#define KV_ENGINE_NAME "swiss"
+
+#else
+
+typedef struct {
+    kv_node **buckets;
+    unsigned long size;   // power of two, 0 while unallocated
+    unsigned long used;
+} kv_table;
+
+typedef struct {
+    kv_table ht[2];
+    long rehash_idx;      // next bucket of ht[0] to migrate, -1 when not rehashing
+} kv_index;
+
+#define KV_ENGINE_NAME "chain"
+
+#endif
+
+#define KV_INDEX_INIT { .rehash_idx = -1 }
+
+typedef struct {
+    unsigned long keys;
+    unsigned long slots;  // buckets or slots allocated across both tables
+    unsigned long rehash_done;
+    unsigned long rehash_total;
+} kv_index_stats_t;
+
+kv_node *kvindex_find(const kv_index *ix, unsigned int h, const char *key, size_t key_len);
+int kvindex_insert(kv_index *ix, unsigned int h, kv_node *node);
+kv_node *kvindex_remove(kv_index *ix, unsigned int h, const char *key, size_t key_len);
+bool kvindex_rehash_step(kv_index *ix, int n);
+bool kvindex_is_rehashing(const kv_index *ix);
+unsigned long kvindex_count(const kv_index *ix);
+void kvindex_clear(kv_index *ix, void (*free_node)(kv_node *));
+void kvindex_stats(const kv_index *ix, kv_index_stats_t *stats);
+size_t kvindex_mem(const kv_index *ix);
+size_t kvindex_sample(const kv_index *ix, unsigned long start, kv_node **out, size_t n);
+
+#endif
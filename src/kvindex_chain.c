@@ -0,0 +1,228 @@
+#include <stdlib.h>
+
+#include "kvindex.h"
+
+#define KV_CHAIN_MIN_BUCKETS 4
+
+/*
+ * Chained engine: a power-of-two bucket array whose entries are singly linked
+ * lists threaded through kv_node->next.
+ *
+ * The index grows once it averages one key per bucket and shrinks below
+ * KV_INDEX_SHRINK_PERCENT. Resizing allocates ht[1] and migrates ht[0] a
+ * bucket at a time; while rehash_idx >= 0 lookups check both tables and
+ * inserts go to ht[1].
+ */
+
+static unsigned long bucket_index(const kv_table *t, unsigned int h) {
+    return (h >> KV_STRIPE_BITS) & (t->size - 1);
+}
+
+bool kvindex_is_rehashing(const kv_index *ix) {
+    return ix->rehash_idx >= 0;
+}
+
+static int table_alloc(kv_table *t, unsigned long size) {
+    kv_node **buckets = calloc(size, sizeof(kv_node *));
+    if (!buckets) return -1;
+
+    t->buckets = buckets;
+    t->size = size;
+    t->used = 0;
+    return 0;
+}
+
+static void table_reset(kv_table *t) {
+    free(t->buckets);
+    t->buckets = NULL;
+    t->size = 0;
+    t->used = 0;
+}
+
+/**
+ * @brief Migrates up to n buckets of ht[0] into ht[1].
+ *
+ * Empty buckets are skipped, but at most n * 10 of them are visited so a
+ * sparse table cannot turn a single step into a full scan. When ht[0] is
+ * drained it is freed and ht[1] takes its place.
+ *
+ * @return true if the index is still rehashing afterwards.
+ */
+bool kvindex_rehash_step(kv_index *ix, int n) {
+    if (!kvindex_is_rehashing(ix)) return false;
+
+    int empty_visits = n * 10;
+    while (n-- > 0 && ix->ht[0].used > 0) {
+        while (ix->ht[0].buckets[ix->rehash_idx] == NULL) {
+            ix->rehash_idx++;
+            if (--empty_visits == 0) return true;
+        }
+
+        kv_node *node = ix->ht[0].buckets[ix->rehash_idx];
+        while (node) {
+            kv_node *next = node->next;
+            unsigned long idx = bucket_index(&ix->ht[1], kv_hash(kv_str_data(&node->key), node->key.len));
+            node->next = ix->ht[1].buckets[idx];
+            ix->ht[1].buckets[idx] = node;
+            ix->ht[0].used--;
+            ix->ht[1].used++;
+            node = next;
+        }
+        ix->ht[0].buckets[ix->rehash_idx] = NULL;
+        ix->rehash_idx++;
+    }
+
+    if (ix->ht[0].used == 0) {
+        free(ix->ht[0].buckets);
+        ix->ht[0] = ix->ht[1];
+        ix->ht[1] = (kv_table){ 0 };
+        ix->rehash_idx = -1;
+        return false;
+    }
+    return true;
+}
+
+static unsigned long next_power(unsigned long n) {
+    unsigned long size = KV_CHAIN_MIN_BUCKETS;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+static void start_rehash(kv_index *ix, unsigned long size) {
+    if (size == ix->ht[0].size) return;
+    if (table_alloc(&ix->ht[1], size) != 0) return; // keep serving from the current table
+    ix->rehash_idx = 0;
+}
+
+static void resize_if_needed(kv_index *ix) {
+    if (kvindex_is_rehashing(ix)) return;
+
+    const kv_table *t = &ix->ht[0];
+    if (t->used >= t->size) {
+        start_rehash(ix, t->size * 2);
+    } else if (t->size > KV_CHAIN_MIN_BUCKETS && t->used * 100 / t->size < KV_INDEX_SHRINK_PERCENT) {
+        start_rehash(ix, next_power(t->used));
+    }
+}
+
+kv_node *kvindex_find(const kv_index *ix, unsigned int h, const char *key, size_t key_len) {
+    for (int table = 0; table <= 1; table++) {
+        const kv_table *t = &ix->ht[table];
+        if (t->size == 0) break;
+
+        kv_node *node = t->buckets[bucket_index(t, h)];
+        while (node != NULL) {
+            if (kv_str_equals(&node->key, key, key_len)) {
+                return node;
+            }
+            node = node->next;
+        }
+
+        if (!kvindex_is_rehashing(ix)) break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Links a node whose key is not yet in the index.
+ *
+ * @return 0 on success, -1 if the first table could not be allocated.
+ */
+int kvindex_insert(kv_index *ix, unsigned int h, kv_node *node) {
+    if (ix->ht[0].size == 0 && table_alloc(&ix->ht[0], KV_CHAIN_MIN_BUCKETS) != 0) {
+        return -1;
+    }
+
+    kv_table *t = kvindex_is_rehashing(ix) ? &ix->ht[1] : &ix->ht[0];
+    unsigned long idx = bucket_index(t, h);
+    node->next = t->buckets[idx];
+    t->buckets[idx] = node;
+    t->used++;
+
+    resize_if_needed(ix);
+    return 0;
+}
+
+/**
+ * @brief Unlinks the node holding key.
+ *
+ * @return The unlinked node, owned by the caller, or NULL if key is absent.
+ */
+kv_node *kvindex_remove(kv_index *ix, unsigned int h, const char *key, size_t key_len) {
+    for (int table = 0; table <= 1; table++) {
+        kv_table *t = &ix->ht[table];
+        if (t->size == 0) break;
+
+        kv_node **link = &t->buckets[bucket_index(t, h)];
+        while (*link != NULL) {
+            kv_node *node = *link;
+            if (kv_str_equals(&node->key, key, key_len)) {
+                *link = node->next;
+                t->used--;
+                resize_if_needed(ix);
+                return node;
+            }
+            link = &node->next;
+        }
+
+        if (!kvindex_is_rehashing(ix)) break;
+    }
+    return NULL;
+}
+
+unsigned long kvindex_count(const kv_index *ix) {
+    return ix->ht[0].used + ix->ht[1].used;
+}
+
+static void free_table(kv_table *t, void (*free_node)(kv_node *)) {
+    for (unsigned long i = 0; i < t->size; i++) {
+        kv_node *node = t->buckets[i];
+
+        while (node) {
+            kv_node *next = node->next;
+            free_node(node);
+            node = next;
+        }
+    }
+    table_reset(t);
+}
+
+/**
+ * @brief Frees every node with free_node and releases both tables.
+ */
+void kvindex_clear(kv_index *ix, void (*free_node)(kv_node *)) {
+    free_table(&ix->ht[0], free_node);
+    free_table(&ix->ht[1], free_node);
+    ix->rehash_idx = -1;
+}
+
+// Bytes held by the bucket arrays.
+size_t kvindex_mem(const kv_index *ix) {
+    return (ix->ht[0].size + ix->ht[1].size) * sizeof(kv_node *);
+}
+
+/**
+ * @brief Collects up to n nodes, walking buckets forward from start.
+ *
+ * Used for eviction sampling. At most n * 10 buckets per table are visited,
+ * so a sparse table returns fewer nodes rather than a costly scan.
+ */
+size_t kvindex_sample(const kv_index *ix, unsigned long start, kv_node **out, size_t n) {
+    size_t found = 0;
+    for (int table = 0; table <= 1 && found < n; table++) {
+        const kv_table *t = &ix->ht[table];
+        unsigned long visits = t->size < n * 10 ? t->size : n * 10;
+        for (unsigned long i = 0; i < visits && found < n; i++) {
+            kv_node *node = t->buckets[(start + i) & (t->size - 1)];
+            for (; node && found < n; node = node->next) out[found++] = node;
+        }
+    }
+    return found;
+}
+
+void kvindex_stats(const kv_index *ix, kv_index_stats_t *stats) {
+    stats->keys = kvindex_count(ix);
+    stats->slots = ix->ht[0].size + ix->ht[1].size;
+    stats->rehash_done = kvindex_is_rehashing(ix) ? (unsigned long)ix->rehash_idx : 0;
+    stats->rehash_total = kvindex_is_rehashing(ix) ? ix->ht[0].size : 0;
+}
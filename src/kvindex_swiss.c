@@ -0,0 +1,368 @@
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "kvindex.h"
+
+/*
+ * Open-addressing engine in the style of a swiss table.
+ *
+ * Slots are grouped by KV_SWISS_GROUP. Next to the slot array sits a control
+ * array with one byte per slot: CTRL_EMPTY, CTRL_DELETED (a tombstone) or, for
+ * a full slot, a 7-bit tag taken from the hash. A lookup hashes to a group and
+ * compares all 16 tags at once with SSE2; only slots whose tag matches have
+ * their key compared, so a miss usually costs one 16-byte load and no pointer
+ * chasing. Groups are probed quadratically until one with an empty slot shows
+ * the key cannot be further along.
+ *
+ * The table is kept at most 7/8 full, counting tombstones. Past that it is
+ * rebuilt at a size that leaves it under half full, which also drops the
+ * tombstones, and it shrinks below KV_INDEX_SHRINK_PERCENT. Rebuilding is
+ * incremental like the chained engine: t[1] is allocated and t[0] is migrated
+ * a group at a time, leaving tombstones behind so the probe sequences of keys
+ * not yet moved stay intact.
+ */
+
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xFE
+
+#define KV_SWISS_MIN_CAPACITY KV_SWISS_GROUP
+
+typedef uint32_t group_mask;
+
+#ifdef __SSE2__
+
+static inline group_mask match_tag(const uint8_t *ctrl, uint8_t tag) {
+    __m128i group = _mm_load_si128((const __m128i *)ctrl);
+    return (group_mask)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+}
+
+// Empty and deleted slots are the only ones with the high bit set.
+static inline group_mask match_free(const uint8_t *ctrl) {
+    return (group_mask)_mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+}
+
+#else
+
+static inline group_mask match_tag(const uint8_t *ctrl, uint8_t tag) {
+    group_mask mask = 0;
+    for (int i = 0; i < KV_SWISS_GROUP; i++) {
+        if (ctrl[i] == tag) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static inline group_mask match_free(const uint8_t *ctrl) {
+    group_mask mask = 0;
+    for (int i = 0; i < KV_SWISS_GROUP; i++) {
+        if (ctrl[i] & 0x80) mask |= 1u << i;
+    }
+    return mask;
+}
+
+#endif
+
+static inline group_mask match_empty(const uint8_t *ctrl) {
+    return match_tag(ctrl, CTRL_EMPTY);
+}
+
+static inline group_mask match_full(const uint8_t *ctrl) {
+    return ~match_free(ctrl) & ((1u << KV_SWISS_GROUP) - 1);
+}
+
+// Top 7 bits of a multiplicative remix; the low bits already pick the stripe and group.
+static inline uint8_t hash_tag(unsigned int h) {
+    return (uint8_t)((h * 2654435761u) >> 25);
+}
+
+static inline unsigned long group_count(const kv_swiss_table *t) {
+    return t->capacity / KV_SWISS_GROUP;
+}
+
+static inline unsigned long max_load(const kv_swiss_table *t) {
+    return t->capacity - t->capacity / 8;
+}
+
+bool kvindex_is_rehashing(const kv_index *ix) {
+    return ix->rehash_idx >= 0;
+}
+
+static int table_alloc(kv_swiss_table *t, unsigned long capacity) {
+    void *mem;
+    // control bytes first, 64-byte aligned so every group is one aligned 16-byte load
+    if (posix_memalign(&mem, 64, capacity + capacity * sizeof(kv_node *)) != 0) return -1;
+
+    t->ctrl = mem;
+    t->slots = (kv_node **)(t->ctrl + capacity);
+    t->capacity = capacity;
+    t->used = 0;
+    t->tombstones = 0;
+    memset(t->ctrl, CTRL_EMPTY, capacity);
+    return 0;
+}
+
+static void table_reset(kv_swiss_table *t) {
+    free(t->ctrl);
+    *t = (kv_swiss_table){ 0 };
+}
+
+/**
+ * @brief Looks up a key in one table.
+ *
+ * @return The slot index, or -1 if the key is absent.
+ */
+static long table_find(const kv_swiss_table *t, unsigned int h, const char *key, size_t key_len) {
+    if (t->capacity == 0) return -1;
+
+    unsigned long mask = group_count(t) - 1;
+    unsigned long g = (h >> KV_STRIPE_BITS) & mask;
+    uint8_t tag = hash_tag(h);
+
+    for (unsigned long probe = 0; probe <= mask; probe++) {
+        const uint8_t *ctrl = t->ctrl + g * KV_SWISS_GROUP;
+
+        for (group_mask m = match_tag(ctrl, tag); m; m &= m - 1) {
+            unsigned long slot = g * KV_SWISS_GROUP + (unsigned long)__builtin_ctz(m);
+            if (kv_str_equals(&t->slots[slot]->key, key, key_len)) {
+                return (long)slot;
+            }
+        }
+        if (match_empty(ctrl)) return -1;
+
+        g = (g + probe + 1) & mask; // triangular steps visit every group of a power-of-two table
+    }
+    return -1;
+}
+
+/**
+ * @brief Places a node whose key is absent in the first free slot of its probe sequence.
+ *
+ * @return 0 on success, -1 if no group on the sequence has a free slot.
+ */
+static int table_insert(kv_swiss_table *t, unsigned int h, kv_node *node) {
+    unsigned long mask = group_count(t) - 1;
+    unsigned long g = (h >> KV_STRIPE_BITS) & mask;
+
+    for (unsigned long probe = 0; probe <= mask; probe++) {
+        group_mask m = match_free(t->ctrl + g * KV_SWISS_GROUP);
+        if (m) {
+            unsigned long slot = g * KV_SWISS_GROUP + (unsigned long)__builtin_ctz(m);
+            if (t->ctrl[slot] == CTRL_DELETED) t->tombstones--;
+            t->ctrl[slot] = hash_tag(h);
+            t->slots[slot] = node;
+            t->used++;
+            return 0;
+        }
+        g = (g + probe + 1) & mask;
+    }
+    return -1;
+}
+
+static unsigned long capacity_for(unsigned long keys) {
+    unsigned long capacity = KV_SWISS_MIN_CAPACITY;
+    while (keys * 16 > capacity * 7) capacity <<= 1; // at most 7/16 full after a resize
+    return capacity;
+}
+
+static void finish_rehash(kv_index *ix) {
+    table_reset(&ix->t[0]);
+    ix->t[0] = ix->t[1];
+    ix->t[1] = (kv_swiss_table){ 0 };
+    ix->rehash_idx = -1;
+}
+
+/**
+ * @brief Migrates up to n non-empty groups of t[0] into t[1].
+ *
+ * Empty groups cost one control-byte load each and at most n * 16 of them are
+ * skipped per call. Moved slots become tombstones so lookups of keys still in
+ * t[0] keep probing past them.
+ *
+ * @return true if the index is still rehashing afterwards.
+ */
+bool kvindex_rehash_step(kv_index *ix, int n) {
+    if (!kvindex_is_rehashing(ix)) return false;
+
+    kv_swiss_table *from = &ix->t[0];
+    unsigned long groups = group_count(from);
+    int empty_visits = n * 16;
+
+    while (n > 0 && from->used > 0 && (unsigned long)ix->rehash_idx < groups) {
+        unsigned long base = (unsigned long)ix->rehash_idx * KV_SWISS_GROUP;
+        group_mask m = match_full(from->ctrl + base);
+        ix->rehash_idx++;
+
+        if (!m) {
+            if (--empty_visits == 0) return true;
+            continue;
+        }
+
+        for (; m; m &= m - 1) {
+            unsigned long slot = base + (unsigned long)__builtin_ctz(m);
+            kv_node *node = from->slots[slot];
+            // kvindex_insert() keeps room in t[1] for every key left in t[0]
+            table_insert(&ix->t[1], kv_hash(kv_str_data(&node->key), node->key.len), node);
+            from->ctrl[slot] = CTRL_DELETED;
+            from->used--;
+        }
+        n--;
+    }
+
+    if (from->used == 0) {
+        finish_rehash(ix);
+        return false;
+    }
+    return true;
+}
+
+static void start_rehash(kv_index *ix, unsigned long capacity) {
+    if (table_alloc(&ix->t[1], capacity) != 0) return; // keep serving from the current table
+    ix->rehash_idx = 0;
+}
+
+/**
+ * @brief Moves every remaining key into a table sized for the current total.
+ *
+ * Only needed when writes outpace an incremental migration, e.g. a burst of
+ * inserts right after a shrink started. Returns -1 and leaves the index
+ * untouched if the new table cannot be allocated.
+ */
+static int rebuild_now(kv_index *ix) {
+    kv_swiss_table fresh;
+    if (table_alloc(&fresh, capacity_for(kvindex_count(ix) + 1)) != 0) return -1;
+
+    for (int table = 0; table <= 1; table++) {
+        kv_swiss_table *t = &ix->t[table];
+        for (unsigned long slot = 0; slot < t->capacity; slot++) {
+            if (t->ctrl[slot] & 0x80) continue;
+            kv_node *node = t->slots[slot];
+            table_insert(&fresh, kv_hash(kv_str_data(&node->key), node->key.len), node);
+        }
+        table_reset(t);
+    }
+
+    ix->t[0] = fresh;
+    ix->rehash_idx = -1;
+    return 0;
+}
+
+static void resize_if_needed(kv_index *ix) {
+    if (kvindex_is_rehashing(ix)) return;
+
+    const kv_swiss_table *t = &ix->t[0];
+    if (t->used + t->tombstones >= max_load(t)) {
+        start_rehash(ix, capacity_for(t->used)); // same size when mostly tombstones
+    } else if (t->capacity > KV_SWISS_MIN_CAPACITY && t->used * 100 / t->capacity < KV_INDEX_SHRINK_PERCENT) {
+        start_rehash(ix, capacity_for(t->used));
+    }
+}
+
+kv_node *kvindex_find(const kv_index *ix, unsigned int h, const char *key, size_t key_len) {
+    for (int table = 0; table <= 1; table++) {
+        const kv_swiss_table *t = &ix->t[table];
+        long slot = table_find(t, h, key, key_len);
+        if (slot >= 0) return t->slots[slot];
+
+        if (!kvindex_is_rehashing(ix)) break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Adds a node whose key is not yet in the index.
+ *
+ * @return 0 on success, -1 if a table could not be allocated.
+ */
+int kvindex_insert(kv_index *ix, unsigned int h, kv_node *node) {
+    if (ix->t[0].capacity == 0 && table_alloc(&ix->t[0], KV_SWISS_MIN_CAPACITY) != 0) {
+        return -1;
+    }
+
+    if (kvindex_is_rehashing(ix)) {
+        // every key still in t[0] will land in t[1] too
+        const kv_swiss_table *t = &ix->t[1];
+        if (kvindex_count(ix) + t->tombstones + 1 >= max_load(t) && rebuild_now(ix) != 0) {
+            return -1;
+        }
+    }
+
+    kv_swiss_table *t = kvindex_is_rehashing(ix) ? &ix->t[1] : &ix->t[0];
+    if (table_insert(t, h, node) != 0) return -1;
+
+    resize_if_needed(ix);
+    return 0;
+}
+
+/**
+ * @brief Removes the node holding key, leaving a tombstone in its slot.
+ *
+ * @return The removed node, owned by the caller, or NULL if key is absent.
+ */
+kv_node *kvindex_remove(kv_index *ix, unsigned int h, const char *key, size_t key_len) {
+    for (int table = 0; table <= 1; table++) {
+        kv_swiss_table *t = &ix->t[table];
+        long slot = table_find(t, h, key, key_len);
+        if (slot >= 0) {
+            kv_node *node = t->slots[slot];
+            t->ctrl[slot] = CTRL_DELETED;
+            t->used--;
+            t->tombstones++;
+            resize_if_needed(ix);
+            return node;
+        }
+
+        if (!kvindex_is_rehashing(ix)) break;
+    }
+    return NULL;
+}
+
+unsigned long kvindex_count(const kv_index *ix) {
+    return ix->t[0].used + ix->t[1].used;
+}
+
+/**
+ * @brief Frees every node with free_node and releases both tables.
+ */
+void kvindex_clear(kv_index *ix, void (*free_node)(kv_node *)) {
+    for (int table = 0; table <= 1; table++) {
+        kv_swiss_table *t = &ix->t[table];
+        for (unsigned long slot = 0; slot < t->capacity; slot++) {
+            if (!(t->ctrl[slot] & 0x80)) free_node(t->slots[slot]);
+        }
+        table_reset(t);
+    }
+    ix->rehash_idx = -1;
+}
+
+// Bytes held by the control and slot arrays.
+size_t kvindex_mem(const kv_index *ix) {
+    return (ix->t[0].capacity + ix->t[1].capacity) * (1 + sizeof(kv_node *));
+}
+
+/**
+ * @brief Collects up to n nodes, scanning forward from slot start.
+ *
+ * Used for eviction sampling. At most n * 10 slots per table are visited, so
+ * a sparse table returns fewer nodes rather than a costly scan.
+ */
+size_t kvindex_sample(const kv_index *ix, unsigned long start, kv_node **out, size_t n) {
+    size_t found = 0;
+    for (int table = 0; table <= 1 && found < n; table++) {
+        const kv_swiss_table *t = &ix->t[table];
+        unsigned long visits = t->capacity < n * 10 ? t->capacity : n * 10;
+        for (unsigned long i = 0; i < visits && found < n; i++) {
+            unsigned long slot = (start + i) & (t->capacity - 1);
+            if (!(t->ctrl[slot] & 0x80)) out[found++] = t->slots[slot];
+        }
+    }
+    return found;
+}
+
+void kvindex_stats(const kv_index *ix, kv_index_stats_t *stats) {
+    stats->keys = kvindex_count(ix);
+    stats->slots = ix->t[0].capacity + ix->t[1].capacity;
+    stats->rehash_done = kvindex_is_rehashing(ix) ? (unsigned long)ix->rehash_idx : 0;
+    stats->rehash_total = kvindex_is_rehashing(ix) ? group_count(&ix->t[0]) : 0;
+}
@@ -0,0 +1,161 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "kvnum.h"
+
+#define KV_FLOAT_EXACT 9007199254740992.0 // 2^53: doubles up to this hold every integer
+
+/**
+ * @brief Parses an integer written the way kv_format_int64() writes it.
+ *
+ * No sign other than '-', no leading zeros or spaces, so a value that parses
+ * reads back unchanged once it is stored as a number.
+ */
+bool kv_parse_int64(const char *data, size_t len, int64_t *out) {
+    if (len == 0 || len > 20) return false;
+
+    bool negative = data[0] == '-';
+    size_t i = negative ? 1 : 0;
+    if (i == len || (data[i] == '0' && len > 1)) return false;
+
+    uint64_t v = 0;
+    for (; i < len; i++) {
+        if (data[i] < '0' || data[i] > '9') return false;
+        unsigned digit = (unsigned)(data[i] - '0');
+        if (v > (UINT64_MAX - digit) / 10) return false;
+        v = v * 10 + digit;
+    }
+
+    if (negative) {
+        if (v > (uint64_t)INT64_MAX + 1) return false;
+        *out = v == 0 ? 0 : -(int64_t)(v - 1) - 1;
+    } else {
+        if (v > (uint64_t)INT64_MAX) return false;
+        *out = (int64_t)v;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a whole token as a finite or infinite double; NaN is refused.
+ *
+ * @param data NUL-terminated at len, as stored values and arguments are.
+ */
+bool kv_parse_float(const char *data, size_t len, double *out) {
+    if (len == 0 || isspace((unsigned char)data[0])) return false;
+
+    char *end;
+    double v = strtod(data, &end);
+    if (end != data + len || isnan(v)) return false;
+    *out = v;
+    return true;
+}
+
+/**
+ * @brief Writes value in base 10 and NUL-terminates it.
+ *
+ * @param buf At least KV_NUM_TEXT bytes.
+ * @return The length written.
+ */
+size_t kv_format_int64(int64_t value, char *buf) {
+    char digits[20];
+    uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    size_t n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+
+    size_t len = 0;
+    if (value < 0) buf[len++] = '-';
+    while (n > 0) buf[len++] = digits[--n];
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Writes the shortest text that parses back to value, at most 17 digits.
+ *
+ * @param buf At least KV_NUM_TEXT bytes.
+ * @return The length written.
+ */
+size_t kv_format_float(double value, char *buf) {
+    int len = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        len = snprintf(buf, KV_NUM_TEXT, "%.*g", precision, value);
+        if (strtod(buf, NULL) == value) break;
+    }
+    return (size_t)len;
+}
+
+/**
+ * @brief Returns the bytes of a value, formatting a number into buf.
+ *
+ * @param buf At least KV_NUM_TEXT bytes.
+ * @param len Receives the length.
+ * @return value->data, or buf.
+ */
+const char *kv_value_text(const kv_value *value, char *buf, size_t *len) {
+    switch (value->encoding) {
+        case KV_VALUE_INT:
+            *len = kv_format_int64(value->num.i, buf);
+            return buf;
+        case KV_VALUE_FLOAT:
+            *len = kv_format_float(value->num.d, buf);
+            return buf;
+        default:
+            *len = value->len;
+            return value->data;
+    }
+}
+
+/**
+ * @brief Adds an increment to a counter.
+ *
+ * A value still stored as text is parsed once here; the result is always a
+ * number. Float sums that are whole numbers are kept as integers, so INCR
+ * still works after INCRBYFLOAT brings a counter back to a whole number, as
+ * it does on Redis, where the sum is stored as text.
+ *
+ * @param current   The value, or NULL for a missing key or field, which counts as 0.
+ * @param encoding  KV_VALUE_INT to add increment.i, KV_VALUE_FLOAT to add increment.d.
+ * @param result    Receives the sum.
+ * @return 0, KV_ERR_NOT_INTEGER or KV_ERR_NOT_FLOAT if current is not a
+ *         number of that kind, or KV_ERR_OVERFLOW.
+ */
+int kv_value_incr(const kv_value *current, uint8_t encoding, kv_num increment, kv_value *result) {
+    int not_number = encoding == KV_VALUE_INT ? KV_ERR_NOT_INTEGER : KV_ERR_NOT_FLOAT;
+    uint8_t from = encoding;
+    kv_num num = { 0 };
+
+    if (current && current->encoding == KV_VALUE_RAW) {
+        bool ok = encoding == KV_VALUE_INT ? kv_parse_int64(current->data, current->len, &num.i)
+                                           : kv_parse_float(current->data, current->len, &num.d);
+        if (!ok) return not_number;
+    } else if (current) {
+        from = current->encoding;
+        num = current->num;
+    }
+
+    result->data = NULL;
+    result->len = 0;
+    if (encoding == KV_VALUE_INT) {
+        if (from != KV_VALUE_INT) return KV_ERR_NOT_INTEGER;
+        if (__builtin_add_overflow(num.i, increment.i, &result->num.i)) return KV_ERR_OVERFLOW;
+        result->encoding = KV_VALUE_INT;
+        return 0;
+    }
+
+    double sum = (from == KV_VALUE_INT ? (double)num.i : num.d) + increment.d;
+    if (!isfinite(sum)) return KV_ERR_OVERFLOW;
+    if (sum >= -KV_FLOAT_EXACT && sum <= KV_FLOAT_EXACT && sum == (double)(int64_t)sum) {
+        result->encoding = KV_VALUE_INT;
+        result->num.i = (int64_t)sum;
+    } else {
+        result->encoding = KV_VALUE_FLOAT;
+        result->num.d = sum;
+    }
+    return 0;
+}
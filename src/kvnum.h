@@ -0,0 +1,34 @@
+#ifndef KVNUM_H
+#define KVNUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kvstore.h"
+
+/*
+ * Counters. INCR, INCRBYFLOAT and their hash variants leave their result in
+ * the node or field as an int64_t or a double with a kv_value_encoding_t
+ * tag, so the next increment is plain arithmetic; the text is only produced
+ * when the value is read. None of the functions lock.
+ */
+
+#define KV_NUM_TEXT 32 // room for any formatted kv_num and its NUL
+
+// A string or hash field value as stored: bytes, or a number.
+typedef struct {
+    uint8_t encoding; // kv_value_encoding_t
+    kv_num num;       // unless encoding is KV_VALUE_RAW
+    const char *data; // if it is: NUL-terminated, owned by the store
+    size_t len;
+} kv_value;
+
+bool kv_parse_int64(const char *data, size_t len, int64_t *out);
+bool kv_parse_float(const char *data, size_t len, double *out);
+size_t kv_format_int64(int64_t value, char *buf);
+size_t kv_format_float(double value, char *buf);
+const char *kv_value_text(const kv_value *value, char *buf, size_t *len);
+int kv_value_incr(const kv_value *current, uint8_t encoding, kv_num increment, kv_value *result);
+
+#endif
@@ -2,275 +2,1369 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "kvstore.h"
+#include "kvindex.h"
+#include "kvstr.h"
+#include "kvhash.h"
+#include "kvfields.h"
+#include "kvnum.h"
+#include "kvexpire.h"
+#include "arena.h"
+#include "slab.h"
 
-static kv_node* hash_table[HASH_TABLE_SIZE];
+#define KV_REHASH_STEP 1
+#define KV_CRON_REHASH_STEP 100
+#define KV_CRON_BUDGET_NS 1000000L
+#define KV_EXPIRE_SAMPLE 20
+#define KV_EXPIRE_REPEAT_PERCENT 25
+#define KV_EXPIRE_BUDGET_NS 2500000L // 2.5% of a core at the 100 ms cron interval
+#define KV_LRU_CLOCK_MS 100
+#define KV_LFU_INIT 5
+#define KV_LFU_LOG_FACTOR 10
+#define KV_LFU_DECAY_TICKS (60000 / KV_LRU_CLOCK_MS) // counters lose one per idle minute
+#define KV_EVICT_SAMPLES 5
+#define KV_EVICT_POOL_SIZE 16
+#define KV_EVICT_MAX_ROUNDS 16
 
+_Static_assert(KV_LOCK_STRIPES == 1 << KV_STRIPE_BITS, "KV_LOCK_STRIPES must be 1 << KV_STRIPE_BITS");
+
+/*
+ * The keyspace is split into stripes, each owning its own table and a rwlock.
+ * A key always maps to the same stripe, so readers of different keys only
+ * contend when they land on the same stripe, and readers of the same stripe
+ * share the lock. Stripes are cache-line aligned to avoid false sharing
+ * between neighbouring locks.
+ *
+ * Each stripe indexes its keys with the engine chosen at build time (see
+ * kvindex.h) and grows and shrinks on its own. A resize migrates the old
+ * table incrementally: every write to the stripe moves KV_REHASH_STEP
+ * buckets or groups and kv_cron() moves more in the background, so no single
+ * command pays for moving the whole table.
+ *
+ * Keys with a TTL also have an entry in the stripe's expires table. Reads
+ * treat a key past its TTL as missing; the next write to the key, or the
+ * active cycle in kv_cron(), deletes it.
+ *
+ * Every stripe also publishes its key count and memory use. The counters are
+ * written under the stripe write lock and read without it, so INFO sums 64
+ * words instead of walking or locking the keyspace.
+ */
+typedef struct {
+    pthread_rwlock_t lock;
+    kv_index index;
+    kv_expires expires;
+    size_t keys;     // keys in the index
+    size_t expiring; // keys with a TTL
+    size_t dataset;  // bytes held by nodes, keys and values
+    size_t overhead; // bytes held by the index and expires tables
+    bool rehashing;  // hint for kv_cron(), rechecked under the lock
+} __attribute__((aligned(64))) kv_stripe;
+
+static kv_stripe stripes[KV_LOCK_STRIPES] = {
+    [0 ... KV_LOCK_STRIPES - 1] = { .lock = PTHREAD_RWLOCK_INITIALIZER, .index = KV_INDEX_INIT }
+};
+
+// Stripes held by the calling thread through kv_lock_keys(). Operations on
+// these skip locking so multi-key commands run under a single acquisition.
+static __thread uint64_t held_read;
+static __thread uint64_t held_write;
+
+// Text of a counter read with kv_get() or kv_hget(), valid until the thread's next call.
+static __thread char num_text[KV_NUM_TEXT];
+
+static size_t max_value_len = KV_DEFAULT_MAX_VALUE_LEN;
+static size_t used_memory_peak;
+static size_t keyspace_mem; // running sum of every stripe's dataset + overhead
+static size_t expired_keys;
+
+static size_t maxmemory;
+static kv_eviction_policy_t eviction_policy = KV_EVICT_NOEVICTION;
+static size_t evicted_keys;
+static uint32_t lru_clock; // coarse clock for access times, advanced by kv_cron()
+
+static const char *eviction_policy_names[] = {
+    [KV_EVICT_NOEVICTION]   = "noeviction",
+    [KV_EVICT_ALLKEYS_LRU]  = "allkeys-lru",
+    [KV_EVICT_ALLKEYS_LFU]  = "allkeys-lfu",
+    [KV_EVICT_VOLATILE_TTL] = "volatile-ttl",
+};
+
+// State of the active expire cycle, only touched by the thread running kv_cron().
+static unsigned int expire_cursor;
+static uint64_t expire_rng = 0x9e3779b97f4a7c15ULL;
+
+static unsigned int stripe_index(unsigned int h) {
+    return h & (KV_LOCK_STRIPES - 1);
+}
+
+/**
+ * @brief Acquires a stripe lock unless the calling thread already holds it.
+ *
+ * @return 1 if the lock was taken and must be released with stripe_unlock(),
+ *         0 if the thread already holds it through kv_lock_keys(),
+ *         -1 if a write was requested on a stripe held only for reading.
+ */
+static int stripe_lock(unsigned int idx, bool write) {
+    uint64_t bit = 1ULL << idx;
+
+    if (held_write & bit) return 0;
+    if (held_read & bit) return write ? -1 : 0;
+
+    if (write) {
+        pthread_rwlock_wrlock(&stripes[idx].lock);
+    } else {
+        pthread_rwlock_rdlock(&stripes[idx].lock);
+    }
+    return 1;
+}
+
+static void stripe_unlock(unsigned int idx, int taken) {
+    if (taken == 1) {
+        pthread_rwlock_unlock(&stripes[idx].lock);
+    }
+}
+
+// Runs the per-write share of rehashing. Caller must hold the stripe write lock.
+static void stripe_write_step(kv_stripe *s) {
+    kvindex_rehash_step(&s->index, KV_REHASH_STEP);
+}
+
+// Adds a new node to the stripe. Caller must hold the stripe write lock.
+static int insert_node_locked(unsigned int h, kv_node *node) {
+    return kvindex_insert(&stripes[stripe_index(h)].index, h, node);
+}
+
+static slab_cache node_cache = SLAB_CACHE_INIT("kv_node", sizeof(kv_node));
+
+// Bytes charged to a node: the node itself plus its out-of-line key and value.
+static size_t node_mem(const kv_node *node) {
+    size_t mem = sizeof(kv_node) + kv_str_mem(&node->key);
+    if (node->type == KV_HASH) return mem + kvfields_mem(&node->fields);
+    return mem + (node->encoding == KV_VALUE_RAW ? kv_str_mem(&node->value) : 0);
+}
+
+// Publishes the stripe's counters after a change. Caller must hold the stripe write lock.
+static void stripe_account(kv_stripe *s, ssize_t dataset_delta) {
+    size_t before = s->dataset + s->overhead;
+    __atomic_store_n(&s->keys, (size_t)kvindex_count(&s->index), __ATOMIC_RELAXED);
+    __atomic_store_n(&s->expiring, s->expires.used, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->dataset, s->dataset + (size_t)dataset_delta, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->overhead, kvindex_mem(&s->index) + kvexpire_mem(&s->expires), __ATOMIC_RELAXED);
+    __atomic_store_n(&s->rehashing, kvindex_is_rehashing(&s->index), __ATOMIC_RELAXED);
+
+    size_t after = s->dataset + s->overhead;
+    if (after != before) __atomic_add_fetch(&keyspace_mem, after - before, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Returns the number of keys without taking any stripe lock.
+ *
+ * Concurrent writers may or may not be reflected, as with any lock-free read.
+ */
 int kv_count_keys(void) {
-    int count = 0;
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        kv_node* node = hash_table[i];
-        while (node != NULL) {
-            count++;
-            node = node->next;
-        }
+    size_t count = 0;
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        count += __atomic_load_n(&stripes[i].keys, __ATOMIC_RELAXED);
     }
-    return count;
+    return (int)count;
 }
 
-static unsigned int hash(const char* key) {
-    unsigned int hash = 5381;
-    int c;
-    while ((c = (unsigned char)*key++)) {
-        hash = ((hash << 5) + hash) + c;
+static void free_node(kv_node *node) {
+    if (node->type == KV_HASH) {
+        kvfields_free(&node->fields);
+    } else if (node->encoding == KV_VALUE_RAW) {
+        kv_str_free(&node->value);
     }
-    return hash % HASH_TABLE_SIZE;
+    kv_str_free(&node->key);
+    slab_free(&node_cache, node);
 }
 
-static void free_hash_fields(kv_field_node *field) {
-    while (field) {
-        kv_field_node *next_field = field->next;
-        free(field);
-        field = next_field;
+void kv_init() {
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        int taken = stripe_lock(i, true);
+
+        kvexpire_clear(&stripes[i].expires);
+        kvindex_clear(&stripes[i].index, free_node);
+        stripe_account(&stripes[i], -(ssize_t)stripes[i].dataset);
+
+        stripe_unlock(i, taken);
     }
 }
 
-static kv_field_node* find_field_node(kv_field_node *field_node, const char *field) {
-    while (field_node) {
-        if (strcmp(field_node->field, field) == 0) {
-            return field_node;
+/**
+ * @brief Sets the largest value, in bytes, that SET and HSET accept.
+ */
+void kv_set_max_value_len(size_t max_len) {
+    // lengths are stored in 32 bits
+    max_value_len = max_len < UINT32_MAX ? max_len : UINT32_MAX - 1;
+}
+
+size_t kv_get_max_value_len(void) {
+    return max_value_len;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool node_expired(const kv_stripe *s, const kv_node *node, int64_t now) {
+    int64_t when;
+    return (node->flags & KV_NODE_EXPIRES) && kvexpire_get(&s->expires, node, &when) && when <= now;
+}
+
+// Unlinks and frees a node, dropping its TTL. Caller must hold the stripe write lock.
+static void delete_node_locked(kv_stripe *s, unsigned int h, kv_node *node) {
+    kvindex_remove(&s->index, h, kv_str_data(&node->key), node->key.len);
+    if (node->flags & KV_NODE_EXPIRES) kvexpire_remove(&s->expires, node);
+    stripe_account(s, -(ssize_t)node_mem(node));
+    free_node(node);
+}
+
+static void expire_node_locked(kv_stripe *s, unsigned int h, kv_node *node) {
+    delete_node_locked(s, h, node);
+    __atomic_add_fetch(&expired_keys, 1, __ATOMIC_RELAXED);
+}
+
+static uint32_t lru_now(void) {
+    return __atomic_load_n(&lru_clock, __ATOMIC_RELAXED);
+}
+
+static void lru_clock_update(void) {
+    __atomic_store_n(&lru_clock, (uint32_t)(now_ms() / KV_LRU_CLOCK_MS), __ATOMIC_RELAXED);
+}
+
+// xorshift64 for LFU increments and eviction sampling, one state per thread.
+static uint64_t thread_random(void) {
+    static __thread uint64_t state;
+    if (state == 0) state = kv_hash64(&state, sizeof(uint64_t *), (uint64_t)(uintptr_t)&state) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static uint32_t idle_ticks(const kv_node *node, uint32_t now) {
+    uint32_t atime = __atomic_load_n(&node->atime, __ATOMIC_RELAXED);
+    return now > atime ? now - atime : 0; // another thread may have advanced the clock
+}
+
+// Access counter after decaying it by one for every KV_LFU_DECAY_TICKS idle.
+static uint8_t lfu_decayed(const kv_node *node, uint32_t now) {
+    uint8_t freq = __atomic_load_n(&node->freq, __ATOMIC_RELAXED);
+    uint32_t periods = idle_ticks(node, now) / KV_LFU_DECAY_TICKS;
+    return periods >= freq ? 0 : (uint8_t)(freq - periods);
+}
+
+/**
+ * @brief Records an access for the eviction policies.
+ *
+ * Readers share the stripe lock, so the fields are written with relaxed
+ * atomics and concurrent hits may overwrite each other; the counters only
+ * need to be approximately right. The LFU counter grows logarithmically:
+ * the higher it is, the less likely a hit increments it, so 8 bits cover
+ * millions of accesses.
+ */
+static void touch_node(kv_node *node) {
+    uint32_t now = lru_now();
+
+    if (__atomic_load_n(&eviction_policy, __ATOMIC_RELAXED) == KV_EVICT_ALLKEYS_LFU) {
+        uint8_t freq = lfu_decayed(node, now);
+        if (freq < UINT8_MAX) {
+            double base = freq > KV_LFU_INIT ? freq - KV_LFU_INIT : 0;
+            double r = (double)(thread_random() >> 11) / (double)(1ULL << 53);
+            if (r < 1.0 / (base * KV_LFU_LOG_FACTOR + 1)) freq++;
+        }
+        if (freq != __atomic_load_n(&node->freq, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&node->freq, freq, __ATOMIC_RELAXED);
         }
-        field_node = field_node->next;
     }
-    return NULL;
+    if (__atomic_load_n(&node->atime, __ATOMIC_RELAXED) != now) {
+        __atomic_store_n(&node->atime, now, __ATOMIC_RELAXED);
+    }
 }
 
-void kv_init() {
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        kv_node* node = hash_table[i];
+// Returns the node for key unless it is missing or past its TTL.
+// Caller must hold the stripe lock for h.
+static kv_node* find_node_locked(unsigned int h, const char* key, size_t key_len) {
+    kv_stripe *s = &stripes[stripe_index(h)];
+    kv_node *node = kvindex_find(&s->index, h, key, key_len);
+    if (!node || node_expired(s, node, now_ms())) return NULL;
+    touch_node(node);
+    return node;
+}
+
+// Like find_node_locked(), but deletes the key if its TTL has passed.
+// Caller must hold the stripe write lock.
+static kv_node* find_node_write_locked(unsigned int h, const char* key, size_t key_len) {
+    kv_stripe *s = &stripes[stripe_index(h)];
+    kv_node *node = kvindex_find(&s->index, h, key, key_len);
+    if (node && node_expired(s, node, now_ms())) {
+        expire_node_locked(s, h, node);
+        return NULL;
+    }
+    if (node) touch_node(node);
+    return node;
+}
 
-        while (node) {
-            kv_node* next = node->next;
+// Sets node to expire ttl_ms from now, or removes its TTL when ttl_ms is 0.
+// Caller must hold the stripe write lock.
+static int set_ttl_locked(kv_stripe *s, kv_node *node, int64_t ttl_ms) {
+    if (ttl_ms == 0) {
+        if (node->flags & KV_NODE_EXPIRES) kvexpire_remove(&s->expires, node);
+        node->flags &= (uint8_t)~KV_NODE_EXPIRES;
+        return 0;
+    }
 
-            if (node->type == KV_HASH) {
-                free_hash_fields(node->hash_fields);
-            }
+    if (kvexpire_set(&s->expires, node, now_ms() + ttl_ms) != 0) return -1;
+    node->flags |= KV_NODE_EXPIRES;
+    return 0;
+}
+
+// Allocates a node of the given type owning a copy of key.
+static kv_node* new_node(const char *key, size_t key_len, kv_type_t type) {
+    kv_node* node = slab_alloc(&node_cache);
+    if (!node) return NULL;
+
+    kv_str_init(&node->key);
+    if (kv_str_set(&node->key, key, key_len) != 0) {
+        slab_free(&node_cache, node);
+        return NULL;
+    }
+
+    node->type = (uint8_t)type;
+    node->encoding = KV_VALUE_RAW;
+    node->flags = 0;
+    node->freq = KV_LFU_INIT;
+    node->atime = lru_now();
+    if (type == KV_HASH) {
+        kvfields_init(&node->fields);
+    } else {
+        kv_str_init(&node->value);
+    }
+    return node;
+}
+
+// Describes the value of a string node.
+static void node_value(const kv_node *node, kv_value *value) {
+    value->encoding = node->encoding;
+    if (node->encoding == KV_VALUE_RAW) {
+        value->data = kv_str_data(&node->value);
+        value->len = node->value.len;
+    } else {
+        value->num = node->num;
+    }
+}
+
+// Stores bytes in a string node, keeping its old value if memory runs out.
+static int node_set_value(kv_node *node, const char *value, size_t value_len) {
+    if (node->encoding == KV_VALUE_RAW) return kv_str_set(&node->value, value, value_len);
+
+    kv_num num = node->num;
+    kv_str_init(&node->value);
+    if (kv_str_set(&node->value, value, value_len) != 0) {
+        node->num = num;
+        return -1;
+    }
+    node->encoding = KV_VALUE_RAW;
+    return 0;
+}
+
+static void node_set_num(kv_node *node, uint8_t encoding, kv_num num) {
+    if (node->encoding == KV_VALUE_RAW) kv_str_free(&node->value);
+    node->num = num;
+    node->encoding = encoding;
+}
+
+/*
+ * Eviction. Once used memory passes maxmemory, every write that can add data
+ * first evicts keys until the keyspace is back under the limit. Victims are
+ * approximated as in Redis: KV_EVICT_SAMPLES keys are sampled from a random
+ * stripe, scored by the policy, and merged into a small per-thread pool of
+ * the best candidates seen so far. The best candidate is evicted once it is
+ * confirmed to still exist, so each eviction costs a handful of lookups
+ * rather than a scan, and the pool carries good candidates between calls.
+ */
+typedef struct {
+    uint64_t score; // higher is a better victim
+    unsigned int stripe;
+    uint32_t key_len;
+    char key[MAX_KEY_LEN];
+} evict_candidate;
+
+static __thread evict_candidate evict_pool[KV_EVICT_POOL_SIZE]; // ascending score
+static __thread int evict_pool_len;
+
+static size_t used_memory_now(void) {
+    return __atomic_load_n(&keyspace_mem, __ATOMIC_RELAXED) + sizeof(stripes);
+}
+
+/**
+ * @brief Locks a stripe without blocking, for eviction or stats.
+ *
+ * The caller may hold other stripes through kv_lock_keys(), so waiting here
+ * could deadlock against a thread locking in ascending order.
+ *
+ * @return As stripe_lock(), or -1 if the stripe is busy.
+ */
+static int stripe_trylock(unsigned int idx, bool write) {
+    uint64_t bit = 1ULL << idx;
+    if (held_write & bit) return 0;
+    if (held_read & bit) return write ? -1 : 0;
+    int res = write ? pthread_rwlock_trywrlock(&stripes[idx].lock) : pthread_rwlock_tryrdlock(&stripes[idx].lock);
+    return res == 0 ? 1 : -1;
+}
+
+static void evict_pool_insert(uint64_t score, unsigned int stripe, const kv_node *node) {
+    if (node->key.len >= MAX_KEY_LEN) return;
+    if (evict_pool_len == KV_EVICT_POOL_SIZE && score <= evict_pool[0].score) return;
+
+    const char *key = kv_str_data(&node->key);
+    for (int i = 0; i < evict_pool_len; i++) {
+        if (evict_pool[i].key_len == node->key.len && memcmp(evict_pool[i].key, key, node->key.len) == 0) return;
+    }
+
+    int pos = 0;
+    while (pos < evict_pool_len && evict_pool[pos].score < score) pos++;
+    if (evict_pool_len == KV_EVICT_POOL_SIZE) {
+        // drop the worst candidate to make room
+        pos--;
+        memmove(&evict_pool[0], &evict_pool[1], (size_t)pos * sizeof(evict_candidate));
+    } else {
+        memmove(&evict_pool[pos + 1], &evict_pool[pos], (size_t)(evict_pool_len - pos) * sizeof(evict_candidate));
+        evict_pool_len++;
+    }
+
+    evict_candidate *c = &evict_pool[pos];
+    c->score = score;
+    c->stripe = stripe;
+    c->key_len = node->key.len;
+    memcpy(c->key, key, node->key.len);
+}
 
-            free(node);
-            node = next;
+// Samples one stripe into the pool. Caller must hold the stripe write lock.
+static void evict_pool_populate_locked(unsigned int idx, kv_eviction_policy_t policy) {
+    kv_stripe *s = &stripes[idx];
+    uint32_t now = lru_now();
+
+    if (policy == KV_EVICT_VOLATILE_TTL) {
+        kv_expire_entry sample[KV_EVICT_SAMPLES];
+        size_t n = kvexpire_sample(&s->expires, (size_t)thread_random(), sample, KV_EVICT_SAMPLES);
+        for (size_t i = 0; i < n; i++) {
+            // the sooner it expires, the better the victim
+            evict_pool_insert(UINT64_MAX - (uint64_t)sample[i].when, idx, sample[i].node);
         }
+        return;
+    }
+
+    kv_node *sample[KV_EVICT_SAMPLES];
+    size_t n = kvindex_sample(&s->index, (unsigned long)thread_random(), sample, KV_EVICT_SAMPLES);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t score = policy == KV_EVICT_ALLKEYS_LFU
+            ? (uint64_t)(UINT8_MAX - lfu_decayed(sample[i], now))
+            : (uint64_t)idle_ticks(sample[i], now);
+        evict_pool_insert(score, idx, sample[i]);
+    }
+}
+
+// Refills the pool from the first lockable stripe, starting at a random one,
+// that has keys the policy may evict.
+static void evict_pool_refill(kv_eviction_policy_t policy) {
+    unsigned int start = (unsigned int)thread_random();
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        unsigned int idx = (start + i) & (KV_LOCK_STRIPES - 1);
+        kv_stripe *s = &stripes[idx];
+        size_t *candidates = policy == KV_EVICT_VOLATILE_TTL ? &s->expiring : &s->keys;
+        if (__atomic_load_n(candidates, __ATOMIC_RELAXED) == 0) continue;
+
+        int taken = stripe_trylock(idx, true);
+        if (taken < 0) continue;
+        evict_pool_populate_locked(idx, policy);
+        stripe_unlock(idx, taken);
+        return;
+    }
+}
+
+// Evicts the best candidate in the pool that still exists.
+// Returns 0 if a key was evicted, -1 once the pool runs dry.
+static int evict_pool_pop(kv_eviction_policy_t policy) {
+    while (evict_pool_len > 0) {
+        evict_candidate *c = &evict_pool[--evict_pool_len];
+        int taken = stripe_trylock(c->stripe, true);
+        if (taken < 0) continue;
 
-        hash_table[i] = NULL;
+        kv_stripe *s = &stripes[c->stripe];
+        unsigned int h = kv_hash(c->key, c->key_len);
+        kv_node *node = kvindex_find(&s->index, h, c->key, c->key_len);
+        bool evict = node && (policy != KV_EVICT_VOLATILE_TTL || (node->flags & KV_NODE_EXPIRES));
+        if (evict) {
+            delete_node_locked(s, h, node);
+            __atomic_add_fetch(&evicted_keys, 1, __ATOMIC_RELAXED);
+        }
+        stripe_unlock(c->stripe, taken);
+        if (evict) return 0;
     }
+    return -1;
 }
 
-static kv_node* find_node(const char* key) {
-    unsigned int index = hash(key);
-    kv_node* node = hash_table[index];
+/**
+ * @brief Makes room for a write when used memory is over maxmemory.
+ *
+ * @return 0 if the write may proceed, KV_ERR_OOM if the policy is noeviction
+ *         or no evictable key could be found.
+ */
+static int evict_if_needed(void) {
+    size_t limit = __atomic_load_n(&maxmemory, __ATOMIC_RELAXED);
+    if (limit == 0 || used_memory_now() <= limit) return 0;
 
-    while (node != NULL) {
-        if (strcmp(node->key, key) == 0) {
-            return node;
+    kv_eviction_policy_t policy = __atomic_load_n(&eviction_policy, __ATOMIC_RELAXED);
+    if (policy == KV_EVICT_NOEVICTION) return KV_ERR_OOM;
+
+    lru_clock_update();
+    while (used_memory_now() > limit) {
+        int evicted = -1;
+        for (int round = 0; round < KV_EVICT_MAX_ROUNDS && evicted != 0; round++) {
+            evict_pool_refill(policy);
+            evicted = evict_pool_pop(policy);
         }
-        node = node->next;
+        if (evicted != 0) return KV_ERR_OOM;
+    }
+    return 0;
+}
+
+/**
+ * @brief Caps the keyspace at bytes of used_memory; 0 removes the limit.
+ *
+ * @param policy What writes do once the limit is reached.
+ */
+void kv_set_maxmemory(size_t bytes, kv_eviction_policy_t policy) {
+    __atomic_store_n(&eviction_policy, policy, __ATOMIC_RELAXED);
+    __atomic_store_n(&maxmemory, bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Parses a policy name such as "allkeys-lru".
+ *
+ * @return The kv_eviction_policy_t, or -1 if the name is unknown.
+ */
+int kv_eviction_policy_from_name(const char *name) {
+    for (size_t i = 0; i < sizeof(eviction_policy_names) / sizeof(eviction_policy_names[0]); i++) {
+        if (strcmp(name, eviction_policy_names[i]) == 0) return (int)i;
     }
-    return NULL;
+    return -1;
 }
 
 bool kv_is_hash(const char *key) {
-    const kv_node* node = find_node(key);
-    if (!node) return false;
-    return (node->type == KV_HASH);
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node* node = find_node_locked(h, key, key_len);
+    bool is_hash = node && node->type == KV_HASH;
+    stripe_unlock(stripe_index(h), taken);
+    return is_hash;
 }
 
 int kv_set(const char* key, const char* value) {
-    unsigned int index = hash(key);
-    kv_node* node = hash_table[index];
+    return kv_setn(key, strlen(key), value, strlen(value));
+}
+
+/**
+ * @brief Stores a binary-safe string value.
+ *
+ * @return 0 on success, KV_ERR_TOO_LARGE if the value exceeds the configured
+ *         maximum, KV_ERR_OOM if used memory is over maxmemory and nothing can
+ *         be evicted, -1 if the key holds another type or memory is exhausted.
+ */
+int kv_setn(const char *key, size_t key_len, const char *value, size_t value_len) {
+    return kv_setex(key, key_len, value, value_len, 0);
+}
+
+/**
+ * @brief Stores a string value that expires ttl_ms milliseconds from now.
+ *
+ * Like SET, a ttl_ms of 0 stores the value without a TTL and clears any TTL
+ * the key had.
+ *
+ * @return The same results as kv_setn().
+ */
+int kv_setex(const char *key, size_t key_len, const char *value, size_t value_len, int64_t ttl_ms) {
+    if (value_len > max_value_len) return KV_ERR_TOO_LARGE;
+    if (evict_if_needed() != 0) return KV_ERR_OOM;
 
-    while (node != NULL) {
-        if (strcmp(node->key, key) == 0) {
-            // enforce type safety
-            if (node->type != KV_STRING) return -1;
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
 
-            snprintf(node->value, MAX_VAL_LEN, "%s", value);
-            return 0;
+    kv_stripe *s = &stripes[stripe_index(h)];
+    stripe_write_step(s);
+
+    int res = 0;
+    kv_node* node = find_node_write_locked(h, key, key_len);
+    if (node) {
+        // enforce type safety
+        size_t before = node_mem(node);
+        if (node->type != KV_STRING || node_set_value(node, value, value_len) != 0 ||
+            set_ttl_locked(s, node, ttl_ms) != 0) {
+            res = -1;
         }
-        node = node->next;
+        stripe_account(s, (ssize_t)node_mem(node) - (ssize_t)before);
+        stripe_unlock(stripe_index(h), taken);
+        return res;
     }
 
-    kv_node* new_node = (kv_node*)malloc(sizeof(kv_node));
-    if (!new_node) return -1;
-
-    snprintf(new_node->key, MAX_KEY_LEN, "%s", key);
-    new_node->type = KV_STRING;
-    snprintf(new_node->value, MAX_VAL_LEN, "%s", value);
-    new_node->next = hash_table[index];
-    hash_table[index] = new_node;
+    node = new_node(key, key_len, KV_STRING);
+    if (!node || node_set_value(node, value, value_len) != 0 || insert_node_locked(h, node) != 0) {
+        if (node) free_node(node);
+        res = -1;
+    } else {
+        res = set_ttl_locked(s, node, ttl_ms);
+        stripe_account(s, (ssize_t)node_mem(node));
+        if (res != 0) delete_node_locked(s, h, node);
+    }
 
-    return 0;
+    stripe_unlock(stripe_index(h), taken);
+    return res;
 }
 
+/**
+ * @brief Returns a pointer to the stored string value.
+ *
+ * The pointer refers to memory owned by the store and is only stable while no
+ * other thread modifies or deletes the key; a counter is formatted into a
+ * per-thread buffer instead. Concurrent callers should use kv_get_copy().
+ */
 const char* kv_get(const char* key) {
-    const kv_node* node = find_node(key);
-    if (!node) return NULL;
-    if (node->type != KV_STRING) return NULL; // enforce type safety
-    return node->value;
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node* node = find_node_locked(h, key, key_len);
+
+    const char *text = NULL;
+    if (node && node->type == KV_STRING) { // enforce type safety
+        kv_value value;
+        size_t len;
+        node_value(node, &value);
+        text = kv_value_text(&value, num_text, &len);
+    }
+
+    stripe_unlock(stripe_index(h), taken);
+    return text;
+}
+
+ssize_t kv_get_copy(const char *key, char *value, size_t value_size) {
+    return kv_getn(key, strlen(key), value, value_size);
+}
+
+/**
+ * @brief Copies a string value into a caller-owned buffer under the stripe lock.
+ *
+ * Follows snprintf() semantics: at most value_size - 1 bytes are copied and
+ * NUL-terminated, and the full length is returned so the caller can retry
+ * with a larger buffer.
+ *
+ * @return The value length, or -1 if the key is missing or not a string.
+ */
+ssize_t kv_getn(const char *key, size_t key_len, char *value, size_t value_size) {
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node* node = find_node_locked(h, key, key_len);
+
+    ssize_t res = -1;
+    if (node && node->type == KV_STRING) {
+        kv_value stored;
+        char buf[KV_NUM_TEXT];
+        size_t len;
+        node_value(node, &stored);
+        const char *text = kv_value_text(&stored, buf, &len);
+        res = kv_copy_out(text, len, value, value_size);
+    }
+
+    stripe_unlock(stripe_index(h), taken);
+    return res;
+}
+
+/**
+ * @brief Fills ref from a value found under the stripe lock.
+ *
+ * @param stored True when data is the data of a kv_str, which can be pinned
+ *               if it lives in its own block.
+ * @return true, or false if a heap copy could not be allocated.
+ */
+static bool ref_locked(kv_ref *ref, const char *data, size_t len, bool stored) {
+    ref->len = len;
+    ref->pinned = stored && !kv_str_is_inline(len);
+    ref->heap = false;
+    if (ref->pinned) {
+        ref->data = kv_str_pin(data);
+        return true;
+    }
+
+    char *copy = ref->small;
+    if (len > KV_REF_SMALL) {
+        copy = malloc(len + 1);
+        if (!copy) return false;
+        ref->heap = true;
+    }
+    memcpy(copy, data, len);
+    copy[len] = '\0';
+    ref->data = copy;
+    return true;
+}
+
+/**
+ * @brief Reads a string value without copying it when it is long.
+ *
+ * The stripe lock is only held to pin or copy the value, so the caller can
+ * write it to a socket without blocking writers to the key. Release it with
+ * kv_ref_release(), or pass a pinned data pointer on to kv_unpin().
+ *
+ * @return true if the key holds a string, false if it is missing, a hash, or
+ *         out of memory.
+ */
+bool kv_get_ref(const char *key, kv_ref *ref) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node* node = find_node_locked(h, key, key_len);
+
+    bool found = false;
+    if (node && node->type == KV_STRING) {
+        kv_value value;
+        char buf[KV_NUM_TEXT];
+        size_t len;
+        node_value(node, &value);
+        const char *text = kv_value_text(&value, buf, &len);
+        found = ref_locked(ref, text, len, text != buf);
+    }
+
+    stripe_unlock(stripe_index(h), taken);
+    return found;
+}
+
+void kv_ref_release(kv_ref *ref) {
+    if (ref->pinned) {
+        kv_unpin(ref->data);
+    } else if (ref->heap) {
+        free((char *)ref->data);
+    }
+    ref->pinned = false;
+    ref->heap = false;
+}
+
+/**
+ * @brief Drops the pin on the data of a pinned kv_ref; takes no lock.
+ */
+void kv_unpin(const char *data) {
+    kv_str_unpin(data);
 }
 
 int kv_delete(const char* key) {
-    unsigned int index = hash(key);
-    kv_node* node = hash_table[index];
-    kv_node* prev = NULL;
-
-    while (node != NULL) {
-        if (strcmp(node->key, key) == 0) {
-            if (prev) {
-                prev->next = node->next;
-            } else {
-                hash_table[index] = node->next;
-            }
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
 
-            if (node->type == KV_HASH) {
-                free_hash_fields(node->hash_fields);
-            }
+    kv_stripe *s = &stripes[stripe_index(h)];
+    stripe_write_step(s);
 
-            free(node);
-            return 0;
-        }
+    kv_node *node = find_node_write_locked(h, key, key_len);
+    if (node) {
+        delete_node_locked(s, h, node);
+    } else {
+        stripe_account(s, 0);
+    }
 
-        prev = node;
-        node = node->next;
+    stripe_unlock(stripe_index(h), taken);
+    return node ? 0 : -1;
+}
+
+/**
+ * @brief Sets key to expire ttl_ms milliseconds from now.
+ *
+ * A ttl_ms of zero or less deletes the key right away.
+ *
+ * @return 0 on success, -1 if the key does not exist or memory is exhausted.
+ */
+int kv_expire(const char *key, int64_t ttl_ms) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
+
+    kv_stripe *s = &stripes[stripe_index(h)];
+    int res = -1;
+    kv_node *node = find_node_write_locked(h, key, key_len);
+    if (node && ttl_ms <= 0) {
+        expire_node_locked(s, h, node);
+        res = 0;
+    } else if (node) {
+        res = set_ttl_locked(s, node, ttl_ms);
+        stripe_account(s, 0);
     }
 
-    return -1;
+    stripe_unlock(stripe_index(h), taken);
+    return res;
+}
+
+/**
+ * @brief Returns the milliseconds left before key expires.
+ *
+ * @return The remaining time, KV_TTL_NONE if the key has no TTL or
+ *         KV_TTL_MISSING if it does not exist.
+ */
+int64_t kv_ttl(const char *key) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+
+    const kv_stripe *s = &stripes[stripe_index(h)];
+    int64_t res = KV_TTL_MISSING;
+    const kv_node *node = find_node_locked(h, key, key_len);
+    int64_t when;
+    if (node && (node->flags & KV_NODE_EXPIRES) && kvexpire_get(&s->expires, node, &when)) {
+        int64_t left = when - now_ms();
+        res = left > 0 ? left : 0;
+    } else if (node) {
+        res = KV_TTL_NONE;
+    }
+
+    stripe_unlock(stripe_index(h), taken);
+    return res;
+}
+
+/**
+ * @brief Removes the TTL of key.
+ *
+ * @return 0 if a TTL was removed, -1 if the key is missing or has none.
+ */
+int kv_persist(const char *key) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
+
+    kv_stripe *s = &stripes[stripe_index(h)];
+    int res = -1;
+    kv_node *node = find_node_write_locked(h, key, key_len);
+    if (node && (node->flags & KV_NODE_EXPIRES)) {
+        set_ttl_locked(s, node, 0);
+        stripe_account(s, 0);
+        res = 0;
+    }
+
+    stripe_unlock(stripe_index(h), taken);
+    return res;
 }
 
 int kv_get_type(const char *key) {
-    const kv_node* node = find_node(key);
-    if (!node) return -1; // not found
-    return node->type;
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node* node = find_node_locked(h, key, key_len);
+    int type = node ? (int)node->type : -1; // -1: not found
+    stripe_unlock(stripe_index(h), taken);
+    return type;
+}
+
+/**
+ * @brief Reports how a hash stores its fields.
+ *
+ * @return KV_FIELDS_PACKED or KV_FIELDS_DICT, or -1 if key is not a hash.
+ */
+int kv_hash_encoding(const char *key) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node* node = find_node_locked(h, key, key_len);
+    int encoding = (node && node->type == KV_HASH) ? (int)node->fields.encoding : -1;
+    stripe_unlock(stripe_index(h), taken);
+    return encoding;
+}
+
+// Returns the hash stored at key, creating an empty one if the key is absent.
+// Caller must hold the stripe write lock.
+static kv_node* hash_node_locked(unsigned int h, const char *key, size_t key_len, bool *created) {
+    stripe_write_step(&stripes[stripe_index(h)]);
+
+    *created = false;
+    kv_node* node = find_node_write_locked(h, key, key_len);
+    if (node) return node->type == KV_HASH ? node : NULL;
+
+    node = new_node(key, key_len, KV_HASH);
+    if (!node || insert_node_locked(h, node) != 0) {
+        if (node) free_node(node);
+        return NULL;
+    }
+    *created = true;
+    return node;
 }
 
+// Drops a hash created by hash_node_locked() when its first field could not be stored.
+static void discard_new_hash_locked(unsigned int h, const char *key, size_t key_len) {
+    kv_node *node = kvindex_remove(&stripes[stripe_index(h)].index, h, key, key_len);
+    if (node) free_node(node);
+}
 
 int kv_hset(const char *key, const char *field, const char *value) {
-    unsigned int index = hash(key);
-    kv_node* node = hash_table[index];
+    return kv_hsetn(key, strlen(key), field, strlen(field), value, strlen(value));
+}
 
-    while (node != NULL) {
-        if (strcmp(node->key, key) == 0) {
-            if (node->type != KV_HASH) return -1;
+/**
+ * @brief Sets a binary-safe hash field.
+ *
+ * @return 0 on success, KV_ERR_TOO_LARGE if the value exceeds the configured
+ *         maximum, KV_ERR_OOM if used memory is over maxmemory and nothing can
+ *         be evicted, -1 if the key holds another type or memory is exhausted.
+ */
+int kv_hsetn(const char *key, size_t key_len, const char *field, size_t field_len,
+             const char *value, size_t value_len) {
+    if (value_len > max_value_len) return KV_ERR_TOO_LARGE;
+    if (evict_if_needed() != 0) return KV_ERR_OOM;
 
-            kv_field_node* field_node = find_field_node(node->hash_fields, field);
-            if (field_node) {
-                snprintf(field_node->value, MAX_VAL_LEN, "%s", value);
-                return 0;
-            }
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
 
-            kv_field_node* new_field = (kv_field_node*)malloc(sizeof(kv_field_node));
-            if (!new_field) return -1;
+    bool created;
+    kv_node* node = hash_node_locked(h, key, key_len, &created);
+    size_t before = (node && !created) ? node_mem(node) : 0;
+    int res = node ? kvfields_set(&node->fields, field, field_len, value, value_len) : -1;
+    if (res != 0 && created) {
+        discard_new_hash_locked(h, key, key_len);
+        node = NULL;
+    }
+    size_t after = node ? node_mem(node) : 0;
+    stripe_account(&stripes[stripe_index(h)], (ssize_t)after - (ssize_t)before);
 
-            snprintf(new_field->field, MAX_KEY_LEN, "%s", field);
-            snprintf(new_field->value, MAX_VAL_LEN, "%s", value);
-            new_field->next = node->hash_fields;
-            node->hash_fields = new_field;
-            return 0;
-        }
+    stripe_unlock(stripe_index(h), taken);
+    return res;
+}
+
+/**
+ * @brief Returns the text of a hash field, formatting a counter into buf.
+ *
+ * Caller must hold the stripe lock for h.
+ *
+ * @param buf At least KV_NUM_TEXT bytes.
+ * @return The value, or NULL if the key is not a hash or the field is missing.
+ */
+static const char* find_hash_field_locked(unsigned int h, const char *key, size_t key_len,
+                                          const char *field, size_t field_len, char *buf, size_t *value_len) {
+    const kv_node* node = find_node_locked(h, key, key_len);
+    kv_value value;
+    if (!node || node->type != KV_HASH || !kvfields_get(&node->fields, field, field_len, &value)) return NULL;
+    return kv_value_text(&value, buf, value_len);
+}
+
+/**
+ * @brief Returns a pointer to a stored hash field value.
+ *
+ * Like kv_get(), the pointer is only stable while no other thread modifies the
+ * hash. Concurrent callers should use kv_hget_copy().
+ */
+const char* kv_hget(const char *key, const char *field) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    size_t value_len;
+    const char *value = find_hash_field_locked(h, key, key_len, field, strlen(field), num_text, &value_len);
+    stripe_unlock(stripe_index(h), taken);
+    return value;
+}
+
+/**
+ * @brief Copies a hash field value with the same semantics as kv_getn().
+ *
+ * @return The value length, or -1 if the key or field is missing.
+ */
+ssize_t kv_hget_copy(const char *key, const char *field, char *value, size_t value_size) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    char buf[KV_NUM_TEXT];
+    size_t value_len;
+    const char *stored = find_hash_field_locked(h, key, key_len, field, strlen(field), buf, &value_len);
+
+    ssize_t res = stored ? kv_copy_out(stored, value_len, value, value_size) : -1;
+
+    stripe_unlock(stripe_index(h), taken);
+    return res;
+}
 
-        node = node->next;
+/**
+ * @brief Reads a hash field value like kv_get_ref().
+ *
+ * Values of packed hashes share their block with the other fields, so they
+ * are copied; dict values are pinned like string values.
+ */
+bool kv_hget_ref(const char *key, const char *field, kv_ref *ref) {
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), false);
+    const kv_node *node = find_node_locked(h, key, key_len);
+
+    bool found = false;
+    kv_value value;
+    if (node && node->type == KV_HASH && kvfields_get(&node->fields, field, strlen(field), &value)) {
+        char buf[KV_NUM_TEXT];
+        size_t len;
+        const char *text = kv_value_text(&value, buf, &len);
+        found = ref_locked(ref, text, len, text != buf && node->fields.encoding == KV_FIELDS_DICT);
     }
 
-    // create new hash key
-    kv_node* new_node = (kv_node*)malloc(sizeof(kv_node));
-    if (!new_node) return -1;
+    stripe_unlock(stripe_index(h), taken);
+    return found;
+}
+
+/**
+ * @brief Adds an increment to the counter at key, creating it from 0.
+ *
+ * The sum is stored as a number in the node, so only the first increment of
+ * a value set as text parses it. A TTL on the key is kept.
+ *
+ * @param encoding KV_VALUE_INT or KV_VALUE_FLOAT, the kind of increment.
+ * @return 0, -1 if the key holds a hash or memory is exhausted, or an error
+ *         of kv_value_incr(), which leaves the value unchanged.
+ */
+static int incr_string(const char *key, uint8_t encoding, kv_num increment, kv_value *result) {
+    if (evict_if_needed() != 0) return KV_ERR_OOM;
+
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
+
+    kv_stripe *s = &stripes[stripe_index(h)];
+    stripe_write_step(s);
+
+    ssize_t delta = 0;
+    int res = -1;
+    kv_node *node = find_node_write_locked(h, key, key_len);
+    if (node && node->type == KV_STRING) {
+        kv_value current;
+        node_value(node, &current);
+        res = kv_value_incr(&current, encoding, increment, result);
+        if (res == 0) {
+            size_t before = node_mem(node);
+            node_set_num(node, result->encoding, result->num);
+            delta = (ssize_t)node_mem(node) - (ssize_t)before;
+        }
+    } else if (!node) {
+        res = kv_value_incr(NULL, encoding, increment, result);
+        if (res == 0) {
+            node = new_node(key, key_len, KV_STRING);
+            if (!node || insert_node_locked(h, node) != 0) {
+                if (node) free_node(node);
+                res = -1;
+            } else {
+                node_set_num(node, result->encoding, result->num);
+                delta = (ssize_t)node_mem(node);
+            }
+        }
+    }
+    stripe_account(s, delta);
+
+    stripe_unlock(stripe_index(h), taken);
+    return res;
+}
+
+/**
+ * @brief INCRBY: adds increment to the integer at key.
+ *
+ * @return 0 with the new value in *result, -1 if the key holds a hash or
+ *         memory is exhausted, KV_ERR_OOM, KV_ERR_NOT_INTEGER or KV_ERR_OVERFLOW.
+ */
+int kv_incrby(const char *key, int64_t increment, int64_t *result) {
+    kv_value sum;
+    int res = incr_string(key, KV_VALUE_INT, (kv_num){ .i = increment }, &sum);
+    if (res == 0) *result = sum.num.i;
+    return res;
+}
+
+/**
+ * @brief INCRBYFLOAT: adds increment to the number at key.
+ *
+ * @return The results of kv_incrby(), with KV_ERR_NOT_FLOAT for a value that
+ *         is not a number and KV_ERR_OVERFLOW for an infinite sum.
+ */
+int kv_incrbyfloat(const char *key, double increment, double *result) {
+    kv_value sum;
+    int res = incr_string(key, KV_VALUE_FLOAT, (kv_num){ .d = increment }, &sum);
+    if (res == 0) *result = sum.encoding == KV_VALUE_INT ? (double)sum.num.i : sum.num.d;
+    return res;
+}
 
-    snprintf(new_node->key, MAX_KEY_LEN, "%s", key);
-    new_node->type = KV_HASH;
-    new_node->hash_fields = NULL;
+// Like incr_string(), for a field of the hash at key.
+static int incr_field(const char *key, const char *field, uint8_t encoding, kv_num increment, kv_value *result) {
+    if (evict_if_needed() != 0) return KV_ERR_OOM;
 
-    kv_field_node* new_field = (kv_field_node*)malloc(sizeof(kv_field_node));
-    if (!new_field) {
-        free(new_node);
+    size_t key_len = strlen(key);
+    unsigned int h = kv_hash(key, key_len);
+    int taken = stripe_lock(stripe_index(h), true);
+    if (taken < 0) return -1;
+
+    size_t field_len = strlen(field);
+    bool created;
+    kv_node* node = hash_node_locked(h, key, key_len, &created);
+    if (!node) {
+        stripe_account(&stripes[stripe_index(h)], 0);
+        stripe_unlock(stripe_index(h), taken);
         return -1;
     }
 
-    snprintf(new_field->field, MAX_KEY_LEN, "%s", field);
-    snprintf(new_field->value, MAX_VAL_LEN, "%s", value);
-    new_field->next = NULL;
+    size_t before = created ? 0 : node_mem(node);
 
-    new_node->hash_fields = new_field;
-    new_node->next = hash_table[index];
-    hash_table[index] = new_node;
+    // a missing key or field starts from 0
+    kv_value current;
+    bool exists = kvfields_get(&node->fields, field, field_len, &current);
+    int res = kv_value_incr(exists ? &current : NULL, encoding, increment, result);
+    if (res == 0 && kvfields_set_num(&node->fields, field, field_len, result->encoding, result->num) != 0) {
+        res = -1;
+    }
+    if (res != 0 && created) {
+        discard_new_hash_locked(h, key, key_len);
+        node = NULL;
+    }
+    size_t after = node ? node_mem(node) : 0;
+    stripe_account(&stripes[stripe_index(h)], (ssize_t)after - (ssize_t)before);
 
-    return 0;
+    stripe_unlock(stripe_index(h), taken);
+    return res;
 }
 
-const char* kv_hget(const char *key, const char *field) {
-    kv_node* node = find_node(key);
-    if (!node || node->type != KV_HASH) return NULL;
+/**
+ * @brief HINCRBY: adds increment to the integer in a hash field.
+ *
+ * @return The results of kv_incrby(), with -1 if the key holds a string.
+ */
+int kv_hincrby(const char *key, const char *field, int64_t increment, int64_t *result) {
+    kv_value sum;
+    int res = incr_field(key, field, KV_VALUE_INT, (kv_num){ .i = increment }, &sum);
+    if (res == 0) *result = sum.num.i;
+    return res;
+}
 
-    kv_field_node* field_node = node->hash_fields;
-    while (field_node != NULL) {
-        if (strcmp(field_node->field, field) == 0) {
-            return field_node->value;
-        }
-        field_node = field_node->next;
+/**
+ * @brief HINCRBYFLOAT: adds increment to the number in a hash field.
+ *
+ * @return The results of kv_incrbyfloat(), with -1 if the key holds a string.
+ */
+int kv_hincrbyfloat(const char *key, const char *field, double increment, double *result) {
+    kv_value sum;
+    int res = incr_field(key, field, KV_VALUE_FLOAT, (kv_num){ .d = increment }, &sum);
+    if (res == 0) *result = sum.encoding == KV_VALUE_INT ? (double)sum.num.i : sum.num.d;
+    return res;
+}
+
+/**
+ * @brief Locks the stripes covering a set of keys for the calling thread.
+ *
+ * Stripes are acquired in ascending index order, so any two threads locking
+ * overlapping key sets cannot deadlock. While held, kv_* calls on these keys
+ * from the same thread skip locking, which makes the whole batch atomic.
+ * A thread must release one set with kv_unlock_keys() before locking another.
+ *
+ * @param keys  Keys the caller is about to touch.
+ * @param count Number of keys.
+ * @param step  Distance between keys in the array: 1, or 2 to take the keys
+ *              of key value pairs straight from a command's arguments.
+ * @param write true to take the stripes exclusively, false to share them with other readers.
+ * @return Mask of stripes acquired by this call, to pass to kv_unlock_keys().
+ */
+uint64_t kv_lock_keys(const char *const *keys, int count, int step, bool write) {
+    uint64_t wanted = 0;
+    for (int i = 0; i < count; i++) {
+        const char *key = keys[(size_t)i * step];
+        wanted |= 1ULL << stripe_index(kv_hash(key, strlen(key)));
+    }
+    wanted &= ~(held_read | held_write);
+
+    for (uint64_t left = wanted; left; left &= left - 1) {
+        stripe_lock((unsigned int)__builtin_ctzll(left), write);
     }
 
-    return NULL;
+    if (write) {
+        held_write |= wanted;
+    } else {
+        held_read |= wanted;
+    }
+    return wanted;
 }
 
-double kv_hincrby(const char *key, const char *field, double increment) {
-    kv_node* node = find_node(key);
-    if (node) {
-        if (node->type != KV_HASH) return -1;
-
-        kv_field_node* field_node = node->hash_fields;
-        while (field_node != NULL) {
-            if (strcmp(field_node->field, field) == 0) {
-                double value = strtod(field_node->value, NULL);
-                value += increment;
-                snprintf(field_node->value, MAX_VAL_LEN, "%.17g", value);
-                return value;
-            }
-            field_node = field_node->next;
+void kv_unlock_keys(uint64_t locked) {
+    for (uint64_t left = locked; left; left &= left - 1) {
+        pthread_rwlock_unlock(&stripes[__builtin_ctzll(left)].lock);
+    }
+    held_read &= ~locked;
+    held_write &= ~locked;
+}
+
+static long elapsed_ns(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+// Advances the rehash of every resizing stripe for at most KV_CRON_BUDGET_NS.
+static void rehash_cron(void) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        kv_stripe *s = &stripes[i];
+        if (!__atomic_load_n(&s->rehashing, __ATOMIC_RELAXED)) continue;
+        if ((held_read | held_write) & (1ULL << i)) continue;
+        if (pthread_rwlock_trywrlock(&s->lock) != 0) continue;
+
+        while (kvindex_rehash_step(&s->index, KV_CRON_REHASH_STEP)) {
+            if (elapsed_ns(&start) >= KV_CRON_BUDGET_NS) break;
         }
+        stripe_account(s, 0);
+        pthread_rwlock_unlock(&s->lock);
+
+        if (elapsed_ns(&start) >= KV_CRON_BUDGET_NS) return;
+    }
+}
 
-        // field does not exist → set it to increment
-        double value = increment;
-        kv_field_node* new_field = (kv_field_node*)malloc(sizeof(kv_field_node));
-        if (!new_field) return -1;
+// Samples KV_EXPIRE_SAMPLE keys with a TTL from a random slot of the stripe
+// and deletes the expired ones. Caller must hold the stripe write lock.
+// Returns the percentage of the sample that had expired.
+static int expire_sample_locked(kv_stripe *s) {
+    expire_rng ^= expire_rng << 13;
+    expire_rng ^= expire_rng >> 7;
+    expire_rng ^= expire_rng << 17;
 
-        snprintf(new_field->field, MAX_KEY_LEN, "%s", field);
-        snprintf(new_field->value, MAX_VAL_LEN, "%.17g", value);
-        new_field->next = node->hash_fields;
-        node->hash_fields = new_field;
-        return value;
+    kv_expire_entry sample[KV_EXPIRE_SAMPLE];
+    size_t n = kvexpire_sample(&s->expires, (size_t)expire_rng, sample, KV_EXPIRE_SAMPLE);
+    if (n == 0) return 0;
+
+    int64_t now = now_ms();
+    size_t expired = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (sample[i].when > now) continue;
+        kv_node *node = sample[i].node;
+        expire_node_locked(s, kv_hash(kv_str_data(&node->key), node->key.len), node);
+        expired++;
     }
+    return (int)(expired * 100 / n);
+}
 
-    // key does not exist → create hash and field
-    kv_node* new_node = (kv_node*)malloc(sizeof(kv_node));
-    if (!new_node) return -1;
+/**
+ * @brief Active expire cycle: reclaims keys whose TTL passed but that nobody
+ * has touched since.
+ *
+ * Visits the stripes round robin from where the previous cycle stopped. A
+ * stripe is sampled again as long as more than KV_EXPIRE_REPEAT_PERCENT of
+ * its sample had expired, so stripes full of stale keys are drained faster
+ * than ones that are mostly live. The whole cycle stops after
+ * KV_EXPIRE_BUDGET_NS and continues on the next tick.
+ */
+static void expire_cron(void) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    snprintf(new_node->key, MAX_KEY_LEN, "%s", key);
-    new_node->type = KV_HASH;
-    new_node->hash_fields = NULL;
+    for (unsigned int visited = 0; visited < KV_LOCK_STRIPES; visited++) {
+        unsigned int i = expire_cursor;
+        expire_cursor = (expire_cursor + 1) & (KV_LOCK_STRIPES - 1);
 
-    kv_field_node* new_field = (kv_field_node*)malloc(sizeof(kv_field_node));
-    if (!new_field) {
-        free(new_node);
-        return -1;
+        kv_stripe *s = &stripes[i];
+        if (__atomic_load_n(&s->expiring, __ATOMIC_RELAXED) == 0) continue;
+        if ((held_read | held_write) & (1ULL << i)) continue;
+        if (pthread_rwlock_trywrlock(&s->lock) != 0) continue;
+
+        bool over_budget = false;
+        while (expire_sample_locked(s) > KV_EXPIRE_REPEAT_PERCENT) {
+            if ((over_budget = elapsed_ns(&start) >= KV_EXPIRE_BUDGET_NS)) break;
+        }
+        pthread_rwlock_unlock(&s->lock);
+
+        if (over_budget || elapsed_ns(&start) >= KV_EXPIRE_BUDGET_NS) return;
+    }
+}
+
+/**
+ * @brief Periodic maintenance, called from the server's timer thread.
+ *
+ * Advances the LRU clock and resizing stripes so idle ones finish migrating
+ * without waiting for writes, then runs the active expire cycle. Each part has its own time
+ * budget, and stripes busy with other threads are skipped until the next tick.
+ */
+void kv_cron(void) {
+    lru_clock_update();
+
+    kv_memory_stats_t mem;
+    kv_memory_stats(&mem); // samples the peak between INFO calls
+
+    rehash_cron();
+    expire_cron();
+}
+
+/**
+ * @brief Collects table size, load factor and rehash progress across stripes.
+ *
+ * A thread holding stripes through kv_lock_keys(), as during EXEC, skips the
+ * stripes it cannot lock at once rather than wait out of order.
+ */
+void kv_table_stats(kv_table_stats_t *stats) {
+    *stats = (kv_table_stats_t){ .engine = KV_ENGINE_NAME };
+    bool holding = (held_read | held_write) != 0;
+
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        int taken = holding ? stripe_trylock(i, false) : stripe_lock(i, false);
+        if (taken < 0) continue;
+        kv_index_stats_t index;
+        kvindex_stats(&stripes[i].index, &index);
+
+        stats->keys += index.keys;
+        stats->buckets += index.slots;
+        if (kvindex_is_rehashing(&stripes[i].index)) {
+            stats->rehashing_stripes++;
+            stats->rehash_buckets_done += index.rehash_done;
+            stats->rehash_buckets_total += index.rehash_total;
+        }
+
+        stripe_unlock(i, taken);
     }
 
-    snprintf(new_field->field, MAX_KEY_LEN, "%s", field);
-    snprintf(new_field->value, MAX_VAL_LEN, "%.17g", increment);
-    new_field->next = NULL;
+    stats->load_factor = stats->buckets ? (double)stats->keys / (double)stats->buckets : 0.0;
+}
+
+/**
+ * @brief Sums the per-stripe memory counters without locking.
+ *
+ * used_memory is what the keyspace holds: nodes, out-of-line keys and values,
+ * hash fields, the engines' tables and the stripe array. Allocator slack
+ * (unused slab objects, free arena blocks) is not included. The peak is the
+ * largest used_memory seen by this function or by kv_cron().
+ */
+void kv_memory_stats(kv_memory_stats_t *stats) {
+    *stats = (kv_memory_stats_t){ .overhead = sizeof(stripes) };
+
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        stats->dataset += __atomic_load_n(&stripes[i].dataset, __ATOMIC_RELAXED);
+        stats->overhead += __atomic_load_n(&stripes[i].overhead, __ATOMIC_RELAXED);
+    }
+    stats->used_memory = stats->dataset + stats->overhead;
 
-    new_node->hash_fields = new_field;
-    unsigned int index = hash(key);
-    new_node->next = hash_table[index];
-    hash_table[index] = new_node;
+    size_t peak = __atomic_load_n(&used_memory_peak, __ATOMIC_RELAXED);
+    while (stats->used_memory > peak &&
+           !__atomic_compare_exchange_n(&used_memory_peak, &peak, stats->used_memory, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    stats->used_memory_peak = stats->used_memory > peak ? stats->used_memory : peak;
 
-    return increment;
+    stats->maxmemory = __atomic_load_n(&maxmemory, __ATOMIC_RELAXED);
+    stats->policy = eviction_policy_names[__atomic_load_n(&eviction_policy, __ATOMIC_RELAXED)];
+    stats->evicted_keys = __atomic_load_n(&evicted_keys, __ATOMIC_RELAXED);
 }
 
+void kv_expire_stats(kv_expire_stats_t *stats) {
+    *stats = (kv_expire_stats_t){ .expired_keys = __atomic_load_n(&expired_keys, __ATOMIC_RELAXED) };
+    for (unsigned int i = 0; i < KV_LOCK_STRIPES; i++) {
+        stats->expires += __atomic_load_n(&stripes[i].expiring, __ATOMIC_RELAXED);
+    }
+}
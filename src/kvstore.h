@@ -1,47 +1,192 @@
 #ifndef kvstore_H
 #define kvstore_H
 
-#define HASH_TABLE_SIZE 256 
-#define MAX_KEY_LEN 32
-#define MAX_VAL_LEN 128
+#define KV_LOCK_STRIPES 64
+#define MAX_KEY_LEN 256
+#define KV_INLINE_CAP 20
+#define KV_DEFAULT_MAX_VALUE_LEN (4 * 1024 * 1024)
+#define KV_DEFAULT_HASH_PACKED_FIELDS 64
+#define KV_DEFAULT_HASH_PACKED_VALUE 64
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define KV_ERR_TOO_LARGE -2
+#define KV_ERR_OOM       -3 // over maxmemory and nothing could be evicted
+#define KV_ERR_NOT_INTEGER -4 // INCRBY on a value that is not an integer
+#define KV_ERR_NOT_FLOAT   -5 // INCRBYFLOAT on a value that is not a number
+#define KV_ERR_OVERFLOW    -6 // the increment would overflow, or give NaN or infinity
+
+// kv_ttl() results that are not a remaining time
+#define KV_TTL_NONE    -1 // the key exists but does not expire
+#define KV_TTL_MISSING -2 // no such key
+
+#define KV_NODE_EXPIRES 0x01 // the node has an entry in its stripe's expires table
 
 typedef enum {
     KV_STRING,
     KV_HASH
 } kv_type_t;
 
-typedef struct kv_field_node {
-    char field[MAX_KEY_LEN];
-    char value[MAX_VAL_LEN];
-    struct kv_field_node *next;
-} kv_field_node;
+// What a write does once used memory passes maxmemory.
+typedef enum {
+    KV_EVICT_NOEVICTION,   // reject writes that add data
+    KV_EVICT_ALLKEYS_LRU,  // evict the least recently used keys
+    KV_EVICT_ALLKEYS_LFU,  // evict the least frequently used keys
+    KV_EVICT_VOLATILE_TTL  // evict the keys with a TTL closest to expiring
+} kv_eviction_policy_t;
 
-typedef struct kv_node {
-    char key[MAX_KEY_LEN];
-    kv_type_t type;
+/*
+ * Length-prefixed, binary-safe string. Strings shorter than KV_INLINE_CAP are
+ * stored inside the struct (NUL-terminated); longer ones live in a refcounted
+ * arena block whose NUL-terminated data ptr points to (see kvstr.c).
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t len;
     union {
-        char value[MAX_VAL_LEN];
-        kv_field_node *hash_fields;
+        char buf[KV_INLINE_CAP];
+        char *ptr;
     };
+} kv_str;
+
+// How a string value or hash field value is stored.
+typedef enum {
+    KV_VALUE_RAW,   // bytes, in a kv_str
+    KV_VALUE_INT,   // int64_t left by INCR and friends, formatted when read
+    KV_VALUE_FLOAT  // double left by INCRBYFLOAT, formatted when read
+} kv_value_encoding_t;
+
+// A value stored natively rather than as text (see kvnum.c).
+typedef union {
+    int64_t i;
+    double d;
+} kv_num;
+
+typedef enum {
+    KV_FIELDS_PACKED,
+    KV_FIELDS_DICT
+} kv_fields_encoding_t;
+
+/*
+ * Fields of a hash value (see kvfields.c). Small hashes keep every
+ * field/value pair in one packed arena block; larger ones use a dict.
+ */
+typedef struct __attribute__((packed)) {
+    union {
+        uint8_t *packed;
+        struct kv_dict *dict;
+    };
+    uint32_t bytes;   // used length of the packed block
+    uint32_t count;   // number of fields
+    uint8_t encoding; // kv_fields_encoding_t
+} kv_fields;
+
+typedef struct kv_node {
     struct kv_node* next;
+    kv_str key;
+    union {
+        kv_str value;     // string, KV_VALUE_RAW
+        kv_num num;       // string, KV_VALUE_INT or KV_VALUE_FLOAT
+        kv_fields fields; // hash
+    };
+    uint8_t type;
+    uint8_t encoding; // kv_value_encoding_t of a string
+    uint8_t flags;    // KV_NODE_* bits
+    uint8_t freq;     // logarithmic access counter for LFU eviction
+    uint32_t atime;   // last access, in LRU clock ticks
 } kv_node;
 
 typedef struct {
-    char key[MAX_KEY_LEN];
-    char value[MAX_VAL_LEN];
+    const char *key;
+    size_t key_len;
+    const char *value;
+    size_t value_len;
 } kv_pair;
 
+#define KV_REF_SMALL 64 // values up to this long are copied into the kv_ref
+
+/*
+ * A value read with kv_get_ref() or kv_hget_ref(). Values stored in their own
+ * block are pinned rather than copied: data points into the store and stays
+ * valid, unchanged, until kv_ref_release(), even if the key is overwritten or
+ * deleted meanwhile. Other values are copied into small, or into a heap
+ * buffer when longer than KV_REF_SMALL.
+ */
+typedef struct {
+    const char *data;
+    size_t len;
+    bool pinned;
+    bool heap;
+    char small[KV_REF_SMALL + 1];
+} kv_ref;
+
+typedef struct {
+    const char *engine; // "chain" or "swiss", fixed at build time
+    unsigned long keys;
+    unsigned long buckets;
+    double load_factor;
+    int rehashing_stripes;
+    unsigned long rehash_buckets_done;
+    unsigned long rehash_buckets_total;
+} kv_table_stats_t;
+
+typedef struct {
+    size_t used_memory;      // dataset + overhead
+    size_t used_memory_peak;
+    size_t dataset;          // nodes, keys, values and hash fields
+    size_t overhead;         // index tables and stripes
+    size_t maxmemory;        // 0 when unlimited
+    const char *policy;      // eviction policy name
+    size_t evicted_keys;
+} kv_memory_stats_t;
+
+typedef struct {
+    size_t expires;      // keys with a TTL
+    size_t expired_keys; // keys removed because their TTL passed
+} kv_expire_stats_t;
+
 void kv_init();
+void kv_set_max_value_len(size_t max_len);
+void kv_set_maxmemory(size_t bytes, kv_eviction_policy_t policy);
+int kv_eviction_policy_from_name(const char *name);
+size_t kv_get_max_value_len(void);
+
 int kv_set(const char *key, const char *value);
+int kv_setn(const char *key, size_t key_len, const char *value, size_t value_len);
 const char* kv_get(const char *key);
+ssize_t kv_get_copy(const char *key, char *value, size_t value_size);
+ssize_t kv_getn(const char *key, size_t key_len, char *value, size_t value_size);
+bool kv_get_ref(const char *key, kv_ref *ref);
+void kv_ref_release(kv_ref *ref);
+void kv_unpin(const char *data);
+int kv_setex(const char *key, size_t key_len, const char *value, size_t value_len, int64_t ttl_ms);
 int kv_delete(const char *key);
+int kv_expire(const char *key, int64_t ttl_ms);
+int64_t kv_ttl(const char *key);
+int kv_persist(const char *key);
 int kv_count_keys(void);
 
 int kv_hset(const char *key, const char *field, const char *value);
+int kv_hsetn(const char *key, size_t key_len, const char *field, size_t field_len, const char *value, size_t value_len);
 const char* kv_hget(const char *key, const char *field);
-double kv_hincrby(const char *key, const char *field, double increment);
+ssize_t kv_hget_copy(const char *key, const char *field, char *value, size_t value_size);
+bool kv_hget_ref(const char *key, const char *field, kv_ref *ref);
+int kv_incrby(const char *key, int64_t increment, int64_t *result);
+int kv_incrbyfloat(const char *key, double increment, double *result);
+int kv_hincrby(const char *key, const char *field, int64_t increment, int64_t *result);
+int kv_hincrbyfloat(const char *key, const char *field, double increment, double *result);
 int kv_get_type(const char *key);
+int kv_hash_encoding(const char *key);
+void kv_set_hash_packed_limits(size_t max_fields, size_t max_value);
 bool kv_is_hash(const char *key);
 
-#endif
\ No newline at end of file
+uint64_t kv_lock_keys(const char *const *keys, int count, int step, bool write);
+void kv_unlock_keys(uint64_t stripes);
+
+void kv_cron(void);
+void kv_table_stats(kv_table_stats_t *stats);
+void kv_memory_stats(kv_memory_stats_t *stats);
+void kv_expire_stats(kv_expire_stats_t *stats);
+
+#endif
@@ -0,0 +1,113 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kvstr.h"
+#include "arena.h"
+
+/*
+ * Out-of-line strings live in a refcounted arena block and ptr points at its
+ * data. The store holds one reference; a reader may take more with
+ * kv_str_pin() under the stripe lock and keep reading the bytes after the
+ * lock is dropped, so a block is never written once it is shared. Writers
+ * replace it instead, and the last kv_str_unpin() frees it.
+ */
+typedef struct {
+    uint32_t refs;
+    uint32_t len;
+    char data[];
+} kv_block;
+
+#define KV_BLOCK_HEADER offsetof(kv_block, data)
+
+static kv_block *block_of(const char *data) {
+    return (kv_block *)(data - KV_BLOCK_HEADER);
+}
+
+void kv_str_init(kv_str *s) {
+    s->len = 0;
+    s->buf[0] = '\0';
+}
+
+void kv_str_free(kv_str *s) {
+    if (!kv_str_is_inline(s->len)) {
+        kv_str_unpin(s->ptr);
+    }
+    kv_str_init(s);
+}
+
+/**
+ * @brief Stores a copy of data in s, inline when it fits.
+ *
+ * An out-of-line block is reused when the new length falls in the same arena
+ * size class and no reader has it pinned, so rewriting a value of similar
+ * size does not reallocate.
+ *
+ * @return 0 on success, -1 if the arena is out of memory (s is left untouched).
+ */
+int kv_str_set(kv_str *s, const char *data, size_t len) {
+    if (kv_str_is_inline(len)) {
+        kv_str_free(s);
+        memcpy(s->buf, data, len);
+        s->buf[len] = '\0';
+        s->len = (uint32_t)len;
+        return 0;
+    }
+
+    kv_block *block;
+    if (!kv_str_is_inline(s->len) && __atomic_load_n(&block_of(s->ptr)->refs, __ATOMIC_ACQUIRE) == 1 &&
+        arena_block_size(KV_BLOCK_HEADER + s->len + 1) == arena_block_size(KV_BLOCK_HEADER + len + 1)) {
+        block = block_of(s->ptr);
+    } else {
+        block = arena_alloc(KV_BLOCK_HEADER + len + 1);
+        if (!block) return -1;
+        block->refs = 1;
+        kv_str_free(s);
+    }
+
+    memcpy(block->data, data, len);
+    block->data[len] = '\0';
+    block->len = (uint32_t)len;
+    s->ptr = block->data;
+    s->len = (uint32_t)len;
+    return 0;
+}
+
+/**
+ * @brief Takes a reference to the block holding data, the data of an out-of-line string.
+ *
+ * The caller must hold the lock that guards the string; the bytes stay valid
+ * until the matching kv_str_unpin(), whatever happens to the string meanwhile.
+ */
+const char *kv_str_pin(const char *data) {
+    __atomic_add_fetch(&block_of(data)->refs, 1, __ATOMIC_RELAXED);
+    return data;
+}
+
+/**
+ * @brief Drops a reference taken with kv_str_pin(), freeing the block after the last one.
+ *
+ * Needs no lock, so a reply can release its pin once the bytes are written.
+ */
+void kv_str_unpin(const char *data) {
+    kv_block *block = block_of(data);
+    if (__atomic_sub_fetch(&block->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        arena_free(block, KV_BLOCK_HEADER + block->len + 1);
+    }
+}
+
+/**
+ * @brief Bytes s owns outside its struct: the arena block of a long string.
+ */
+size_t kv_str_mem(const kv_str *s) {
+    return kv_str_is_inline(s->len) ? 0 : arena_block_size(KV_BLOCK_HEADER + s->len + 1);
+}
+
+// snprintf-style copy: returns the full length even when truncated.
+ssize_t kv_copy_out(const char *data, size_t len, char *out, size_t out_size) {
+    if (out_size > 0) {
+        size_t n = len < out_size - 1 ? len : out_size - 1;
+        memcpy(out, data, n);
+        out[n] = '\0';
+    }
+    return (ssize_t)len;
+}
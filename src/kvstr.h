@@ -0,0 +1,34 @@
+#ifndef KVSTR_H
+#define KVSTR_H
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "kvstore.h"
+
+static inline bool kv_str_is_inline(size_t len) {
+    return len < KV_INLINE_CAP;
+}
+
+static inline const char *kv_str_data(const kv_str *s) {
+    return kv_str_is_inline(s->len) ? s->buf : s->ptr;
+}
+
+static inline bool kv_str_equals(const kv_str *s, const char *data, size_t len) {
+    return s->len == len && memcmp(kv_str_data(s), data, len) == 0;
+}
+
+void kv_str_init(kv_str *s);
+void kv_str_free(kv_str *s);
+int kv_str_set(kv_str *s, const char *data, size_t len);
+const char *kv_str_pin(const char *data);
+void kv_str_unpin(const char *data);
+size_t kv_str_mem(const kv_str *s);
+ssize_t kv_copy_out(const char *data, size_t len, char *out, size_t out_size);
+
+static inline ssize_t kv_str_copy_out(const kv_str *s, char *out, size_t out_size) {
+    return kv_copy_out(kv_str_data(s), s->len, out, out_size);
+}
+
+#endif
@@ -1,105 +1,246 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
+#include <strings.h>
 
 #include "protocol.h"
-#include "kvstore.h"
 #include "errors.h"
 
-typedef struct {
-    const char *name;
-    size_t len;
-    bool simple_terminator;
-    command_t cmd;
-} command_def_t;
+#define COMMAND_DEF(id, name, arity, flags, keys, proc, resp_proc) \
+    [CMD_##id] = { name, sizeof(name) - 1, arity, flags, keys },
 
-command_t parse_command(const char *message) {
-    static const command_def_t commands[] = {
-        { "SET",     3, true,  CMD_SET },
-        { "GET",     3, true,  CMD_GET },
-        { "DEL",     3, true,  CMD_DEL },
-        { "HSET",    4, true,  CMD_HSET },
-        { "HGET",    4, true,  CMD_HGET },
-        { "HMGET",   5, true,  CMD_HMGET },
-        { "HINCRBY", 7, true,  CMD_HINCRBY },
-        { "TYPE",    4, true,  CMD_TYPE },
-        { "MSET",    4, true,  CMD_MSET },
-        { "MGET",    4, true,  CMD_MGET },
-        { "PING",    4, false, CMD_PING },
-        { "INFO",    4, false, CMD_INFO },
-        { "TIME",    4, false, CMD_TIME },
-    };
-
-    const size_t num_commands = sizeof(commands) / sizeof(commands[0]);
-    size_t msg_len = strlen(message); //NOSONAR
-    for (size_t i = 0; i < num_commands; i++) {
-        const command_def_t *c = &commands[i];
-        if (msg_len < c->len) continue;             /* avoid OOB */
-        if (strncmp(message, c->name, c->len) != 0) continue;
-        char terminator = message[c->len];          /* safe now */
-        bool is_valid_terminator = c->simple_terminator
-            ? IS_SIMPLE_CMD_TERMINATOR(terminator)
-            : IS_CMD_TERMINATOR(terminator);
-        if (is_valid_terminator) return c->cmd;
-    }
+static const command_def_t commands[CMD_COUNT] = {
+    COMMAND_LIST(COMMAND_DEF)
+};
 
-    return CMD_UNKNOWN;
+const command_def_t *command_def(command_t cmd) {
+    return &commands[cmd];
 }
 
-int extract_key_value(const char *message, char *key, char *value, size_t key_size, size_t value_size) {
-    const char *space1 = strchr(message, ' ');
-    if (!space1) return EXTRACT_ERR_PARSE;
+bool command_arity_ok(const command_def_t *def, int argc) {
+    return def->arity >= 0 ? argc == def->arity : argc >= -def->arity;
+}
 
-    const char *space2 = strchr(space1 + 1, ' ');
-    if (!space2) return EXTRACT_ERR_PARSE;
+// Index of the last key in a command of argc arguments, below first_key if it has none.
+int command_last_key(const command_def_t *def, int argc) {
+    return def->last_key < 0 ? argc + def->last_key : def->last_key;
+}
 
-    // Extract key
-    size_t key_len = space2 - (space1 + 1);
-    if (key_len >= key_size || key_len >= MAX_KEY_LEN - 1) return EXTRACT_ERR_KEY_TOO_LONG;
+/**
+ * @brief Identifies the command a line starts with.
+ *
+ * Commands that take arguments must be followed by a space, so the client
+ * can reject a bare "GET" before sending it.
+ */
+command_t parse_command(const char *message) {
+    size_t len = 0;
+    while (!IS_CMD_TERMINATOR(message[len])) len++;
 
-    memcpy(key, space1 + 1, key_len);
-    key[key_len] = '\0';
+    command_t cmd = lookup_command(message, len);
+    if (cmd == CMD_UNKNOWN) return CMD_UNKNOWN;
 
-    // Skip spaces after key
-    const char *value_start = space2 + 1;
-    while (*value_start == ' ') value_start++;
-    if (*value_start == '\0') return EXTRACT_ERR_PARSE;
+    int arity = commands[cmd].arity;
+    bool takes_arguments = arity > 1 || arity < -1;
+    if (takes_arguments && !IS_SIMPLE_CMD_TERMINATOR(message[len])) return CMD_UNKNOWN;
+    return cmd;
+}
 
-    // Check if value is quoted
-    if (*value_start == '"') {
-        value_start++;
-        const char *quote_end = strchr(value_start, '"');
-        if (!quote_end) return EXTRACT_ERR_PARSE;
+// Slots in the name index; a power of two, kept at least twice CMD_COUNT so probes stay short.
+#define COMMAND_INDEX_SIZE 64
+_Static_assert(CMD_COUNT * 2 <= COMMAND_INDEX_SIZE, "grow COMMAND_INDEX_SIZE");
 
-        size_t value_len = quote_end - value_start;
-        if (value_len >= value_size || value_len >= MAX_VAL_LEN - 1) return EXTRACT_ERR_VALUE_TOO_LONG;
+// Open-addressed index from a name to its command, as the command plus 1; 0 is an empty slot.
+static unsigned char command_index[COMMAND_INDEX_SIZE];
 
-        memcpy(value, value_start, value_len);
-        value[value_len] = '\0';
-    } else {
-        // Unquoted value: take until newline
-        size_t value_len = strnlen(value_start, value_size);
-        if (value_len >= value_size - 1 || value_len >= MAX_VAL_LEN - 1) return EXTRACT_ERR_VALUE_TOO_LONG;
+// Hashes the length and the first and last letters, lower-cased.
+static size_t command_slot(const char *name, size_t len) {
+    unsigned first = (unsigned char)(name[0] | 0x20);
+    unsigned last = (unsigned char)(name[len - 1] | 0x20);
+    return (len * 31 + first * 7 + last) & (COMMAND_INDEX_SIZE - 1);
+}
 
-        snprintf(value, value_size, "%s", value_start);
-        char *newline = strchr(value, '\n');
-        if (newline) *newline = '\0';
+// Fills the index from the registry before main(), so lookups never wait on it.
+__attribute__((constructor)) static void command_index_init(void) {
+    for (int cmd = 0; cmd < CMD_COUNT; cmd++) {
+        size_t slot = command_slot(commands[cmd].name, commands[cmd].len);
+        while (command_index[slot] != 0) slot = (slot + 1) & (COMMAND_INDEX_SIZE - 1);
+        command_index[slot] = (unsigned char)(cmd + 1);
     }
+}
 
-    return EXTRACT_OK;
+/**
+ * @brief Maps a command name, such as argv[0] of a tokenized line, to its command.
+ *
+ * The index built from COMMAND_LIST hashes the length and first and last
+ * letters, so a lookup costs one case-insensitive comparison, rarely more
+ * where two names share those, whatever the number of commands.
+ */
+command_t lookup_command(const char *name, size_t len) {
+    if (len == 0) return CMD_UNKNOWN;
+
+    size_t slot = command_slot(name, len);
+    for (int entry; (entry = command_index[slot]) != 0; slot = (slot + 1) & (COMMAND_INDEX_SIZE - 1)) {
+        const command_def_t *def = &commands[entry - 1];
+        if (def->len == len && strncasecmp(name, def->name, len) == 0) return (command_t)(entry - 1);
+    }
+    return CMD_UNKNOWN;
 }
 
-int extract_key(const char *message, char *key, size_t key_size) {
-    const char *space = strchr(message, ' ');
-    if (!space) return -1;
+void command_args_init(command_args_t *args) {
+    args->argc = 0;
+    args->cap = 0;
+    args->argv = NULL;
+    args->argv_len = NULL;
+    args->queue = (command_queue_t){ 0 };
+}
 
-    space++;
-    while (*space == ' ') space++;
-    if (*space == '\0') return -1;
+void command_args_free(command_args_t *args) {
+    free(args->argv);
+    free(args->argv_len);
+    command_queue_clear(&args->queue);
+    command_args_init(args);
+}
 
-    snprintf(key, key_size, "%s", space);
+/**
+ * @brief Makes room for at least count arguments, doubling the arrays.
+ *
+ * @return 0, or -1 if memory ran out; the arrays are then unchanged.
+ */
+int command_args_reserve(command_args_t *args, int count) {
+    if (count <= args->cap) return 0;
+
+    int cap = args->cap > 0 ? args->cap : 8;
+    while (cap < count) {
+        if (cap > INT_MAX / 2) return -1;
+        cap *= 2;
+    }
 
-    char *newline = strchr(key, '\n');
-    if (newline) *newline = '\0';
+    char **argv = realloc(args->argv, (size_t)cap * sizeof(*argv));
+    if (!argv) return -1;
+    args->argv = argv;
+    size_t *argv_len = realloc(args->argv_len, (size_t)cap * sizeof(*argv_len));
+    if (!argv_len) return -1;
+    args->argv_len = argv_len;
+    args->cap = cap;
+    return 0;
+}
 
+/**
+ * @brief Splits a command line into arguments in a single pass.
+ *
+ * Arguments are separated by spaces and the line ends at CR, LF or NUL. An
+ * argument that starts with a double quote runs to the next one, so it may
+ * hold spaces; there are no escapes, and the closing quote must end the
+ * argument. Each argument is NUL-terminated in place
+ * over the byte that ends it, so handlers use the slices without copying.
+ *
+ * @return EXTRACT_OK, EXTRACT_ERR_PARSE for an unterminated quote or text
+ *         right after a closing quote, or
+ *         EXTRACT_ERR_OOM if the argument arrays could not grow.
+ */
+int tokenize_command(char *line, command_args_t *args) {
+    char *p = line;
+    args->argc = 0;
+
+    while (1) {
+        while (*p == ' ') p++;
+        if (*p == '\0' || *p == '\n' || *p == '\r') return EXTRACT_OK;
+        if (args->argc == args->cap && command_args_reserve(args, args->argc + 1) != 0) return EXTRACT_ERR_OOM;
+
+        char *start;
+        char *end;
+        if (*p == '"') {
+            start = p + 1;
+            end = start;
+            while (*end != '"' && *end != '\0' && *end != '\n') end++;
+            if (*end != '"') return EXTRACT_ERR_PARSE;
+            p = end + 1;
+            if (!IS_CMD_TERMINATOR(*p)) return EXTRACT_ERR_PARSE; // "foo"bar
+        } else {
+            start = p;
+            end = p;
+            while (*end != ' ' && *end != '\0' && *end != '\n' && *end != '\r') end++;
+            p = end;
+        }
+
+        args->argv[args->argc] = start;
+        args->argv_len[args->argc] = (size_t)(end - start);
+        args->argc++;
+
+        // the byte after an unquoted argument ends the line or separates the next one
+        bool last = *p == '\0' || *p == '\n' || *p == '\r';
+        *end = '\0';
+        if (last) return EXTRACT_OK;
+        if (end == p) p++;
+    }
+}
+
+// Grows an array of *cap items of size to hold count, doubling it.
+static int queue_reserve(void **items, size_t *cap, size_t count, size_t size) {
+    if (count <= *cap) return 0;
+
+    size_t new_cap = *cap > 0 ? *cap : 16;
+    while (new_cap < count) {
+        if (new_cap > SIZE_MAX / 2 / size) return -1;
+        new_cap *= 2;
+    }
+    void *grown = realloc(*items, new_cap * size);
+    if (!grown) return -1;
+    *items = grown;
+    *cap = new_cap;
     return 0;
 }
+
+/**
+ * @brief Appends a copy of a command to a transaction.
+ *
+ * @return EXTRACT_OK, or EXTRACT_ERR_OOM with the queue unchanged.
+ */
+int command_queue_push(command_queue_t *queue, command_t cmd, const command_args_t *args) {
+    size_t bytes = 0;
+    for (int i = 0; i < args->argc; i++) bytes += args->argv_len[i] + 1;
+
+    if (queue->count == INT_MAX ||
+        queue_reserve((void **)&queue->commands, &queue->commands_cap, (size_t)queue->count + 1, sizeof(*queue->commands)) != 0 ||
+        queue_reserve((void **)&queue->args, &queue->args_cap, queue->args_count + (size_t)args->argc, sizeof(*queue->args)) != 0 ||
+        queue_reserve((void **)&queue->bytes, &queue->bytes_cap, queue->bytes_len + bytes, 1) != 0) {
+        return EXTRACT_ERR_OOM;
+    }
+
+    queue->commands[queue->count++] = (queued_command_t){ cmd, args->argc, queue->args_count };
+    for (int i = 0; i < args->argc; i++) {
+        queue->args[queue->args_count++] = (queued_arg_t){ queue->bytes_len, args->argv_len[i] };
+        memcpy(queue->bytes + queue->bytes_len, args->argv[i], args->argv_len[i]);
+        queue->bytes[queue->bytes_len + args->argv_len[i]] = '\0';
+        queue->bytes_len += args->argv_len[i] + 1;
+    }
+    return EXTRACT_OK;
+}
+
+/**
+ * @brief Points args at the i-th queued command, whose bytes stay in the queue.
+ *
+ * @return The command, or CMD_UNKNOWN if the argument arrays could not grow.
+ */
+command_t command_queue_load(const command_queue_t *queue, int i, command_args_t *args) {
+    const queued_command_t *queued = &queue->commands[i];
+    if (command_args_reserve(args, queued->argc) != 0) return CMD_UNKNOWN;
+
+    for (int j = 0; j < queued->argc; j++) {
+        const queued_arg_t *arg = &queue->args[queued->first_arg + (size_t)j];
+        args->argv[j] = queue->bytes + arg->offset;
+        args->argv_len[j] = arg->len;
+    }
+    args->argc = queued->argc;
+    return queued->cmd;
+}
+
+// Drops every queued command and leaves the transaction, freeing its memory.
+void command_queue_clear(command_queue_t *queue) {
+    free(queue->commands);
+    free(queue->args);
+    free(queue->bytes);
+    *queue = (command_queue_t){ 0 };
+}
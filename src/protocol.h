@@ -1,30 +1,141 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #define IS_CMD_TERMINATOR(c) ((c) == ' ' || (c) == '\0' || (c) == '\n' || (c) == '\r')
 #define IS_SIMPLE_CMD_TERMINATOR(c) ((c) == ' ')
 
+#define COMMAND_READONLY 0x1 // reads keys without changing them
+#define COMMAND_WRITE    0x2 // may create, change or delete keys
+#define COMMAND_NOQUEUE  0x4 // runs at once between MULTI and EXEC instead of being queued
+
+#define KEY_RANGE(first, last, step) first, last, step
+#define KEY1     KEY_RANGE(1, 1, 1) // the first argument is the key
+#define NO_KEYS  KEY_RANGE(0, 0, 0)
+
+/*
+ * Every command, once: X(id, name, arity, flags, keys, text handler, RESP
+ * handler). The enum, the registry in protocol.c and the handler tables of
+ * both protocols are expanded from it, so a command cannot be added to one
+ * and missed in another. lookup_command finds names through an index that
+ * protocol.c hashes from it at startup.
+ */
+#define COMMAND_LIST(X) \
+    X(DECR,         "decr",         2,  COMMAND_WRITE,    KEY1,                cmd_decr,         resp_cmd_decr) \
+    X(DECRBY,       "decrby",       3,  COMMAND_WRITE,    KEY1,                cmd_decr,         resp_cmd_decr) \
+    X(DEL,          "del",          -2, COMMAND_WRITE,    KEY_RANGE(1, -1, 1), cmd_del,          resp_cmd_del) \
+    X(DISCARD,      "discard",      1,  COMMAND_NOQUEUE,  NO_KEYS,             cmd_discard,      resp_cmd_discard) \
+    X(ECHO,         "echo",         2,  0,                NO_KEYS,             cmd_echo,         resp_cmd_echo) \
+    X(EXEC,         "exec",         1,  COMMAND_NOQUEUE,  NO_KEYS,             cmd_exec,         resp_cmd_exec) \
+    X(EXPIRE,       "expire",       3,  COMMAND_WRITE,    KEY1,                cmd_expire,       resp_cmd_expire) \
+    X(GET,          "get",          2,  COMMAND_READONLY, KEY1,                cmd_get,          resp_cmd_get) \
+    X(HGET,         "hget",         3,  COMMAND_READONLY, KEY1,                cmd_hget,         resp_cmd_hget) \
+    X(HINCRBY,      "hincrby",      4,  COMMAND_WRITE,    KEY1,                cmd_hincrby,      resp_cmd_hincrby) \
+    X(HINCRBYFLOAT, "hincrbyfloat", 4,  COMMAND_WRITE,    KEY1,                cmd_hincrbyfloat, resp_cmd_hincrbyfloat) \
+    X(HMGET,        "hmget",        -3, COMMAND_READONLY, KEY1,                cmd_hmget,        resp_cmd_hmget) \
+    X(HSET,         "hset",         -4, COMMAND_WRITE,    KEY1,                cmd_hset,         resp_cmd_hset) \
+    X(INCR,         "incr",         2,  COMMAND_WRITE,    KEY1,                cmd_incr,         resp_cmd_incr) \
+    X(INCRBY,       "incrby",       3,  COMMAND_WRITE,    KEY1,                cmd_incr,         resp_cmd_incr) \
+    X(INCRBYFLOAT,  "incrbyfloat",  3,  COMMAND_WRITE,    KEY1,                cmd_incrbyfloat,  resp_cmd_incrbyfloat) \
+    X(INFO,         "info",         -1, 0,                NO_KEYS,             cmd_info,         resp_cmd_info) \
+    X(MGET,         "mget",         -2, COMMAND_READONLY, KEY_RANGE(1, -1, 1), cmd_mget,         resp_cmd_mget) \
+    X(MSET,         "mset",         -3, COMMAND_WRITE,    KEY_RANGE(1, -1, 2), cmd_mset,         resp_cmd_mset) \
+    X(MULTI,        "multi",        1,  COMMAND_NOQUEUE,  NO_KEYS,             cmd_multi,        resp_cmd_multi) \
+    X(PERSIST,      "persist",      2,  COMMAND_WRITE,    KEY1,                cmd_persist,      resp_cmd_persist) \
+    X(PEXPIRE,      "pexpire",      3,  COMMAND_WRITE,    KEY1,                cmd_pexpire,      resp_cmd_pexpire) \
+    X(PING,         "ping",         -1, 0,                NO_KEYS,             cmd_ping,         resp_cmd_ping) \
+    X(PTTL,         "pttl",         2,  COMMAND_READONLY, KEY1,                cmd_pttl,         resp_cmd_pttl) \
+    X(SET,          "set",          -3, COMMAND_WRITE,    KEY1,                cmd_set,          resp_cmd_set) \
+    X(TIME,         "time",         1,  0,                NO_KEYS,             cmd_time,         resp_cmd_time) \
+    X(TTL,          "ttl",          2,  COMMAND_READONLY, KEY1,                cmd_ttl,          resp_cmd_ttl) \
+    X(TYPE,         "type",         2,  COMMAND_READONLY, KEY1,                cmd_type,         resp_cmd_type)
+
+#define COMMAND_ENUM(id, name, arity, flags, keys, proc, resp_proc) CMD_##id,
+
 typedef enum {
-    CMD_PING,
-    CMD_TIME,
-    CMD_INFO,
-    CMD_SET,
-    CMD_GET,
-    CMD_DEL,
-    CMD_MSET,
-    CMD_MGET,
-    CMD_TYPE,
-    CMD_HSET,
-    CMD_HGET,
-    CMD_HMGET,
-    CMD_HINCRBY,
+    COMMAND_LIST(COMMAND_ENUM)
+    CMD_COUNT,       // number of commands, not a command
     CMD_UNKNOWN = -1
 } command_t;
 
-command_t parse_command(const char *message); 
-int extract_key_value(const char *message, char *key, char *value, size_t key_size, size_t value_size);
-int extract_key(const char *message, char *key, size_t key_size);
+/*
+ * What the server knows about a command besides its handlers: its name, how
+ * many arguments it takes and which of them are keys. Both protocols check
+ * arguments against it before a handler runs, so handlers only check what
+ * is particular to them.
+ */
+typedef struct {
+    const char *name;   // lower case; matched case-insensitively
+    size_t len;
+    int arity;          // argc including the name; -N means at least N
+    int flags;          // COMMAND_READONLY or COMMAND_WRITE, 0 for neither, and COMMAND_NOQUEUE
+    int first_key;      // argv index of the first key, 0 if there is none
+    int last_key;       // argv index of the last key; -1 is the last argument
+    int key_step;       // distance between keys, 2 for key value pairs
+} command_def_t;
+
+// One command waiting in a command_queue_t.
+typedef struct {
+    command_t cmd;
+    int argc;
+    size_t first_arg;   // index of its name in the queue's args
+} queued_command_t;
+
+// Where a queued argument was copied to in the queue's bytes.
+typedef struct {
+    size_t offset;
+    size_t len;
+} queued_arg_t;
+
+/*
+ * Commands received between MULTI and EXEC. The input buffer their arguments
+ * point into is reused, so the arguments are copied into one block of
+ * NUL-terminated strings. Everything is freed when the queue is cleared.
+ */
+typedef struct {
+    bool active;        // MULTI was received and neither EXEC nor DISCARD yet
+    bool failed;        // a command was rejected, so EXEC must refuse; reset by MULTI
+    int count;
+    size_t commands_cap;
+    queued_command_t *commands;
+    size_t args_count;
+    size_t args_cap;
+    queued_arg_t *args;
+    size_t bytes_len;
+    size_t bytes_cap;
+    char *bytes;
+} command_queue_t;
+
+/*
+ * One command split into its arguments, argv[0] being the command name.
+ * Arguments point into the input buffer and are NUL-terminated in place;
+ * argv_len is their length without the quotes of a quoted argument. The
+ * arrays grow to the longest command seen and are reused, one set per
+ * connection, so a command of any number of arguments costs no allocation
+ * once its connection has seen one as long. The connection's transaction
+ * is kept alongside, as it is made of commands copied from here.
+ */
+typedef struct {
+    int argc;
+    int cap;            // slots in argv and argv_len
+    char **argv;
+    size_t *argv_len;
+    command_queue_t queue;
+} command_args_t;
+
+command_t parse_command(const char *message);
+command_t lookup_command(const char *name, size_t len);
+const command_def_t *command_def(command_t cmd);
+bool command_arity_ok(const command_def_t *def, int argc);
+int command_last_key(const command_def_t *def, int argc);
+void command_args_init(command_args_t *args);
+void command_args_free(command_args_t *args);
+int command_args_reserve(command_args_t *args, int count);
+int tokenize_command(char *line, command_args_t *args);
+int command_queue_push(command_queue_t *queue, command_t cmd, const command_args_t *args);
+command_t command_queue_load(const command_queue_t *queue, int i, command_args_t *args);
+void command_queue_clear(command_queue_t *queue);
 
 #endif
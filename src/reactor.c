@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "reactor.h"
+#include "server_utils.h"
+#include "logs.h"
+#include "clients.h"
+#include "errors.h"
+
+/*
+ * Event loop serving the connections accepted on one listening socket. The
+ * server runs one per I/O thread, each on its own SO_REUSEPORT socket, so
+ * connections are spread across threads by the kernel and a connection is
+ * only ever touched by the thread that accepted it.
+ *
+ * Sockets are registered edge-triggered, so epoll reports a socket once per
+ * burst of new data and the loop must drain it with non-blocking reads until
+ * EAGAIN. Each connection owns an input buffer instead of a thread and its
+ * stack, so an idle keep-alive connection costs one small allocation.
+ *
+ * The replies to the commands of each read are written with one non-blocking
+ * sendmsg(). What the socket does not take stays in the connection's reply
+ * buffer and the socket is watched for EPOLLOUT until it drains, so a client
+ * that stops reading only grows its own buffer; the client limits disconnect
+ * it once that passes the output buffer limits. Once a second the loop also
+ * walks its connections for idle timeouts and soft limits that expired while
+ * nothing happened on the socket.
+ */
+
+#define REACTOR_MAX_EVENTS 256
+#define REACTOR_TICK_MS 100 // how often the loop rechecks *running
+
+typedef struct reactor_conn reactor_conn;
+
+typedef struct {
+    int epfd;
+    int listenfd;
+    io_thread_stats_t *stats;
+    reactor_conn *conns; // every open connection, for the once a second sweep
+    time_t now;          // read once per loop iteration
+} reactor;
+
+struct reactor_conn {
+    int fd;
+    input_buffer_t in;
+    reply_t out;
+    size_t sent;        // bytes at the front of out already written
+    bool want_write;    // registered for EPOLLOUT
+    bool closing;       // close once out is written
+    time_t last_active; // last read or write
+    time_t soft_since;  // over the soft output limit since, or 0
+    reactor_conn *prev;
+    reactor_conn *next;
+};
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void conn_close(reactor *r, reactor_conn *conn) {
+    epoll_ctl(r->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    input_buffer_free(&conn->in);
+    reply_free(&conn->out);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        r->conns = conn->next;
+    }
+    if (conn->next) conn->next->prev = conn->prev;
+    free(conn);
+    iostats_add(&r->stats->connections, -1);
+    clients_release();
+}
+
+/**
+ * @brief Writes what the socket takes of the pending replies, without blocking.
+ *
+ * Watches the socket for EPOLLOUT while replies are left, and checks them
+ * against the output buffer limits.
+ *
+ * @return 0 to keep the connection, -1 to close it.
+ */
+static int conn_flush(reactor *r, reactor_conn *conn) {
+    if (conn->out.len > conn->sent) {
+        size_t before = conn->out.len - conn->sent;
+        iostats_add(&r->stats->syscalls, 1); // short writes aside
+        if (reply_write(&conn->out, conn->fd, &conn->sent) != 0) return -1;
+        if (conn->out.len - conn->sent < before) conn->last_active = r->now;
+    }
+
+    size_t pending = conn->out.len - conn->sent;
+    if ((pending > 0) != conn->want_write) {
+        conn->want_write = pending > 0;
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | EPOLLET | (conn->want_write ? EPOLLOUT : 0), .data.ptr = conn };
+        epoll_ctl(r->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+        iostats_add(&r->stats->syscalls, 1);
+    }
+
+    if (clients_output_exceeded(pending, r->now, &conn->soft_since)) {
+        clients_count_evicted();
+        return -1;
+    }
+    return conn->closing && pending == 0 ? -1 : 0;
+}
+
+// Accepts every pending connection. The listening socket is non-blocking, so
+// the loop ends at EAGAIN once the backlog is empty.
+static void accept_all(reactor *r) {
+    while (1) {
+        int fd = accept(r->listenfd, NULL, NULL);
+        iostats_add(&r->stats->syscalls, 1);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_error("Error accepting connection: %s", strerror(errno));
+            }
+            return;
+        }
+
+        if (!clients_admit()) {
+            reject_client(fd, EXTRACT_ERR_MAX_CLIENTS);
+            continue;
+        }
+
+        set_nodelay(fd);
+        reactor_conn *conn = calloc(1, sizeof(reactor_conn));
+        if (!conn) {
+            close(fd);
+            clients_release();
+            continue;
+        }
+        conn->fd = fd;
+        input_buffer_init(&conn->in);
+        reply_init(&conn->out);
+        conn->last_active = r->now;
+
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | EPOLLET, .data.ptr = conn };
+        if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(conn);
+            clients_release();
+            continue;
+        }
+        conn->next = r->conns;
+        if (r->conns) r->conns->prev = conn;
+        r->conns = conn;
+        iostats_add(&r->stats->accepted, 1);
+        iostats_add(&r->stats->connections, 1);
+    }
+}
+
+/**
+ * @brief Drains a readable connection, dispatching every complete command.
+ *
+ * Once the peer has closed its side, or sent bytes that end the session, the
+ * connection stays only until its pending replies are written.
+ *
+ * @return 0 to keep the connection, -1 to close it.
+ */
+static int conn_read(reactor *r, reactor_conn *conn) {
+    while (!conn->closing) {
+        size_t avail;
+        char *space = input_buffer_space(&conn->in, &avail);
+        ssize_t bytes = recv(conn->fd, space, avail, MSG_DONTWAIT);
+        iostats_add(&r->stats->syscalls, 1);
+        if (bytes > 0) {
+            conn->last_active = r->now;
+            iostats_add(&r->stats->bytes_in, bytes);
+            iostats_add(&r->stats->commands, input_buffer_dispatch(&conn->out, &conn->in, (size_t)bytes));
+            conn->closing = conn->in.failed;
+            if (conn_flush(r, conn) != 0) return -1;
+            continue;
+        }
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (bytes < 0) return -1;
+        conn->closing = true; // EOF
+    }
+    return conn->out.len > conn->sent ? 0 : -1;
+}
+
+// Closes the connections that have been idle too long or over the soft output
+// limit for too long; both can expire while nothing happens on the socket.
+static void sweep(reactor *r) {
+    reactor_conn *conn = r->conns;
+    while (conn) {
+        reactor_conn *next = conn->next;
+        if (clients_idle_expired(conn->last_active, r->now)) {
+            clients_count_timed_out();
+            conn_close(r, conn);
+        } else if (clients_output_exceeded(conn->out.len - conn->sent, r->now, &conn->soft_since)) {
+            clients_count_evicted();
+            conn_close(r, conn);
+        }
+        conn = next;
+    }
+}
+
+/**
+ * @brief Serves connections on listenfd from the calling thread until *running is cleared.
+ *
+ * @param listenfd Bound and listening socket; it is switched to non-blocking mode.
+ * @param stats    Counters for this thread, or NULL to keep none.
+ * @param running  Checked at least every REACTOR_TICK_MS.
+ * @return 0 on shutdown, -1 if epoll could not be set up.
+ */
+int reactor_run(int listenfd, io_thread_stats_t *stats, volatile sig_atomic_t *running) {
+    io_thread_stats_t unregistered = { .cpu = -1 };
+    reactor r = { .listenfd = listenfd, .stats = stats ? stats : &unregistered };
+    iostats_set_backend(r.stats, "epoll");
+
+    r.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r.epfd < 0) {
+        log_error("Error creating epoll instance: %s", strerror(errno));
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = NULL };
+    if (set_nonblocking(listenfd) != 0 || epoll_ctl(r.epfd, EPOLL_CTL_ADD, listenfd, &ev) != 0) {
+        log_error("Error registering listening socket: %s", strerror(errno));
+        close(r.epfd);
+        return -1;
+    }
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    r.now = time(NULL);
+    time_t last_sweep = r.now;
+    while (*running) {
+        int n = epoll_wait(r.epfd, events, REACTOR_MAX_EVENTS, REACTOR_TICK_MS);
+        iostats_add(&r.stats->syscalls, 1);
+        r.now = time(NULL);
+        for (int i = 0; i < n; i++) {
+            reactor_conn *conn = events[i].data.ptr;
+            if (!conn) {
+                accept_all(&r);
+                continue;
+            }
+
+            // read first: the peer may have sent a command and closed right away
+            uint32_t ev = events[i].events;
+            bool keep = true;
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) keep = conn_read(&r, conn) == 0;
+            if (keep && (ev & EPOLLOUT)) keep = conn_flush(&r, conn) == 0;
+            if (!keep || (ev & (EPOLLHUP | EPOLLERR))) {
+                conn_close(&r, conn);
+            }
+        }
+
+        if (r.now != last_sweep) {
+            last_sweep = r.now;
+            sweep(&r);
+        }
+    }
+
+    // connections still open are closed with the process
+    close(r.epfd);
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <signal.h>
+
+#include "iostats.h"
+
+int reactor_run(int listenfd, io_thread_stats_t *stats, volatile sig_atomic_t *running);
+
+#endif
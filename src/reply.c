@@ -0,0 +1,295 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "reply.h"
+
+// A block either holds its bytes in data, or refers to bytes owned elsewhere
+// (ext) that release() gives back once the block is dropped.
+struct reply_block {
+    reply_block_t *next;
+    size_t len;
+    size_t cap;
+    const char *ext;
+    void (*release)(const char *ext);
+    char data[];
+};
+
+static const char *block_data(const reply_block_t *b) {
+    return b->ext ? b->ext : b->data;
+}
+
+static void block_free(reply_block_t *b) {
+    if (b->ext) b->release(b->ext);
+    free(b);
+}
+
+void reply_init(reply_t *r) {
+    r->head = NULL;
+    r->tail = NULL;
+    r->len = 0;
+    r->failed = false;
+}
+
+void reply_free(reply_t *r) {
+    reply_block_t *b = r->head;
+    while (b) {
+        reply_block_t *next = b->next;
+        block_free(b);
+        b = next;
+    }
+    reply_init(r);
+}
+
+/**
+ * @brief Drops everything pending.
+ *
+ * The first block is kept for the next batch, so a connection whose replies
+ * fit in one block does not allocate once it is warm.
+ */
+void reply_reset(reply_t *r) {
+    if (!r->head) return;
+    if (r->head->ext) {
+        reply_free(r);
+        return;
+    }
+
+    reply_block_t *b = r->head->next;
+    while (b) {
+        reply_block_t *next = b->next;
+        block_free(b);
+        b = next;
+    }
+    r->head->next = NULL;
+    r->head->len = 0;
+    r->tail = r->head;
+    r->len = 0;
+    r->failed = false;
+}
+
+static void link_block(reply_t *r, reply_block_t *b) {
+    if (r->tail) {
+        r->tail->next = b;
+    } else {
+        r->head = b;
+    }
+    r->tail = b;
+}
+
+/**
+ * @brief Appends len bytes, filling the last block before adding another.
+ *
+ * The first block holds REPLY_FIRST_BLOCK_SIZE bytes and later ones
+ * REPLY_BLOCK_SIZE, or the whole rest of the data if that is larger. On allocation failure the reply is marked failed
+ * and further appends are ignored until it is reset.
+ */
+void reply_append(reply_t *r, const char *data, size_t len) {
+    if (r->failed) return;
+
+    while (len > 0) {
+        reply_block_t *b = r->tail;
+        if (!b || b->len == b->cap) {
+            // after a referenced value, a small block is enough for its framing
+            size_t cap = b && !b->ext ? REPLY_BLOCK_SIZE : REPLY_FIRST_BLOCK_SIZE;
+            if (cap < len) cap = len;
+            b = malloc(sizeof(reply_block_t) + cap);
+            if (!b) {
+                r->failed = true;
+                return;
+            }
+            b->next = NULL;
+            b->len = 0;
+            b->cap = cap;
+            b->ext = NULL;
+            link_block(r, b);
+        }
+
+        size_t n = b->cap - b->len < len ? b->cap - b->len : len;
+        memcpy(b->data + b->len, data, n);
+        b->len += n;
+        r->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Appends len bytes at data without copying them.
+ *
+ * The reply takes over the caller's hold on data: release(data) is called
+ * once the bytes have been written or the reply is dropped, and right away if
+ * the reply has failed.
+ */
+void reply_ref(reply_t *r, const char *data, size_t len, void (*release)(const char *data)) {
+    reply_block_t *b = r->failed ? NULL : malloc(sizeof(reply_block_t));
+    if (!b) {
+        r->failed = true;
+        release(data);
+        return;
+    }
+    b->next = NULL;
+    b->len = len;
+    b->cap = len;
+    b->ext = data;
+    b->release = release;
+    link_block(r, b);
+    r->len += len;
+}
+
+void reply_str(reply_t *r, const char *s) {
+    reply_append(r, s, strlen(s));
+}
+
+void reply_printf(reply_t *r, const char *fmt, ...) {
+    char stack_buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(stack_buf, sizeof(stack_buf), fmt, args);
+    va_end(args);
+    if (n < 0) return;
+
+    if ((size_t)n < sizeof(stack_buf)) {
+        reply_append(r, stack_buf, (size_t)n);
+        return;
+    }
+
+    char *heap_buf = malloc((size_t)n + 1);
+    if (!heap_buf) {
+        r->failed = true;
+        return;
+    }
+    va_start(args, fmt);
+    vsnprintf(heap_buf, (size_t)n + 1, fmt, args);
+    va_end(args);
+    reply_append(r, heap_buf, (size_t)n);
+    free(heap_buf);
+}
+
+/**
+ * @brief Copies the pending bytes into buf as a NUL-terminated string.
+ *
+ * Lets tests inspect replies without a socket.
+ *
+ * @return Number of bytes copied, at most size - 1.
+ */
+size_t reply_copy(const reply_t *r, char *buf, size_t size) {
+    if (size == 0) return 0;
+
+    size_t copied = 0;
+    for (const reply_block_t *b = r->head; b && copied < size - 1; b = b->next) {
+        size_t n = b->len < size - 1 - copied ? b->len : size - 1 - copied;
+        memcpy(buf + copied, block_data(b), n);
+        copied += n;
+    }
+    buf[copied] = '\0';
+    return copied;
+}
+
+/**
+ * @brief Describes the pending bytes after the first skip ones as iovecs.
+ *
+ * @return Number of iovecs filled, at most max; more may remain.
+ */
+int reply_iov(const reply_t *r, size_t skip, struct iovec *iov, int max) {
+    int count = 0;
+    for (reply_block_t *b = r->head; b && count < max; b = b->next) {
+        if (b->len > skip) {
+            iov[count].iov_base = (char *)block_data(b) + skip;
+            iov[count].iov_len = b->len - skip;
+            count++;
+            skip = 0;
+        } else {
+            skip -= b->len;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Writes every pending byte to fd and resets the buffer.
+ *
+ * All blocks go out in one writev() call, repeated only for a short write
+ * or when there are more than REPLY_MAX_IOV blocks.
+ *
+ * @return 0 on success, -1 if the write failed or the reply is incomplete
+ *         because an append ran out of memory; the connection should then be
+ *         closed, since the client can no longer match replies to commands.
+ */
+int reply_flush(reply_t *r, int fd) {
+    if (r->failed) {
+        reply_reset(r);
+        return -1;
+    }
+
+    size_t written = 0;
+    while (written < r->len) {
+        struct iovec iov[REPLY_MAX_IOV];
+        int count = reply_iov(r, written, iov, REPLY_MAX_IOV);
+
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            reply_reset(r);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+
+    reply_reset(r);
+    return 0;
+}
+
+/**
+ * @brief Writes as much of the pending bytes as fd takes without blocking.
+ *
+ * *written counts the bytes already sent and is advanced. Blocks sent in full
+ * are freed on the way, so a client that reads slowly only holds what it has
+ * not received yet. Once everything is out the buffer is reset and *written
+ * goes back to 0.
+ *
+ * @return 0 if everything was written or the socket is full (r->len is then
+ *         above *written), -1 as for reply_flush().
+ */
+int reply_write(reply_t *r, int fd, size_t *written) {
+    if (r->failed) {
+        reply_reset(r);
+        *written = 0;
+        return -1;
+    }
+
+    while (*written < r->len) {
+        struct iovec iov[REPLY_MAX_IOV];
+        struct msghdr msg = { .msg_iov = iov };
+        msg.msg_iovlen = (size_t)reply_iov(r, *written, iov, REPLY_MAX_IOV);
+
+        ssize_t n = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            reply_reset(r);
+            *written = 0;
+            return -1;
+        }
+        *written += (size_t)n;
+    }
+
+    if (*written == r->len) {
+        reply_reset(r);
+        *written = 0;
+        return 0;
+    }
+
+    while (r->head != r->tail && r->head->len <= *written) {
+        reply_block_t *b = r->head;
+        r->head = b->next;
+        *written -= b->len;
+        r->len -= b->len;
+        block_free(b);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef REPLY_H
+#define REPLY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#define REPLY_FIRST_BLOCK_SIZE 1024 // kept between batches, so small for idle connections
+#define REPLY_BLOCK_SIZE 16384
+#define REPLY_MAX_IOV 64 // iovecs per write
+#define REPLY_REF_MIN 4096 // shorter values are cheaper to copy than to reference
+
+/*
+ * Output buffer of one connection. Command handlers append their replies to
+ * it, and the connection writes everything pending with one writev() after
+ * the commands from a read have run, instead of a send() per line.
+ *
+ * Bytes go into a chain of blocks, so growing never moves what is already
+ * buffered; each block becomes one iovec when flushed. A block may also refer
+ * to bytes owned elsewhere (reply_ref()), such as a large value pinned in the
+ * store, which then go to the socket without being copied.
+ */
+typedef struct reply_block reply_block_t;
+
+typedef struct {
+    reply_block_t *head;
+    reply_block_t *tail;
+    size_t len;  // bytes pending
+    bool failed; // an append could not allocate, so the pending bytes are incomplete
+} reply_t;
+
+void reply_init(reply_t *r);
+void reply_free(reply_t *r);
+void reply_reset(reply_t *r);
+void reply_append(reply_t *r, const char *data, size_t len);
+void reply_ref(reply_t *r, const char *data, size_t len, void (*release)(const char *data));
+void reply_str(reply_t *r, const char *s);
+void reply_printf(reply_t *r, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+size_t reply_copy(const reply_t *r, char *buf, size_t size);
+int reply_iov(const reply_t *r, size_t skip, struct iovec *iov, int max);
+int reply_flush(reply_t *r, int fd);
+int reply_write(reply_t *r, int fd, size_t *written);
+
+#endif
@@ -0,0 +1,671 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "resp.h"
+#include "commands.h"
+#include "errors.h"
+#include "kvstore.h"
+#include "kvnum.h"
+
+/*
+ * RESP2 mode of the wire protocol, picked per connection by
+ * input_buffer_dispatch() when the first byte is '*' or '$'.
+ *
+ * A command is an array of bulk strings, each prefixed with its length, so
+ * the parser jumps over arguments instead of scanning them for delimiters
+ * and a value may hold spaces, quotes, CR, LF or NUL bytes. Replies use the
+ * RESP2 types: +simple, -error, :integer, $bulk and *array.
+ *
+ * Values are binary-safe end to end. Keys and hash fields are handed to the
+ * store as C strings, so they may hold any byte but NUL.
+ */
+
+#define RESP_MAX_BULK (512LL * 1024 * 1024)
+#define RESP_WRONGTYPE "WRONGTYPE Operation against a key holding the wrong kind of value"
+
+typedef void (*resp_proc_t)(reply_t *out, resp_command_t *cmd);
+
+/**
+ * @brief Parses the length after a '*' or '$' up to its CRLF.
+ *
+ * @return Offset just past the CRLF, RESP_INCOMPLETE or RESP_PROTO_ERR.
+ */
+static ssize_t parse_length(const char *buf, size_t len, size_t pos, long long *out) {
+    bool negative = pos < len && buf[pos] == '-';
+    if (negative) pos++;
+
+    size_t digits = pos;
+    long long n = 0;
+    while (pos < len && buf[pos] >= '0' && buf[pos] <= '9') {
+        n = n * 10 + (buf[pos] - '0');
+        if (n > RESP_MAX_BULK) return RESP_PROTO_ERR;
+        pos++;
+    }
+
+    if (pos == len) return RESP_INCOMPLETE;
+    if (pos == digits || buf[pos] != '\r') return RESP_PROTO_ERR;
+    if (pos + 1 == len) return RESP_INCOMPLETE;
+    if (buf[pos + 1] != '\n') return RESP_PROTO_ERR;
+
+    *out = negative ? -n : n;
+    return (ssize_t)(pos + 2);
+}
+
+/**
+ * @brief Parses one command from the start of buf, resuming where parser left off.
+ *
+ * A lone bulk string is taken as a command of one argument. A null or empty
+ * array parses with argc 0 and has nothing to run. Each call picks up at the
+ * first argument not yet complete, so the bytes of a command that arrives
+ * over many reads are looked at once. Arguments are only NUL-terminated once
+ * the whole command has arrived, so an incomplete one leaves buf unchanged;
+ * if its bytes move before the next call, resp_parser_move() must follow.
+ *
+ * @return Bytes the command took, RESP_INCOMPLETE, RESP_PROTO_ERR or RESP_NOMEM.
+ *         parser is zeroed again once a command is complete.
+ */
+ssize_t resp_parse(char *buf, size_t len, resp_command_t *cmd, resp_parser_t *parser) {
+    if (parser->pos == 0) {
+        if (len == 0) return RESP_INCOMPLETE;
+
+        long long count = 1;
+        size_t pos = 0;
+        if (buf[0] == '*') {
+            ssize_t next = parse_length(buf, len, 1, &count);
+            if (next <= 0) return next;
+            pos = (size_t)next;
+        } else if (buf[0] != '$') {
+            return RESP_PROTO_ERR;
+        }
+        if (count > RESP_MAX_ARGS) return RESP_PROTO_ERR;
+
+        parser->argc = count < 0 ? 0 : (int)count;
+        parser->parsed = 0;
+        parser->pos = pos;
+    }
+
+    size_t pos = parser->pos;
+    for (int i = parser->parsed; i < parser->argc; i++) {
+        if (pos == len) return RESP_INCOMPLETE;
+        if (i == cmd->cap && command_args_reserve(cmd, i + 1) != 0) return RESP_NOMEM;
+        if (buf[pos] != '$') return RESP_PROTO_ERR;
+
+        long long arg_len;
+        ssize_t next = parse_length(buf, len, pos + 1, &arg_len);
+        if (next <= 0) return next;
+        if (arg_len < 0) return RESP_PROTO_ERR;
+
+        size_t data = (size_t)next;
+        if (len - data < (size_t)arg_len + 2) return RESP_INCOMPLETE;
+        if (buf[data + arg_len] != '\r' || buf[data + arg_len + 1] != '\n') return RESP_PROTO_ERR;
+        cmd->argv[i] = buf + data;
+        cmd->argv_len[i] = (size_t)arg_len;
+        pos = data + (size_t)arg_len + 2;
+        parser->parsed = i + 1;
+        parser->pos = pos;
+    }
+
+    cmd->argc = parser->argc;
+    for (int i = 0; i < cmd->argc; i++) {
+        cmd->argv[i][cmd->argv_len[i]] = '\0';
+    }
+    *parser = (resp_parser_t){ 0 };
+    return (ssize_t)pos;
+}
+
+/**
+ * @brief Follows the bytes of an incomplete command from from to to.
+ *
+ * The arguments parsed so far point into the old bytes; both must still be
+ * readable, so a buffer is grown by copying rather than with realloc().
+ */
+void resp_parser_move(const resp_parser_t *parser, resp_command_t *cmd, const char *from, char *to) {
+    for (int i = 0; i < parser->parsed; i++) {
+        cmd->argv[i] = to + (cmd->argv[i] - from);
+    }
+}
+
+void resp_simple(reply_t *out, const char *s) {
+    reply_printf(out, "+%s\r\n", s);
+}
+
+void resp_error(reply_t *out, const char *msg) {
+    reply_printf(out, "-%s\r\n", msg);
+}
+
+void resp_integer(reply_t *out, long long n) {
+    reply_printf(out, ":%lld\r\n", n);
+}
+
+void resp_bulk(reply_t *out, const char *data, size_t len) {
+    reply_printf(out, "$%zu\r\n", len);
+    reply_append(out, data, len);
+    reply_append(out, "\r\n", 2);
+}
+
+// Like resp_bulk() for a value read from the store; releases it.
+static void resp_bulk_value(reply_t *out, kv_ref *val) {
+    reply_printf(out, "$%zu\r\n", val->len);
+    append_value(out, val);
+    reply_append(out, "\r\n", 2);
+}
+
+void resp_null(reply_t *out) {
+    reply_append(out, "$-1\r\n", 5);
+}
+
+void resp_array(reply_t *out, long long count) {
+    reply_printf(out, "*%lld\r\n", count);
+}
+
+static void reply_store_error(reply_t *out, int res) {
+    switch (res) {
+        case KV_ERR_TOO_LARGE:
+            resp_error(out, "ERR value too long");
+            break;
+        case KV_ERR_OOM:
+            resp_error(out, "OOM command not allowed when used memory > 'maxmemory'");
+            break;
+        case KV_ERR_NOT_INTEGER:
+            resp_error(out, "ERR value is not an integer or out of range");
+            break;
+        case KV_ERR_NOT_FLOAT:
+            resp_error(out, "ERR value is not a valid float");
+            break;
+        case KV_ERR_OVERFLOW:
+            resp_error(out, "ERR increment or decrement would overflow");
+            break;
+        default:
+            resp_error(out, "ERR internal error");
+            break;
+    }
+}
+
+// Checks that argument i can be used as a key or field, replying with an error if not.
+static bool check_key(reply_t *out, const resp_command_t *cmd, int i) {
+    if (cmd->argv_len[i] >= MAX_KEY_LEN) {
+        resp_error(out, "ERR key too long");
+        return false;
+    }
+    if (memchr(cmd->argv[i], '\0', cmd->argv_len[i]) != NULL) {
+        resp_error(out, "ERR key contains a NUL byte");
+        return false;
+    }
+    return true;
+}
+
+static bool check_keys(reply_t *out, const resp_command_t *cmd, int first, int step) {
+    for (int i = first; i < cmd->argc; i += step) {
+        if (!check_key(out, cmd, i)) return false;
+    }
+    return true;
+}
+
+// Parses a whole argument as a base-10 integer.
+static bool parse_integer(const resp_command_t *cmd, int i, long long *out) {
+    if (cmd->argv_len[i] == 0) return false;
+    char *end;
+    errno = 0;
+    *out = strtoll(cmd->argv[i], &end, 10);
+    return errno == 0 && end == cmd->argv[i] + cmd->argv_len[i];
+}
+
+static void resp_cmd_ping(reply_t *out, resp_command_t *cmd) {
+    if (cmd->argc > 2) {
+        resp_error(out, "ERR wrong number of arguments for 'ping' command");
+    } else if (cmd->argc == 2) {
+        resp_bulk(out, cmd->argv[1], cmd->argv_len[1]);
+    } else {
+        resp_simple(out, "PONG");
+    }
+}
+
+static void resp_cmd_echo(reply_t *out, resp_command_t *cmd) {
+    resp_bulk(out, cmd->argv[1], cmd->argv_len[1]);
+}
+
+static void resp_cmd_time(reply_t *out, resp_command_t *cmd) {
+    (void)cmd;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    char sec[24], usec[24];
+    int sec_len = snprintf(sec, sizeof(sec), "%lld", (long long)ts.tv_sec);
+    int usec_len = snprintf(usec, sizeof(usec), "%ld", ts.tv_nsec / 1000);
+    resp_array(out, 2);
+    resp_bulk(out, sec, (size_t)sec_len);
+    resp_bulk(out, usec, (size_t)usec_len);
+}
+
+static void resp_cmd_info(reply_t *out, resp_command_t *cmd) {
+    (void)cmd;
+    reply_t report;
+    reply_init(&report);
+    append_info(&report);
+
+    char *text = malloc(report.len + 1);
+    if (!text || report.failed) {
+        resp_error(out, "ERR out of memory");
+    } else {
+        size_t len = reply_copy(&report, text, report.len + 1);
+        resp_bulk(out, text, len);
+    }
+    free(text);
+    reply_free(&report);
+}
+
+static void resp_cmd_set(reply_t *out, resp_command_t *cmd) {
+    int64_t ttl_ms = 0;
+    for (int i = 3; i < cmd->argc; i += 2) {
+        int64_t unit;
+        if (strcasecmp(cmd->argv[i], "EX") == 0) {
+            unit = 1000;
+        } else if (strcasecmp(cmd->argv[i], "PX") == 0) {
+            unit = 1;
+        } else {
+            resp_error(out, "ERR syntax error");
+            return;
+        }
+        if (i + 1 == cmd->argc) {
+            resp_error(out, "ERR syntax error");
+            return;
+        }
+
+        long long ttl;
+        if (!parse_integer(cmd, i + 1, &ttl) || ttl <= 0 || ttl > INT64_MAX / 1000 / unit) {
+            resp_error(out, "ERR invalid expire time in 'set' command");
+            return;
+        }
+        ttl_ms = ttl * unit;
+    }
+
+    int res = kv_setex(cmd->argv[1], cmd->argv_len[1], cmd->argv[2], cmd->argv_len[2], ttl_ms);
+    if (res == 0) {
+        resp_simple(out, "OK");
+    } else {
+        reply_store_error(out, res);
+    }
+}
+
+static void resp_cmd_get(reply_t *out, resp_command_t *cmd) {
+    kv_ref val;
+    if (kv_get_ref(cmd->argv[1], &val)) {
+        resp_bulk_value(out, &val);
+    } else if (kv_get_type(cmd->argv[1]) == KV_HASH) {
+        resp_error(out, RESP_WRONGTYPE);
+    } else {
+        resp_null(out);
+    }
+}
+
+static void resp_cmd_del(reply_t *out, resp_command_t *cmd) {
+    long long deleted = 0;
+    for (int i = 1; i < cmd->argc; i++) {
+        if (kv_delete(cmd->argv[i]) == 0) deleted++;
+    }
+    resp_integer(out, deleted);
+}
+
+static void resp_cmd_mset(reply_t *out, resp_command_t *cmd) {
+    if (cmd->argc % 2 == 0) {
+        resp_error(out, "ERR wrong number of arguments for 'mset' command");
+        return;
+    }
+
+    int res = 0;
+    uint64_t locked = kv_lock_keys((const char *const *)cmd->argv + 1, (cmd->argc - 1) / 2, 2, true);
+    for (int i = 1; i < cmd->argc && res == 0; i += 2) {
+        res = kv_setn(cmd->argv[i], cmd->argv_len[i], cmd->argv[i + 1], cmd->argv_len[i + 1]);
+    }
+    kv_unlock_keys(locked);
+
+    if (res == 0) {
+        resp_simple(out, "OK");
+    } else {
+        reply_store_error(out, res);
+    }
+}
+
+// Replies with the values of a key or, when hash_key is set, of its fields:
+// arguments from first on, as one array from a single snapshot.
+static void reply_values(reply_t *out, resp_command_t *cmd, const char *hash_key, int first) {
+    resp_array(out, cmd->argc - first);
+    uint64_t locked = hash_key ? kv_lock_keys(&hash_key, 1, 1, false)
+                               : kv_lock_keys((const char *const *)cmd->argv + first, cmd->argc - first, 1, false);
+    for (int i = first; i < cmd->argc; i++) {
+        kv_ref val;
+        bool found = hash_key ? kv_hget_ref(hash_key, cmd->argv[i], &val) : kv_get_ref(cmd->argv[i], &val);
+        if (found) {
+            resp_bulk_value(out, &val);
+        } else {
+            resp_null(out);
+        }
+    }
+    kv_unlock_keys(locked);
+}
+
+static void resp_cmd_mget(reply_t *out, resp_command_t *cmd) {
+    reply_values(out, cmd, NULL, 1);
+}
+
+static void resp_cmd_hset(reply_t *out, resp_command_t *cmd) {
+    if (cmd->argc % 2 != 0) {
+        resp_error(out, "ERR wrong number of arguments for 'hset' command");
+        return;
+    }
+    if (!check_keys(out, cmd, 2, 2)) return;
+
+    const char *key = cmd->argv[1];
+    const char *keys[] = { key };
+    uint64_t locked = kv_lock_keys(keys, 1, 1, true);
+    if (kv_get_type(key) == KV_STRING) {
+        kv_unlock_keys(locked);
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+
+    // like Redis, reply with the number of fields that did not exist before
+    long long added = 0;
+    for (int i = 2; i < cmd->argc; i += 2) {
+        bool existed = kv_hget(key, cmd->argv[i]) != NULL;
+        int res = kv_hsetn(key, cmd->argv_len[1], cmd->argv[i], cmd->argv_len[i],
+                           cmd->argv[i + 1], cmd->argv_len[i + 1]);
+        if (res != 0) {
+            kv_unlock_keys(locked);
+            reply_store_error(out, res);
+            return;
+        }
+        if (!existed) added++;
+    }
+    kv_unlock_keys(locked);
+    resp_integer(out, added);
+}
+
+static void resp_cmd_hget(reply_t *out, resp_command_t *cmd) {
+    if (!check_key(out, cmd, 2)) return;
+    if (kv_get_type(cmd->argv[1]) == KV_STRING) {
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+
+    kv_ref val;
+    if (kv_hget_ref(cmd->argv[1], cmd->argv[2], &val)) {
+        resp_bulk_value(out, &val);
+    } else {
+        resp_null(out);
+    }
+}
+
+static void resp_cmd_hmget(reply_t *out, resp_command_t *cmd) {
+    if (!check_keys(out, cmd, 2, 1)) return;
+    if (kv_get_type(cmd->argv[1]) == KV_STRING) {
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+    reply_values(out, cmd, cmd->argv[1], 2);
+}
+
+static void resp_cmd_hincrby(reply_t *out, resp_command_t *cmd) {
+    if (!check_key(out, cmd, 2)) return;
+
+    long long increment;
+    if (!parse_integer(cmd, 3, &increment)) {
+        resp_error(out, "ERR value is not an integer or out of range");
+        return;
+    }
+    if (kv_get_type(cmd->argv[1]) == KV_STRING) {
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+
+    int64_t value;
+    int res = kv_hincrby(cmd->argv[1], cmd->argv[2], increment, &value);
+    if (res == 0) {
+        resp_integer(out, value);
+    } else {
+        reply_store_error(out, res);
+    }
+}
+
+// Replies with a float result as a bulk string, as Redis does.
+static void resp_float(reply_t *out, double value) {
+    char text[KV_NUM_TEXT];
+    size_t len = kv_format_float(value, text);
+    resp_bulk(out, text, len);
+}
+
+static void resp_cmd_hincrbyfloat(reply_t *out, resp_command_t *cmd) {
+    if (!check_key(out, cmd, 2)) return;
+
+    double increment;
+    if (!kv_parse_float(cmd->argv[3], cmd->argv_len[3], &increment)) {
+        resp_error(out, "ERR value is not a valid float");
+        return;
+    }
+    if (kv_get_type(cmd->argv[1]) == KV_STRING) {
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+
+    double value;
+    int res = kv_hincrbyfloat(cmd->argv[1], cmd->argv[2], increment, &value);
+    if (res == 0) {
+        resp_float(out, value);
+    } else {
+        reply_store_error(out, res);
+    }
+}
+
+// INCR, DECR, INCRBY and DECRBY: adds sign times the increment, 1 without one.
+static void incr_command(reply_t *out, resp_command_t *cmd, long long sign) {
+    long long increment = 1;
+    if (cmd->argc == 3 && (!parse_integer(cmd, 2, &increment) || (sign < 0 && increment == LLONG_MIN))) {
+        resp_error(out, "ERR value is not an integer or out of range");
+        return;
+    }
+    if (kv_get_type(cmd->argv[1]) == KV_HASH) {
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+
+    int64_t value;
+    int res = kv_incrby(cmd->argv[1], sign * increment, &value);
+    if (res == 0) {
+        resp_integer(out, value);
+    } else {
+        reply_store_error(out, res);
+    }
+}
+
+// INCR key and INCRBY key increment
+static void resp_cmd_incr(reply_t *out, resp_command_t *cmd) {
+    incr_command(out, cmd, 1);
+}
+
+// DECR key and DECRBY key decrement
+static void resp_cmd_decr(reply_t *out, resp_command_t *cmd) {
+    incr_command(out, cmd, -1);
+}
+
+static void resp_cmd_incrbyfloat(reply_t *out, resp_command_t *cmd) {
+    double increment;
+    if (!kv_parse_float(cmd->argv[2], cmd->argv_len[2], &increment)) {
+        resp_error(out, "ERR value is not a valid float");
+        return;
+    }
+    if (kv_get_type(cmd->argv[1]) == KV_HASH) {
+        resp_error(out, RESP_WRONGTYPE);
+        return;
+    }
+
+    double value;
+    int res = kv_incrbyfloat(cmd->argv[1], increment, &value);
+    if (res == 0) {
+        resp_float(out, value);
+    } else {
+        reply_store_error(out, res);
+    }
+}
+
+// EXPIRE/PEXPIRE key time, with the time in units of unit_ms.
+static void expire_command(reply_t *out, resp_command_t *cmd, int64_t unit_ms) {
+    long long ttl;
+    if (!parse_integer(cmd, 2, &ttl) || ttl > INT64_MAX / unit_ms || ttl < INT64_MIN / unit_ms) {
+        resp_error(out, "ERR value is not an integer or out of range");
+        return;
+    }
+    resp_integer(out, kv_expire(cmd->argv[1], ttl * unit_ms) == 0 ? 1 : 0);
+}
+
+static void resp_cmd_expire(reply_t *out, resp_command_t *cmd) {
+    expire_command(out, cmd, 1000);
+}
+
+static void resp_cmd_pexpire(reply_t *out, resp_command_t *cmd) {
+    expire_command(out, cmd, 1);
+}
+
+// TTL/PTTL key: the remaining time, -1 without a TTL and -2 for a missing key.
+static void ttl_command(reply_t *out, resp_command_t *cmd, int64_t unit_ms) {
+    int64_t ttl = kv_ttl(cmd->argv[1]);
+    if (ttl >= 0) ttl = (ttl + unit_ms / 2) / unit_ms;
+    resp_integer(out, ttl);
+}
+
+static void resp_cmd_ttl(reply_t *out, resp_command_t *cmd) {
+    ttl_command(out, cmd, 1000);
+}
+
+static void resp_cmd_pttl(reply_t *out, resp_command_t *cmd) {
+    ttl_command(out, cmd, 1);
+}
+
+static void resp_cmd_persist(reply_t *out, resp_command_t *cmd) {
+    resp_integer(out, kv_persist(cmd->argv[1]) == 0 ? 1 : 0);
+}
+
+static void resp_cmd_type(reply_t *out, resp_command_t *cmd) {
+    switch (kv_get_type(cmd->argv[1])) {
+        case KV_STRING: resp_simple(out, "string"); break;
+        case KV_HASH:   resp_simple(out, "hash"); break;
+        default:        resp_simple(out, "none"); break;
+    }
+}
+
+static void resp_run(reply_t *out, command_t id, resp_command_t *cmd);
+
+static void resp_cmd_multi(reply_t *out, resp_command_t *cmd) {
+    if (cmd->queue.active) {
+        resp_error(out, "ERR MULTI calls can not be nested");
+        return;
+    }
+    cmd->queue.active = true;
+    cmd->queue.failed = false;
+    resp_simple(out, "OK");
+}
+
+static void exec_begin(reply_t *out, int count) {
+    resp_array(out, count);
+}
+
+// EXEC: an array of the queued commands' replies
+static void resp_cmd_exec(reply_t *out, resp_command_t *cmd) {
+    if (!cmd->queue.active) {
+        resp_error(out, "ERR EXEC without MULTI");
+        return;
+    }
+    if (cmd->queue.failed) {
+        command_queue_clear(&cmd->queue);
+        resp_error(out, "EXECABORT Transaction discarded because of previous errors.");
+        return;
+    }
+    if (commands_exec(out, cmd, exec_begin, resp_run) != EXTRACT_OK) resp_error(out, "ERR out of memory");
+}
+
+static void resp_cmd_discard(reply_t *out, resp_command_t *cmd) {
+    if (!cmd->queue.active) {
+        resp_error(out, "ERR DISCARD without MULTI");
+        return;
+    }
+    command_queue_clear(&cmd->queue);
+    resp_simple(out, "OK");
+}
+
+// RESP2 handlers, from the command list in protocol.h.
+#define RESP_PROC(id, name, arity, flags, keys, proc, resp_proc) [CMD_##id] = resp_proc,
+
+static const resp_proc_t resp_procs[CMD_COUNT] = {
+    COMMAND_LIST(RESP_PROC)
+};
+
+/**
+ * @brief Checks a command against the registry and runs it, counting it in its stats.
+ *
+ * Wrong argument counts and unusable keys get an error reply, as in Redis,
+ * and make a pending EXEC refuse the transaction.
+ */
+static void resp_run(reply_t *out, command_t id, resp_command_t *cmd) {
+    const command_def_t *def = command_def(id);
+    if (!command_arity_ok(def, cmd->argc)) {
+        commands_count_rejected(id);
+        cmd->queue.failed = true;
+        reply_printf(out, "-ERR wrong number of arguments for '%s' command\r\n", def->name);
+        return;
+    }
+    int last = def->first_key > 0 ? command_last_key(def, cmd->argc) : 0;
+    for (int i = def->first_key; i > 0 && i <= last; i += def->key_step) {
+        if (!check_key(out, cmd, i)) {
+            commands_count_rejected(id);
+            cmd->queue.failed = true;
+            return;
+        }
+    }
+
+    if (cmd->queue.active && !(def->flags & COMMAND_NOQUEUE)) {
+        if (command_queue_push(&cmd->queue, id, cmd) != EXTRACT_OK) {
+            cmd->queue.failed = true;
+            resp_error(out, "ERR out of memory");
+            return;
+        }
+        resp_simple(out, "QUEUED");
+        return;
+    }
+
+    uint64_t start = commands_clock_us();
+    resp_procs[id](out, cmd);
+    commands_count_call(id, start);
+}
+
+/**
+ * @brief Runs a parsed command, appending its RESP2 reply to out.
+ *
+ * Command names are matched case-insensitively and the command is checked
+ * and run by resp_run(). An unknown one gets an error reply, as in Redis.
+ */
+void resp_dispatch(reply_t *out, resp_command_t *cmd) {
+    if (cmd->argc == 0) return;
+
+    command_t id = lookup_command(cmd->argv[0], cmd->argv_len[0]);
+    if (id != CMD_UNKNOWN) {
+        resp_run(out, id, cmd);
+        return;
+    }
+
+    // the name is echoed back, so it must not break the reply line
+    char name[64];
+    size_t len = cmd->argv_len[0] < sizeof(name) - 1 ? cmd->argv_len[0] : sizeof(name) - 1;
+    for (size_t i = 0; i < len; i++) {
+        char c = cmd->argv[0][i];
+        name[i] = (c == '\r' || c == '\n' || c == '\0') ? ' ' : c;
+    }
+    name[len] = '\0';
+    cmd->queue.failed = true;
+    reply_printf(out, "-ERR unknown command '%s'\r\n", name);
+}
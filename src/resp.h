@@ -0,0 +1,47 @@
+#ifndef RESP_H
+#define RESP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "protocol.h"
+#include "reply.h"
+
+// Most arguments one command can carry, as in Redis.
+#define RESP_MAX_ARGS (1024 * 1024)
+
+#define RESP_INCOMPLETE 0 // resp_parse(): more bytes are needed
+#define RESP_PROTO_ERR -1 // resp_parse(): the bytes are not RESP2
+#define RESP_NOMEM -2     // resp_parse(): the argument arrays could not grow
+
+/*
+ * One RESP2 command: an array of bulk strings. Arguments point into the input
+ * buffer and are NUL-terminated in place, over the CR that ends each one; a
+ * value may still hold NUL bytes, so argv_len is the real length. The argument
+ * arrays are the connection's, shared with the text protocol.
+ */
+typedef command_args_t resp_command_t;
+
+/*
+ * How far resp_parse() got into a command that has not fully arrived, kept
+ * between reads so the next call resumes there instead of parsing the command
+ * again from its first byte. Zeroed, it starts a new command.
+ */
+typedef struct {
+    int argc;           // arguments the command declares
+    int parsed;         // arguments complete so far, already in argv
+    size_t pos;         // bytes of the command parsed so far; 0 until its header is
+} resp_parser_t;
+
+ssize_t resp_parse(char *buf, size_t len, resp_command_t *cmd, resp_parser_t *parser);
+void resp_parser_move(const resp_parser_t *parser, resp_command_t *cmd, const char *from, char *to);
+void resp_dispatch(reply_t *out, resp_command_t *cmd);
+
+void resp_simple(reply_t *out, const char *s);
+void resp_error(reply_t *out, const char *msg);
+void resp_integer(reply_t *out, long long n);
+void resp_bulk(reply_t *out, const char *data, size_t len);
+void resp_null(reply_t *out);
+void resp_array(reply_t *out, long long count);
+
+#endif
@@ -1,12 +1,18 @@
+#define _GNU_SOURCE // pthread_setaffinity_np, CPU_SET
+
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -14,11 +20,20 @@
 #include "logs.h"
 #include "server_utils.h"
 #include "info.h"
+#include "config.h"
+#include "reactor.h"
+#include "iostats.h"
+#include "uring.h"
+#include "workers.h"
+#include "errors.h"
+#include "clients.h"
 
 #ifndef VERSION
 #define VERSION "dev"
 #endif
 
+#define CRON_INTERVAL_MS 100
+
 volatile sig_atomic_t running = 1;
 int serverfd;
 time_t start_time;
@@ -38,55 +53,309 @@ void handle_sigterm(int sig) {
 
 
 /**
- * @brief Entry point for the multi-threaded TCP server.
+ * @brief Timer thread running periodic store maintenance.
  *
- * Initializes the key-value store, sets up the server socket, and listens for incoming client connections on a configurable port. Handles each client connection in a separate detached thread. Supports graceful shutdown on SIGTERM.
+ * Calls kv_cron() every CRON_INTERVAL_MS so resizing tables keep migrating
+ * even when no writes reach them.
+ */
+static void* cron_loop(void *arg) {
+    (void)arg;
+    const struct timespec interval = { 0, CRON_INTERVAL_MS * 1000000L };
+
+    while (running) {
+        kv_cron();
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates a socket listening on port on every interface.
  *
- * @return int Returns 0 on normal termination, or 1 if socket binding or listening fails.
+ * @param reuseport Set SO_REUSEPORT so several sockets can share the port and
+ *                  the kernel spreads incoming connections across them.
+ * @param backlog   Connections the kernel completes and holds until accepted;
+ *                  it silently caps this at net.core.somaxconn.
+ * @return The socket, or -1 if it could not be bound or put to listen (logged).
  */
-int main() {
-    log_info("Version: %s\n", VERSION);
-    start_time = time(NULL);
-    kv_init();
-    int status;
-    int SERVER_PORT = getenv("PORT") ? atoi(getenv("PORT")) : 8080;
+static int open_listener(int port, bool reuseport, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        log_error("Error creating socket: %s", strerror(errno));
+        return -1;
+    }
 
-    signal(SIGTERM, handle_sigterm);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)); // restart while old connections linger in TIME_WAIT
+    if (reuseport) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
 
-    serverfd = socket(AF_INET, SOCK_STREAM, 0);
     struct sockaddr_in addr = {
         .sin_family = AF_INET,
-        .sin_port = htons((uint16_t)SERVER_PORT),
+        .sin_port = htons((uint16_t)port),
         .sin_addr.s_addr = INADDR_ANY
     };
 
-    status = bind(serverfd, (struct sockaddr*)&addr, sizeof(addr));
-    if (status != 0 ) {
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
         log_error("Error binding the port: %s", strerror(errno));
-        return 1;
+        close(fd);
+        return -1;
     }
 
-    status = listen(serverfd, 5);
-    if (status != 0) {
+    if (listen(fd, backlog) != 0) {
         log_error("Error listening: %s", strerror(errno));
-        return 1;
+        close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    log_info("Server listening on port %d...\n", SERVER_PORT);
+/**
+ * @brief Creates a socket listening on a Unix socket path, for clients on the same host.
+ *
+ * They skip the TCP/IP stack: no checksums, segmentation, ACKs or loopback
+ * routing. A socket file left at path by an earlier run is replaced; any other
+ * file there is an error.
+ *
+ * @return The socket, or -1 if it could not be bound or put to listen (logged).
+ */
+static int open_unix_listener(const char *path, int backlog) {
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            log_error("Not replacing %s: it is not a socket", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        log_error("Error creating Unix socket: %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        log_error("Error binding %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, backlog) != 0) {
+        log_error("Error listening on %s: %s", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+// Worker pool handler: serves a connection clients_admit() let in, then releases it.
+static void* serve_client(void *arg) {
+    handle_client(arg);
+    clients_release();
+    return NULL;
+}
+
+// Accepts clients on a listener and queues them for the worker pool.
+static void* accept_loop(void *arg) {
+    int listenfd = (int)(intptr_t)arg;
 
     while (running) {
-        int clientfd = accept(serverfd, NULL, NULL);
+        int clientfd = accept(listenfd, NULL, NULL);
         if (clientfd < 0) {
             if (running) {
                 log_error("Error accepting connection: %s", strerror(errno));
             }
             continue;
         }
+        if (!clients_admit()) {
+            reject_client(clientfd, EXTRACT_ERR_MAX_CLIENTS);
+            continue;
+        }
+        set_nodelay(clientfd);
+        if (workers_submit(clientfd) != 0) {
+            clients_release();
+            reject_client(clientfd, EXTRACT_ERR_BUSY);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Thread backend: accepted clients are queued for a bounded pool of
+ *        threads that each serve one connection at a time.
+ *
+ * serverfd is accepted from the calling thread, and unixfd, unless it is -1,
+ * from a second one.
+ *
+ * @return 0 on shutdown, -1 if the pool could not be set up.
+ */
+static int serve_threads(int worker_threads, int worker_queue, int unixfd) {
+    if (workers_init(worker_threads, worker_queue, serve_client) != 0) {
+        log_error("Could not allocate a worker queue of %d", worker_queue);
+        return -1;
+    }
+
+    if (unixfd >= 0) {
         pthread_t tid;
-        pthread_create(&tid, NULL, handle_client, (void *)(intptr_t)clientfd);
+        if (pthread_create(&tid, NULL, accept_loop, (void *)(intptr_t)unixfd) != 0) {
+            log_error("Could not start the Unix socket accept thread");
+            return -1;
+        }
         pthread_detach(tid);
     }
+    accept_loop((void *)(intptr_t)serverfd);
+    return 0;
+}
+
+typedef struct {
+    pthread_t tid;
+    int listenfd;
+    int cpu; // -1 to leave the thread unpinned
+    io_backend_t backend;
+} io_thread_t;
+
+static void* io_thread_main(void *arg) {
+    const io_thread_t *t = arg;
+
+    if (t->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(t->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            log_error("Could not pin I/O thread to CPU %d", t->cpu);
+        }
+    }
+
+    io_thread_stats_t *stats = iostats_register(t->cpu);
+    if (t->backend == IO_BACKEND_URING) {
+        if (uring_run(t->listenfd, stats, &running) != URING_UNSUPPORTED) return NULL;
+        log_info("io_uring is not supported by this kernel, falling back to epoll\n");
+    }
+    reactor_run(t->listenfd, stats, &running);
+    return NULL;
+}
+
+// Returns the nth CPU the process may run on, wrapping around, or -1 if unknown.
+static int nth_allowed_cpu(const cpu_set_t *allowed, int nth) {
+    int count = CPU_COUNT(allowed);
+    if (count == 0) return -1;
+
+    nth %= count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, allowed) && nth-- == 0) return cpu;
+    }
+    return -1;
+}
+
+/**
+ * @brief Event loop backends: runs io_threads epoll or io_uring loops, each pinned to its own CPU.
+ *
+ * Every loop owns a SO_REUSEPORT listener bound to the same port, so the
+ * kernel shards new connections across threads and no accept lock is shared.
+ * The first listener is serverfd. A Unix socket listener, unless unixfd is
+ * -1, gets one more loop of its own, pinned like the next TCP one would be.
+ *
+ * @return 0 on shutdown, -1 if a listener or thread could not be started.
+ */
+static int serve_reactors(int port, int backlog, io_backend_t backend, int io_threads, int unixfd) {
+    io_thread_t threads[IOSTATS_MAX_THREADS + 1];
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+    }
+
+    int loops = unixfd >= 0 ? io_threads + 1 : io_threads;
+    int started = 0;
+    int res = 0;
+    for (int i = 0; i < loops; i++) {
+        if (i == io_threads) {
+            threads[i].listenfd = unixfd;
+        } else {
+            threads[i].listenfd = i == 0 ? serverfd : open_listener(port, true, backlog);
+        }
+        threads[i].cpu = nth_allowed_cpu(&allowed, i);
+        threads[i].backend = backend;
+        if (threads[i].listenfd < 0 ||
+            pthread_create(&threads[i].tid, NULL, io_thread_main, &threads[i]) != 0) {
+            if (i > 0 && i < io_threads && threads[i].listenfd >= 0) close(threads[i].listenfd);
+            running = 0;
+            res = -1;
+            break;
+        }
+        started++;
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i].tid, NULL);
+        if (i > 0 && i < io_threads) close(threads[i].listenfd);
+    }
+    return res;
+}
+
+/**
+ * @brief Entry point for the TCP server.
+ *
+ * Initializes the key-value store, sets up the server socket, and listens for incoming client connections on a configurable port. Connections are served by IO_THREADS epoll event loops (or --io-threads), io_uring ones with IO_BACKEND=uring, or by a bounded pool of WORKER_THREADS threads with IO_BACKEND=threads. With UNIX_SOCKET (or --unix-socket) it also listens on that path. Supports graceful shutdown on SIGTERM.
+ *
+ * @return int Returns 0 on normal termination, or 1 if the options are invalid or socket binding or listening fails.
+ */
+int main(int argc, char **argv) {
+    log_info("Version: %s\n", VERSION);
+    start_time = time(NULL);
+
+    server_config_t config;
+    config_defaults(&config);
+    config_load_env(&config);
+    if (config_load_args(&config, argc, argv) != 0) {
+        fprintf(stderr, "Usage: %s [--io-threads N] [--unix-socket PATH]\n", argv[0]);
+        return 1;
+    }
+
+    kv_init();
+    kv_set_max_value_len(config.max_value_size);
+    kv_set_hash_packed_limits(config.hash_max_packed_fields, config.hash_max_packed_value);
+    kv_set_maxmemory(config.maxmemory, config.maxmemory_policy);
+    clients_set_limits(&config.clients);
+    int SERVER_PORT = config.port;
+
+    signal(SIGTERM, handle_sigterm);
+    signal(SIGPIPE, SIG_IGN); // a client gone mid-reply fails the write instead of killing the server
+
+    serverfd = open_listener(SERVER_PORT, config.io_backend != IO_BACKEND_THREADS, config.listen_backlog);
+    if (serverfd < 0) return 1;
+
+    log_info("Server listening on port %d...\n", SERVER_PORT);
+
+    int unixfd = -1;
+    if (config.unix_socket) {
+        unixfd = open_unix_listener(config.unix_socket, config.listen_backlog);
+        if (unixfd < 0) return 1;
+        log_info("Server listening on %s...\n", config.unix_socket);
+    }
+
+    pthread_t cron_tid;
+    pthread_create(&cron_tid, NULL, cron_loop, NULL);
+    pthread_detach(cron_tid);
+
+    if (config.io_backend != IO_BACKEND_THREADS) {
+        log_info("Serving with %d I/O threads\n", config.io_threads);
+        if (serve_reactors(SERVER_PORT, config.listen_backlog, config.io_backend, config.io_threads, unixfd) != 0) return 1;
+    } else {
+        log_info("Serving with up to %d worker threads, %d queued connections\n",
+                 config.worker_threads, config.worker_queue);
+        if (serve_threads(config.worker_threads, config.worker_queue, unixfd) != 0) return 1;
+    }
 
     close(serverfd);
+    if (unixfd >= 0) {
+        close(unixfd);
+        unlink(config.unix_socket);
+    }
     return 0;
 }
@@ -1,92 +1,328 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "commands.h"
 #include "protocol.h"
 #include "server_utils.h"
 #include "errors.h"
+#include "resp.h"
+#include "clients.h"
 
 /**
  * @brief Parses and dispatches a client command to the appropriate handler.
  *
- * Determines the command type from the input buffer and invokes the corresponding handler function for the client socket. Sends an "Invalid command" message if the command is unrecognized.
+ * Splits the line into arguments in place, looks the first one up as the command name and invokes its handler, which appends its reply to out. Replies with an "unknown command" error if the command is unrecognized, which also makes a pending EXEC refuse the transaction.
  *
- * @param clientfd File descriptor for the client socket.
- * @param buffer Null-terminated string containing the client's command.
+ * @param out Output buffer of the client connection.
+ * @param args The connection's argument arrays, which grow to fit the command.
+ * @param buffer Null-terminated string containing the client's command; modified in place.
  */
-void dispatch_command(int clientfd, const char *buffer) {
-    command_t cmd = parse_command(buffer);
+void dispatch_command(reply_t *out, command_args_t *args, char *buffer) {
+    int res = tokenize_command(buffer, args);
+    if (res != EXTRACT_OK) {
+        args->queue.failed = true;
+        send_error_response(out, res);
+        return;
+    }
 
-    switch (cmd) {
-        case CMD_PING:
-            handle_command(clientfd, CMD_PING, "");
-            break;
-        case CMD_TIME:
-            handle_command(clientfd, CMD_TIME, "");
-            break;
-        case CMD_SET:
-            handle_command(clientfd, CMD_SET, buffer);
-            break;
-        case CMD_GET:
-            handle_command(clientfd, CMD_GET, buffer);
-            break;
-        case CMD_MSET:
-            handle_command(clientfd, CMD_MSET, buffer);
-            break;
-        case CMD_MGET:
-            handle_command(clientfd, CMD_MGET, buffer);
-            break;
-        case CMD_INFO:
-            handle_command(clientfd, CMD_INFO, "");
-            break;
-        case CMD_DEL:
-            handle_command(clientfd, CMD_DEL, buffer);
-            break;
-        case CMD_TYPE:
-            handle_command(clientfd, CMD_TYPE, buffer);
-            break;
-        case CMD_HSET:
-            handle_command(clientfd, CMD_HSET, buffer);
-            break;
-        case CMD_HGET:
-            handle_command(clientfd, CMD_HGET, buffer);
-            break;
-        case CMD_HMGET:
-            handle_command(clientfd, CMD_HMGET, buffer);
-            break;
-        case CMD_HINCRBY:
-            handle_command(clientfd, CMD_HINCRBY, buffer);
-            break;
-        case CMD_UNKNOWN:
-        default:
-            send(clientfd, ERR_UNKNOWN_CMD, strlen(ERR_UNKNOWN_CMD), 0); 
-            break;
+    command_t cmd = args->argc > 0 ? lookup_command(args->argv[0], args->argv_len[0]) : CMD_UNKNOWN;
+    if (cmd == CMD_UNKNOWN) {
+        args->queue.failed = true;
+        reply_str(out, ERR_UNKNOWN_CMD);
+        return;
+    }
+    handle_command(out, cmd, args);
+}
+
+/**
+ * @brief Disables Nagle's algorithm on a client socket.
+ *
+ * With Nagle enabled, a batch of replies written while the previous one is
+ * still unacknowledged waits for the client's delayed ACK, about 40 ms.
+ */
+void set_nodelay(int clientfd) {
+    int one = 1;
+    setsockopt(clientfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/**
+ * @brief Tells a client turned away at accept why, then closes it.
+ *
+ * @param reason EXTRACT_ERR_BUSY or EXTRACT_ERR_MAX_CLIENTS.
+ */
+void reject_client(int clientfd, int reason) {
+    reply_t out;
+    reply_init(&out);
+    send_error_response(&out, reason);
+    size_t sent = 0;
+    reply_write(&out, clientfd, &sent); // never waits on a client that is not reading
+    reply_free(&out);
+    close(clientfd);
+}
+
+void input_buffer_init(input_buffer_t *in) {
+    in->data = in->small;
+    in->cap = sizeof(in->small);
+    in->len = 0;
+    in->discarding = false;
+    in->failed = false;
+    in->protocol = PROTOCOL_UNKNOWN;
+    command_args_init(&in->args);
+    in->resp = (resp_parser_t){ 0 };
+}
+
+void input_buffer_free(input_buffer_t *in) {
+    if (in->data != in->small) free(in->data);
+    in->data = in->small;
+    in->cap = sizeof(in->small);
+    in->len = 0;
+    command_args_free(&in->args);
+    in->resp = (resp_parser_t){ 0 };
+}
+
+/**
+ * @brief Returns where the next read should land and how much room is left.
+ *
+ * One byte is always held back so a complete line can be NUL-terminated in
+ * place; input_buffer_dispatch() never leaves the buffer without room.
+ */
+char *input_buffer_space(input_buffer_t *in, size_t *avail) {
+    *avail = in->cap - 1 - in->len;
+    return in->data + in->len;
+}
+
+// A partial RESP2 command holds pointers to its parsed arguments, which follow its bytes.
+static void input_buffer_moved(input_buffer_t *in, const char *from, char *to) {
+    if (in->protocol == PROTOCOL_RESP) resp_parser_move(&in->resp, &in->args, from, to);
+}
+
+/**
+ * @brief Doubles a buffer that a partial command fills, up to max_request.
+ *
+ * @return EXTRACT_OK, EXTRACT_ERR_LINE_TOO_LONG if the buffer already holds
+ *         max_request bytes, or EXTRACT_ERR_OOM.
+ */
+static int input_buffer_grow(input_buffer_t *in) {
+    size_t max = clients_limits()->max_request;
+    if (max > 0 && in->cap - 1 >= max) return EXTRACT_ERR_LINE_TOO_LONG;
+
+    size_t cap = in->cap * 2;
+    if (max > 0 && cap - 1 > max) cap = max + 1;
+
+    // copied rather than realloc()ed, so a partial command's arguments can follow
+    char *data = malloc(cap);
+    if (!data) return EXTRACT_ERR_OOM;
+    memcpy(data, in->data, in->len);
+    input_buffer_moved(in, in->data, data);
+    if (in->data != in->small) free(in->data);
+    in->data = data;
+    in->cap = cap;
+    return EXTRACT_OK;
+}
+
+/**
+ * @brief Keeps what is left of the buffer after dispatch at its front.
+ *
+ * A drained heap buffer goes back to the inline one, so a connection holds
+ * the memory of a long command only while it arrives. A buffer that a
+ * partial command fills is grown for the rest of it.
+ *
+ * @return EXTRACT_OK, or the error of input_buffer_grow().
+ */
+static int input_buffer_compact(input_buffer_t *in, char *start) {
+    if (in->len == 0 && in->data != in->small) {
+        free(in->data);
+        in->data = in->small;
+        in->cap = sizeof(in->small);
+    } else if (in->len > 0 && start != in->data) {
+        memmove(in->data, start, in->len);
+        input_buffer_moved(in, start, in->data);
     }
+    return in->len == in->cap - 1 ? input_buffer_grow(in) : EXTRACT_OK;
+}
+
+/**
+ * @brief Runs every complete RESP2 command in the buffer.
+ *
+ * Commands are parsed in place from the front of the buffer; an incomplete
+ * one is moved to the front, and in->resp keeps how far it was parsed so the
+ * next read resumes there. Bytes that
+ * are not RESP2, or a command longer than max_request, get an error reply
+ * and mark the buffer failed, since the stream cannot be resynchronized.
+ */
+static int dispatch_resp(reply_t *out, input_buffer_t *in) {
+    char *start = in->data;
+    char *end = in->data + in->len;
+
+    int commands = 0;
+    while (start < end) {
+        ssize_t n = resp_parse(start, (size_t)(end - start), &in->args, &in->resp);
+        if (n == RESP_INCOMPLETE) break;
+        if (n < 0) {
+            resp_error(out, n == RESP_NOMEM ? "ERR out of memory" : "ERR Protocol error");
+            in->failed = true;
+            in->len = 0;
+            in->resp = (resp_parser_t){ 0 };
+            return commands;
+        }
+        if (in->args.argc > 0) {
+            resp_dispatch(out, &in->args);
+            commands++;
+        }
+        start += n;
+    }
+
+    in->len = (size_t)(end - start);
+    int res = input_buffer_compact(in, start);
+    if (res != EXTRACT_OK) {
+        resp_error(out, res == EXTRACT_ERR_OOM ? "ERR out of memory" : "ERR Protocol error: command too long");
+        in->failed = true;
+        in->len = 0;
+        in->resp = (resp_parser_t){ 0 };
+    }
+    return commands;
+}
+
+/**
+ * @brief Dispatches every complete command in the buffer after a read.
+ *
+ * The first byte of the connection picks the protocol: '*' or '$' starts
+ * RESP2 (see dispatch_resp()), anything else the text protocol. Each
+ * newline-terminated line is handed to dispatch_command() in place, so
+ * pipelined commands are answered in order without copying. Replies are
+ * appended to out; the caller flushes them once the batch is done. Empty lines are
+ * skipped. A trailing partial line is moved to the front of the buffer, which
+ * grows when the line fills it. A line longer than max_request is answered
+ * with ERROR line too long and dropped up to its newline.
+ *
+ * @param bytes Number of bytes just read into input_buffer_space().
+ * @return Number of commands dispatched.
+ */
+int input_buffer_dispatch(reply_t *out, input_buffer_t *in, size_t bytes) {
+    if (in->protocol == PROTOCOL_UNKNOWN && bytes > 0) {
+        char first = in->data[in->len];
+        in->protocol = (first == '*' || first == '$') ? PROTOCOL_RESP : PROTOCOL_TEXT;
+    }
+    if (in->protocol == PROTOCOL_RESP) {
+        in->len += bytes;
+        return dispatch_resp(out, in);
+    }
+
+    char *start = in->data + in->len;
+    char *end = start + bytes;
+    in->len += bytes;
+
+    // bytes left from earlier reads hold no newline, so only the new ones are searched
+    char *scan = start;
+    if (in->discarding) {
+        char *nl = memchr(start, '\n', bytes);
+        if (!nl) {
+            in->len = 0;
+            return 0;
+        }
+        in->discarding = false;
+        start = nl + 1;
+        scan = start;
+    } else {
+        start = in->data;
+    }
+
+    int commands = 0;
+    char *nl;
+    while ((nl = memchr(scan, '\n', (size_t)(end - scan))) != NULL) {
+        char *next = nl + 1;
+        if (next - start > 1 && !(next - start == 2 && *start == '\r')) {
+            char saved = *next; // the first byte of the following line, or spare room
+            *next = '\0';
+            dispatch_command(out, &in->args, start);
+            *next = saved;
+            commands++;
+        }
+        start = next;
+        scan = next;
+    }
+
+    in->len = (size_t)(end - start);
+    int res = input_buffer_compact(in, start);
+    if (res == EXTRACT_ERR_LINE_TOO_LONG) {
+        send_error_response(out, EXTRACT_ERR_LINE_TOO_LONG);
+        in->discarding = true;
+        in->len = 0;
+    } else if (res != EXTRACT_OK) {
+        send_error_response(out, res);
+        in->failed = true;
+        in->len = 0;
+    }
+    return commands;
 }
 
 /**
  * @brief Handles communication with a connected client over a socket.
  *
- * Continuously receives commands from the client, dispatches each command for processing,
- * and closes the connection when the client disconnects or an error occurs.
+ * Continuously receives data from the client, dispatches each complete command,
+ * writes the replies to a read's commands with one reply_flush(), and closes the
+ * connection when the client disconnects or an error occurs.
+ *
+ * The client limits apply through socket timeouts: a client idle for the
+ * timeout is disconnected, and so is one whose replies stay unwritten for
+ * output_soft_seconds (the timeout without a soft limit), since a blocked
+ * write is this backend's full output buffer. A batch of replies over the
+ * output limits disconnects it before it is written.
  *
  * @param arg Pointer to the client socket file descriptor (cast from void*).
  * @return Always returns NULL upon client disconnection or error.
  */
 void* handle_client(void *arg) {
     int clientfd = (int)(intptr_t)arg;
-    char buffer[BUFFER_SIZE];
+    input_buffer_t in;
+    input_buffer_init(&in);
+    reply_t out;
+    reply_init(&out);
+
+    const client_limits_t *limits = clients_limits();
+    if (limits->timeout > 0) {
+        struct timeval tv = { .tv_sec = limits->timeout };
+        setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    int send_timeout = limits->output_soft_limit > 0 && limits->output_soft_seconds > 0
+        ? limits->output_soft_seconds : limits->timeout;
+    if (send_timeout > 0) {
+        struct timeval tv = { .tv_sec = send_timeout };
+        setsockopt(clientfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    time_t soft_since = 0;
 
     while (1) {
-        memset(buffer, 0, sizeof(buffer));
-        ssize_t bytes = recv(clientfd, buffer, sizeof(buffer) - 1, 0);
-        if (bytes <= 0) break;
+        size_t avail;
+        char *space = input_buffer_space(&in, &avail);
+        ssize_t bytes = recv(clientfd, space, avail, 0);
+        if (bytes <= 0) {
+            if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) clients_count_timed_out();
+            break;
+        }
 
-        dispatch_command(clientfd, buffer);
+        input_buffer_dispatch(&out, &in, (size_t)bytes);
+        if (clients_output_exceeded(out.len, time(NULL), &soft_since)) {
+            clients_count_evicted();
+            break;
+        }
+        if (reply_flush(&out, clientfd) != 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) clients_count_evicted();
+            break;
+        }
+        if (in.failed) break;
     }
 
+    input_buffer_free(&in);
+    reply_free(&out);
     close(clientfd);
     return NULL;
 }
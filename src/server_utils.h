@@ -1,9 +1,49 @@
 #ifndef SERVER_UTILS_H
 #define SERVER_UTILS_H
 
-#define BUFFER_SIZE 1024
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "protocol.h"
+#include "reply.h"
+#include "resp.h"
+
+// Bytes a connection can hold before its input buffer moves to the heap.
+#define INPUT_BUFFER_SIZE 1024
+
+// Wire protocol of a connection, picked from the first byte it sends.
+typedef enum {
+    PROTOCOL_UNKNOWN, // nothing received yet
+    PROTOCOL_TEXT,    // newline-terminated commands, RESPONSE ... END replies
+    PROTOCOL_RESP     // RESP2 arrays of bulk strings (see resp.c)
+} protocol_t;
+
+/*
+ * Bytes received on a connection and not yet dispatched. A read may carry
+ * several commands and end halfway through the next, which stays here until
+ * the rest arrives. Commands that fit in INPUT_BUFFER_SIZE use the inline
+ * buffer; a longer one grows a heap buffer, up to the max_request client
+ * limit, which is released once the buffer is drained.
+ */
+typedef struct {
+    char *data;          // small, or the heap buffer while a long command arrives
+    size_t cap;
+    size_t len;
+    bool discarding;     // dropping the rest of a line that did not fit
+    bool failed;         // RESP protocol error: close once the error reply is sent
+    protocol_t protocol;
+    command_args_t args; // arguments of the command being dispatched
+    resp_parser_t resp;  // progress into a RESP2 command that has not fully arrived
+    char small[INPUT_BUFFER_SIZE];
+} input_buffer_t;
 
 void* handle_client(void *arg);
-void dispatch_command(int clientfd, const char *buffer);
+void dispatch_command(reply_t *out, command_args_t *args, char *buffer);
+void input_buffer_init(input_buffer_t *in);
+void input_buffer_free(input_buffer_t *in);
+char *input_buffer_space(input_buffer_t *in, size_t *avail);
+int input_buffer_dispatch(reply_t *out, input_buffer_t *in, size_t bytes);
+void set_nodelay(int clientfd);
+void reject_client(int clientfd, int reason);
 
 #endif
@@ -0,0 +1,291 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "slab.h"
+
+/*
+ * Slab allocator for the store's fixed-size nodes, after Bonwick's magazines.
+ *
+ * Objects are carved from SLAB_SIZE slabs. Each thread keeps two magazines
+ * (arrays of up to SLAB_MAGAZINE_SIZE free objects) per cache, so most
+ * allocations and frees are a push or pop on thread-local memory with no
+ * lock. Only when both magazines are empty (alloc) or full (free) does the
+ * thread take the cache lock and exchange a whole magazine with the global
+ * depot, or carve a magazine's worth of new objects from the current slab.
+ *
+ * Objects freed by another thread simply land in that thread's magazines.
+ * A thread's magazines go back to the depot when it exits. Slabs are never
+ * returned to the system; the fragmentation stat shows how much of them is
+ * sitting free.
+ */
+
+typedef struct slab_magazine {
+    struct slab_magazine *next;
+    int count;
+    void *objs[SLAB_MAGAZINE_SIZE];
+} slab_magazine;
+
+typedef struct {
+    slab_magazine *loaded;
+    slab_magazine *previous;
+    long in_use_delta; // allocations minus frees not yet published to the cache
+} slab_tcache;
+
+static slab_cache *caches[SLAB_MAX_CACHES];
+static int cache_count;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static __thread slab_tcache tcaches[SLAB_MAX_CACHES];
+static __thread bool thread_registered;
+
+static void thread_exit(void *arg) {
+    (void)arg;
+    slab_flush_thread();
+}
+
+static void make_thread_key(void) {
+    pthread_key_create(&thread_key, thread_exit);
+}
+
+/**
+ * @brief Assigns the cache its per-thread slot on first use.
+ *
+ * @return The cache id, or -1 if SLAB_MAX_CACHES are already registered, in
+ *         which case the cache falls back to malloc.
+ */
+static int register_cache(slab_cache *c) {
+    int id = __atomic_load_n(&c->id, __ATOMIC_ACQUIRE);
+    if (id >= 0) return id;
+
+    pthread_mutex_lock(&registry_lock);
+    if (c->id < 0 && cache_count < SLAB_MAX_CACHES) {
+        // keep every object pointer aligned
+        c->obj_size = (c->obj_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+        caches[cache_count] = c;
+        __atomic_store_n(&c->id, cache_count, __ATOMIC_RELEASE);
+        cache_count++;
+    }
+    id = c->id;
+    pthread_mutex_unlock(&registry_lock);
+    return id;
+}
+
+static slab_tcache *thread_cache(int id) {
+    if (!thread_registered) {
+        pthread_once(&thread_key_once, make_thread_key);
+        pthread_setspecific(thread_key, tcaches); // any non-NULL value arms the destructor
+        thread_registered = true;
+    }
+    return &tcaches[id];
+}
+
+// Takes a magazine from the depot's spares or allocates one. Caller holds c->lock.
+static slab_magazine *spare_magazine(slab_cache *c) {
+    slab_magazine *mag = c->empty;
+    if (mag) {
+        c->empty = mag->next;
+    } else {
+        mag = malloc(sizeof(slab_magazine));
+        if (!mag) return NULL;
+    }
+    mag->count = 0;
+    mag->next = NULL;
+    return mag;
+}
+
+// Caller holds c->lock.
+static void depot_put(slab_cache *c, slab_magazine *mag) {
+    if (mag->count > 0) {
+        mag->next = c->full;
+        c->full = mag;
+        c->depot_objects += (size_t)mag->count;
+    } else {
+        mag->next = c->empty;
+        c->empty = mag;
+    }
+}
+
+// Caller holds c->lock.
+static void publish(slab_cache *c, slab_tcache *tc) {
+    c->in_use += tc->in_use_delta;
+    tc->in_use_delta = 0;
+}
+
+// Fills mag with never-used objects, starting new slabs as needed. Caller holds c->lock.
+static void carve(slab_cache *c, slab_magazine *mag) {
+    while (mag->count < SLAB_MAGAZINE_SIZE) {
+        if (c->carve_left < c->obj_size) {
+            char *slab = malloc(SLAB_SIZE);
+            if (!slab) return;
+            // the tail of the previous slab is smaller than one object and is abandoned
+            c->carve_pos = slab;
+            c->carve_left = SLAB_SIZE;
+            c->slabs++;
+        }
+        mag->objs[mag->count++] = c->carve_pos;
+        c->carve_pos += c->obj_size;
+        c->carve_left -= c->obj_size;
+    }
+}
+
+/**
+ * @brief Swaps the thread's empty loaded magazine for a full one from the
+ *        depot, or carves a fresh magazine from the slabs.
+ *
+ * @return 0 if the loaded magazine now holds objects, -1 if out of memory.
+ */
+static int refill(slab_cache *c, slab_tcache *tc) {
+    pthread_mutex_lock(&c->lock);
+    publish(c, tc);
+
+    if (!tc->loaded) {
+        tc->loaded = spare_magazine(c);
+    }
+
+    if (tc->loaded && c->full) {
+        slab_magazine *mag = c->full;
+        c->full = mag->next;
+        c->depot_objects -= (size_t)mag->count;
+        depot_put(c, tc->loaded);
+        tc->loaded = mag;
+    } else if (tc->loaded) {
+        carve(c, tc->loaded);
+    }
+
+    int res = (tc->loaded && tc->loaded->count > 0) ? 0 : -1;
+    pthread_mutex_unlock(&c->lock);
+    return res;
+}
+
+/**
+ * @brief Hands both full magazines' worth of room back: the previous
+ *        magazine goes to the depot and an empty one is loaded.
+ *
+ * @return 0 if the loaded magazine now has room, -1 if out of memory.
+ */
+static int drain(slab_cache *c, slab_tcache *tc) {
+    pthread_mutex_lock(&c->lock);
+    publish(c, tc);
+
+    slab_magazine *mag = spare_magazine(c);
+    if (mag) {
+        if (tc->previous) depot_put(c, tc->previous);
+        tc->previous = tc->loaded;
+        tc->loaded = mag;
+    }
+
+    pthread_mutex_unlock(&c->lock);
+    return mag ? 0 : -1;
+}
+
+void *slab_alloc(slab_cache *c) {
+    int id = register_cache(c);
+    if (id < 0) return malloc(c->obj_size);
+
+    slab_tcache *tc = thread_cache(id);
+    if (!tc->loaded || tc->loaded->count == 0) {
+        if (tc->previous && tc->previous->count > 0) {
+            slab_magazine *tmp = tc->loaded;
+            tc->loaded = tc->previous;
+            tc->previous = tmp;
+        } else if (refill(c, tc) != 0) {
+            return NULL;
+        }
+    }
+
+    tc->in_use_delta++;
+    return tc->loaded->objs[--tc->loaded->count];
+}
+
+/**
+ * @brief Returns an object obtained from slab_alloc() on the same cache.
+ *
+ * Any thread may free any object.
+ */
+void slab_free(slab_cache *c, void *obj) {
+    if (!obj) return;
+
+    int id = __atomic_load_n(&c->id, __ATOMIC_ACQUIRE);
+    if (id < 0) {
+        free(obj);
+        return;
+    }
+
+    slab_tcache *tc = thread_cache(id);
+    if (!tc->loaded || tc->loaded->count == SLAB_MAGAZINE_SIZE) {
+        if (tc->loaded && tc->previous && tc->previous->count < SLAB_MAGAZINE_SIZE) {
+            slab_magazine *tmp = tc->loaded;
+            tc->loaded = tc->previous;
+            tc->previous = tmp;
+        } else if (drain(c, tc) != 0) {
+            // no memory for a magazine: keep the object out of circulation
+            // rather than lose track of whose it is
+            tc->in_use_delta--;
+            return;
+        }
+    }
+
+    tc->in_use_delta--;
+    tc->loaded->objs[tc->loaded->count++] = obj;
+}
+
+/**
+ * @brief Returns the calling thread's magazines to the depots.
+ *
+ * Runs automatically when a thread exits; call it directly before a thread
+ * goes idle for a long time.
+ */
+void slab_flush_thread(void) {
+    pthread_mutex_lock(&registry_lock);
+    int count = cache_count;
+    pthread_mutex_unlock(&registry_lock);
+
+    for (int i = 0; i < count; i++) {
+        slab_cache *c = caches[i];
+        slab_tcache *tc = &tcaches[i];
+
+        pthread_mutex_lock(&c->lock);
+        publish(c, tc);
+        if (tc->loaded) depot_put(c, tc->loaded);
+        if (tc->previous) depot_put(c, tc->previous);
+        tc->loaded = NULL;
+        tc->previous = NULL;
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+/**
+ * @brief Reports usage of every registered cache.
+ *
+ * in_use counts what threads have published, so it can lag by up to two
+ * magazines per active thread.
+ *
+ * @return Number of entries written to stats.
+ */
+int slab_get_stats(slab_stats_t *stats, int max) {
+    pthread_mutex_lock(&registry_lock);
+    int count = cache_count < max ? cache_count : max;
+
+    for (int i = 0; i < count; i++) {
+        slab_cache *c = caches[i];
+        slab_stats_t *s = &stats[i];
+
+        pthread_mutex_lock(&c->lock);
+        s->name = c->name;
+        s->obj_size = c->obj_size;
+        s->slabs = c->slabs;
+        s->objects = c->slabs * (SLAB_SIZE / c->obj_size);
+        s->in_use = c->in_use > 0 ? (size_t)c->in_use : 0;
+        if (s->in_use > s->objects) s->in_use = s->objects;
+        pthread_mutex_unlock(&c->lock);
+
+        s->free_objects = s->objects - s->in_use;
+        s->fragmentation = s->objects ? (double)s->free_objects / (double)s->objects : 0.0;
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    return count;
+}
@@ -0,0 +1,49 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define SLAB_SIZE (64 * 1024)
+#define SLAB_MAGAZINE_SIZE 64
+#define SLAB_MAX_CACHES 8
+
+struct slab_magazine;
+
+/*
+ * Pool of fixed-size objects. Define one per object type with
+ * SLAB_CACHE_INIT; it registers itself on first use.
+ */
+typedef struct {
+    const char *name;
+    size_t obj_size;
+    int id;                        // index into the per-thread caches, -1 until registered
+    pthread_mutex_t lock;          // guards everything below
+    struct slab_magazine *full;    // depot of magazines holding free objects
+    struct slab_magazine *empty;   // depot of spare magazines
+    char *carve_pos;               // next never-used object of the newest slab
+    size_t carve_left;
+    size_t slabs;
+    size_t depot_objects;          // free objects in the depot
+    long in_use;                   // objects handed out, as last published by threads
+} slab_cache;
+
+#define SLAB_CACHE_INIT(cache_name, size) \
+    { .name = (cache_name), .obj_size = (size), .id = -1, .lock = PTHREAD_MUTEX_INITIALIZER }
+
+typedef struct {
+    const char *name;
+    size_t obj_size;
+    size_t slabs;
+    size_t objects;         // capacity of all slabs
+    size_t in_use;
+    size_t free_objects;    // objects reserved in slabs but not in use
+    double fragmentation;   // free_objects / objects
+} slab_stats_t;
+
+void *slab_alloc(slab_cache *c);
+void slab_free(slab_cache *c, void *obj);
+void slab_flush_thread(void);
+int slab_get_stats(slab_stats_t *stats, int max);
+
+#endif
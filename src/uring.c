@@ -0,0 +1,548 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uring.h"
+#include "server_utils.h"
+#include "logs.h"
+#include "clients.h"
+#include "errors.h"
+
+/*
+ * io_uring event loop, used by IO_BACKEND=uring in place of the epoll one.
+ *
+ * Instead of a readiness wait followed by a system call per accept, read and
+ * write, every operation is queued on the submission ring and its result read
+ * from the completion ring, so one io_uring_enter() per loop iteration both
+ * submits the work queued while handling the last batch and waits for more:
+ *
+ * - one multishot accept on the listening socket completes once per new
+ *   connection until it is cancelled;
+ * - one multishot recv per connection completes once per read, into a buffer
+ *   the kernel picks from a registered ring of provided buffers, so idle
+ *   connections hold no read buffer in the kernel;
+ * - the replies to each read are sent with one sendmsg() over the blocks of
+ *   the connection's reply buffer. Replies produced while a send is in flight
+ *   collect in a second buffer and go out when it completes.
+ *
+ * Commands go through input_buffer_dispatch(), like the other backends.
+ * A client whose unsent replies pass the output buffer limits, or that stays
+ * idle past the timeout, is shut down, which fails the send still waiting on
+ * it; idle timeouts and expired soft limits are found by a sweep once a second.
+ *
+ * The ring is driven with raw system calls, so there is no liburing
+ * dependency. It needs Linux 6.0 or later (multishot recv); uring_run()
+ * fails without touching the listener on older kernels and the caller falls
+ * back to epoll.
+ */
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#endif
+#endif
+
+#ifdef IORING_RECV_MULTISHOT
+
+#define URING_ENTRIES 1024
+#define URING_BUFS 256                 // provided receive buffers, a power of two
+#define URING_BUF_SIZE INPUT_BUFFER_SIZE
+#define URING_BUF_GROUP 0
+#define URING_TICK_NS 100000000LL      // how often the loop rechecks *running
+
+// Operation of a completion, kept in the low bits of its user_data next to
+// the connection pointer.
+enum { OP_ACCEPT = 1, OP_RECV = 2, OP_SEND = 3 };
+#define OP_MASK 3ULL
+
+typedef struct uring_conn uring_conn;
+
+struct uring_conn {
+    int fd;
+    input_buffer_t in;
+    reply_t out;                         // replies not yet being sent
+    reply_t sending;                     // replies of the send in flight
+    size_t sent;                         // bytes of sending already written
+    struct iovec iov[REPLY_MAX_IOV];
+    struct msghdr msg;
+    bool recv_armed;
+    bool send_armed;
+    bool closing;
+    time_t last_active;                  // last read or write
+    time_t soft_since;                   // over the soft output limit since, or 0
+    uring_conn *prev;
+    uring_conn *next;
+};
+
+typedef struct {
+    int ring_fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+
+    struct io_uring_buf_ring *buf_ring;
+    char *bufs;
+    unsigned short buf_tail;
+
+    int listenfd;
+    bool accept_armed;
+    io_thread_stats_t *stats;
+    uring_conn *conns; // every connection not yet freed
+    time_t now;        // read once per loop iteration
+} uring;
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_close(uring *u) {
+    if (u->bufs) free(u->bufs);
+    if (u->buf_ring) munmap(u->buf_ring, URING_BUFS * sizeof(struct io_uring_buf));
+    if (u->sqes) munmap(u->sqes, u->sqes_size);
+    if (u->ring_ptr) munmap(u->ring_ptr, u->ring_size);
+    close(u->ring_fd);
+}
+
+// Multishot recv arrived in the same release as IORING_OP_SEND_ZC, which the
+// probe can report, unlike flags.
+static bool ring_has_multishot_recv(int ring_fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) return false;
+
+    bool ok = sys_register(ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+              probe->last_op >= IORING_OP_SEND_ZC &&
+              (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return ok;
+}
+
+static void buf_recycle(uring *u, unsigned short bid) {
+    struct io_uring_buf *buf = &u->buf_ring->bufs[u->buf_tail & (URING_BUFS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * URING_BUF_SIZE);
+    buf->len = URING_BUF_SIZE;
+    buf->bid = bid;
+    u->buf_tail++;
+    __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Creates the ring, maps it and registers the provided buffers.
+ *
+ * @return 0 on success, -1 if the kernel lacks io_uring or a feature the loop needs.
+ */
+static int ring_open(uring *u) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->ring_fd = sys_setup(URING_ENTRIES, &p);
+    if (u->ring_fd < 0) return -1;
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG) ||
+        !ring_has_multishot_recv(u->ring_fd)) {
+        close(u->ring_fd);
+        return -1;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    u->ring_ptr = mmap(NULL, u->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    if (u->ring_ptr == MAP_FAILED) {
+        u->ring_ptr = NULL;
+        ring_close(u);
+        return -1;
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        ring_close(u);
+        return -1;
+    }
+
+    char *ring = u->ring_ptr;
+    u->sq_head = (unsigned *)(ring + p.sq_off.head);
+    u->sq_tail = (unsigned *)(ring + p.sq_off.tail);
+    u->sq_mask = *(unsigned *)(ring + p.sq_off.ring_mask);
+    u->sq_entries = p.sq_entries;
+    u->sq_array = (unsigned *)(ring + p.sq_off.array);
+    u->cq_head = (unsigned *)(ring + p.cq_off.head);
+    u->cq_tail = (unsigned *)(ring + p.cq_off.tail);
+    u->cq_mask = *(unsigned *)(ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+
+    // the buffer ring must be page aligned; an anonymous mapping is
+    u->buf_ring = mmap(NULL, URING_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->bufs = malloc((size_t)URING_BUFS * URING_BUF_SIZE);
+    if (u->buf_ring == MAP_FAILED || !u->bufs) {
+        if (u->buf_ring == MAP_FAILED) u->buf_ring = NULL;
+        ring_close(u);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->buf_ring;
+    reg.ring_entries = URING_BUFS;
+    reg.bgid = URING_BUF_GROUP;
+    if (sys_register(u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        ring_close(u);
+        return -1;
+    }
+    for (unsigned short i = 0; i < URING_BUFS; i++) buf_recycle(u, i);
+    return 0;
+}
+
+// SQEs queued and not yet consumed by the kernel.
+static unsigned ring_pending(const uring *u) {
+    return *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Submits the queued SQEs and waits up to a tick for a completion.
+ *
+ * @return 0, or -1 if the ring failed.
+ */
+static int ring_submit_and_wait(uring *u) {
+    struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = URING_TICK_NS };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    int res = sys_enter(u->ring_fd, ring_pending(u), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    iostats_add(&u->stats->syscalls, 1);
+    if (res < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        log_error("io_uring_enter failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Returns a zeroed SQE, submitting the queued ones first if the ring is full.
+static struct io_uring_sqe *ring_get_sqe(uring *u) {
+    while (ring_pending(u) >= u->sq_entries) {
+        sys_enter(u->ring_fd, ring_pending(u), 0, 0, NULL, 0);
+        iostats_add(&u->stats->syscalls, 1);
+    }
+
+    unsigned tail = *u->sq_tail;
+
+    unsigned index = tail & u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static void arm_accept(uring *u) {
+    struct io_uring_sqe *sqe = ring_get_sqe(u);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = u->listenfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = OP_ACCEPT;
+    u->accept_armed = true;
+}
+
+static void arm_recv(uring *u, uring_conn *conn) {
+    struct io_uring_sqe *sqe = ring_get_sqe(u);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_RECV;
+    conn->recv_armed = true;
+}
+
+// Sends what is left of conn->sending.
+static void arm_send(uring *u, uring_conn *conn) {
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = (size_t)reply_iov(&conn->sending, conn->sent, conn->iov, REPLY_MAX_IOV);
+
+    struct io_uring_sqe *sqe = ring_get_sqe(u);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&conn->msg;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_SEND;
+    conn->send_armed = true;
+}
+
+// Starts sending the pending replies unless a send is already in flight.
+static void conn_send(uring *u, uring_conn *conn) {
+    if (conn->send_armed || conn->out.len == 0) return;
+
+    reply_t swap = conn->sending;
+    conn->sending = conn->out;
+    conn->out = swap;
+    conn->sent = 0;
+    arm_send(u, conn);
+}
+
+// Closes the connection once the replies already queued have been sent.
+// Shutting the socket down completes the recv still armed; the connection is
+// freed when no operation is left in flight.
+static void conn_close(uring *u, uring_conn *conn) {
+    if (!conn->closing) {
+        conn->closing = true;
+        iostats_add(&u->stats->connections, -1);
+        clients_release();
+    }
+    if (conn->send_armed) return; // on_send comes back here
+    if (conn->recv_armed) {
+        shutdown(conn->fd, SHUT_RDWR); // on_recv comes back here
+        return;
+    }
+
+    close(conn->fd);
+    input_buffer_free(&conn->in);
+    reply_free(&conn->out);
+    reply_free(&conn->sending);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        u->conns = conn->next;
+    }
+    if (conn->next) conn->next->prev = conn->prev;
+    free(conn);
+}
+
+// Drops the replies not yet sent and closes the connection now. The shutdown
+// fails a send the client is not reading.
+static void conn_evict(uring *u, uring_conn *conn) {
+    reply_reset(&conn->out);
+    shutdown(conn->fd, SHUT_RDWR);
+    conn_close(u, conn);
+}
+
+// Reply bytes queued or in flight and not yet taken by the socket.
+static size_t conn_pending(const uring_conn *conn) {
+    return conn->out.len + conn->sending.len - conn->sent;
+}
+
+static void on_accept(uring *u, const struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) u->accept_armed = false;
+    if (cqe->res < 0) {
+        if (cqe->res != -ECONNABORTED && cqe->res != -EINTR) {
+            log_error("Error accepting connection: %s", strerror(-cqe->res));
+        }
+        return;
+    }
+
+    int fd = cqe->res;
+    if (!clients_admit()) {
+        reject_client(fd, EXTRACT_ERR_MAX_CLIENTS);
+        return;
+    }
+    uring_conn *conn = malloc(sizeof(uring_conn));
+    if (!conn) {
+        close(fd);
+        clients_release();
+        return;
+    }
+    set_nodelay(fd);
+    conn->fd = fd;
+    input_buffer_init(&conn->in);
+    reply_init(&conn->out);
+    reply_init(&conn->sending);
+    conn->sent = 0;
+    conn->recv_armed = false;
+    conn->send_armed = false;
+    conn->closing = false;
+    conn->last_active = u->now;
+    conn->soft_since = 0;
+    conn->prev = NULL;
+    conn->next = u->conns;
+    if (u->conns) u->conns->prev = conn;
+    u->conns = conn;
+    iostats_add(&u->stats->accepted, 1);
+    iostats_add(&u->stats->connections, 1);
+    arm_recv(u, conn);
+}
+
+static void on_recv(uring *u, uring_conn *conn, const struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) conn->recv_armed = false;
+
+    if (cqe->res <= 0) {
+        // out of provided buffers: the multishot recv stopped, start another
+        if (cqe->res == -ENOBUFS && !conn->closing) {
+            if (!conn->recv_armed) arm_recv(u, conn);
+            return;
+        }
+        conn_close(u, conn);
+        return;
+    }
+
+    unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    if (!conn->closing) {
+        const char *data = u->bufs + (size_t)bid * URING_BUF_SIZE;
+        size_t left = (size_t)cqe->res;
+        iostats_add(&u->stats->bytes_in, cqe->res);
+        conn->last_active = u->now;
+
+        // the input buffer always has room after a dispatch, so this ends
+        while (left > 0 && !conn->in.failed) {
+            size_t avail;
+            char *space = input_buffer_space(&conn->in, &avail);
+            size_t n = left < avail ? left : avail;
+            memcpy(space, data, n);
+            iostats_add(&u->stats->commands, input_buffer_dispatch(&conn->out, &conn->in, n));
+            data += n;
+            left -= n;
+        }
+    }
+    buf_recycle(u, bid);
+
+    if (conn->out.failed) {
+        reply_reset(&conn->out); // incomplete, the client could not match it to commands
+        conn_close(u, conn);
+    } else if (conn->closing) {
+        conn_close(u, conn);
+    } else if (conn->in.failed) {
+        conn_send(u, conn); // the error reply goes out before the close
+        conn_close(u, conn);
+    } else {
+        conn_send(u, conn);
+        if (clients_output_exceeded(conn_pending(conn), u->now, &conn->soft_since)) {
+            clients_count_evicted();
+            conn_evict(u, conn);
+        } else if (!conn->recv_armed) {
+            arm_recv(u, conn);
+        }
+    }
+}
+
+static void on_send(uring *u, uring_conn *conn, const struct io_uring_cqe *cqe) {
+    conn->send_armed = false;
+    if (cqe->res < 0) {
+        reply_reset(&conn->sending);
+        reply_reset(&conn->out);
+        conn_close(u, conn);
+        return;
+    }
+
+    conn->sent += (size_t)cqe->res;
+    conn->last_active = u->now;
+    if (conn->sent < conn->sending.len) {
+        arm_send(u, conn); // short write: send the rest
+        return;
+    }
+    reply_reset(&conn->sending);
+    conn_send(u, conn);
+    if (conn->closing) conn_close(u, conn);
+}
+
+// Evicts the connections that have been idle too long or over the soft output
+// limit for too long; both can expire while no completion arrives for them.
+static void sweep(uring *u) {
+    uring_conn *conn = u->conns;
+    while (conn) {
+        uring_conn *next = conn->next; // an eviction may free conn
+        if (conn->closing) {
+            // already on its way out
+        } else if (clients_idle_expired(conn->last_active, u->now)) {
+            clients_count_timed_out();
+            conn_evict(u, conn);
+        } else if (clients_output_exceeded(conn_pending(conn), u->now, &conn->soft_since)) {
+            clients_count_evicted();
+            conn_evict(u, conn);
+        }
+        conn = next;
+    }
+}
+
+/**
+ * @brief Serves connections on listenfd with io_uring until *running is cleared.
+ *
+ * @param listenfd Bound and listening socket.
+ * @param stats    Counters for this thread, or NULL to keep none.
+ * @param running  Checked at least every 100 ms.
+ * @return 0 on shutdown, URING_UNSUPPORTED if the kernel cannot run the loop
+ *         (nothing was done with listenfd), -1 if the ring failed later.
+ */
+int uring_run(int listenfd, io_thread_stats_t *stats, volatile sig_atomic_t *running) {
+    io_thread_stats_t unregistered = { .cpu = -1 };
+    uring u;
+    memset(&u, 0, sizeof(u));
+    u.listenfd = listenfd;
+    u.stats = stats ? stats : &unregistered;
+
+    if (ring_open(&u) != 0) return URING_UNSUPPORTED;
+    iostats_set_backend(u.stats, "uring");
+
+    int res = 0;
+    u.now = time(NULL);
+    time_t last_sweep = u.now;
+    arm_accept(&u);
+    while (*running) {
+        if (ring_submit_and_wait(&u) != 0) {
+            res = -1;
+            break;
+        }
+        u.now = time(NULL);
+
+        unsigned head = *u.cq_head;
+        unsigned tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &u.cqes[head & u.cq_mask];
+            uring_conn *conn = (uring_conn *)(uintptr_t)(cqe->user_data & ~OP_MASK);
+            switch (cqe->user_data & OP_MASK) {
+                case OP_ACCEPT: on_accept(&u, cqe); break;
+                case OP_RECV:   on_recv(&u, conn, cqe); break;
+                case OP_SEND:   on_send(&u, conn, cqe); break;
+                default: break;
+            }
+        }
+        __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+
+        if (!u.accept_armed && *running) arm_accept(&u);
+        if (u.now != last_sweep) {
+            last_sweep = u.now;
+            sweep(&u);
+        }
+    }
+
+    // connections still open are closed with the process
+    ring_close(&u);
+    return res;
+}
+
+#else
+
+int uring_run(int listenfd, io_thread_stats_t *stats, volatile sig_atomic_t *running) {
+    (void)listenfd;
+    (void)stats;
+    (void)running;
+    return URING_UNSUPPORTED;
+}
+
+#endif
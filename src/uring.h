@@ -0,0 +1,12 @@
+#ifndef URING_H
+#define URING_H
+
+#include <signal.h>
+
+#include "iostats.h"
+
+#define URING_UNSUPPORTED 1 // uring_run() result when the kernel cannot run the loop
+
+int uring_run(int listenfd, io_thread_stats_t *stats, volatile sig_atomic_t *running);
+
+#endif
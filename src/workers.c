@@ -0,0 +1,138 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "workers.h"
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void *(*handler)(void *);
+    int *queue; // ring of client fds
+    int head;
+    int count;
+    int depth;
+    int threads;
+    int max_threads;
+    int idle;   // workers waiting for a connection
+    unsigned long accepted;
+    unsigned long delayed;
+    unsigned long rejected;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .not_full = PTHREAD_COND_INITIALIZER,
+};
+
+static void* worker_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    while (1) {
+        pool.idle++;
+        while (pool.count == 0) {
+            pthread_cond_wait(&pool.not_empty, &pool.lock);
+        }
+        pool.idle--;
+
+        int clientfd = pool.queue[pool.head];
+        pool.head = (pool.head + 1) % pool.depth;
+        pool.count--;
+        pthread_cond_signal(&pool.not_full);
+        pthread_mutex_unlock(&pool.lock);
+
+        pool.handler((void *)(intptr_t)clientfd);
+
+        pthread_mutex_lock(&pool.lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Sets up the pool; handler is run on a worker with each submitted fd.
+ *
+ * Workers start on demand, when a connection is queued and none is idle, and
+ * then stay for the life of the process.
+ *
+ * @return 0 on success, -1 if the queue could not be allocated.
+ */
+int workers_init(int max_threads, int queue_depth, void *(*handler)(void *)) {
+    pool.queue = malloc(sizeof(int) * (size_t)queue_depth);
+    if (!pool.queue) return -1;
+
+    pool.depth = queue_depth;
+    pool.max_threads = max_threads;
+    pool.handler = handler;
+    return 0;
+}
+
+/**
+ * @brief Queues an accepted connection for a worker.
+ *
+ * When the queue is full, waits up to WORKERS_ADMISSION_WAIT_MS for a worker
+ * to take one, so a short burst is delayed rather than refused.
+ *
+ * @return 0 if the connection was queued, -1 if it was rejected; the caller
+ *         still owns a rejected fd.
+ */
+int workers_submit(int clientfd) {
+    pthread_mutex_lock(&pool.lock);
+
+    if (pool.count == pool.depth) {
+        pool.delayed++;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += WORKERS_ADMISSION_WAIT_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (pool.count == pool.depth) {
+            if (pthread_cond_timedwait(&pool.not_full, &pool.lock, &deadline) == ETIMEDOUT) break;
+        }
+        if (pool.count == pool.depth) {
+            pool.rejected++;
+            pthread_mutex_unlock(&pool.lock);
+            return -1;
+        }
+    }
+
+    pool.queue[(pool.head + pool.count) % pool.depth] = clientfd;
+    pool.count++;
+
+    if (pool.idle < pool.count && pool.threads < pool.max_threads) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, worker_main, NULL) == 0) {
+            pthread_detach(tid);
+            pool.threads++;
+        } else if (pool.threads == 0) {
+            // nobody would ever take it
+            pool.count--;
+            pool.rejected++;
+            pthread_mutex_unlock(&pool.lock);
+            return -1;
+        }
+    }
+
+    pool.accepted++;
+    pthread_cond_signal(&pool.not_empty);
+    pthread_mutex_unlock(&pool.lock);
+    return 0;
+}
+
+void workers_stats(worker_pool_stats_t *out) {
+    pthread_mutex_lock(&pool.lock);
+    out->threads = pool.threads;
+    out->max_threads = pool.max_threads;
+    out->busy = pool.threads - pool.idle;
+    out->queued = pool.count;
+    out->queue_depth = pool.depth;
+    out->accepted = pool.accepted;
+    out->delayed = pool.delayed;
+    out->rejected = pool.rejected;
+    pthread_mutex_unlock(&pool.lock);
+}
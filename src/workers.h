@@ -0,0 +1,25 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#define WORKERS_ADMISSION_WAIT_MS 50 // how long workers_submit() waits for room in a full queue
+
+/*
+ * Bounded pool serving IO_BACKEND=threads: accepted connections wait in a
+ * queue of fixed depth and up to max_threads workers serve one each.
+ */
+typedef struct {
+    int threads;            // started so far, never more than max_threads
+    int max_threads;
+    int busy;               // serving a connection
+    int queued;             // waiting for a worker
+    int queue_depth;
+    unsigned long accepted; // connections queued
+    unsigned long delayed;  // submissions that found the queue full and waited
+    unsigned long rejected; // submissions still facing a full queue after the wait
+} worker_pool_stats_t;
+
+int workers_init(int max_threads, int queue_depth, void *(*handler)(void *));
+int workers_submit(int clientfd);
+void workers_stats(worker_pool_stats_t *out);
+
+#endif
@@ -2,11 +2,15 @@
 
 SERVER_BIN=bin/server
 CLIENT_BIN=bin/client
+SOCKET_PATH=/tmp/kv-integration-$$.sock
 
 echo "🚀 Starting integration tests..."
 NCOPTS=$1
 
-$SERVER_BIN &
+# small enough that the oversized request test stays quick
+export MAX_REQUEST_SIZE=256kb
+
+UNIX_SOCKET=$SOCKET_PATH $SERVER_BIN &
 SERVER_PID=$!
 sleep 1
 restart_server() {
@@ -14,7 +18,7 @@ restart_server() {
   kill $SERVER_PID
   wait $SERVER_PID
   sleep 1
-  $SERVER_BIN &
+  UNIX_SOCKET=$SOCKET_PATH $SERVER_BIN &
   SERVER_PID=$!
   sleep 1
 }
@@ -27,7 +31,7 @@ fail() {
 }
 
 assert_contains() {
-    echo "$1" | tr -d '\r' | grep -Fq "$2" || fail "$3"
+    echo "$1" | tr -d '\r' | grep -Fq -- "$2" || fail "$3"
 }
 
 # -------- TEST CASES DEFINITION --------
@@ -44,8 +48,11 @@ test_cases=(
     'TIME | 20 | TIME did not return expected format'
     'INFO | Uptime: | INFO did not return uptime'
     'INFO | Memory: | INFO did not return memory'
+    'INFO | used_memory: | INFO did not return used memory'
     'INFO | Keys: | INFO did not return keys'
     'INFO | Version: | INFO did not return version'
+    'INFO | Load factor: | INFO did not return load factor'
+    'INFO | Slabs: | INFO did not return slab stats'
     'MSET k1 v1 k2 v2 k3 v3 | OK | MSET did not return OK'
     'MGET k1 k2 k3 | 1) v1 | MGET k1 failed'
     'MGET k1 k2 k3 | 2) v2 | MGET k2 failed'
@@ -82,13 +89,34 @@ test_cases=(
     'GET myhash | not found | GET on hash key did not return not found'
     'SET myhash fail | ERROR parse error | SET on hash key did not return parse error'
     "SET $VERY_LONG_KEY value | ERROR | SET with very long key did not return ERROR"
-    "SET test $VERY_LONG_VALUE | ERROR | SET with very long value did not return ERROR"
+    "SET test $VERY_LONG_VALUE | OK | SET with a value over 1 KB did not return OK"
     'HSET myhash fieldx valx | 1 | HSET for TYPE test failed'
     'TYPE myhash | hash | TYPE on hash did not return hash'
     'DEL nonexistent_key | not found | DEL nonexistent key did not return not found'
+    'SET del1 v | OK | SET for DEL of several keys failed'
+    'DEL del1 nonexistent_key | DELETED | DEL of several keys did not return DELETED'
     'HINCRBY newneg counter -42 | 42 | HINCRBY new field negative did not return -42'
     'HINCRBY newneg counter 0 | 42 | HINCRBY increment 0 did not return same value'
+    'INCR visits | 1 | INCR new key did not return 1'
+    'INCRBY visits 41 | 42 | INCRBY did not return 42'
+    'DECR visits | 41 | DECR did not return 41'
+    'GET visits | 41 | GET counter did not return 41'
+    'INCRBYFLOAT visits 0.5 | 41.5 | INCRBYFLOAT did not return 41.5'
+    'INCR visits | ERROR value is not an integer | INCR on a float did not fail'
+    'HINCRBYFLOAT newneg ratio 2.25 | 2.25 | HINCRBYFLOAT new field did not return 2.25'
+    'INCR type_test | ERROR value is not an integer | INCR on text did not fail'
     'SET sss abc | OK | SET for HMGET test failed'
+    'SET ttlkey v EX 100 | OK | SET EX did not return OK'
+    'GET ttlkey | v | GET after SET EX did not return the value'
+    'TTL ttlkey | 100 | TTL did not return the remaining seconds'
+    'PERSIST ttlkey | 1 | PERSIST did not return 1'
+    'TTL ttlkey | -1 | TTL without expiry did not return -1'
+    'PEXPIRE ttlkey 100000 | 1 | PEXPIRE did not return 1'
+    'EXPIRE missing_ttl 10 | 0 | EXPIRE missing key did not return 0'
+    'TTL missing_ttl | -2 | TTL missing key did not return -2'
+    'INFO | expired_keys: | INFO did not return expired keys'
+    'INFO | evicted_keys: | INFO did not return evicted keys'
+    'INFO | io_threads: | INFO did not return I/O thread stats'
 #    'HMGET sss field1 | ERROR parse error | HMGET on string key did not return parse error'
     'BLAH foo bar | ERROR | Unknown command did not return error'
     'MGET missing1 missing2 missing3\n | 1) (nil) | MGET all missing key1 failed'
@@ -132,6 +160,47 @@ run_nc_tests() {
     done
 }
 
+# RESP2 requests, written with printf escapes, and a reply they must contain
+resp_test_cases=(
+    '*1\r\n$4\r\nPING\r\n | +PONG | RESP PING did not return +PONG'
+    '*3\r\n$3\r\nSET\r\n$4\r\nresp\r\n$8\r\na "b"\r\nc\r\n*2\r\n$3\r\nGET\r\n$4\r\nresp\r\n | $8 | RESP GET did not return the binary value'
+    '*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n | $-1 | RESP GET of a missing key did not return a null bulk'
+    '*2\r\n$3\r\nDEL\r\n$4\r\nresp\r\n | :1 | RESP DEL did not return :1'
+    '*1\r\n$4\r\nNOPE\r\n | -ERR unknown command | RESP unknown command did not return an error'
+    '*1\r\n$5\r\nMULTI\r\n*3\r\n$3\r\nSET\r\n$2\r\ntx\r\n$1\r\n1\r\n*2\r\n$4\r\nINCR\r\n$2\r\ntx\r\n*1\r\n$4\r\nEXEC\r\n | *2 | RESP EXEC did not return the replies of the transaction'
+)
+
+run_resp_tests() {
+    echo "🔷 Running RESP tests..."
+    for entry in "${resp_test_cases[@]}"; do
+        IFS="|" read -r cmd expected desc <<< "$entry"
+        cmd=$(echo "$cmd" | sed 's/ *$//')
+        expected=$(echo "$expected" | xargs)
+        desc=$(echo "$desc" | xargs)
+
+        echo "👉 RESP: $cmd → expecting: '$expected'"
+
+        printf "$cmd" | nc ${NCOPTS} 127.0.0.1 8080 > nc_out.txt
+        output=$(cat nc_out.txt)
+        assert_contains "$output" "$expected" "$desc"
+    done
+}
+
+run_transaction_tests() {
+    echo "🔷 Running transaction tests..."
+    printf 'MULTI\nSET txkey 1\nINCR txkey\nHINCRBY txhash n 5\nEXEC\n' | nc ${NCOPTS} 127.0.0.1 8080 > nc_out.txt
+    assert_contains "$(cat nc_out.txt)" "QUEUED" "Commands after MULTI were not queued"
+    assert_contains "$(cat nc_out.txt)" "RESPONSE OK EXEC" "EXEC did not return the transaction's replies"
+    output=$($CLIENT_BIN GET txkey)
+    assert_contains "$output" "2" "EXEC did not run the queued commands"
+
+    printf 'MULTI\nSET txkey 10\nDISCARD\n' | nc ${NCOPTS} 127.0.0.1 8080 > nc_out.txt
+    output=$($CLIENT_BIN GET txkey)
+    assert_contains "$output" "2" "DISCARD did not drop the queued commands"
+    output=$($CLIENT_BIN EXEC)
+    assert_contains "$output" "ERROR no transaction" "EXEC without MULTI did not fail"
+}
+
 SKIP_INTERACTIVE_FOR=(
     "SET test $VERY_LONG_VALUE"
     "BLAH foo bar"
@@ -168,17 +237,59 @@ EOF
     done
 }
 
+run_unix_socket_tests() {
+    echo "🔷 Running Unix socket tests..."
+    output=$($CLIENT_BIN -s "$SOCKET_PATH" SET unixkey unixval)
+    assert_contains "$output" "OK" "SET over the Unix socket"
+    output=$($CLIENT_BIN -s "$SOCKET_PATH" GET unixkey)
+    assert_contains "$output" "unixval" "GET over the Unix socket"
+    output=$($CLIENT_BIN GET unixkey)
+    assert_contains "$output" "unixval" "TCP sees a key set over the Unix socket"
+}
+
+run_large_request_tests() {
+    echo "🔷 Running large request tests..."
+    local big_value
+    big_value=$(head -c 100000 < /dev/zero | tr '\0' 'C')
+    output=$($CLIENT_BIN SET bigkey "$big_value")
+    assert_contains "$output" "OK" "SET of a 100 KB value did not return OK"
+    output=$($CLIENT_BIN GET bigkey | tr -d '\n')
+    assert_contains "$output" "$big_value" "GET did not return the 100 KB value"
+
+    local mset="MSET" mget="MGET"
+    for i in $(seq 1 3000); do
+        mset+=" batch$i v$i"
+        mget+=" batch$i"
+    done
+    printf '%s\n' "$mset" | nc ${NCOPTS} 127.0.0.1 8080 > nc_out.txt
+    assert_contains "$(cat nc_out.txt)" "OK" "MSET of 3000 keys did not return OK"
+    printf '%s\n' "$mget" | nc ${NCOPTS} 127.0.0.1 8080 > nc_out.txt
+    assert_contains "$(cat nc_out.txt)" "3000) v3000" "MGET of 3000 keys did not return the last one"
+
+    local huge
+    huge=$(head -c 300000 < /dev/zero | tr '\0' 'D')
+    # stdin stays open a moment so nc does not quit before the PONG arrives
+    { printf 'SET huge %s\nPING\n' "$huge"; sleep 0.5; } | nc ${NCOPTS} 127.0.0.1 8080 > nc_out.txt
+    assert_contains "$(cat nc_out.txt)" "ERROR line too long" "A request over MAX_REQUEST_SIZE was not refused"
+    assert_contains "$(cat nc_out.txt)" "PONG" "The command after an oversized request was not run"
+}
+
 # -------- EXECUTE TESTS --------
 
 run_cmd_tests
 restart_server
 run_nc_tests
+run_resp_tests
+run_transaction_tests
 restart_server
 run_interactive_tests
+run_unix_socket_tests
+run_large_request_tests
 
 # Done
 kill $SERVER_PID
 wait $SERVER_PID
+[ -e "$SOCKET_PATH" ] && fail "Unix socket left behind on shutdown"
 rm -f nc_out.txt
 
 echo "✅ All integration tests passed!"
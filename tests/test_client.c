@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include "../src/client_utils.h"
 
 #define BUFFER_SIZE 1024
@@ -43,7 +46,7 @@ void test_empty_buffer() {
     assert(result == -1);
 }
 
-void test_send_command_too_long() {
+void test_send_command_bad_socket() {
     int dummy_fd = -1;
     char long_cmd[BUFFER_SIZE + 100];
     memset(long_cmd, 'A', sizeof(long_cmd) - 1);
@@ -53,6 +56,49 @@ void test_send_command_too_long() {
     assert(result == -1);
 }
 
+void test_send_command_long() {
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    // larger than the socket buffer, so it goes out over several writes
+    size_t len = 4 * 1024 * 1024;
+    char *command = malloc(len + 1);
+    memset(command, 'A', len);
+    command[len] = '\0';
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(send_command(fds[0], command) == (int)len + 1 ? 0 : 1);
+    }
+    close(fds[0]);
+
+    size_t received = 0;
+    char buf[65536];
+    char last = 0;
+    ssize_t n;
+    while ((n = recv(fds[1], buf, sizeof(buf), 0)) > 0) {
+        received += (size_t)n;
+        last = buf[n - 1];
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(received == len + 1 && last == '\n');
+
+    close(fds[1]);
+    free(command);
+    printf("✅ test_send_command_long passed\n");
+}
+
+void test_command_string_size() {
+    char *argv[] = { "client", "SET", "key", "a \"quoted\" value" };
+    size_t size = command_string_size(4, argv);
+    char *buffer = malloc(size);
+    assert(build_command_string(4, argv, buffer, size) == 0);
+    assert(strlen(buffer) < size);
+    free(buffer);
+}
+
 void capture_stdout_start(FILE **original_stdout, FILE **tmp_file) {
     *original_stdout = stdout;
     *tmp_file = tmpfile();
@@ -108,14 +154,44 @@ void test_multiple_arguments_with_spaces() {
     assert(strcmp(buffer, "SET key \"val with spaces\"") == 0);
 }
 
+void test_connect_unix() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_client_%d.sock", (int)getpid());
+    unlink(path);
+    assert(connect_unix(path) == -1);
+
+    int listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, path);
+    assert(bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(listenfd, 1) == 0);
+
+    int fd = connect_unix(path);
+    assert(fd >= 0);
+    int serverfd = accept(listenfd, NULL, NULL);
+    assert(send_command(fd, "GET key") == 8);
+    char buf[16] = {0};
+    assert(recv(serverfd, buf, sizeof(buf) - 1, 0) == 8);
+    assert(strcmp(buf, "GET key\n") == 0);
+
+    close(serverfd);
+    close(fd);
+    close(listenfd);
+    unlink(path);
+    printf("✅ test_connect_unix passed\n");
+}
+
 int main() {
     test_single_argument();
     test_multiple_arguments();
     test_long_input_truncates();
     test_empty_buffer();
-    test_send_command_too_long();
+    test_send_command_bad_socket();
+    test_send_command_long();
+    test_command_string_size();
     test_handle_char();
     test_multiple_arguments_with_spaces();
+    test_connect_unix();
     printf("✅ All build_command_string tests passed\n");
     return 0;
 }
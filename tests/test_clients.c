@@ -0,0 +1,61 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "../src/clients.h"
+
+void test_admit() {
+    client_limits_t limits = { .maxclients = 2 };
+    clients_set_limits(&limits);
+
+    assert(clients_admit());
+    assert(clients_admit());
+    assert(!clients_admit());
+    clients_release();
+    assert(clients_admit());
+
+    client_stats_t stats;
+    clients_stats(&stats);
+    assert(stats.connected == 2 && stats.rejected == 1);
+    clients_release();
+    clients_release();
+}
+
+void test_output_limits() {
+    client_limits_t limits = { .output_hard_limit = 1000, .output_soft_limit = 100, .output_soft_seconds = 10 };
+    clients_set_limits(&limits);
+    time_t since = 0;
+
+    assert(!clients_output_exceeded(50, 1000, &since) && since == 0);
+    assert(clients_output_exceeded(1000, 1000, &since));
+
+    // over the soft limit only counts while it lasts
+    assert(!clients_output_exceeded(200, 1000, &since) && since == 1000);
+    assert(!clients_output_exceeded(200, 1009, &since));
+    assert(!clients_output_exceeded(0, 1009, &since) && since == 0);
+    assert(!clients_output_exceeded(200, 1010, &since));
+    assert(clients_output_exceeded(200, 1020, &since));
+
+    limits = (client_limits_t){ 0 };
+    clients_set_limits(&limits);
+    since = 0;
+    assert(!clients_output_exceeded((size_t)1 << 40, 1000, &since));
+}
+
+void test_idle() {
+    client_limits_t limits = { .timeout = 60 };
+    clients_set_limits(&limits);
+    assert(!clients_idle_expired(1000, 1060));
+    assert(clients_idle_expired(1000, 1061));
+
+    limits.timeout = 0;
+    clients_set_limits(&limits);
+    assert(!clients_idle_expired(0, 1000000));
+}
+
+int main() {
+    test_admit();
+    test_output_limits();
+    test_idle();
+    printf("✅ Client limits tests passed\n");
+    return 0;
+}
@@ -1,28 +1,41 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <unistd.h>
 #include <time.h>
 
 #include "../src/commands.h"
 #include "../src/kvstore.h"
 #include "../src/protocol.h"
 #include "../src/errors.h"
+#include "../src/reply.h"
 
 #define BUF_SIZE 1024
+#define TEST_MAX_VAL_LEN 128
 time_t start_time = 0;
 
-void recv_until_end(int fd, char *buf, size_t buf_size) {
-    size_t total_read = 0;
-    while (total_read < buf_size - 1) {
-        ssize_t n = recv(fd, buf + total_read, buf_size - 1 - total_read, 0);
-        if (n <= 0) break;
-        total_read += n;
-        buf[total_read] = '\0';
+// Moves the pending reply into buf as a string.
+void take_reply(reply_t *out, char *buf, size_t buf_size) {
+    reply_copy(out, buf, buf_size);
+    reply_reset(out);
+}
 
-        if (strstr(buf, "END\n")) break;
-    }
+// Runs line with a connection's arguments, which keep its transaction between calls.
+void run_connection_command(reply_t *out, command_args_t *args, const char *line) {
+    char copy[BUF_SIZE];
+    snprintf(copy, sizeof(copy), "%s", line);
+    assert(tokenize_command(copy, args) == EXTRACT_OK);
+    command_t cmd = lookup_command(args->argv[0], args->argv_len[0]);
+    assert(cmd != CMD_UNKNOWN);
+    handle_command(out, cmd, args);
+}
+
+// Tokenizes a copy of line and runs it through handle_command(), as dispatch_command() would.
+void run_command(reply_t *out, const char *line) {
+    command_args_t args;
+    command_args_init(&args);
+    run_connection_command(out, &args, line);
+    command_args_free(&args);
 }
 
 int response_contains(const char *buf, const char *expected_resp) {
@@ -40,38 +53,37 @@ int response_contains(const char *buf, const char *expected_resp) {
 }
 
 void test_cmd_set(const char *cmd_buffer, const char *expected_resp) {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     // Reset the kv store
     kv_init();
 
     // Call cmd_set
-    cmd_set(fds[1], cmd_buffer);
+    run_command(&out, cmd_buffer);
 
     // Read response
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
 
     printf("cmd_set('%s') -> '%s'\n", cmd_buffer, buf);
 
     // Assert
     assert(response_contains(buf, expected_resp));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_send_error_response(int error_code, const char *expected_msg) {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     // Call send_error_response
-    send_error_response(fds[1], error_code);
+    send_error_response(&out, error_code);
 
     // Read response
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
 
     printf("send_error_response(%d) -> '%s'\n", error_code, buf);
 
@@ -84,18 +96,17 @@ void test_send_error_response(int error_code, const char *expected_msg) {
     // Assert footer
     assert(strstr(buf, "END") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_info() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
-    cmd_info(fds[1], "");
+    run_command(&out, "INFO");
 
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
 
     printf("cmd_info() -> '%s'\n", buf);
 
@@ -103,299 +114,494 @@ void test_cmd_info() {
     assert(response_contains(buf, "Memory:"));
     assert(response_contains(buf, "Keys:"));
     assert(response_contains(buf, "Version:"));
+    assert(response_contains(buf, "Load factor:"));
+    assert(response_contains(buf, "maxmemory_policy: noeviction"));
+    assert(response_contains(buf, "evicted_keys:"));
+    assert(response_contains(buf, "io_threads:"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_type() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     // Setup: SET a key
     kv_init();
     kv_set("foo", "bar");
 
     // Test TYPE existing key
-    cmd_type(fds[1], "TYPE foo");
+    run_command(&out, "TYPE foo");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_type() existing key -> '%s'\n", buf);
     assert(response_contains(buf, "string"));
 
     // Test TYPE missing key
-    cmd_type(fds[1], "TYPE missing_key");
+    run_command(&out, "TYPE missing_key");
     memset(buf, 0, sizeof(buf));
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_type() missing key -> '%s'\n", buf);
 
     // Make the test more robust
     assert(strstr(buf, "(nil)") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_ping() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
-    cmd_ping(fds[1], "");
+    run_command(&out, "PING");
 
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
 
     printf("cmd_ping() -> '%s'\n", buf);
     assert(response_contains(buf, "PONG"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_time() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
-    cmd_time(fds[1], "");
+    run_command(&out, "TIME");
 
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
 
     printf("cmd_time() -> '%s'\n", buf);
     assert(response_contains(buf, ":")); // e.g. time string
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_get() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
     kv_set("foo", "bar");
 
-    cmd_get(fds[1], "GET foo");
+    run_command(&out, "GET foo");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_get() -> '%s'\n", buf);
     assert(response_contains(buf, "bar"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_del() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
     kv_set("foo", "bar");
 
-    cmd_del(fds[1], "DEL foo");
+    run_command(&out, "DEL foo");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_del() -> '%s'\n", buf);
     assert(response_contains(buf, "DELETED"));
 
-    close(fds[0]);
-    close(fds[1]);
+    // Several keys, as the registry allows; missing ones are skipped
+    kv_set("a", "1");
+    kv_set("b", "2");
+    run_command(&out, "DEL a missing b");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "DELETED"));
+    assert(kv_get("a") == NULL && kv_get("b") == NULL);
+    run_command(&out, "DEL a b");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, ERR_NOT_FOUND) != NULL);
+
+    reply_free(&out);
 }
 
 void test_cmd_mset_mget() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
-    cmd_mset(fds[1], "MSET k1 v1 k2 v2 k3 v3");
+    run_command(&out, "MSET k1 v1 k2 v2 k3 v3");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_mset() -> '%s'\n", buf);
     assert(response_contains(buf, "OK"));
 
     // Now test MGET
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
-    cmd_mget(fds[1], "MGET k1 k2 k3");
+    run_command(&out, "MGET k1 k2 k3");
 
     char buf2[BUF_SIZE];
-    recv_until_end(fds[0], buf2, sizeof(buf2));
+    take_reply(&out, buf2, sizeof(buf2));
     printf("cmd_mget() -> '%s'\n", buf2);
 
     assert(response_contains(buf2, "1) v1"));
     assert(response_contains(buf2, "2) v2"));
     assert(response_contains(buf2, "3) v3"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_hset_hget() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
-    cmd_hset(fds[1], "HSET myhash field1 value1");
+    run_command(&out, "HSET myhash field1 value1");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hset() -> '%s'\n", buf);
     assert(response_contains(buf, "1"));
 
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
 
-    cmd_hget(fds[1], "HGET myhash field1");
+    run_command(&out, "HGET myhash field1");
     char buf2[BUF_SIZE];
-    recv_until_end(fds[0], buf2, sizeof(buf2));
+    take_reply(&out, buf2, sizeof(buf2));
     printf("cmd_hget() -> '%s'\n", buf2);
     assert(response_contains(buf2, "value1"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_hincrby() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
-    cmd_hincrby(fds[1], "HINCRBY myhash counter 5");
+    run_command(&out, "HINCRBY myhash counter 5");
 
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hincrby() -> '%s'\n", buf);
     assert(response_contains(buf, "5"));
 
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
 
-    cmd_hincrby(fds[1], "HINCRBY myhash counter 3");
+    run_command(&out, "HINCRBY myhash counter 3");
     char buf2[BUF_SIZE];
-    recv_until_end(fds[0], buf2, sizeof(buf2));
+    take_reply(&out, buf2, sizeof(buf2));
     printf("cmd_hincrby() second -> '%s'\n", buf2);
     assert(response_contains(buf2, "8"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
+}
+
+void test_cmd_counters() {
+    reply_t out;
+    reply_init(&out);
+    char buf[BUF_SIZE];
+
+    kv_init();
+    run_command(&out, "INCR hits");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strcmp(buf, "RESPONSE OK STRING\n1\nEND\n") == 0);
+    run_command(&out, "INCRBY hits 41");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "42"));
+    run_command(&out, "DECRBY hits 50");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "-8"));
+    run_command(&out, "DECR hits");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "-9"));
+    run_command(&out, "GET hits");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "-9"));
+
+    run_command(&out, "INCRBYFLOAT hits 0.25");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "-8.75"));
+    run_command(&out, "INCR hits");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR value is not an integer") != NULL);
+    run_command(&out, "INCRBY hits x");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR value is not an integer") != NULL);
+    run_command(&out, "INCRBYFLOAT hits x");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR value is not a valid float") != NULL);
+
+    kv_set("max", "9223372036854775807");
+    run_command(&out, "INCR max");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR increment would overflow") != NULL);
+
+    run_command(&out, "HINCRBYFLOAT myhash ratio 1.5");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "1.5"));
+    run_command(&out, "HINCRBY myhash ratio 1");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR value is not an integer") != NULL);
+    run_command(&out, "INCR myhash");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR parse error") != NULL);
+    run_command(&out, "HINCRBY hits f 1");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR parse error") != NULL);
+
+    reply_free(&out);
+}
+
+void test_cmd_multi() {
+    reply_t out;
+    reply_init(&out);
+    command_args_t conn;
+    command_args_init(&conn);
+    char buf[BUF_SIZE];
+
+    kv_init();
+    run_connection_command(&out, &conn, "MULTI");
+    run_connection_command(&out, &conn, "SET a 1");
+    run_connection_command(&out, &conn, "INCR a");
+    run_connection_command(&out, &conn, "HSET h f v");
+    run_connection_command(&out, &conn, "MGET a missing");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strcmp(buf, "RESPONSE OK STRING\nOK\nEND\n"
+                       "RESPONSE OK STRING\nQUEUED\nEND\n"
+                       "RESPONSE OK STRING\nQUEUED\nEND\n"
+                       "RESPONSE OK STRING\nQUEUED\nEND\n"
+                       "RESPONSE OK STRING\nQUEUED\nEND\n") == 0);
+    assert(kv_get("a") == NULL); // nothing runs before EXEC
+
+    // Each reply keeps its type line; a failing command does not stop the rest
+    run_connection_command(&out, &conn, "EXEC");
+    take_reply(&out, buf, sizeof(buf));
+    printf("cmd_exec() -> '%s'\n", buf);
+    assert(strcmp(buf, "RESPONSE OK EXEC\nOK STRING\nOK\nOK STRING\n2\nOK STRING\n1\n"
+                       "OK MULTI\n1) 2\n2) (nil)\nEND\n") == 0);
+    assert(!conn.queue.active);
+
+    run_connection_command(&out, &conn, "EXEC");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, ERR_NO_MULTI) != NULL);
+    run_connection_command(&out, &conn, "DISCARD");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, ERR_NO_MULTI) != NULL);
+
+    run_connection_command(&out, &conn, "MULTI");
+    run_connection_command(&out, &conn, "MULTI");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, ERR_NESTED_MULTI) != NULL);
+    run_connection_command(&out, &conn, "SET a 10");
+    run_connection_command(&out, &conn, "DISCARD");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strcmp(kv_get("a"), "2") == 0);
+    assert(!conn.queue.active && conn.queue.count == 0);
+
+    // A command rejected while queuing aborts the whole transaction
+    run_connection_command(&out, &conn, "MULTI");
+    run_connection_command(&out, &conn, "SET a 10");
+    run_connection_command(&out, &conn, "GET");
+    run_connection_command(&out, &conn, "EXEC");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, ERR_EXEC_ABORT) != NULL);
+    assert(strcmp(kv_get("a"), "2") == 0);
+
+    run_connection_command(&out, &conn, "MULTI");
+    run_connection_command(&out, &conn, "EXEC");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, "RESPONSE OK EXEC\nEND\n") != NULL);
+
+    // INFO walks every stripe while EXEC holds some of them
+    run_connection_command(&out, &conn, "MULTI");
+    run_connection_command(&out, &conn, "INCR a");
+    run_connection_command(&out, &conn, "INFO");
+    run_connection_command(&out, &conn, "EXEC");
+    char info[8192];
+    take_reply(&out, info, sizeof(info));
+    assert(strstr(info, "Table size:") != NULL);
+
+    command_args_free(&conn);
+    reply_free(&out);
+    printf("✅ MULTI/EXEC tests passed!\n");
+}
+
+#define TX_ROUNDS 2000
+
+// Moves two counters together, one transaction at a time.
+static void *tx_writer(void *arg) {
+    (void)arg;
+    reply_t out;
+    reply_init(&out);
+    command_args_t conn;
+    command_args_init(&conn);
+    for (int i = 0; i < TX_ROUNDS; i++) {
+        run_connection_command(&out, &conn, "MULTI");
+        run_connection_command(&out, &conn, "INCR tx:a");
+        run_connection_command(&out, &conn, "INCR tx:b");
+        run_connection_command(&out, &conn, "EXEC");
+        reply_reset(&out);
+    }
+    command_args_free(&conn);
+    reply_free(&out);
+    return NULL;
+}
+
+void test_cmd_exec_atomic() {
+    kv_init();
+    kv_set("tx:a", "0");
+    kv_set("tx:b", "0");
+
+    pthread_t writers[2];
+    for (int t = 0; t < 2; t++) pthread_create(&writers[t], NULL, tx_writer, NULL);
+
+    reply_t out;
+    reply_init(&out);
+    command_args_t conn;
+    command_args_init(&conn);
+    char buf[BUF_SIZE];
+    for (int i = 0; i < TX_ROUNDS; i++) {
+        run_connection_command(&out, &conn, "MULTI");
+        run_connection_command(&out, &conn, "GET tx:a");
+        run_connection_command(&out, &conn, "GET tx:b");
+        reply_reset(&out);
+        run_connection_command(&out, &conn, "EXEC");
+        take_reply(&out, buf, sizeof(buf));
+
+        long long a, b;
+        assert(sscanf(buf, "RESPONSE OK EXEC\nOK STRING\n%lld\nOK STRING\n%lld\n", &a, &b) == 2);
+        assert(a == b);
+    }
+    for (int t = 0; t < 2; t++) pthread_join(writers[t], NULL);
+    assert(strcmp(kv_get("tx:a"), "4000") == 0);
+
+    command_args_free(&conn);
+    reply_free(&out);
+    printf("✅ Concurrent EXEC tests passed!\n");
+}
+
+void test_cmd_expire_ttl() {
+    reply_t out;
+    reply_init(&out);
+    char buf[BUF_SIZE];
+
+    kv_init();
+    run_command(&out, "SET session abc EX 100\n");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "OK"));
+    assert(strcmp(kv_get("session"), "abc") == 0); // the option is not part of the value
+
+    run_command(&out, "TTL session");
+    take_reply(&out, buf, sizeof(buf));
+    printf("cmd_ttl() -> '%s'\n", buf);
+    assert(response_contains(buf, "100"));
+
+    run_command(&out, "SET quoted \"a b\" PX 5000\n");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strcmp(kv_get("quoted"), "a b") == 0);
+    assert(kv_ttl("quoted") > 4000);
+
+    run_command(&out, "SET bad v EX soon\n");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "ERROR parse error"));
+
+    run_command(&out, "PERSIST session");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "1"));
+
+    run_command(&out, "TTL session");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "-1"));
+
+    run_command(&out, "PEXPIRE session 20000");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "1"));
+
+    run_command(&out, "PTTL session");
+    take_reply(&out, buf, sizeof(buf));
+    printf("cmd_pttl() -> '%s'\n", buf);
+    assert(kv_ttl("session") > 19000);
+
+    run_command(&out, "EXPIRE missing 10");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "0"));
+
+    run_command(&out, "TTL missing");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "-2"));
+
+    run_command(&out, "EXPIRE session ten");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "ERROR parse error"));
+
+    // a non-positive time deletes the key
+    run_command(&out, "EXPIRE session 0");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "1"));
+    assert(kv_get("session") == NULL);
+
+    reply_free(&out);
 }
 
 void test_cmd_hmget() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
     kv_hset("myhash", "field1", "val1");
     kv_hset("myhash", "field2", "val2");
 
-    cmd_hmget(fds[1], "HMGET myhash field1 field2 missing");
+    run_command(&out, "HMGET myhash field1 field2 missing");
 
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hmget() -> '%s'\n", buf);
 
     assert(response_contains(buf, "1) val1"));
     assert(response_contains(buf, "2) val2"));
     assert(response_contains(buf, "3) (nil)"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
-void test_extract_key_from_ptr() {
-    char key[128];
-    const char *input;
-
-    // Test 1: Quoted token normal
-    input = "\"mykey\" rest_of_input";
-    const char *p = input;
-    int ret = extract_key_from_ptr(&p, key, sizeof(key));
-    printf("extract_key_from_ptr() -> '%s' ret=%d\n", key, ret);
-    assert(ret == EXTRACT_OK);
-    assert(strcmp(key, "mykey") == 0);
-    assert(strcmp(p, "rest_of_input") == 0);
-
-    // Test 2: Quoted token, unterminated (parse error)
-    input = "\"unterminated rest_of_input";
-    p = input;
-    ret = extract_key_from_ptr(&p, key, sizeof(key));
-    printf("extract_key_from_ptr() unterminated -> ret=%d\n", ret);
-    assert(ret == EXTRACT_ERR_PARSE);
-
-    // Test 3: Quoted token, key too long
-    char long_input[300];
-    memset(long_input, 'A', 200);  // fill with 'A's
-    long_input[0] = '"';
-    long_input[199] = '"';
-    long_input[200] = ' ';
-    long_input[201] = '\0';
-    p = long_input;
-    ret = extract_key_from_ptr(&p, key, 10);  // force small key_size
-    printf("extract_key_from_ptr() too long -> ret=%d\n", ret);
-    assert(ret == EXTRACT_ERR_KEY_TOO_LONG);
-
-    // Test 4: Unquoted token (still test unquoted for completeness)
-    input = "plain_key next_token";
-    p = input;
-    ret = extract_key_from_ptr(&p, key, sizeof(key));
-    printf("extract_key_from_ptr() unquoted -> '%s' ret=%d\n", key, ret);
-    assert(ret == EXTRACT_OK);
-    assert(strcmp(key, "plain_key") == 0);
-    assert(strcmp(p, "next_token") == 0);
-
-    printf("✅ All extract_key_from_ptr tests passed!\n");
-}
+void test_cmd_quoted_arguments() {
+    reply_t out;
+    reply_init(&out);
+
+    kv_init();
+
+    // Quoted keys and values keep their spaces
+    run_command(&out, "SET \"my key\" \"my value\"\n");
+    char buf[BUF_SIZE];
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "OK"));
+    assert(strcmp(kv_get("my key"), "my value") == 0);
 
-void test_extract_value_from_ptr() {
-    char value[128];
-    const char *input;
-
-    // Quoted value
-    input = "\"my value\" rest";
-    const char *p = input;
-    int ret = extract_value_from_ptr(&p, value, sizeof(value));
-    printf("extract_value_from_ptr() quoted -> '%s' ret=%d\n", value, ret);
-    assert(ret == EXTRACT_OK);
-    assert(strcmp(value, "my value") == 0);
-    assert(strcmp(p, "rest") == 0);
-
-    // Unterminated
-    input = "\"unterminated value";
-    p = input;
-    ret = extract_value_from_ptr(&p, value, sizeof(value));
-    printf("extract_value_from_ptr() unterminated -> ret=%d\n", ret);
-    assert(ret == EXTRACT_ERR_PARSE);
-
-    // Value too long
-    char long_input[300];
-    memset(long_input, 'B', 200);
-    long_input[0] = '"';
-    long_input[199] = '"';
-    long_input[200] = ' ';
-    long_input[201] = '\0';
-    p = long_input;
-    ret = extract_value_from_ptr(&p, value, 10); // small buffer
-    printf("extract_value_from_ptr() too long -> ret=%d\n", ret);
-    assert(ret == EXTRACT_ERR_VALUE_TOO_LONG);
-
-    // Unquoted value
-    input = "plain_value next";
-    p = input;
-    ret = extract_value_from_ptr(&p, value, sizeof(value));
-    printf("extract_value_from_ptr() unquoted -> '%s' ret=%d\n", value, ret);
-    assert(ret == EXTRACT_OK);
-    assert(strcmp(value, "plain_value") == 0);
-    assert(strcmp(p, "next") == 0);
-
-    printf("✅ All extract_value_from_ptr tests passed!\n");
+    run_command(&out, "GET \"my key\"");
+    take_reply(&out, buf, sizeof(buf));
+    printf("cmd_get() quoted key -> '%s'\n", buf);
+    assert(response_contains(buf, "my value"));
+
+    // An empty quoted value is stored as an empty string
+    run_command(&out, "SET empty \"\"");
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "OK"));
+    assert(strcmp(kv_get("empty"), "") == 0);
+
+    // A value with spaces must be quoted
+    run_command(&out, "SET k hello world");
+    take_reply(&out, buf, sizeof(buf));
+    printf("cmd_set() unquoted words -> '%s'\n", buf);
+    assert(strstr(buf, ERR_PARSE_ERROR) != NULL);
+
+    reply_free(&out);
+    printf("✅ All quoted argument tests passed!\n");
 }
 
 void test_cmd_mset_errors() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
 
     // Missing value
-    cmd_mset(fds[1], "MSET k1\n");
+    run_command(&out, "MSET k1\n");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_mset() missing value -> '%s'\n", buf);
     assert(strstr(buf, "RESPONSE ERROR") != NULL);
     assert(strstr(buf, ERR_PARSE_ERROR) != NULL);
@@ -407,117 +613,143 @@ void test_cmd_mset_errors() {
     long_key[sizeof(long_key) - 1] = '\0';
     char buffer[BUF_SIZE];
     snprintf(buffer, sizeof(buffer), "MSET %s v1\n", long_key);
-    cmd_mset(fds[1], buffer);
-    recv_until_end(fds[0], buf, sizeof(buf));
+    run_command(&out, buffer);
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_mset() key too long -> '%s'\n", buf);
     assert(strstr(buf, "RESPONSE ERROR") != NULL);
     assert(strstr(buf, ERR_KEY_TOO_LONG) != NULL);
     assert(strstr(buf, "END") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_mget_empty() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
 
-    cmd_mget(fds[1], "MGET\n");
+    run_command(&out, "MGET\n");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_mget() empty -> '%s'\n", buf);
-    // Should not crash — just "END" expected
+    // MGET needs at least one key
+    assert(strstr(buf, ERR_PARSE_ERROR) != NULL);
     assert(strstr(buf, "END") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_type_invalid() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
 
     // No such key
-    cmd_type(fds[1], "TYPE unknown_key");
+    run_command(&out, "TYPE unknown_key");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_type() unknown_key -> '%s'\n", buf);
     assert(response_contains(buf, "(nil)"));
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_hset_errors() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
 
     // Missing field/value → parse error
-    cmd_hset(fds[1], "HSET myhash field1\n");
+    run_command(&out, "HSET myhash field1\n");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hset() missing value -> '%s'\n", buf);
     assert(strstr(buf, "ERROR parse error") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_hget_wrong_type() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
     kv_set("foo", "bar"); // string type
 
-    cmd_hget(fds[1], "HGET foo field1");
+    run_command(&out, "HGET foo field1");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hget() wrong type -> '%s'\n", buf);
     assert(strstr(buf, "ERROR parse error") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_hmget_no_fields() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
     kv_hset("myhash", "field1", "val1");
 
-    cmd_hmget(fds[1], "HMGET myhash\n");
+    run_command(&out, "HMGET myhash\n");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hmget() no fields -> '%s'\n", buf);
     assert(strstr(buf, "ERROR parse error") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
 }
 
 void test_cmd_hincrby_missing_arg() {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
     kv_init();
     kv_hset("myhash", "counter", "5");
 
-    cmd_hincrby(fds[1], "HINCRBY myhash counter\n");
+    run_command(&out, "HINCRBY myhash counter\n");
     char buf[BUF_SIZE];
-    recv_until_end(fds[0], buf, sizeof(buf));
+    take_reply(&out, buf, sizeof(buf));
     printf("cmd_hincrby() missing arg -> '%s'\n", buf);
     assert(strstr(buf, "ERROR parse error") != NULL);
 
-    close(fds[0]);
-    close(fds[1]);
+    reply_free(&out);
+}
+
+void test_command_stats() {
+    reply_t out;
+    reply_init(&out);
+
+    kv_init();
+
+    command_stats_t before, after;
+    commands_stats(CMD_ECHO, &before);
+
+    run_command(&out, "ECHO \"hello there\"");
+    char buf[BUF_SIZE];
+    take_reply(&out, buf, sizeof(buf));
+    assert(response_contains(buf, "hello there"));
+
+    // The registry rejects a wrong argument count before the handler runs
+    run_command(&out, "ECHO a b");
+    take_reply(&out, buf, sizeof(buf));
+    assert(strstr(buf, ERR_PARSE_ERROR) != NULL);
+
+    commands_stats(CMD_ECHO, &after);
+    assert(after.calls == before.calls + 1);
+    assert(after.rejected_calls == before.rejected_calls + 1);
+
+    char info[8192];
+    run_command(&out, "INFO");
+    take_reply(&out, info, sizeof(info));
+    assert(strstr(info, "cmdstat_echo: calls=") != NULL);
+
+    reply_free(&out);
+    printf("✅ Command stats tests passed!\n");
 }
 
 int main() {
@@ -532,13 +764,20 @@ int main() {
     snprintf(buffer1, sizeof(buffer1), "SET %s value\n", long_key);
     test_cmd_set(buffer1, "ERROR key too long");
 
-    // Test value too long
-    char long_value[MAX_VAL_LEN + 100];
-    memset(long_value, 'B', MAX_VAL_LEN + 50);  // Ensure it exceeds MAX_VAL_LEN
-    long_value[MAX_VAL_LEN + 50] = '\0';
+    // Test value too long against a lowered limit
+    size_t max_value_len = kv_get_max_value_len();
+    kv_set_max_value_len(TEST_MAX_VAL_LEN);
+    char long_value[TEST_MAX_VAL_LEN + 100];
+    memset(long_value, 'B', TEST_MAX_VAL_LEN + 50);  // Ensure it exceeds TEST_MAX_VAL_LEN
+    long_value[TEST_MAX_VAL_LEN + 50] = '\0';
     char buffer2[BUF_SIZE];
     snprintf(buffer2, sizeof(buffer2), "SET foo %s\n", long_value);
     test_cmd_set(buffer2, "ERROR value too long");
+    kv_set_max_value_len(max_value_len);
+
+    // Values over the old fixed 128-byte slot are stored whole
+    test_cmd_set(buffer2, "OK");
+    assert(strlen(kv_get("foo")) == TEST_MAX_VAL_LEN + 50);
 
     // Test parse error
     test_cmd_set("SET foo\n", "ERROR parse error");
@@ -548,6 +787,18 @@ int main() {
     test_send_error_response(EXTRACT_ERR_KEY_TOO_LONG, ERR_KEY_TOO_LONG);
     test_send_error_response(EXTRACT_ERR_VALUE_TOO_LONG, ERR_VALUE_TOO_LONG);
     test_send_error_response(EXTRACT_ERR_KEY_NOT_FOUND, ERR_NOT_FOUND);
+    test_send_error_response(EXTRACT_ERR_OOM, ERR_OOM);
+    test_send_error_response(EXTRACT_ERR_LINE_TOO_LONG, ERR_LINE_TOO_LONG);
+    test_send_error_response(EXTRACT_ERR_BUSY, ERR_BUSY);
+    test_send_error_response(EXTRACT_ERR_MAX_CLIENTS, ERR_MAX_CLIENTS);
+    test_send_error_response(EXTRACT_ERR_NESTED_MULTI, ERR_NESTED_MULTI);
+    test_send_error_response(EXTRACT_ERR_NO_MULTI, ERR_NO_MULTI);
+    test_send_error_response(EXTRACT_ERR_EXEC_ABORT, ERR_EXEC_ABORT);
+
+    // Writes over maxmemory with noeviction are refused
+    kv_set_maxmemory(1, KV_EVICT_NOEVICTION);
+    test_cmd_set("SET foo bar\n", "ERROR out of memory");
+    kv_set_maxmemory(0, KV_EVICT_NOEVICTION);
 
     // Test INFO
     test_cmd_info();
@@ -563,9 +814,12 @@ int main() {
     test_cmd_hset_hget();
     test_cmd_hmget();
     test_cmd_hincrby();
+    test_cmd_counters();
+    test_cmd_multi();
+    test_cmd_exec_atomic();
+    test_cmd_expire_ttl();
 
-    test_extract_key_from_ptr();
-    test_extract_value_from_ptr();
+    test_cmd_quoted_arguments();
     test_cmd_mset_errors();
     test_cmd_mget_empty();
     test_cmd_type_invalid();
@@ -573,6 +827,7 @@ int main() {
     test_cmd_hget_wrong_type();
     test_cmd_hmget_no_fields();
     test_cmd_hincrby_missing_arg();
+    test_command_stats();
 
     printf("✅ All cmd_set tests passed!\n");
     return 0;
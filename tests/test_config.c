@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/config.h"
+#include "../src/kvstore.h"
+
+void test_parse_size() {
+    size_t size;
+    assert(parse_size("512", &size) == 0 && size == 512);
+    assert(parse_size("64k", &size) == 0 && size == 64 * 1024);
+    assert(parse_size("8mb", &size) == 0 && size == 8 * 1024 * 1024);
+    assert(parse_size("1G", &size) == 0 && size == 1024UL * 1024 * 1024);
+    assert(parse_size("", &size) == -1);
+    assert(parse_size("-1", &size) == -1);
+    assert(parse_size("10x", &size) == -1);
+    assert(parse_size(NULL, &size) == -1);
+}
+
+void test_load_env() {
+    server_config_t config;
+    config_defaults(&config);
+    assert(config.port == DEFAULT_PORT);
+    assert(config.max_value_size == KV_DEFAULT_MAX_VALUE_LEN);
+    assert(config.io_backend == IO_BACKEND_EPOLL);
+
+    setenv("PORT", "9090", 1);
+    setenv("MAX_VALUE_SIZE", "2mb", 1);
+    setenv("HASH_MAX_PACKED_FIELDS", "128", 1);
+    setenv("HASH_MAX_PACKED_VALUE", "1k", 1);
+    setenv("MAXMEMORY", "100mb", 1);
+    setenv("MAXMEMORY_POLICY", "allkeys-lru", 1);
+    setenv("IO_BACKEND", "threads", 1);
+    config_load_env(&config);
+    assert(config.port == 9090);
+    assert(config.max_value_size == 2 * 1024 * 1024);
+    assert(config.hash_max_packed_fields == 128);
+    assert(config.hash_max_packed_value == 1024);
+    assert(config.maxmemory == 100 * 1024 * 1024);
+    assert(config.maxmemory_policy == KV_EVICT_ALLKEYS_LRU);
+    assert(config.io_backend == IO_BACKEND_THREADS);
+
+    // invalid sizes keep the previous value
+    setenv("MAX_VALUE_SIZE", "lots", 1);
+    setenv("MAXMEMORY_POLICY", "volatile-lru", 1);
+    setenv("IO_BACKEND", "kqueue", 1);
+    config_load_env(&config);
+    assert(config.max_value_size == 2 * 1024 * 1024);
+    assert(config.maxmemory_policy == KV_EVICT_ALLKEYS_LRU);
+    assert(config.io_backend == IO_BACKEND_THREADS);
+
+    setenv("IO_BACKEND", "uring", 1);
+    config_load_env(&config);
+    assert(config.io_backend == IO_BACKEND_URING);
+
+    unsetenv("PORT");
+    unsetenv("MAX_VALUE_SIZE");
+    unsetenv("HASH_MAX_PACKED_FIELDS");
+    unsetenv("HASH_MAX_PACKED_VALUE");
+    unsetenv("MAXMEMORY");
+    unsetenv("MAXMEMORY_POLICY");
+    unsetenv("IO_BACKEND");
+}
+
+void test_io_threads() {
+    server_config_t config;
+    config_defaults(&config);
+    assert(config.io_threads == 1);
+
+    setenv("IO_THREADS", "4", 1);
+    config_load_env(&config);
+    assert(config.io_threads == 4);
+
+    setenv("IO_THREADS", "0", 1);
+    config_load_env(&config);
+    assert(config.io_threads == 4);
+    unsetenv("IO_THREADS");
+
+    // command line options override the environment
+    char *args[] = { "server", "--io-threads", "8" };
+    assert(config_load_args(&config, 3, args) == 0);
+    assert(config.io_threads == 8);
+
+    char *too_many[] = { "server", "--io-threads", "1000" };
+    assert(config_load_args(&config, 3, too_many) == -1);
+    char *missing[] = { "server", "--io-threads" };
+    assert(config_load_args(&config, 2, missing) == -1);
+    char *unknown[] = { "server", "--verbose" };
+    assert(config_load_args(&config, 2, unknown) == -1);
+    assert(config.io_threads == 8);
+}
+
+void test_worker_pool() {
+    server_config_t config;
+    config_defaults(&config);
+    assert(config.listen_backlog == DEFAULT_LISTEN_BACKLOG);
+    assert(config.worker_threads == DEFAULT_WORKER_THREADS);
+    assert(config.worker_queue == DEFAULT_WORKER_QUEUE);
+
+    setenv("LISTEN_BACKLOG", "4096", 1);
+    setenv("WORKER_THREADS", "32", 1);
+    setenv("WORKER_QUEUE", "64", 1);
+    config_load_env(&config);
+    assert(config.listen_backlog == 4096);
+    assert(config.worker_threads == 32);
+    assert(config.worker_queue == 64);
+
+    setenv("LISTEN_BACKLOG", "-1", 1);
+    setenv("WORKER_THREADS", "0", 1);
+    setenv("WORKER_QUEUE", "99999999999999999999", 1);
+    config_load_env(&config);
+    assert(config.listen_backlog == 4096);
+    assert(config.worker_threads == 32);
+    assert(config.worker_queue == 64);
+
+    unsetenv("LISTEN_BACKLOG");
+    unsetenv("WORKER_THREADS");
+    unsetenv("WORKER_QUEUE");
+}
+
+void test_unix_socket() {
+    server_config_t config;
+    config_defaults(&config);
+    assert(config.unix_socket == NULL);
+
+    setenv("UNIX_SOCKET", "/tmp/kv.sock", 1);
+    config_load_env(&config);
+    assert(strcmp(config.unix_socket, "/tmp/kv.sock") == 0);
+
+    // sun_path holds 108 bytes with the NUL
+    char too_long[200];
+    memset(too_long, 'a', sizeof(too_long) - 1);
+    too_long[sizeof(too_long) - 1] = '\0';
+    setenv("UNIX_SOCKET", too_long, 1);
+    config_load_env(&config);
+    assert(strcmp(config.unix_socket, "/tmp/kv.sock") == 0);
+    unsetenv("UNIX_SOCKET");
+
+    char *args[] = { "server", "--unix-socket", "/run/kv.sock" };
+    assert(config_load_args(&config, 3, args) == 0);
+    assert(strcmp(config.unix_socket, "/run/kv.sock") == 0);
+    char *empty[] = { "server", "--unix-socket", "" };
+    assert(config_load_args(&config, 3, empty) == -1);
+}
+
+void test_client_limits() {
+    server_config_t config;
+    config_defaults(&config);
+    assert(config.clients.maxclients == DEFAULT_MAXCLIENTS);
+    assert(config.clients.timeout == 0);
+    assert(config.clients.output_hard_limit == DEFAULT_OUTPUT_HARD_LIMIT);
+    assert(config.clients.output_soft_limit == DEFAULT_OUTPUT_SOFT_LIMIT);
+    assert(config.clients.output_soft_seconds == DEFAULT_OUTPUT_SOFT_SECONDS);
+    assert(config.clients.max_request == DEFAULT_MAX_REQUEST_SIZE);
+
+    setenv("MAXCLIENTS", "500", 1);
+    setenv("TIMEOUT", "300", 1);
+    setenv("OUTPUT_BUFFER_HARD_LIMIT", "0", 1);
+    setenv("OUTPUT_BUFFER_SOFT_LIMIT", "1mb", 1);
+    setenv("OUTPUT_BUFFER_SOFT_SECONDS", "0", 1);
+    setenv("MAX_REQUEST_SIZE", "1gb", 1);
+    config_load_env(&config);
+    assert(config.clients.maxclients == 500);
+    assert(config.clients.timeout == 300);
+    assert(config.clients.output_hard_limit == 0);
+    assert(config.clients.output_soft_limit == 1024 * 1024);
+    assert(config.clients.output_soft_seconds == 0);
+    assert(config.clients.max_request == 1024UL * 1024 * 1024);
+
+    setenv("MAXCLIENTS", "0", 1);
+    setenv("TIMEOUT", "-5", 1);
+    setenv("OUTPUT_BUFFER_HARD_LIMIT", "big", 1);
+    setenv("MAX_REQUEST_SIZE", "-1", 1);
+    config_load_env(&config);
+    assert(config.clients.maxclients == 500);
+    assert(config.clients.timeout == 300);
+    assert(config.clients.output_hard_limit == 0);
+    assert(config.clients.max_request == 1024UL * 1024 * 1024);
+
+    unsetenv("MAXCLIENTS");
+    unsetenv("TIMEOUT");
+    unsetenv("OUTPUT_BUFFER_HARD_LIMIT");
+    unsetenv("OUTPUT_BUFFER_SOFT_LIMIT");
+    unsetenv("OUTPUT_BUFFER_SOFT_SECONDS");
+    unsetenv("MAX_REQUEST_SIZE");
+}
+
+int main() {
+    test_parse_size();
+    test_load_env();
+    test_io_threads();
+    test_worker_pool();
+    test_unix_socket();
+    test_client_limits();
+    printf("✅ Config tests passed\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/kvhash.h"
+
+#define ATTACK_BITS 14
+#define ATTACK_KEYS (1 << ATTACK_BITS)
+#define STRIPES 64
+#define BUCKETS_PER_STRIPE 256
+
+static const uint64_t seeds[] = { 0, 1, 0x9e3779b97f4a7c15ULL };
+
+// The unseeded hash the store used before.
+static unsigned int djb2(const char *data, size_t len) {
+    unsigned int hash = 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)data[i];
+    }
+    return hash;
+}
+
+// Key i of a set that all collide under djb2: "Aa" and "B@" hash alike
+// (33 * 'A' + 'a' == 33 * 'B' + '@'), so any sequence of the two does too.
+static void attack_key(int i, char *out) {
+    for (int b = 0; b < ATTACK_BITS; b++) {
+        memcpy(out + 2 * b, (i >> b) & 1 ? "B@" : "Aa", 2);
+    }
+    out[2 * ATTACK_BITS] = '\0';
+}
+
+void test_seeding() {
+    const char *key = "user:1000";
+    uint64_t h = kv_hash64(key, strlen(key), 42);
+    assert(kv_hash64(key, strlen(key), 42) == h);
+    assert(kv_hash64(key, strlen(key), 43) != h);
+
+    // the process seed is random and kv_hash follows it
+    assert(kv_hash_get_seed() != 0);
+    uint64_t saved = kv_hash_get_seed();
+    kv_hash_set_seed(42);
+    assert(kv_hash(key, strlen(key)) == (unsigned int)h);
+    kv_hash_set_seed(saved);
+
+    // every length path, including the empty key, is defined
+    char buf[200];
+    memset(buf, 'k', sizeof(buf));
+    for (size_t len = 0; len < sizeof(buf); len++) {
+        assert(kv_hash64(buf, len, 1) != kv_hash64(buf, len + 1, 1));
+    }
+}
+
+void test_adversarial_keys() {
+    char key[2 * ATTACK_BITS + 1];
+    attack_key(0, key);
+    unsigned int target = djb2(key, strlen(key));
+    for (int i = 1; i < ATTACK_KEYS; i++) {
+        attack_key(i, key);
+        assert(djb2(key, strlen(key)) == target); // the old hash put them all in one bucket
+    }
+
+    for (size_t s = 0; s < sizeof(seeds) / sizeof(seeds[0]); s++) {
+        kv_hash_set_seed(seeds[s]);
+        static int per_stripe[STRIPES];
+        static int per_bucket[STRIPES][BUCKETS_PER_STRIPE];
+        memset(per_stripe, 0, sizeof(per_stripe));
+        memset(per_bucket, 0, sizeof(per_bucket));
+
+        for (int i = 0; i < ATTACK_KEYS; i++) {
+            attack_key(i, key);
+            unsigned int h = kv_hash(key, strlen(key));
+            per_stripe[h & (STRIPES - 1)]++;
+            per_bucket[h & (STRIPES - 1)][(h >> 6) & (BUCKETS_PER_STRIPE - 1)]++;
+        }
+
+        // one key per bucket on average; a uniform hash stays far below these
+        int max_stripe = 0;
+        int max_bucket = 0;
+        for (int i = 0; i < STRIPES; i++) {
+            if (per_stripe[i] > max_stripe) max_stripe = per_stripe[i];
+            for (int j = 0; j < BUCKETS_PER_STRIPE; j++) {
+                if (per_bucket[i][j] > max_bucket) max_bucket = per_bucket[i][j];
+            }
+        }
+        assert(max_stripe < 2 * ATTACK_KEYS / STRIPES);
+        assert(max_bucket <= 12);
+    }
+}
+
+void test_avalanche() {
+    // flipping any input bit flips about half of the output bits
+    char key[16] = "avalanche-test!";
+    long flipped = 0;
+    long samples = 0;
+    for (size_t byte = 0; byte < sizeof(key) - 1; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint64_t a = kv_hash64(key, sizeof(key) - 1, 7);
+            key[byte] ^= (char)(1 << bit);
+            uint64_t b = kv_hash64(key, sizeof(key) - 1, 7);
+            key[byte] ^= (char)(1 << bit);
+            flipped += __builtin_popcountll(a ^ b);
+            samples++;
+        }
+    }
+    double avg = (double)flipped / (double)samples;
+    assert(avg > 28.0 && avg < 36.0);
+}
+
+int main() {
+    test_seeding();
+    test_adversarial_keys();
+    test_avalanche();
+    printf("✅ Hash function tests passed\n");
+    return 0;
+}
@@ -1,10 +1,660 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include "../src/kvstore.h"
+#include "../src/arena.h"
+
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_KEYS 512
+#define CONCURRENT_ROUNDS 50
+
+static void *concurrent_writer(void *arg) {
+    int id = (int)(intptr_t)arg;
+    char key[MAX_KEY_LEN], value[64];
+
+    for (int round = 0; round < CONCURRENT_ROUNDS; round++) {
+        for (int i = 0; i < CONCURRENT_KEYS; i++) {
+            snprintf(key, sizeof(key), "t%d:%d", id, i);
+            snprintf(value, sizeof(value), "v%d", round);
+            assert(kv_set(key, value) == 0);
+
+            // shared keys are hammered by every thread at once
+            snprintf(key, sizeof(key), "shared:%d", i);
+            kv_set(key, value);
+            char copy[64];
+            kv_get_copy(key, copy, sizeof(copy));
+            int64_t hits;
+            kv_hincrby("shared:counter", "hits", 1, &hits);
+
+            if (round % 2 == 1) {
+                snprintf(key, sizeof(key), "t%d:%d", id, i);
+                assert(kv_delete(key) == 0);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_access() {
+    kv_init();
+
+    pthread_t threads[CONCURRENT_THREADS];
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        pthread_create(&threads[t], NULL, concurrent_writer, (void *)(intptr_t)t);
+    }
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // every per-thread key was deleted in the last round, only shared ones remain
+    assert(kv_count_keys() == CONCURRENT_KEYS + 1);
+    int64_t hits;
+    assert(kv_hincrby("shared:counter", "hits", 0, &hits) == 0);
+    assert(hits == CONCURRENT_THREADS * CONCURRENT_KEYS * CONCURRENT_ROUNDS);
+
+    // keys locked together are applied atomically and can be re-entered by the holder
+    const char *keys[] = { "a", "b", "shared:1" };
+    uint64_t locked = kv_lock_keys(keys, 3, 1, true);
+    assert(locked != 0);
+    assert(kv_set("a", "1") == 0);
+    assert(kv_set("b", "2") == 0);
+    kv_unlock_keys(locked);
+    assert(strcmp(kv_get("a"), "1") == 0);
+
+    // a write on a stripe held for reading is refused instead of deadlocking
+    locked = kv_lock_keys(keys, 1, 1, false);
+    assert(kv_set("a", "3") == -1);
+    kv_unlock_keys(locked);
+    assert(kv_set("a", "3") == 0);
+}
+
+static void test_table_resizing() {
+    kv_init();
+
+    kv_table_stats_t stats;
+    kv_table_stats(&stats);
+    unsigned long initial_buckets = stats.buckets;
+
+    char key[MAX_KEY_LEN];
+    const int num_keys = 50000;
+    for (int i = 0; i < num_keys; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        assert(kv_set(key, "v") == 0);
+    }
+
+    // every key stays reachable while stripes are mid-rehash
+    for (int i = 0; i < num_keys; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        assert(kv_get(key) != NULL);
+    }
+
+    while (kv_table_stats(&stats), stats.rehashing_stripes > 0) {
+        kv_cron();
+    }
+    assert(stats.keys == (unsigned long)num_keys);
+    assert(stats.buckets > initial_buckets);
+    assert(stats.load_factor <= 1.0);
+
+    for (int i = 0; i < num_keys; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        assert(kv_delete(key) == 0);
+    }
+    while (kv_table_stats(&stats), stats.rehashing_stripes > 0) {
+        kv_cron();
+    }
+    assert(stats.keys == 0);
+    assert(stats.buckets < (unsigned long)num_keys / 4);
+}
+
+static void test_delete_churn() {
+    kv_init();
+
+    // rolling window of keys: deletes leave tombstones in open-addressing
+    // engines and every lookup must still probe past them
+    char key[MAX_KEY_LEN];
+    const int window = 2000;
+    for (int i = 0; i < 40000; i++) {
+        snprintf(key, sizeof(key), "churn%d", i);
+        assert(kv_set(key, "v") == 0);
+        if (i >= window) {
+            snprintf(key, sizeof(key), "churn%d", i - window);
+            assert(kv_delete(key) == 0);
+            assert(kv_get(key) == NULL);
+        }
+    }
+    assert(kv_count_keys() == window);
+    for (int i = 40000 - window; i < 40000; i++) {
+        snprintf(key, sizeof(key), "churn%d", i);
+        assert(kv_get(key) != NULL);
+    }
+
+    // a burst of inserts right after the table started shrinking
+    for (int i = 40000 - window; i < 40000 - 10; i++) {
+        snprintf(key, sizeof(key), "churn%d", i);
+        assert(kv_delete(key) == 0);
+    }
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "burst%d", i);
+        assert(kv_set(key, "v") == 0);
+    }
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "burst%d", i);
+        assert(kv_get(key) != NULL);
+    }
+    assert(kv_count_keys() == 20010);
+}
+
+static void test_memory_accounting() {
+    kv_init();
+
+    kv_memory_stats_t empty;
+    kv_memory_stats(&empty);
+    assert(empty.dataset == 0);
+    assert(empty.used_memory == empty.overhead);
+
+    char key[MAX_KEY_LEN];
+    char big[4096];
+    memset(big, 'x', sizeof(big));
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "mem%d", i);
+        assert(kv_setn(key, strlen(key), big, (size_t)(i % 2 ? sizeof(big) : 8)) == 0);
+    }
+    assert(kv_count_keys() == 1000);
+
+    kv_memory_stats_t full;
+    kv_memory_stats(&full);
+    assert(full.dataset >= 500 * sizeof(big));
+    assert(full.overhead > empty.overhead);
+    assert(full.used_memory == full.dataset + full.overhead);
+    assert(full.used_memory_peak >= full.used_memory);
+
+    // shrinking a value in place gives its bytes back
+    assert(kv_setn("mem1", 4, "small", 5) == 0);
+    kv_memory_stats_t shrunk;
+    kv_memory_stats(&shrunk);
+    assert(shrunk.dataset < full.dataset);
+
+    // hashes are charged through both encodings
+    for (int i = 0; i < 200; i++) {
+        char field[32];
+        snprintf(field, sizeof(field), "f%d", i);
+        assert(kv_hset("memhash", field, "value") == 0);
+    }
+    kv_memory_stats_t hashed;
+    kv_memory_stats(&hashed);
+    assert(hashed.dataset > shrunk.dataset);
+
+    assert(kv_delete("memhash") == 0);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "mem%d", i);
+        assert(kv_delete(key) == 0);
+    }
+    assert(kv_count_keys() == 0);
+
+    kv_memory_stats_t drained;
+    kv_memory_stats(&drained);
+    assert(drained.dataset == 0);
+    assert(drained.used_memory_peak >= hashed.used_memory);
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void test_expiration() {
+    kv_init();
+    kv_expire_stats_t stats;
+    kv_expire_stats(&stats);
+    size_t expired_before = stats.expired_keys;
+
+    // SET EX, then lazy expiry on access
+    assert(kv_setex("temp", 4, "v", 1, 50) == 0);
+    assert(strcmp(kv_get("temp"), "v") == 0);
+    int64_t ttl = kv_ttl("temp");
+    assert(ttl > 0 && ttl <= 50);
+    sleep_ms(80);
+    assert(kv_get("temp") == NULL);
+    assert(kv_ttl("temp") == KV_TTL_MISSING);
+    assert(kv_get_type("temp") == -1);
+    assert(kv_delete("temp") == -1); // deleting reclaims it, but it was already gone
+    kv_expire_stats(&stats);
+    assert(stats.expires == 0);
+    assert(stats.expired_keys == expired_before + 1);
+    assert(kv_count_keys() == 0);
+
+    // EXPIRE / PERSIST / plain SET clearing the TTL
+    assert(kv_expire("nokey", 1000) == -1);
+    assert(kv_set("k", "v") == 0);
+    assert(kv_ttl("k") == KV_TTL_NONE);
+    assert(kv_persist("k") == -1);
+    assert(kv_expire("k", 10000) == 0);
+    assert(kv_ttl("k") > 9000);
+    assert(kv_persist("k") == 0);
+    assert(kv_ttl("k") == KV_TTL_NONE);
+    assert(kv_expire("k", 10000) == 0);
+    assert(kv_set("k", "w") == 0);
+    assert(kv_ttl("k") == KV_TTL_NONE);
+    assert(kv_expire("k", 0) == 0);
+    assert(kv_get("k") == NULL);
+
+    // HSET keeps the TTL of the hash
+    assert(kv_hset("h", "f", "1") == 0);
+    assert(kv_expire("h", 10000) == 0);
+    assert(kv_hset("h", "g", "2") == 0);
+    assert(kv_ttl("h") > 9000);
+
+    // the active cycle reclaims keys nobody touches again
+    char key[MAX_KEY_LEN];
+    kv_memory_stats_t before;
+    kv_memory_stats(&before);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof(key), "volatile%d", i);
+        assert(kv_setex(key, strlen(key), "v", 1, 20) == 0);
+        snprintf(key, sizeof(key), "durable%d", i);
+        assert(kv_set(key, "v") == 0);
+    }
+    kv_expire_stats(&stats);
+    assert(stats.expires == 5001);
+    sleep_ms(40);
+    for (int i = 0; i < 1000 && kv_count_keys() > 5001; i++) {
+        kv_cron();
+    }
+    assert(kv_count_keys() == 5001);
+    kv_expire_stats(&stats);
+    assert(stats.expires == 1);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof(key), "durable%d", i);
+        assert(kv_get(key) != NULL);
+        assert(kv_delete(key) == 0);
+    }
+    kv_memory_stats_t after;
+    kv_memory_stats(&after);
+    assert(after.dataset == before.dataset);
+}
+
+static size_t used_memory(void) {
+    kv_memory_stats_t mem;
+    kv_memory_stats(&mem);
+    return mem.used_memory;
+}
+
+static int count_present(const char *prefix, int n) {
+    char key[MAX_KEY_LEN];
+    char value[128];
+    int present = 0;
+    for (int i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "%s%d", prefix, i);
+        if (kv_get_copy(key, value, sizeof(value)) >= 0) present++;
+    }
+    return present;
+}
+
+static void fill_keys(const char *prefix, int n, int64_t ttl_ms) {
+    char key[MAX_KEY_LEN];
+    char value[100];
+    memset(value, 'v', sizeof(value));
+    for (int i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "%s%d", prefix, i);
+        assert(kv_setex(key, strlen(key), value, sizeof(value), ttl_ms) == 0);
+    }
+}
+
+static void test_eviction() {
+    kv_init();
+    kv_memory_stats_t mem;
+
+    // noeviction rejects writes over the limit but keeps serving reads and deletes
+    fill_keys("keep", 100, 0);
+    kv_set_maxmemory(used_memory() - 1, KV_EVICT_NOEVICTION);
+    assert(kv_set("more", "v") == KV_ERR_OOM);
+    assert(kv_hset("morehash", "f", "v") == KV_ERR_OOM);
+    assert(count_present("keep", 100) == 100);
+    assert(kv_delete("keep0") == 0);
+    kv_memory_stats(&mem);
+    assert(strcmp(mem.policy, "noeviction") == 0);
+    assert(mem.maxmemory > 0);
+
+    // allkeys-lru evicts the keys that were not read since the clock moved on
+    kv_set_maxmemory(0, KV_EVICT_NOEVICTION);
+    kv_init();
+    fill_keys("cold", 1000, 0);
+    sleep_ms(250);
+    kv_cron();
+    fill_keys("hot", 1000, 0);
+    kv_memory_stats(&mem);
+    size_t evicted_before = mem.evicted_keys;
+    kv_set_maxmemory(used_memory(), KV_EVICT_ALLKEYS_LRU);
+    fill_keys("new", 500, 0);
+    assert(used_memory() <= mem.used_memory + mem.used_memory / 10); // each write may land over the limit
+    assert(count_present("new", 500) >= 450);
+    assert(count_present("hot", 1000) >= 900);
+    assert(count_present("cold", 1000) <= 600);
+    kv_memory_stats(&mem);
+    assert(mem.evicted_keys >= evicted_before + 400);
+    assert(strcmp(mem.policy, "allkeys-lru") == 0);
+
+    // allkeys-lfu keeps the keys that are read often
+    kv_set_maxmemory(0, KV_EVICT_ALLKEYS_LFU);
+    kv_init();
+    fill_keys("rare", 1000, 0);
+    fill_keys("often", 200, 0);
+    for (int round = 0; round < 50; round++) {
+        assert(count_present("often", 200) == 200);
+    }
+    kv_set_maxmemory(used_memory(), KV_EVICT_ALLKEYS_LFU);
+    fill_keys("new", 500, 0);
+    assert(count_present("often", 200) >= 180);
+    assert(count_present("rare", 1000) + count_present("new", 500) <= 1100);
+
+    // volatile-ttl only evicts keys with a TTL, soonest to expire first
+    kv_set_maxmemory(0, KV_EVICT_NOEVICTION);
+    kv_init();
+    fill_keys("durable", 500, 0);
+    fill_keys("soon", 300, 100000);
+    fill_keys("late", 300, 10000000);
+    kv_set_maxmemory(used_memory(), KV_EVICT_VOLATILE_TTL);
+    fill_keys("new", 200, 0);
+    assert(count_present("durable", 500) == 500);
+    assert(count_present("soon", 300) < count_present("late", 300));
+    kv_init();
+    fill_keys("durable", 100, 0);
+    kv_set_maxmemory(used_memory() - 1, KV_EVICT_VOLATILE_TTL);
+    assert(kv_set("more", "v") == KV_ERR_OOM);
+
+    assert(kv_eviction_policy_from_name("allkeys-lfu") == KV_EVICT_ALLKEYS_LFU);
+    assert(kv_eviction_policy_from_name("volatile-lru") == -1);
+
+    kv_set_maxmemory(0, KV_EVICT_NOEVICTION);
+    kv_init();
+}
+
+static void test_variable_length_values() {
+    kv_init();
+
+    // strings either side of the inline threshold
+    char value[4096];
+    for (size_t len = 0; len < sizeof(value); len = len ? len * 2 : 1) {
+        memset(value, 'x', len);
+        value[len] = '\0';
+        assert(kv_set("sized", value) == 0);
+        assert(strlen(kv_get("sized")) == len);
+    }
+    memset(value, 'y', KV_INLINE_CAP - 1);
+    value[KV_INLINE_CAP - 1] = '\0';
+    assert(kv_set("edge", value) == 0);
+    assert(strcmp(kv_get("edge"), value) == 0);
+    memset(value, 'y', KV_INLINE_CAP);
+    value[KV_INLINE_CAP] = '\0';
+    assert(kv_set("edge", value) == 0);
+    assert(strcmp(kv_get("edge"), value) == 0);
+
+    // binary-safe keys and values
+    const char bin_key[] = { 'k', '\0', 'x' };
+    const char bin_val[] = { 'a', '\0', 'b', '\n', '"' };
+    assert(kv_setn(bin_key, sizeof(bin_key), bin_val, sizeof(bin_val)) == 0);
+    assert(kv_get("k") == NULL);
+    char out[16];
+    assert(kv_getn(bin_key, sizeof(bin_key), out, sizeof(out)) == (ssize_t)sizeof(bin_val));
+    assert(memcmp(out, bin_val, sizeof(bin_val)) == 0);
+
+    // copies report the full length when the buffer is too small
+    assert(kv_set("long", "0123456789abcdef") == 0);
+    assert(kv_get_copy("long", out, 8) == 16);
+    assert(strcmp(out, "0123456") == 0);
+
+    // megabyte values up to the configured limit
+    size_t big_len = 2 * 1024 * 1024;
+    char *big = malloc(big_len + 1);
+    memset(big, 'z', big_len);
+    big[big_len] = '\0';
+    assert(kv_set("big", big) == 0);
+    assert(strlen(kv_get("big")) == big_len);
+    assert(kv_hset("bighash", "f", big) == 0);
+    assert(strlen(kv_hget("bighash", "f")) == big_len);
+
+    size_t max_len = kv_get_max_value_len();
+    kv_set_max_value_len(1024);
+    assert(kv_set("big", big) == KV_ERR_TOO_LARGE);
+    assert(kv_hset("bighash", "f", big) == KV_ERR_TOO_LARGE);
+    kv_set_max_value_len(max_len);
+    free(big);
+
+    // long keys
+    char long_key[MAX_KEY_LEN];
+    memset(long_key, 'K', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    assert(kv_set(long_key, "v") == 0);
+    assert(strcmp(kv_get(long_key), "v") == 0);
+    assert(kv_delete(long_key) == 0);
+}
+
+// Rewrites one long value with every letter in turn, each the same length.
+static void *pin_writer(void *arg) {
+    (void)arg;
+    char value[4096];
+    for (int round = 0; round < 2000; round++) {
+        memset(value, 'a' + round % 26, sizeof(value) - 1);
+        value[sizeof(value) - 1] = '\0';
+        assert(kv_set("pinned", value) == 0);
+    }
+    return NULL;
+}
+
+static void test_pinned_values() {
+    kv_init();
+    arena_stats_t before;
+    arena_get_stats(&before);
+
+    // a pinned value survives being overwritten in place and deleted
+    char value[256];
+    memset(value, 'p', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    assert(kv_set("k", value) == 0);
+    kv_ref ref;
+    assert(kv_get_ref("k", &ref));
+    assert(ref.pinned && ref.len == sizeof(value) - 1);
+    memset(value, 'q', sizeof(value) - 1);
+    assert(kv_set("k", value) == 0); // same size class, but the block is shared
+    assert(strcmp(kv_get("k"), value) == 0);
+    assert(kv_delete("k") == 0);
+    for (size_t i = 0; i < ref.len; i++) assert(ref.data[i] == 'p');
+    kv_ref_release(&ref);
+
+    arena_stats_t after;
+    arena_get_stats(&after);
+    assert(after.allocated == before.allocated);
+
+    // short strings and packed hash values are copied
+    assert(kv_set("short", "tiny") == 0);
+    assert(kv_get_ref("short", &ref) && !ref.pinned && strcmp(ref.data, "tiny") == 0);
+    kv_ref_release(&ref);
+    assert(kv_hset("h", "f", "a packed value, but longer than the inline cap") == 0);
+    assert(kv_hash_encoding("h") == KV_FIELDS_PACKED);
+    assert(kv_hget_ref("h", "f", &ref) && !ref.pinned);
+    kv_ref_release(&ref);
+    assert(!kv_get_ref("h", &ref));
+    assert(!kv_hget_ref("short", "f", &ref));
+    assert(!kv_get_ref("missing", &ref));
+
+    // dict values are pinned like strings
+    kv_set_hash_packed_limits(1, 16);
+    assert(kv_hset("d", "f", "a dict value, longer than the inline cap") == 0);
+    assert(kv_hset("d", "g", "v") == 0);
+    assert(kv_hash_encoding("d") == KV_FIELDS_DICT);
+    assert(kv_hget_ref("d", "f", &ref) && ref.pinned);
+    assert(kv_hset("d", "f", "changed") == 0);
+    assert(strcmp(ref.data, "a dict value, longer than the inline cap") == 0);
+    kv_ref_release(&ref);
+    kv_set_hash_packed_limits(KV_DEFAULT_HASH_PACKED_FIELDS, KV_DEFAULT_HASH_PACKED_VALUE);
+
+    // readers never see a value change under them while a writer replaces it
+    assert(kv_set("pinned", "a value long enough to need a block") == 0);
+    pthread_t writer;
+    pthread_create(&writer, NULL, pin_writer, NULL);
+    for (int round = 0; round < 2000; round++) {
+        assert(kv_get_ref("pinned", &ref));
+        for (size_t i = 1; i < ref.len && ref.len == 4095; i++) assert(ref.data[i] == ref.data[0]);
+        kv_ref_release(&ref);
+    }
+    pthread_join(writer, NULL);
+    kv_init();
+}
+
+static void test_hash_encodings() {
+    kv_init();
+    kv_set_hash_packed_limits(8, 16);
+
+    // small hashes stay packed while fields are added and rewritten
+    char field[32];
+    char value[64];
+    for (int i = 0; i < 8; i++) {
+        snprintf(field, sizeof(field), "f%d", i);
+        assert(kv_hset("small", field, "v") == 0);
+    }
+    assert(kv_hash_encoding("small") == KV_FIELDS_PACKED);
+    assert(kv_hset("small", "f3", "a longer value") == 0);
+    assert(kv_hset("small", "f0", "") == 0);
+    assert(strcmp(kv_hget("small", "f3"), "a longer value") == 0);
+    assert(strcmp(kv_hget("small", "f0"), "") == 0);
+    assert(strcmp(kv_hget("small", "f7"), "v") == 0);
+    assert(kv_hget("small", "f8") == NULL);
+    int64_t n;
+    assert(kv_hincrby("small", "f1", 3, &n) == KV_ERR_NOT_INTEGER);
+    assert(strcmp(kv_hget("small", "f1"), "v") == 0);
+    assert(kv_hset("small", "f1", "2") == 0);
+    assert(kv_hincrby("small", "f1", 1, &n) == 0 && n == 3); // now stored as a number
+    assert(kv_hash_encoding("small") == KV_FIELDS_PACKED);
+
+    // one field too many converts to a dict without losing fields
+    assert(kv_hset("small", "f8", "v") == 0);
+    assert(kv_hash_encoding("small") == KV_FIELDS_DICT);
+    assert(strcmp(kv_hget("small", "f3"), "a longer value") == 0);
+    assert(strcmp(kv_hget("small", "f1"), "3") == 0);
+    assert(strcmp(kv_hget("small", "f8"), "v") == 0);
+
+    // a long value converts too
+    assert(kv_hset("long", "f", "short") == 0);
+    assert(kv_hash_encoding("long") == KV_FIELDS_PACKED);
+    assert(kv_hset("long", "f", "a value past sixteen bytes") == 0);
+    assert(kv_hash_encoding("long") == KV_FIELDS_DICT);
+    assert(strcmp(kv_hget("long", "f"), "a value past sixteen bytes") == 0);
+
+    // large hashes grow their dict
+    for (int i = 0; i < 5000; i++) {
+        snprintf(field, sizeof(field), "field%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(kv_hset("large", field, value) == 0);
+    }
+    for (int i = 0; i < 5000; i++) {
+        snprintf(field, sizeof(field), "field%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(strcmp(kv_hget("large", field), value) == 0);
+    }
+
+    assert(kv_hash_encoding("missing") == -1);
+    assert(kv_set("str", "v") == 0);
+    assert(kv_hash_encoding("str") == -1);
+
+    kv_set_hash_packed_limits(KV_DEFAULT_HASH_PACKED_FIELDS, KV_DEFAULT_HASH_PACKED_VALUE);
+    kv_init();
+}
+
+static void test_counters() {
+    kv_init();
+    int64_t n;
+    double d;
+    char buf[64];
+
+    // a missing key starts from 0 and a number set as text is parsed once
+    assert(kv_incrby("c", 1, &n) == 0 && n == 1);
+    assert(kv_incrby("c", -11, &n) == 0 && n == -10);
+    assert(strcmp(kv_get("c"), "-10") == 0);
+    assert(kv_set("c", "41") == 0);
+    assert(kv_incrby("c", 1, &n) == 0 && n == 42);
+    assert(kv_get_copy("c", buf, sizeof(buf)) == 2 && strcmp(buf, "42") == 0);
+    kv_ref ref;
+    assert(kv_get_ref("c", &ref) && ref.len == 2 && memcmp(ref.data, "42", 2) == 0 && !ref.pinned);
+    kv_ref_release(&ref);
+
+    // text that is not a canonical integer is refused and left alone
+    const char *not_integers[] = { "abc", "", " 1", "1 ", "+1", "01", "-0", "1.5", "9223372036854775808" };
+    for (size_t i = 0; i < sizeof(not_integers) / sizeof(not_integers[0]); i++) {
+        assert(kv_set("bad", not_integers[i]) == 0);
+        assert(kv_incrby("bad", 1, &n) == KV_ERR_NOT_INTEGER);
+        assert(strcmp(kv_get("bad"), not_integers[i]) == 0);
+    }
+
+    assert(kv_set("big", "9223372036854775807") == 0);
+    assert(kv_incrby("big", 1, &n) == KV_ERR_OVERFLOW);
+    assert(strcmp(kv_get("big"), "9223372036854775807") == 0);
+    assert(kv_incrby("big", -1, &n) == 0 && n == INT64_MAX - 1);
+    assert(kv_set("small", "-9223372036854775808") == 0);
+    assert(kv_incrby("small", -1, &n) == KV_ERR_OVERFLOW);
+
+    // float sums are formatted on read; whole ones stay integers
+    assert(kv_set("f", "10.5") == 0);
+    assert(kv_incrbyfloat("f", 0.1, &d) == 0 && d == 10.6);
+    assert(strcmp(kv_get("f"), "10.6") == 0);
+    assert(kv_incrby("f", 1, &n) == KV_ERR_NOT_INTEGER);
+    assert(kv_incrbyfloat("f", -0.6, &d) == 0 && d == 10);
+    assert(strcmp(kv_get("f"), "10") == 0);
+    assert(kv_incrby("f", 1, &n) == 0 && n == 11);
+    assert(kv_incrbyfloat("f", 1e308, &d) == 0);
+    assert(kv_incrbyfloat("f", 1e308, &d) == KV_ERR_OVERFLOW);
+    assert(kv_set("f", "x") == 0);
+    assert(kv_incrbyfloat("f", 1, &d) == KV_ERR_NOT_FLOAT);
+
+    // SET replaces a counter with text, and INCR keeps a TTL
+    assert(kv_set("c", "a value longer than the inline buffer") == 0);
+    assert(strcmp(kv_get("c"), "a value longer than the inline buffer") == 0);
+    assert(kv_setex("t", 1, "5", 1, 60000) == 0);
+    assert(kv_incrby("t", 1, &n) == 0 && n == 6);
+    assert(kv_ttl("t") > 0);
+
+    // hash fields, packed and dict, and the wrong types
+    assert(kv_hincrbyfloat("h", "f", 2.5, &d) == 0 && d == 2.5);
+    assert(kv_hincrby("h", "g", 7, &n) == 0 && n == 7);
+    assert(kv_hash_encoding("h") == KV_FIELDS_PACKED);
+    assert(strcmp(kv_hget("h", "f"), "2.5") == 0);
+    assert(kv_hget_copy("h", "g", buf, sizeof(buf)) == 1 && strcmp(buf, "7") == 0);
+    char field[32];
+    for (int i = 0; i < KV_DEFAULT_HASH_PACKED_FIELDS; i++) {
+        snprintf(field, sizeof(field), "n%d", i);
+        assert(kv_hincrby("h", field, i, &n) == 0);
+    }
+    assert(kv_hash_encoding("h") == KV_FIELDS_DICT);
+    assert(strcmp(kv_hget("h", "f"), "2.5") == 0);
+    assert(kv_hincrby("h", "g", 1, &n) == 0 && n == 8);
+    assert(kv_hget_ref("h", "n63", &ref) && ref.len == 2 && memcmp(ref.data, "63", 2) == 0);
+    kv_ref_release(&ref);
+    assert(kv_hset("h", "g", "text") == 0);
+    assert(strcmp(kv_hget("h", "g"), "text") == 0);
+    assert(kv_hincrby("h", "g", 1, &n) == KV_ERR_NOT_INTEGER);
+
+    assert(kv_incrby("h", 1, &n) == -1);
+    assert(kv_hincrby("c", "f", 1, &n) == -1);
+    assert(kv_hincrby("new", "f", INT64_MAX, &n) == 0);
+    assert(kv_hincrby("new", "f", 1, &n) == KV_ERR_OVERFLOW);
+
+    kv_init();
+}
 
 int main() {
+    test_concurrent_access();
+    test_hash_encodings();
+    test_counters();
+    test_variable_length_values();
+    test_pinned_values();
+    test_table_resizing();
+    test_delete_churn();
+    test_memory_accounting();
+    test_expiration();
+    test_eviction();
+
     kv_init();
 
     // Test basic set/get/delete
@@ -17,7 +667,7 @@ int main() {
     // Test inserting multiple keys
     const int num_keys = 2000; // Large number to test hash collisions + chaining
     for (int i = 0; i < num_keys; i++) {
-        char key[MAX_KEY_LEN], value[MAX_VAL_LEN];
+        char key[MAX_KEY_LEN], value[64];
         snprintf(key, sizeof(key), "key%d", i);
         snprintf(value, sizeof(value), "value%d", i);
         assert(kv_set(key, value) == 0);
@@ -25,7 +675,7 @@ int main() {
 
     // Test retrieving the inserted keys
     for (int i = 0; i < num_keys; i++) {
-        char key[MAX_KEY_LEN], expected_value[MAX_VAL_LEN];
+        char key[MAX_KEY_LEN], expected_value[64];
         snprintf(key, sizeof(key), "key%d", i);
         snprintf(expected_value, sizeof(expected_value), "value%d", i);
         const char* actual_value = kv_get(key);
@@ -43,7 +693,7 @@ int main() {
 
     // Ensure the other half still exists
     for (int i = 1; i < num_keys; i += 2) {
-        char key[MAX_KEY_LEN], expected_value[MAX_VAL_LEN];
+        char key[MAX_KEY_LEN], expected_value[64];
         snprintf(key, sizeof(key), "key%d", i);
         snprintf(expected_value, sizeof(expected_value), "value%d", i);
         const char* actual_value = kv_get(key);
@@ -53,8 +703,9 @@ int main() {
 
     assert(kv_hset("myhash", "field1", "val1") == 0);
     assert(strcmp(kv_hget("myhash", "field1"), "val1") == 0);
-    assert(kv_hincrby("myhash", "counter", 5) == 5);
-    assert(kv_hincrby("myhash", "counter", 2) == 7);
+    int64_t counter;
+    assert(kv_hincrby("myhash", "counter", 5, &counter) == 0 && counter == 5);
+    assert(kv_hincrby("myhash", "counter", 2, &counter) == 0 && counter == 7);
     assert(kv_is_hash("myhash") == true);
     assert(kv_get("myhash") == NULL); // type safety
 
@@ -1,12 +1,14 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "../src/protocol.h"
+#include "../src/errors.h"
 
 /**
  * @brief Runs tests to validate the protocol command parsing and extraction functions.
  *
- * Executes assertions to verify correct behavior of `parse_command`, `extract_key_value`, and `extract_key` for various command inputs. Prints a confirmation message if all tests pass.
+ * Executes assertions to verify correct behavior of `parse_command`, `lookup_command`, the command registry and `tokenize_command` for various command inputs. Prints a confirmation message if all tests pass.
  *
  * @return int Returns 0 upon successful completion of all tests.
  */
@@ -21,18 +23,114 @@ int main() {
     assert(parse_command("MSET k1 v1 k2 v2") == CMD_MSET);
     assert(parse_command("MGET k1 k2") == CMD_MGET);
     assert(parse_command("HSET h f v") == CMD_HSET);
+    assert(parse_command("EXPIRE k 10") == CMD_EXPIRE);
+    assert(parse_command("PEXPIRE k 10") == CMD_PEXPIRE);
+    assert(parse_command("TTL k") == CMD_TTL);
+    assert(parse_command("PTTL k") == CMD_PTTL);
+    assert(parse_command("PERSIST k") == CMD_PERSIST);
     assert(parse_command("HGET h f") == CMD_HGET);
     assert(parse_command("HMGET h f1 f2") == CMD_HMGET);
     assert(parse_command("HINCRBY h f 5") == CMD_HINCRBY);
     assert(parse_command("TYPE foo") == CMD_TYPE);
     assert(parse_command("INFO") == CMD_INFO);
+    assert(parse_command("MULTI") == CMD_MULTI);
+    assert(parse_command("EXEC") == CMD_EXEC);
+    assert(parse_command("DISCARD") == CMD_DISCARD);
 
-    char k[64], v[64];
-    assert(extract_key_value("SET foo bar", k, v, 64, 64) == 0);
-    assert(strcmp(k, "foo") == 0 && strcmp(v, "bar") == 0);
-    
-    assert(extract_key("GET key", k, 64) == 0);
-    assert(strcmp(k, "key") == 0);
+    assert(lookup_command("GET", 3) == CMD_GET);
+    assert(lookup_command("HMGET", 5) == CMD_HMGET);
+    assert(lookup_command("HMGETX", 6) == CMD_UNKNOWN);
+    assert(lookup_command("HM", 2) == CMD_UNKNOWN);
+    assert(lookup_command("get", 3) == CMD_GET);
+    assert(lookup_command("PExpire", 7) == CMD_PEXPIRE);
+    assert(lookup_command("GE\0", 3) == CMD_UNKNOWN);
+    assert(lookup_command("", 0) == CMD_UNKNOWN);
+    assert(lookup_command("INCRB", 5) == CMD_UNKNOWN);
+    assert(lookup_command("INCRBYFLOAT", 11) == CMD_INCRBYFLOAT);
+    assert(lookup_command("zzz", 3) == CMD_UNKNOWN);
+    assert(lookup_command("hset", 4) == CMD_HSET && lookup_command("HGET", 4) == CMD_HGET); // same slot
+    assert(parse_command("GET") == CMD_UNKNOWN);
+    assert(parse_command("ECHO hi") == CMD_ECHO);
+
+    // every command in the registry can be looked up by its name
+    for (int cmd = 0; cmd < CMD_COUNT; cmd++) {
+        const command_def_t *def = command_def(cmd);
+        assert(def->name != NULL && strlen(def->name) == def->len);
+        assert(lookup_command(def->name, def->len) == (command_t)cmd);
+        assert(def->first_key == 0 || def->key_step > 0);
+    }
+
+    assert(command_arity_ok(command_def(CMD_GET), 2));
+    assert(!command_arity_ok(command_def(CMD_GET), 3));
+    assert(command_arity_ok(command_def(CMD_MSET), 5));
+    assert(!command_arity_ok(command_def(CMD_MSET), 2));
+    assert(command_last_key(command_def(CMD_MSET), 5) == 4);
+    assert(command_last_key(command_def(CMD_GET), 2) == 1);
+
+    command_args_t args;
+    command_args_init(&args);
+    char line[1024];
+
+    strcpy(line, "SET foo bar\n");
+    assert(tokenize_command(line, &args) == EXTRACT_OK);
+    assert(args.argc == 3);
+    assert(strcmp(args.argv[0], "SET") == 0 && args.argv_len[0] == 3);
+    assert(strcmp(args.argv[1], "foo") == 0 && strcmp(args.argv[2], "bar") == 0);
+
+    // Quoted arguments keep their spaces; repeated spaces and CRLF are separators
+    strcpy(line, "SET  \"my key\"   \"a b c\"\r\n");
+    assert(tokenize_command(line, &args) == EXTRACT_OK);
+    assert(args.argc == 3);
+    assert(strcmp(args.argv[1], "my key") == 0 && args.argv_len[1] == 6);
+    assert(strcmp(args.argv[2], "a b c") == 0 && args.argv_len[2] == 5);
+
+    strcpy(line, "SET k \"\"");
+    assert(tokenize_command(line, &args) == EXTRACT_OK);
+    assert(args.argc == 3 && args.argv_len[2] == 0 && args.argv[2][0] == '\0');
+
+    strcpy(line, "SET k \"unterminated\n");
+    assert(tokenize_command(line, &args) == EXTRACT_ERR_PARSE);
+
+    // A closing quote must end its argument
+    strcpy(line, "SET \"foo\"bar v");
+    assert(tokenize_command(line, &args) == EXTRACT_ERR_PARSE);
+    strcpy(line, "SET k \"a\"\"b\"");
+    assert(tokenize_command(line, &args) == EXTRACT_ERR_PARSE);
+    strcpy(line, "SET \"foo\"\r\n");
+    assert(tokenize_command(line, &args) == EXTRACT_OK && args.argc == 2 && strcmp(args.argv[1], "foo") == 0);
+
+    strcpy(line, "   \n");
+    assert(tokenize_command(line, &args) == EXTRACT_OK && args.argc == 0);
+
+    // The argument arrays grow to fit any number of arguments
+    int count = 5000;
+    char *many = malloc((size_t)count * 2 + 1);
+    for (int i = 0; i < count; i++) {
+        many[i * 2] = 'a';
+        many[i * 2 + 1] = ' ';
+    }
+    many[count * 2] = '\0';
+    assert(tokenize_command(many, &args) == EXTRACT_OK && args.argc == count);
+    assert(args.cap >= count && strcmp(args.argv[count - 1], "a") == 0);
+    free(many);
+
+    // Queued commands keep a copy of their arguments, since the line is reused
+    command_queue_t queue = { 0 };
+    strcpy(line, "SET k \"a b\"");
+    assert(tokenize_command(line, &args) == EXTRACT_OK);
+    assert(command_queue_push(&queue, CMD_SET, &args) == EXTRACT_OK);
+    strcpy(line, "INCR n");
+    assert(tokenize_command(line, &args) == EXTRACT_OK);
+    for (int i = 0; i < 100; i++) assert(command_queue_push(&queue, CMD_INCR, &args) == EXTRACT_OK);
+    memset(line, 'x', sizeof(line));
+    assert(queue.count == 101);
+    assert(command_queue_load(&queue, 0, &args) == CMD_SET);
+    assert(args.argc == 3 && strcmp(args.argv[2], "a b") == 0 && args.argv_len[2] == 3);
+    assert(command_queue_load(&queue, 100, &args) == CMD_INCR);
+    assert(args.argc == 2 && strcmp(args.argv[1], "n") == 0);
+    command_queue_clear(&queue);
+    assert(queue.count == 0 && queue.bytes == NULL && !queue.active);
+    command_args_free(&args);
 
     printf("✅ Simple protocol tests passed\n");
     return 0;
@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/reply.h"
+
+void test_append_and_copy() {
+    reply_t out;
+    reply_init(&out);
+
+    reply_str(&out, "RESPONSE OK STRING\n");
+    reply_printf(&out, "%d) %s\n", 1, "value");
+    reply_append(&out, "END\n", 4);
+    assert(out.len == strlen("RESPONSE OK STRING\n1) value\nEND\n"));
+
+    char buf[64];
+    assert(reply_copy(&out, buf, sizeof(buf)) == out.len);
+    assert(strcmp(buf, "RESPONSE OK STRING\n1) value\nEND\n") == 0);
+
+    // a short buffer gets a truncated, terminated copy
+    assert(reply_copy(&out, buf, 9) == 8);
+    assert(strcmp(buf, "RESPONSE") == 0);
+
+    reply_reset(&out);
+    assert(out.len == 0);
+    assert(reply_copy(&out, buf, sizeof(buf)) == 0);
+
+    // formatted output longer than the stack buffer
+    char long_value[1000];
+    memset(long_value, 'x', sizeof(long_value) - 1);
+    long_value[sizeof(long_value) - 1] = '\0';
+    reply_printf(&out, "%s\n", long_value);
+    assert(out.len == sizeof(long_value));
+
+    reply_free(&out);
+}
+
+/**
+ * @brief Flushes replies spanning several blocks and checks they arrive whole and in order.
+ */
+void test_flush_blocks() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    // larger than the socket buffer, so the flush runs in a child while this reads
+    size_t total = 4 * REPLY_BLOCK_SIZE + 123;
+    char *expected = malloc(total);
+    for (size_t i = 0; i < total; i++) expected[i] = (char)('a' + i % 26);
+
+    reply_t out;
+    reply_init(&out);
+    // small appends that fill blocks, then one larger than a block
+    size_t small = REPLY_BLOCK_SIZE + 77;
+    for (size_t off = 0; off < small; off += 7) {
+        reply_append(&out, expected + off, off + 7 <= small ? 7 : small - off);
+    }
+    reply_append(&out, expected + small, total - small);
+    assert(out.len == total);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        _exit(reply_flush(&out, fds[1]) == 0 ? 0 : 1);
+    }
+    close(fds[1]);
+
+    char *received = malloc(total);
+    size_t got = 0;
+    ssize_t n;
+    while (got < total && (n = recv(fds[0], received + got, total - got, 0)) > 0) {
+        got += (size_t)n;
+    }
+    assert(got == total);
+    assert(memcmp(received, expected, total) == 0);
+
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    reply_free(&out);
+    assert(out.len == 0 && out.head == NULL);
+
+    free(received);
+    free(expected);
+    close(fds[0]);
+}
+
+/**
+ * @brief Lists the blocks after a partial send as iovecs, as the io_uring loop does.
+ */
+void test_iov_skip() {
+    reply_t out;
+    reply_init(&out);
+    char big[REPLY_BLOCK_SIZE];
+    memset(big, 'b', sizeof(big));
+    reply_str(&out, "head\n");
+    reply_append(&out, big, sizeof(big)); // does not fit the first block
+    reply_str(&out, "tail\n");
+
+    struct iovec iov[REPLY_MAX_IOV];
+    int count = reply_iov(&out, 0, iov, REPLY_MAX_IOV);
+    assert(count >= 2);
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += iov[i].iov_len;
+    assert(total == out.len);
+    assert(memcmp(iov[0].iov_base, "head\n", 5) == 0);
+
+    // skipping part of the first block starts mid-block
+    count = reply_iov(&out, 2, iov, REPLY_MAX_IOV);
+    assert(memcmp(iov[0].iov_base, "ad\n", 3) == 0);
+
+    // skipping whole blocks drops them
+    count = reply_iov(&out, out.len - 5, iov, REPLY_MAX_IOV);
+    assert(count == 1);
+    assert(iov[0].iov_len == 5 && memcmp(iov[0].iov_base, "tail\n", 5) == 0);
+
+    assert(reply_iov(&out, 0, iov, 1) == 1);
+    assert(reply_iov(&out, out.len, iov, REPLY_MAX_IOV) == 0);
+
+    reply_free(&out);
+}
+
+void test_flush_closed_peer() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    close(fds[0]);
+
+    reply_t out;
+    reply_init(&out);
+    reply_str(&out, "PONG\n");
+    // writev() has no MSG_NOSIGNAL: ignore SIGPIPE as the server does
+    signal(SIGPIPE, SIG_IGN);
+    assert(reply_flush(&out, fds[1]) == -1);
+    assert(out.len == 0);
+
+    reply_free(&out);
+    close(fds[1]);
+}
+
+/**
+ * @brief Writes into a full socket without blocking, keeping only the unsent bytes.
+ */
+void test_write_nonblocking() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    reply_t out;
+    reply_init(&out);
+    char chunk[REPLY_BLOCK_SIZE];
+    size_t total = 0;
+    for (int i = 0; i < 64; i++) {
+        memset(chunk, 'a' + i % 26, sizeof(chunk));
+        reply_append(&out, chunk, sizeof(chunk));
+        total += sizeof(chunk);
+    }
+
+    // 1 MB does not fit in the socket buffer of a peer that is not reading
+    size_t written = 0;
+    assert(reply_write(&out, fds[1], &written) == 0);
+    assert(out.len > written);
+    assert(out.len - written < total);
+    assert(written < REPLY_BLOCK_SIZE); // blocks sent in full are gone
+
+    char *received = malloc(total);
+    size_t got = 0;
+    while (got < total) {
+        ssize_t n = recv(fds[0], received + got, total - got, MSG_DONTWAIT);
+        if (n > 0) {
+            got += (size_t)n;
+            continue;
+        }
+        assert(reply_write(&out, fds[1], &written) == 0);
+    }
+    assert(out.len == 0 && written == 0);
+    for (size_t i = 0; i < total; i++) {
+        assert(received[i] == 'a' + (int)(i / REPLY_BLOCK_SIZE) % 26);
+    }
+    free(received);
+
+    close(fds[0]);
+    reply_str(&out, "PONG\n");
+    assert(reply_write(&out, fds[1], &written) == -1);
+    assert(out.len == 0);
+
+    reply_free(&out);
+    close(fds[1]);
+}
+
+static int released;
+
+static void count_release(const char *data) {
+    (void)data;
+    released++;
+}
+
+void test_ref() {
+    reply_t out;
+    reply_init(&out);
+    char value[REPLY_REF_MIN];
+    memset(value, 'v', sizeof(value));
+
+    // referenced bytes sit between copied ones without being copied
+    reply_str(&out, "$4096\r\n");
+    reply_ref(&out, value, sizeof(value), count_release);
+    reply_str(&out, "\r\n");
+    assert(out.len == 7 + sizeof(value) + 2);
+    struct iovec iov[REPLY_MAX_IOV];
+    assert(reply_iov(&out, 0, iov, REPLY_MAX_IOV) == 3);
+    assert(iov[1].iov_base == value);
+
+    char copy[8192];
+    assert(reply_copy(&out, copy, sizeof(copy)) == out.len);
+    assert(copy[7] == 'v' && strcmp(copy + 7 + sizeof(value), "\r\n") == 0);
+
+    // released once written, not before
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    assert(reply_flush(&out, fds[1]) == 0);
+    assert(released == 1);
+    assert(recv(fds[0], copy, 7 + sizeof(value) + 2, MSG_WAITALL) == (ssize_t)(7 + sizeof(value) + 2));
+
+    // a reference at the head is dropped on reset, and a failed reply releases right away
+    reply_free(&out);
+    reply_ref(&out, value, sizeof(value), count_release);
+    reply_reset(&out);
+    assert(released == 2 && out.len == 0 && out.head == NULL);
+    out.failed = true;
+    reply_ref(&out, value, sizeof(value), count_release);
+    assert(released == 3 && out.len == 0);
+
+    reply_free(&out);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main() {
+    test_append_and_copy();
+    test_flush_blocks();
+    test_iov_skip();
+    test_flush_closed_peer();
+    test_write_nonblocking();
+    test_ref();
+    printf("✅ Reply buffer tests passed\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/resp.h"
+#include "../src/kvstore.h"
+#include "../src/reply.h"
+
+time_t start_time = 0;
+
+// Parses and runs one complete command on a connection's arguments, returning its reply in buf.
+static size_t run_on(resp_command_t *cmd, const char *wire, size_t wire_len, char *buf, size_t buf_size) {
+    char *data = malloc(wire_len + 1);
+    memcpy(data, wire, wire_len);
+    resp_parser_t parser = { 0 };
+    assert(resp_parse(data, wire_len, cmd, &parser) == (ssize_t)wire_len);
+
+    reply_t out;
+    reply_init(&out);
+    resp_dispatch(&out, cmd);
+    size_t len = reply_copy(&out, buf, buf_size);
+    assert(len == out.len);
+    reply_free(&out);
+    free(data);
+    return len;
+}
+
+// Parses and runs one complete command, returning its reply in buf.
+static size_t run(const char *wire, size_t wire_len, char *buf, size_t buf_size) {
+    resp_command_t cmd;
+    command_args_init(&cmd);
+    size_t len = run_on(&cmd, wire, wire_len, buf, buf_size);
+    command_args_free(&cmd);
+    return len;
+}
+
+#define RUN(wire, buf) run(wire, sizeof(wire) - 1, buf, sizeof(buf))
+#define RUN_ON(cmd, wire, buf) run_on(cmd, wire, sizeof(wire) - 1, buf, sizeof(buf))
+
+void test_parse() {
+    char wire[] = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$0\r\n\r\n";
+    size_t len = sizeof(wire) - 1;
+    resp_command_t cmd;
+    command_args_init(&cmd);
+    resp_parser_t parser = { 0 };
+
+    // every proper prefix is incomplete and leaves the bytes untouched
+    for (size_t i = 0; i < len; i++) {
+        resp_parser_t fresh = { 0 };
+        assert(resp_parse(wire, i, &cmd, &fresh) == RESP_INCOMPLETE);
+    }
+    assert(strcmp(wire + len - 2, "\r\n") == 0);
+
+    assert(resp_parse(wire, len, &cmd, &parser) == (ssize_t)len);
+    assert(cmd.argc == 3);
+    assert(strcmp(cmd.argv[0], "SET") == 0 && cmd.argv_len[0] == 3);
+    assert(strcmp(cmd.argv[1], "key") == 0);
+    assert(cmd.argv_len[2] == 0 && cmd.argv[2][0] == '\0');
+
+    // a lone bulk string is a command of one argument
+    char bulk[] = "$4\r\nPING\r\n";
+    assert(resp_parse(bulk, sizeof(bulk) - 1, &cmd, &parser) == (ssize_t)sizeof(bulk) - 1);
+    assert(cmd.argc == 1 && strcmp(cmd.argv[0], "PING") == 0);
+
+    char empty[] = "*0\r\n";
+    assert(resp_parse(empty, 4, &cmd, &parser) == 4 && cmd.argc == 0);
+
+    char bad_type[] = "*1\r\n+PING\r\n";
+    assert(resp_parse(bad_type, sizeof(bad_type) - 1, &cmd, &(resp_parser_t){ 0 }) == RESP_PROTO_ERR);
+    char bad_len[] = "*1\r\n$x\r\n";
+    assert(resp_parse(bad_len, sizeof(bad_len) - 1, &cmd, &(resp_parser_t){ 0 }) == RESP_PROTO_ERR);
+    char bad_end[] = "*1\r\n$2\r\nPINGxx";
+    assert(resp_parse(bad_end, sizeof(bad_end) - 1, &cmd, &(resp_parser_t){ 0 }) == RESP_PROTO_ERR);
+    char inline_cmd[] = "PING\r\n";
+    assert(resp_parse(inline_cmd, sizeof(inline_cmd) - 1, &cmd, &(resp_parser_t){ 0 }) == RESP_PROTO_ERR);
+    char too_many[] = "*2000000\r\n";
+    assert(resp_parse(too_many, sizeof(too_many) - 1, &cmd, &(resp_parser_t){ 0 }) == RESP_PROTO_ERR);
+
+    // the argument arrays grow past any fixed count
+    size_t many_len = 16 + 10000 * 7;
+    char *many = malloc(many_len);
+    size_t pos = (size_t)sprintf(many, "*10000\r\n");
+    for (int i = 0; i < 10000; i++) pos += (size_t)sprintf(many + pos, "$1\r\nk\r\n");
+    assert(resp_parse(many, pos, &cmd, &parser) == (ssize_t)pos);
+    assert(cmd.argc == 10000 && cmd.cap >= 10000 && strcmp(cmd.argv[9999], "k") == 0);
+    free(many);
+
+    command_args_free(&cmd);
+}
+
+/**
+ * @brief Resumes a command fed a byte at a time, and after its bytes move.
+ */
+void test_parse_resume() {
+    char wire[] = "*3\r\n$3\r\nSET\r\n$5\r\nresum\r\n$2\r\nok\r\n";
+    size_t len = sizeof(wire) - 1;
+    resp_command_t cmd;
+    command_args_init(&cmd);
+    resp_parser_t parser = { 0 };
+
+    // complete arguments are not parsed again: the second one is done before the third arrives
+    for (size_t i = 0; i < len - 1; i++) {
+        assert(resp_parse(wire, i, &cmd, &parser) == RESP_INCOMPLETE);
+    }
+    assert(parser.argc == 3 && parser.parsed == 2 && parser.pos == len - 8);
+
+    // the partial command moves, as when a buffer is compacted or grown
+    char *moved = malloc(len);
+    memcpy(moved, wire, len - 1);
+    resp_parser_move(&parser, &cmd, wire, moved);
+    memset(wire, 'x', len);
+    moved[len - 1] = '\n';
+    assert(resp_parse(moved, len, &cmd, &parser) == (ssize_t)len);
+    assert(cmd.argc == 3 && strcmp(cmd.argv[0], "SET") == 0 && strcmp(cmd.argv[1], "resum") == 0);
+    assert(strcmp(cmd.argv[2], "ok") == 0 && parser.pos == 0 && parser.parsed == 0);
+
+    free(moved);
+    command_args_free(&cmd);
+}
+
+/**
+ * @brief Stores and reads back a value holding spaces, quotes, CRLF and NUL bytes.
+ */
+void test_binary_values() {
+    char buf[256];
+    size_t len = RUN("*3\r\n$3\r\nset\r\n$3\r\nbin\r\n$11\r\na \"b\"\r\n\0c d\r\n", buf);
+    assert(len == 5 && memcmp(buf, "+OK\r\n", 5) == 0);
+
+    len = RUN("*2\r\n$3\r\nGET\r\n$3\r\nbin\r\n", buf);
+    const char expected[] = "$11\r\na \"b\"\r\n\0c d\r\n";
+    assert(len == sizeof(expected) - 1 && memcmp(buf, expected, len) == 0);
+
+    len = RUN("*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n", buf);
+    assert(len == 5 && memcmp(buf, "$-1\r\n", 5) == 0);
+
+    RUN("*2\r\n$3\r\nGET\r\n$3\r\nk\0y\r\n", buf);
+    assert(strncmp(buf, "-ERR", 4) == 0);
+}
+
+void test_commands() {
+    char buf[4096];
+
+    RUN("*1\r\n$4\r\nPING\r\n", buf);
+    assert(strcmp(buf, "+PONG\r\n") == 0);
+    RUN("*2\r\n$4\r\nping\r\n$2\r\nhi\r\n", buf);
+    assert(strcmp(buf, "$2\r\nhi\r\n") == 0);
+
+    RUN("*5\r\n$4\r\nMSET\r\n$2\r\nk1\r\n$2\r\nv1\r\n$2\r\nk2\r\n$2\r\nv2\r\n", buf);
+    assert(strcmp(buf, "+OK\r\n") == 0);
+    RUN("*4\r\n$4\r\nMGET\r\n$2\r\nk1\r\n$2\r\nk3\r\n$2\r\nk2\r\n", buf);
+    assert(strcmp(buf, "*3\r\n$2\r\nv1\r\n$-1\r\n$2\r\nv2\r\n") == 0);
+    RUN("*4\r\n$3\r\nDEL\r\n$2\r\nk1\r\n$2\r\nk2\r\n$2\r\nk3\r\n", buf);
+    assert(strcmp(buf, ":2\r\n") == 0);
+
+    RUN("*6\r\n$4\r\nHSET\r\n$1\r\nh\r\n$1\r\na\r\n$1\r\n1\r\n$1\r\nb\r\n$1\r\n2\r\n", buf);
+    assert(strcmp(buf, ":2\r\n") == 0);
+    RUN("*4\r\n$4\r\nHSET\r\n$1\r\nh\r\n$1\r\na\r\n$1\r\n3\r\n", buf);
+    assert(strcmp(buf, ":0\r\n") == 0); // updated, not added
+    RUN("*3\r\n$4\r\nHGET\r\n$1\r\nh\r\n$1\r\na\r\n", buf);
+    assert(strcmp(buf, "$1\r\n3\r\n") == 0);
+    RUN("*4\r\n$5\r\nHMGET\r\n$1\r\nh\r\n$1\r\nb\r\n$1\r\nz\r\n", buf);
+    assert(strcmp(buf, "*2\r\n$1\r\n2\r\n$-1\r\n") == 0);
+    RUN("*4\r\n$7\r\nHINCRBY\r\n$1\r\nh\r\n$1\r\nb\r\n$2\r\n40\r\n", buf);
+    assert(strcmp(buf, ":42\r\n") == 0);
+    RUN("*4\r\n$7\r\nHINCRBY\r\n$1\r\nh\r\n$1\r\nb\r\n$3\r\n1.5\r\n", buf);
+    assert(strncmp(buf, "-ERR", 4) == 0);
+    RUN("*4\r\n$12\r\nHINCRBYFLOAT\r\n$1\r\nh\r\n$1\r\nb\r\n$3\r\n1.5\r\n", buf);
+    assert(strcmp(buf, "$4\r\n43.5\r\n") == 0);
+    RUN("*2\r\n$4\r\nINCR\r\n$1\r\nh\r\n", buf);
+    assert(strncmp(buf, "-WRONGTYPE", 10) == 0);
+    RUN("*2\r\n$4\r\nTYPE\r\n$1\r\nh\r\n", buf);
+    assert(strcmp(buf, "+hash\r\n") == 0);
+    RUN("*2\r\n$3\r\nGET\r\n$1\r\nh\r\n", buf);
+    assert(strncmp(buf, "-WRONGTYPE", 10) == 0);
+
+    RUN("*5\r\n$3\r\nSET\r\n$1\r\nt\r\n$1\r\nv\r\n$2\r\nEX\r\n$3\r\n100\r\n", buf);
+    assert(strcmp(buf, "+OK\r\n") == 0);
+    RUN("*2\r\n$3\r\nTTL\r\n$1\r\nt\r\n", buf);
+    assert(strcmp(buf, ":100\r\n") == 0);
+    RUN("*2\r\n$7\r\nPERSIST\r\n$1\r\nt\r\n", buf);
+    assert(strcmp(buf, ":1\r\n") == 0);
+    RUN("*2\r\n$4\r\nPTTL\r\n$1\r\nt\r\n", buf);
+    assert(strcmp(buf, ":-1\r\n") == 0);
+    RUN("*5\r\n$3\r\nSET\r\n$1\r\nt\r\n$1\r\nv\r\n$2\r\nXX\r\n$1\r\n1\r\n", buf);
+    assert(strcmp(buf, "-ERR syntax error\r\n") == 0);
+
+    RUN("*2\r\n$4\r\nINCR\r\n$1\r\nn\r\n", buf);
+    assert(strcmp(buf, ":1\r\n") == 0);
+    RUN("*3\r\n$6\r\nDECRBY\r\n$1\r\nn\r\n$2\r\n11\r\n", buf);
+    assert(strcmp(buf, ":-10\r\n") == 0);
+    RUN("*3\r\n$11\r\nINCRBYFLOAT\r\n$1\r\nn\r\n$4\r\n0.75\r\n", buf);
+    assert(strcmp(buf, "$5\r\n-9.25\r\n") == 0);
+    RUN("*2\r\n$3\r\nGET\r\n$1\r\nn\r\n", buf);
+    assert(strcmp(buf, "$5\r\n-9.25\r\n") == 0);
+    RUN("*2\r\n$4\r\nDECR\r\n$1\r\nn\r\n", buf);
+    assert(strcmp(buf, "-ERR value is not an integer or out of range\r\n") == 0);
+    RUN("*3\r\n$3\r\nSET\r\n$1\r\ns\r\n$2\r\nv1\r\n", buf);
+    RUN("*3\r\n$6\r\nINCRBY\r\n$1\r\ns\r\n$1\r\n1\r\n", buf);
+    assert(strcmp(buf, "-ERR value is not an integer or out of range\r\n") == 0);
+    RUN("*3\r\n$6\r\nDECRBY\r\n$1\r\nm\r\n$20\r\n-9223372036854775808\r\n", buf);
+    assert(strncmp(buf, "-ERR", 4) == 0);
+
+    RUN("*1\r\n$4\r\nINFO\r\n", buf);
+    assert(buf[0] == '$' && strstr(buf, "Keys: ") != NULL);
+    RUN("*1\r\n$4\r\nTIME\r\n", buf);
+    assert(strncmp(buf, "*2\r\n$", 5) == 0);
+}
+
+void test_transactions() {
+    char buf[256];
+    resp_command_t conn;
+    command_args_init(&conn);
+
+    RUN_ON(&conn, "*1\r\n$5\r\nMULTI\r\n", buf);
+    assert(strcmp(buf, "+OK\r\n") == 0);
+    RUN_ON(&conn, "*3\r\n$3\r\nSET\r\n$2\r\ntx\r\n$3\r\na\0b\r\n", buf);
+    assert(strcmp(buf, "+QUEUED\r\n") == 0);
+    RUN_ON(&conn, "*2\r\n$3\r\nGET\r\n$2\r\ntx\r\n", buf);
+    RUN_ON(&conn, "*2\r\n$4\r\nINCR\r\n$2\r\ntx\r\n", buf);
+    RUN_ON(&conn, "*2\r\n$4\r\nINCR\r\n$2\r\ntn\r\n", buf);
+    assert(strcmp(buf, "+QUEUED\r\n") == 0);
+    size_t len = RUN_ON(&conn, "*1\r\n$4\r\nexec\r\n", buf);
+    const char expected[] = "*4\r\n+OK\r\n$3\r\na\0b\r\n-ERR value is not an integer or out of range\r\n:1\r\n";
+    assert(len == sizeof(expected) - 1 && memcmp(buf, expected, len) == 0);
+
+    RUN_ON(&conn, "*1\r\n$4\r\nEXEC\r\n", buf);
+    assert(strcmp(buf, "-ERR EXEC without MULTI\r\n") == 0);
+    RUN_ON(&conn, "*1\r\n$7\r\nDISCARD\r\n", buf);
+    assert(strcmp(buf, "-ERR DISCARD without MULTI\r\n") == 0);
+
+    RUN_ON(&conn, "*1\r\n$5\r\nMULTI\r\n", buf);
+    RUN_ON(&conn, "*1\r\n$5\r\nMULTI\r\n", buf);
+    assert(strcmp(buf, "-ERR MULTI calls can not be nested\r\n") == 0);
+    RUN_ON(&conn, "*2\r\n$3\r\nDEL\r\n$2\r\ntn\r\n", buf);
+    RUN_ON(&conn, "*1\r\n$7\r\nDISCARD\r\n", buf);
+    assert(strcmp(buf, "+OK\r\n") == 0);
+    assert(strcmp(kv_get("tn"), "1") == 0);
+
+    RUN_ON(&conn, "*1\r\n$5\r\nMULTI\r\n", buf);
+    RUN_ON(&conn, "*2\r\n$3\r\nDEL\r\n$2\r\ntn\r\n", buf);
+    RUN_ON(&conn, "*1\r\n$4\r\nNOPE\r\n", buf);
+    RUN_ON(&conn, "*1\r\n$4\r\nEXEC\r\n", buf);
+    assert(strcmp(buf, "-EXECABORT Transaction discarded because of previous errors.\r\n") == 0);
+    assert(strcmp(kv_get("tn"), "1") == 0);
+
+    command_args_free(&conn);
+}
+
+void test_errors() {
+    char buf[256];
+    RUN("*1\r\n$3\r\nGET\r\n", buf);
+    assert(strcmp(buf, "-ERR wrong number of arguments for 'get' command\r\n") == 0);
+    RUN("*2\r\n$4\r\nMSET\r\n$1\r\nk\r\n", buf);
+    assert(strcmp(buf, "-ERR wrong number of arguments for 'mset' command\r\n") == 0);
+    RUN("*1\r\n$6\r\nNO\r\nPE\r\n", buf);
+    assert(strcmp(buf, "-ERR unknown command 'NO  PE'\r\n") == 0);
+}
+
+int main() {
+    kv_init();
+    test_parse();
+    test_parse_resume();
+    test_binary_values();
+    test_commands();
+    test_transactions();
+    test_errors();
+    printf("✅ RESP tests passed\n");
+    return 0;
+}
@@ -1,14 +1,22 @@
 #include <assert.h>
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <netinet/in.h>
+#include <signal.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <time.h>
 
 #include "../src/server_utils.h"
+#include "../src/reactor.h"
+#include "../src/uring.h"
 #include "../src/errors.h"
 #include "../src/kvstore.h"
+#include "../src/clients.h"
 
 #define BUF_SIZE 1024
 
@@ -49,21 +57,24 @@ int response_contains(const char *buf, const char *expected_resp) {
  * @brief Tests the dispatch_command function by sending a command and verifying the response.
  */
 void test_dispatch_command(const char *cmd, const char *expected_resp) {
-    int fds[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reply_t out;
+    reply_init(&out);
 
-    dispatch_command(fds[1], cmd);
-    shutdown(fds[1], SHUT_WR);
+    char line[1024];
+    snprintf(line, sizeof(line), "%s", cmd);
+    command_args_t args;
+    command_args_init(&args);
+    dispatch_command(&out, &args, line);
+    command_args_free(&args);
 
-    char buf[1024] = {0};
-    recv_until_end(fds[0], buf, sizeof(buf));
+    char buf[1024];
+    reply_copy(&out, buf, sizeof(buf));
 
     printf("Response:\n%s\n", buf);
 
     assert(strstr(buf, expected_resp) != NULL);
 
-    close(fds[0]);
-    close(fds[1]); 
+    reply_free(&out);
 }
 
 /**
@@ -92,6 +103,391 @@ void test_handle_client(const char *cmd, const char *expected_resp) {
     close(fds[1]); 
 }
 
+static int count_occurrences(const char *haystack, const char *needle) {
+    int count = 0;
+    for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+// Reads replies until `replies` END lines have arrived.
+static void recv_replies(int fd, char *buf, size_t buf_size, int replies) {
+    size_t total_read = 0;
+    buf[0] = '\0';
+    while (total_read < buf_size - 1 && count_occurrences(buf, "END\n") < replies) {
+        ssize_t n = recv(fd, buf + total_read, buf_size - 1 - total_read, 0);
+        if (n <= 0) break;
+        total_read += n;
+        buf[total_read] = '\0';
+    }
+}
+
+/**
+ * @brief Feeds input_buffer_dispatch() commands split and merged across reads.
+ */
+void test_input_buffer() {
+    reply_t out;
+    reply_init(&out);
+
+    input_buffer_t in;
+    input_buffer_init(&in);
+    size_t avail;
+    char *space;
+
+    // one complete command and the start of the next
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, "PING\nPI", 7);
+    assert(input_buffer_dispatch(&out, &in, 7) == 1);
+    assert(in.len == 2 && memcmp(in.data, "PI", 2) == 0);
+
+    // the rest of it, followed by blank lines that are skipped
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, "NG\r\n\r\n\n", 7);
+    assert(input_buffer_dispatch(&out, &in, 7) == 1);
+    assert(in.len == 0);
+
+    // a line longer than the inline buffer moves to a heap buffer that grows
+    client_limits_t limits = { .max_request = 4 * INPUT_BUFFER_SIZE };
+    clients_set_limits(&limits);
+    space = input_buffer_space(&in, &avail);
+    assert(avail == INPUT_BUFFER_SIZE - 1);
+    memcpy(space, "ECHO ", 5);
+    memset(space + 5, 'e', avail - 5);
+    assert(input_buffer_dispatch(&out, &in, avail) == 0);
+    assert(in.data != in.small && in.cap > INPUT_BUFFER_SIZE);
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, "\nPING\n", 6);
+    assert(input_buffer_dispatch(&out, &in, 6) == 2);
+    assert(in.len == 0 && in.data == in.small); // drained, back to the inline buffer
+
+    // a line over max_request is refused and dropped up to its newline
+    size_t total = 0;
+    while (!in.discarding) {
+        space = input_buffer_space(&in, &avail);
+        memset(space, 'A', avail);
+        assert(input_buffer_dispatch(&out, &in, avail) == 0);
+        total += avail;
+    }
+    assert(total == limits.max_request);
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, "AAA\nPING\n", 9);
+    assert(input_buffer_dispatch(&out, &in, 9) == 1);
+    assert(!in.discarding && in.len == 0);
+    limits.max_request = 0;
+    clients_set_limits(&limits);
+
+    char buf[8192];
+    reply_copy(&out, buf, sizeof(buf));
+    assert(count_occurrences(buf, "END\n") == 6);
+    assert(count_occurrences(buf, "PONG") == 4);
+    assert(strstr(buf, "eeeeeeee\nEND") != NULL);
+    assert(strstr(buf, "ERROR line too long") != NULL);
+
+    input_buffer_free(&in);
+    reply_free(&out);
+}
+
+/**
+ * @brief Detects RESP2 from the first byte and runs commands split and pipelined across reads.
+ */
+void test_input_buffer_resp() {
+    reply_t out;
+    reply_init(&out);
+    input_buffer_t in;
+    input_buffer_init(&in);
+    size_t avail;
+    char *space;
+
+    const char *first = "*3\r\n$3\r\nSET\r\n$4\r\nresp\r\n$6\r\na\r\nb c\r\n*2\r\n$3\r\nGET\r\n$4\r";
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, first, strlen(first));
+    assert(input_buffer_dispatch(&out, &in, strlen(first)) == 1);
+    assert(in.protocol == PROTOCOL_RESP);
+
+    const char *rest = "\nresp\r\n*1\r\n$4\r\nPING\r\n";
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, rest, strlen(rest));
+    assert(input_buffer_dispatch(&out, &in, strlen(rest)) == 2);
+    assert(in.len == 0 && !in.failed);
+
+    char buf[256];
+    reply_copy(&out, buf, sizeof(buf));
+    assert(strcmp(buf, "+OK\r\n$6\r\na\r\nb c\r\n+PONG\r\n") == 0);
+    reply_reset(&out);
+
+    // bytes that are not RESP2 get an error and fail the connection
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, "PING\r\n", 6);
+    assert(input_buffer_dispatch(&out, &in, 6) == 0);
+    assert(in.failed);
+    reply_copy(&out, buf, sizeof(buf));
+    assert(strcmp(buf, "-ERR Protocol error\r\n") == 0);
+
+    // a text connection stays text even if a line starts with '*'
+    input_buffer_free(&in);
+    input_buffer_init(&in);
+    reply_reset(&out);
+    space = input_buffer_space(&in, &avail);
+    memcpy(space, "PING\n*1\n", 8);
+    assert(input_buffer_dispatch(&out, &in, 8) == 2);
+    assert(in.protocol == PROTOCOL_TEXT);
+    reply_copy(&out, buf, sizeof(buf));
+    assert(strstr(buf, "ERROR unknown command") != NULL);
+
+    // an MSET of thousands of keys arrives over many reads into a growing buffer
+    input_buffer_free(&in);
+    input_buffer_init(&in);
+    reply_reset(&out);
+    int keys = 5000;
+    size_t wire_size = 32 + (size_t)keys * 32;
+    char *wire = malloc(wire_size);
+    size_t wire_len = (size_t)sprintf(wire, "*%d\r\n$4\r\nMSET\r\n", 1 + keys * 2);
+    for (int i = 0; i < keys; i++) {
+        wire_len += (size_t)sprintf(wire + wire_len, "$7\r\nbk%05d\r\n$1\r\nv\r\n", i);
+    }
+    int dispatched = 0;
+    for (size_t fed = 0; fed < wire_len;) {
+        space = input_buffer_space(&in, &avail);
+        size_t n = wire_len - fed < avail ? wire_len - fed : avail;
+        memcpy(space, wire + fed, n);
+        dispatched += input_buffer_dispatch(&out, &in, n);
+        fed += n;
+    }
+    free(wire);
+    assert(dispatched == 1 && !in.failed);
+    reply_copy(&out, buf, sizeof(buf));
+    assert(strcmp(buf, "+OK\r\n") == 0);
+    assert(strcmp(kv_get("bk04999"), "v") == 0);
+
+    input_buffer_free(&in);
+    reply_free(&out);
+}
+
+/**
+ * @brief Pipelines many commands in one write and splits one across writes.
+ */
+void test_handle_client_pipelined() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, handle_client, (void*)(intptr_t)fds[1]);
+
+    enum { PIPELINED = 200 };
+    char cmds[PIPELINED * 16];
+    size_t len = 0;
+    for (int i = 0; i < PIPELINED; i++) {
+        len += (size_t)snprintf(cmds + len, sizeof(cmds) - len, "SET pipe%d v%d\n", i, i);
+    }
+    write(fds[0], cmds, len);
+
+    char buf[PIPELINED * 64];
+    recv_replies(fds[0], buf, sizeof(buf), PIPELINED);
+    assert(count_occurrences(buf, "\nOK\n") == PIPELINED);
+
+    // a command arriving in two pieces is answered once, when complete
+    write(fds[0], "GET pi", 6);
+    usleep(10000);
+    write(fds[0], "pe199\n", 7);
+    shutdown(fds[0], SHUT_WR);
+    recv_replies(fds[0], buf, sizeof(buf), 1);
+    printf("Split command response:\n%s\n", buf);
+    assert(strstr(buf, "v199") != NULL);
+
+    pthread_join(thread, NULL);
+    close(fds[0]);
+}
+
+static volatile sig_atomic_t reactor_running = 1;
+
+static io_thread_stats_t *reactor_stats;
+
+static void *reactor_thread(void *arg) {
+    reactor_run((int)(intptr_t)arg, reactor_stats, &reactor_running);
+    return NULL;
+}
+
+static int connect_to(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = port, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+/**
+ * @brief Serves several connections from one reactor thread and stops it.
+ */
+void test_reactor() {
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    assert(bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(listenfd, 16) == 0);
+    assert(getsockname(listenfd, (struct sockaddr *)&addr, &addr_len) == 0);
+
+    reactor_stats = iostats_register(-1);
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_thread, (void *)(intptr_t)listenfd);
+
+    // the first connection stays open and idle while the others are served
+    int idle = connect_to(addr.sin_port);
+    const char *cmds[] = { "SET reactor works\n", "GET reactor\n", "PING\n" };
+    const char *expected[] = { "OK", "works", "PONG" };
+    for (int i = 0; i < 3; i++) {
+        int fd = connect_to(addr.sin_port);
+        write(fd, cmds[i], strlen(cmds[i]));
+
+        char buf[1024] = {0};
+        recv_until_end(fd, buf, sizeof(buf));
+        printf("Reactor response:\n%s\n", buf);
+        assert(strstr(buf, expected[i]) != NULL);
+        close(fd);
+    }
+
+    write(idle, "PING\n", 5);
+    char buf[1024] = {0};
+    recv_until_end(idle, buf, sizeof(buf));
+    assert(strstr(buf, "PONG") != NULL);
+    close(idle);
+
+    reactor_running = 0;
+    pthread_join(thread, NULL);
+    close(listenfd);
+
+    io_thread_stats_t stats[IOSTATS_MAX_THREADS];
+    assert(iostats_get(stats, IOSTATS_MAX_THREADS) == 1);
+    assert(stats[0].cpu == -1);
+    assert(stats[0].accepted == 4);
+    assert(stats[0].connections == 0);
+    assert(stats[0].commands == 4);
+    assert(stats[0].bytes_in == strlen("SET reactor works\n") + strlen("GET reactor\n") + 2 * strlen("PING\n"));
+}
+
+/**
+ * @brief A client that stops reading neither stalls the loop nor grows past the hard limit.
+ */
+void test_reactor_slow_consumer() {
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    assert(bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(listenfd, 16) == 0);
+    assert(getsockname(listenfd, (struct sockaddr *)&addr, &addr_len) == 0);
+
+    client_limits_t limits = { 0 };
+    clients_set_limits(&limits);
+    reactor_running = 1;
+    reactor_stats = NULL;
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_thread, (void *)(intptr_t)listenfd);
+
+    char set[1024] = "SET slow ";
+    memset(set + 9, 'x', 900);
+    strcpy(set + 909, "\n");
+    char buf[1024] = {0};
+    // a small receive buffer keeps the kernel from absorbing the replies
+    int slow = socket(AF_INET, SOCK_STREAM, 0);
+    int rcvbuf = 4096;
+    setsockopt(slow, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    assert(connect(slow, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    write(slow, set, strlen(set));
+    recv_until_end(slow, buf, sizeof(buf));
+
+    // about 9 MB of replies, far more than the socket buffers hold
+    const char *get = "GET slow\n";
+    for (int i = 0; i < 10000; i++) write(slow, get, strlen(get));
+
+    int fast = connect_to(addr.sin_port);
+    struct timeval timeout = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(fast, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    write(fast, "PING\n", 5);
+    memset(buf, 0, sizeof(buf));
+    recv_until_end(fast, buf, sizeof(buf));
+    assert(strstr(buf, "PONG") != NULL);
+
+    // over the hard limit the next batch disconnects it
+    limits.output_hard_limit = 64 * 1024;
+    clients_set_limits(&limits);
+    write(slow, get, strlen(get));
+    setsockopt(slow, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char drain[65536];
+    ssize_t n;
+    while ((n = recv(slow, drain, sizeof(drain), 0)) > 0) {}
+    assert(n == 0 || errno == ECONNRESET);
+
+    client_stats_t stats;
+    clients_stats(&stats);
+    assert(stats.evicted == 1);
+    close(slow);
+    close(fast);
+
+    reactor_running = 0;
+    pthread_join(thread, NULL);
+    close(listenfd);
+    limits.output_hard_limit = 0;
+    clients_set_limits(&limits);
+}
+
+static volatile sig_atomic_t uring_running = 1;
+static io_thread_stats_t *uring_stats;
+static int uring_result;
+
+static void *uring_thread(void *arg) {
+    uring_result = uring_run((int)(intptr_t)arg, uring_stats, &uring_running);
+    return NULL;
+}
+
+/**
+ * @brief Serves plain and pipelined connections from an io_uring loop, if the kernel has one.
+ */
+void test_uring() {
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    assert(bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(listenfd, 16) == 0);
+    assert(getsockname(listenfd, (struct sockaddr *)&addr, &addr_len) == 0);
+
+    uring_stats = iostats_register(-1);
+    pthread_t thread;
+    pthread_create(&thread, NULL, uring_thread, (void *)(intptr_t)listenfd);
+
+    // connect() completes from the backlog even if the loop never starts, so
+    // an unsupported kernel shows up as no reply
+    int fd = connect_to(addr.sin_port);
+    struct timeval timeout = { .tv_sec = 5, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    write(fd, "SET uring works\n", strlen("SET uring works\n"));
+    char buf[1024] = {0};
+    recv_until_end(fd, buf, sizeof(buf));
+    if (buf[0] == '\0') {
+        pthread_join(thread, NULL);
+        assert(uring_result == URING_UNSUPPORTED);
+        printf("io_uring not supported, skipping\n");
+        close(fd);
+        close(listenfd);
+        return;
+    }
+    assert(strstr(buf, "OK") != NULL);
+
+    // a pipelined batch is answered in order
+    const char *batch = "GET uring\nPING\nGET uring\n";
+    write(fd, batch, strlen(batch));
+    char replies[4096] = {0};
+    recv_replies(fd, replies, sizeof(replies), 3);
+    assert(count_occurrences(replies, "works") == 2);
+    assert(strstr(replies, "PONG") != NULL);
+    close(fd);
+
+    uring_running = 0;
+    pthread_join(thread, NULL);
+    assert(uring_result == 0);
+    close(listenfd);
+
+    assert(uring_stats->accepted == 1);
+    assert(uring_stats->commands == 4);
+    assert(strcmp(uring_stats->backend, "uring") == 0);
+}
+
 /**
  * @brief Runs all server command and client handler tests.
  */
@@ -109,6 +505,13 @@ int main() {
     test_handle_client("DEL test\n", "DELETED");
     test_handle_client("NOEXIST\n", "ERROR unknown command");
 
+    test_input_buffer();
+    test_input_buffer_resp();
+    test_handle_client_pipelined();
+    test_reactor();
+    test_reactor_slow_consumer();
+    test_uring();
+
     printf("✅ All server tests passed!\n");
     return 0;
 }
\ No newline at end of file
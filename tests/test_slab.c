@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/slab.h"
+
+typedef struct {
+    uint64_t id;
+    char payload[56];
+} test_obj;
+
+static slab_cache obj_cache = SLAB_CACHE_INIT("test_obj", sizeof(test_obj));
+
+#define OBJS_PER_THREAD 20000
+#define THREADS 4
+
+static slab_stats_t cache_stats(void) {
+    slab_stats_t stats[SLAB_MAX_CACHES];
+    int n = slab_get_stats(stats, SLAB_MAX_CACHES);
+    for (int i = 0; i < n; i++) {
+        if (strcmp(stats[i].name, "test_obj") == 0) return stats[i];
+    }
+    assert(0 && "test_obj cache not registered");
+    return stats[0];
+}
+
+void test_alloc_free() {
+    test_obj **objs = malloc(OBJS_PER_THREAD * sizeof(test_obj *));
+    for (uint64_t i = 0; i < OBJS_PER_THREAD; i++) {
+        objs[i] = slab_alloc(&obj_cache);
+        assert(objs[i] != NULL);
+        objs[i]->id = i;
+        memset(objs[i]->payload, (int)(i & 0xFF), sizeof(objs[i]->payload));
+    }
+    // no two live objects overlap
+    for (uint64_t i = 0; i < OBJS_PER_THREAD; i++) {
+        assert(objs[i]->id == i);
+        assert(objs[i]->payload[sizeof(objs[i]->payload) - 1] == (char)(i & 0xFF));
+    }
+
+    slab_flush_thread();
+    slab_stats_t stats = cache_stats();
+    assert(stats.obj_size == sizeof(test_obj));
+    assert(stats.in_use == OBJS_PER_THREAD);
+    assert(stats.slabs >= OBJS_PER_THREAD / (SLAB_SIZE / sizeof(test_obj)));
+    size_t slabs = stats.slabs;
+
+    for (int i = 0; i < OBJS_PER_THREAD; i++) {
+        slab_free(&obj_cache, objs[i]);
+    }
+    slab_flush_thread();
+    stats = cache_stats();
+    assert(stats.in_use == 0);
+    assert(stats.free_objects == stats.objects);
+    assert(stats.fragmentation == 1.0);
+
+    // freed objects are reused before new slabs are carved
+    for (int i = 0; i < OBJS_PER_THREAD; i++) {
+        objs[i] = slab_alloc(&obj_cache);
+    }
+    slab_flush_thread();
+    assert(cache_stats().slabs == slabs);
+    for (int i = 0; i < OBJS_PER_THREAD; i++) {
+        slab_free(&obj_cache, objs[i]);
+    }
+    slab_flush_thread();
+    free(objs);
+}
+
+typedef struct {
+    test_obj **objs;
+    uint64_t base;
+} worker_arg;
+
+static void *allocator_thread(void *arg) {
+    worker_arg *w = arg;
+    for (uint64_t i = 0; i < OBJS_PER_THREAD; i++) {
+        w->objs[i] = slab_alloc(&obj_cache);
+        assert(w->objs[i] != NULL);
+        w->objs[i]->id = w->base + i;
+    }
+    return NULL;
+}
+
+static void *freeing_thread(void *arg) {
+    worker_arg *w = arg;
+    for (uint64_t i = 0; i < OBJS_PER_THREAD; i++) {
+        assert(w->objs[i]->id == w->base + i);
+        slab_free(&obj_cache, w->objs[i]);
+    }
+    return NULL;
+}
+
+void test_cross_thread_free() {
+    pthread_t tids[THREADS];
+    worker_arg args[THREADS];
+
+    for (int t = 0; t < THREADS; t++) {
+        args[t].objs = malloc(OBJS_PER_THREAD * sizeof(test_obj *));
+        args[t].base = (uint64_t)t * OBJS_PER_THREAD;
+        pthread_create(&tids[t], NULL, allocator_thread, &args[t]);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    // free each batch from a different thread than the one that allocated it
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&tids[t], NULL, freeing_thread, &args[(t + 1) % THREADS]);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        free(args[t].objs);
+    }
+
+    // exiting threads returned their magazines to the depot
+    slab_stats_t stats = cache_stats();
+    assert(stats.in_use == 0);
+    assert(stats.free_objects == stats.objects);
+}
+
+int main() {
+    test_alloc_free();
+    test_cross_thread_free();
+    printf("✅ Slab allocator tests passed\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/workers.h"
+
+// Stands in for handle_client: blocks until a byte arrives on the pipe, then closes it.
+static void* hold_until_written(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    char c;
+    assert(read(fd, &c, 1) == 1);
+    close(fd);
+    return NULL;
+}
+
+// Polls the pool until busy and queued reach the wanted values, failing after a second.
+static void wait_for(int busy, int queued) {
+    const struct timespec tick = { 0, 1000000L };
+    worker_pool_stats_t stats;
+    for (int i = 0; i < 1000; i++) {
+        workers_stats(&stats);
+        if (stats.busy == busy && stats.queued == queued) return;
+        nanosleep(&tick, NULL);
+    }
+    assert(0 && "worker pool did not settle");
+}
+
+/**
+ * @brief One worker and a queue of one: a third connection waits, then is rejected.
+ */
+void test_admission() {
+    assert(workers_init(1, 1, hold_until_written) == 0);
+
+    int a[2], b[2], c[2];
+    assert(pipe(a) == 0 && pipe(b) == 0 && pipe(c) == 0);
+
+    assert(workers_submit(a[0]) == 0);
+    wait_for(1, 0);
+    assert(workers_submit(b[0]) == 0);
+
+    struct timespec before, after;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    assert(workers_submit(c[0]) == -1);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    long waited_ms = (after.tv_sec - before.tv_sec) * 1000 + (after.tv_nsec - before.tv_nsec) / 1000000;
+    assert(waited_ms >= WORKERS_ADMISSION_WAIT_MS - 1);
+
+    worker_pool_stats_t stats;
+    workers_stats(&stats);
+    assert(stats.threads == 1 && stats.max_threads == 1);
+    assert(stats.busy == 1 && stats.queued == 1 && stats.queue_depth == 1);
+    assert(stats.accepted == 2 && stats.delayed == 1 && stats.rejected == 1);
+
+    // the worker drains the queue once the first connection ends
+    assert(write(a[1], "x", 1) == 1);
+    wait_for(1, 0);
+    assert(workers_submit(c[0]) == 0);
+    assert(write(b[1], "x", 1) == 1);
+    assert(write(c[1], "x", 1) == 1);
+    wait_for(0, 0);
+
+    workers_stats(&stats);
+    assert(stats.threads == 1 && stats.accepted == 3 && stats.rejected == 1);
+    close(a[1]);
+    close(b[1]);
+    close(c[1]);
+}
+
+int main() {
+    test_admission();
+    printf("✅ Worker pool tests passed\n");
+    return 0;
+}